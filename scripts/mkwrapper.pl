@@ -71,10 +71,24 @@ void ::Murmur::${class}I::${func}_async('. join(", ", @{$wrapargs}).qq') {
 		}
 	}
 #endif
-	ExecEvent *ie = new ExecEvent(boost::bind(&impl_${class}_$func, ' . join(", ", @${callargs}).qq'));
+#ifdef SNAPSHOT_${class}_${func}
+	if (snapshot_${class}_${func}(' . join(", ", @${callargs}).qq'))
+		return;
+#endif
+';
+  if ($class eq "Server") {
+    print $I qq'#ifndef MAIN_${class}_${func}
+	postServer(' . $callargs->[1] . qq', boost::bind(&impl_${class}_$func, ' . join(", ", @${callargs}).qq'));
+#else
+';
+  }
+  print $I qq'	ExecEvent *ie = new ExecEvent(boost::bind(&impl_${class}_$func, ' . join(", ", @${callargs}).qq'));
 	QCoreApplication::instance()->postEvent(mi, ie);
-}
 ';
+  if ($class eq "Server") {
+    print $I "#endif\n";
+  }
+  print $I "}\n";
 
   if( ! grep(/impl_${class}_$func/,@mi)) {
     print $B "static void impl_${class}_$func(".join(", ", @${implargs}). ") {}\n";
@@ -128,17 +128,22 @@ QSet<Channel *> Channel::allLinks() {
 QSet<Channel *> Channel::allChildren() {
 	QSet<Channel *> seen;
 	if (! qlChannels.isEmpty()) {
-		QStack<Channel *> stack;
-		stack.push(this);
-
-		while (! stack.isEmpty()) {
-			Channel *c = stack.pop();
-			foreach(Channel *chld, c->qlChannels) {
-				seen.insert(chld);
-				if (! chld->qlChannels.isEmpty())
-					stack.append(chld);
-			}
+		// Collect into a flat list first; growing a vector is much
+		// cheaper than growing the hash one child at a time.
+		QVector<Channel *> children;
+		children.reserve(qlChannels.count());
+		foreach(Channel *chld, qlChannels)
+			children.append(chld);
+
+		for (int i = 0; i < children.count(); ++i) {
+			const Channel *c = children.at(i);
+			foreach(Channel *chld, c->qlChannels)
+				children.append(chld);
 		}
+
+		seen.reserve(children.count());
+		foreach(Channel *chld, children)
+			seen.insert(chld);
 	}
 	return seen;
 }
@@ -199,7 +204,10 @@ size_t Channel::getDepth() const {
 }
 
 QString Channel::getPath() const {
-	QString out;
+	// Walk up once to size the result, then fill it in from the
+	// root down, instead of prepending (and moving) at every level.
+	QVarLengthArray<const Channel *, 16> path;
+	int length = 0;
 
 	const Channel *tmp = this;
 	while (tmp->cParent) {
@@ -208,11 +216,18 @@ QString Channel::getPath() const {
 			break;
 		}
 
-		out.prepend(QString::fromLatin1("/"));
-		out.prepend(tmp->qsName);
+		path.append(tmp);
+		length += tmp->qsName.length() + 1;
 
 		tmp = tmp->cParent;
 	}
 
+	QString out;
+	out.reserve(length);
+	for (int i = path.count() - 1; i >= 0; --i) {
+		out.append(path[i]->qsName);
+		out.append(QLatin1Char('/'));
+	}
+
 	return out;
 }
@@ -141,9 +141,13 @@ bool CryptState::decrypt(const unsigned char *source, unsigned char *dst, unsign
 		}
 	}
 
+	// Decrypting in place overwrites the tag.
+	unsigned char sourcetag[3];
+	memcpy(sourcetag, source+1, 3);
+
 	ocb_decrypt(source+4, dst, plain_length, decrypt_iv, tag);
 
-	if (memcmp(tag, source+1, 3) != 0) {
+	if (memcmp(tag, sourcetag, 3) != 0) {
 		memcpy(decrypt_iv, saveiv, AES_BLOCK_SIZE);
 		return false;
 	}
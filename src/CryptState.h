@@ -44,6 +44,8 @@ class CryptState {
 		void ocb_encrypt(const unsigned char *plain, unsigned char *encrypted, unsigned int len, const unsigned char *nonce, unsigned char *tag);
 		void ocb_decrypt(const unsigned char *encrypted, unsigned char *plain, unsigned int len, const unsigned char *nonce, unsigned char *tag);
 
+		/// Decrypts a packet, and returns whether it is authentic. dst may
+		/// be source, to decrypt in place.
 		bool decrypt(const unsigned char *source, unsigned char *dst, unsigned int crypted_length);
 		void encrypt(const unsigned char *source, unsigned char *dst, unsigned int plain_length);
 };
@@ -21,6 +21,216 @@ QString HTMLFilter::escapeTags(const QString &in) {
 	return out;
 }
 
+static inline bool isSpace(ushort c) {
+	return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+static inline bool isNameStart(ushort c) {
+	return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_') || (c == ':') || (c >= 0x80);
+}
+
+static inline bool isNameChar(ushort c) {
+	return isNameStart(c) || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '.');
+}
+
+static inline bool equals(const QChar *s, int len, const char *latin1) {
+	int i = 0;
+	for (; (i < len) && latin1[i]; ++i)
+		if (s[i].unicode() != static_cast<uchar>(latin1[i]))
+			return false;
+	return (i == len) && ! latin1[i];
+}
+
+static inline int find(const QChar *s, int n, int i, const char *latin1) {
+	const int len = static_cast<int>(strlen(latin1));
+	for (; i + len <= n; ++i)
+		if (equals(s + i, len, latin1))
+			return i;
+	return -1;
+}
+
+/// Skips the entity or character reference at s[i], which is
+/// an ampersand. Only the predefined XML entities are accepted,
+/// the same as QXmlStreamReader does without a DTD.
+static bool skipEntity(const QChar *s, int n, int &i) {
+	int start = ++i;
+	while ((i < n) && (s[i].unicode() != ';')) {
+		if (i - start > 10)
+			return false;
+		++i;
+	}
+	if (i >= n)
+		return false;
+
+	const QChar *e = s + start;
+	const int len = i - start;
+	++i;
+
+	if ((len > 1) && (e[0].unicode() == '#')) {
+		bool hex = (e[1].unicode() == 'x');
+		int j = hex ? 2 : 1;
+		if (j >= len)
+			return false;
+		for (; j < len; ++j) {
+			ushort c = e[j].unicode();
+			bool digit = (c >= '0') && (c <= '9');
+			if (hex)
+				digit = digit || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'));
+			if (! digit)
+				return false;
+		}
+		return true;
+	}
+	return equals(e, len, "amp") || equals(e, len, "lt") || equals(e, len, "gt") || equals(e, len, "quot") || equals(e, len, "apos");
+}
+
+bool HTMLFilter::measure(const QString &in, int &textLength, int &imageLength) {
+	const QChar *s = in.constData();
+	const int n = in.size();
+
+	textLength = n;
+	imageLength = 0;
+
+	// Open elements, as offset and length of their names in s.
+	QVarLengthArray<QPair<int, int>, 32> open;
+
+	int i = 0;
+	while (i < n) {
+		ushort c = s[i].unicode();
+		if (c == '&') {
+			if (! skipEntity(s, n, i))
+				return false;
+			continue;
+		} else if (c == '>') {
+			// Allowed in text, except as the end of a CDATA section.
+			if ((i >= 2) && (s[i - 1].unicode() == ']') && (s[i - 2].unicode() == ']'))
+				return false;
+			++i;
+			continue;
+		} else if (c != '<') {
+			++i;
+			continue;
+		}
+
+		if (++i >= n)
+			return false;
+		c = s[i].unicode();
+
+		if (c == '!') {
+			if (equals(s + i, qMin(3, n - i), "!--")) {
+				i = find(s, n, i + 3, "-->");
+				if (i < 0)
+					return false;
+				i += 3;
+			} else if (equals(s + i, qMin(8, n - i), "![CDATA[")) {
+				i = find(s, n, i + 8, "]]>");
+				if (i < 0)
+					return false;
+				i += 3;
+			} else {
+				return false;
+			}
+			continue;
+		} else if (c == '?') {
+			i = find(s, n, i + 1, "?>");
+			if (i < 0)
+				return false;
+			i += 2;
+			continue;
+		}
+
+		const bool end = (c == '/');
+		if (end)
+			++i;
+
+		const int name = i;
+		if ((i >= n) || ! isNameStart(s[i].unicode()))
+			return false;
+		while ((i < n) && isNameChar(s[i].unicode()))
+			++i;
+		const int nameLength = i - name;
+
+		if (end) {
+			while ((i < n) && isSpace(s[i].unicode()))
+				++i;
+			if ((i >= n) || (s[i].unicode() != '>') || open.isEmpty())
+				return false;
+			const QPair<int, int> &top = open.at(open.size() - 1);
+			if ((top.second != nameLength) || (memcmp(s + top.first, s + name, nameLength * sizeof(QChar)) != 0))
+				return false;
+			open.removeLast();
+			++i;
+			continue;
+		}
+
+		const bool img = equals(s + name, nameLength, "img");
+
+		forever {
+			const int space = i;
+			while ((i < n) && isSpace(s[i].unicode()))
+				++i;
+			if (i >= n)
+				return false;
+
+			c = s[i].unicode();
+			if (c == '>') {
+				open.append(qMakePair(name, nameLength));
+				++i;
+				break;
+			} else if (c == '/') {
+				if ((i + 1 >= n) || (s[i + 1].unicode() != '>'))
+					return false;
+				i += 2;
+				break;
+			}
+
+			// Attributes have to be separated by whitespace.
+			if ((i == space) || ! isNameStart(c))
+				return false;
+
+			const int attr = i;
+			while ((i < n) && isNameChar(s[i].unicode()))
+				++i;
+			const int attrLength = i - attr;
+
+			while ((i < n) && isSpace(s[i].unicode()))
+				++i;
+			if ((i >= n) || (s[i].unicode() != '='))
+				return false;
+			++i;
+			while ((i < n) && isSpace(s[i].unicode()))
+				++i;
+			if (i >= n)
+				return false;
+
+			const ushort quote = s[i].unicode();
+			if ((quote != '"') && (quote != '\''))
+				return false;
+			const int value = ++i;
+			while ((i < n) && ((c = s[i].unicode()) != quote)) {
+				if (c == '<')
+					return false;
+				if (c == '&') {
+					if (! skipEntity(s, n, i))
+						return false;
+				} else {
+					++i;
+				}
+			}
+			if (i >= n)
+				return false;
+			++i;
+
+			if (img && equals(s + attr, attrLength, "src")) {
+				textLength -= i - space;
+				imageLength += i - 1 - value;
+			}
+		}
+	}
+
+	return open.isEmpty();
+}
+
 bool HTMLFilter::filter(const QString &in, QString &out) {
 	if (! in.contains(QLatin1Char('<'))) {
 		out = in.simplified();
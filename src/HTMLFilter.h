@@ -32,6 +32,19 @@ class HTMLFilter {
 		/// If the filtering failed, the function returns false
 		/// and out is left unchanged.	
 		static bool filter(const QString &in, QString &out);
+
+		/// measure checks that the in HTML document is
+		/// well-formed and measures it in a single pass,
+		/// without copying it.
+		///
+		/// textLength receives the length of the document
+		/// without the src attributes of its img elements,
+		/// and imageLength the total length of their values.
+		///
+		/// Returns false if the document is not well-formed,
+		/// in which case textLength and imageLength are
+		/// undefined.
+		static bool measure(const QString &in, int &textLength, int &imageLength);
 };
 
 #endif
@@ -41,7 +41,8 @@
 	MUMBLE_MH_MSG(UserStats) \
 	MUMBLE_MH_MSG(RequestBlob) \
 	MUMBLE_MH_MSG(ServerConfig) \
-	MUMBLE_MH_MSG(SuggestConfig)
+	MUMBLE_MH_MSG(SuggestConfig) \
+	MUMBLE_MH_MSG(UserInterest)
 
 class MessageHandler {
 	public:
@@ -75,6 +76,11 @@ inline ::std::string blob(const QByteArray &str) {
 	return ::std::string(str.constData(), str.length());
 }
 
+/// Descriptions, comments and textures at least this long are sent to
+/// clients as a SHA1 hash, and clients request the full blob when they
+/// need it.
+#define BLOB_HASH_THRESHOLD 128
+
 inline QByteArray sha1(const QByteArray &blob) {
 	return QCryptographicHash::hash(blob, QCryptographicHash::Sha1);
 }
@@ -0,0 +1,66 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MESSAGECACHE_H_
+#define MUMBLE_MESSAGECACHE_H_
+
+#include <QtCore/QtGlobal>
+
+/// MessageCache keeps a protobuf message of type T around for
+/// parsing the next message of that type into.
+///
+/// Parsing clears the message first, which keeps the strings and
+/// repeated fields it allocated for the previous message. Small
+/// control messages therefore parse without any heap allocations
+/// once the cache has seen a message of similar shape.
+///
+/// A MessageCache is not thread-safe; each thread that parses
+/// messages needs its own.
+template <class T>
+class MessageCache {
+	private:
+		Q_DISABLE_COPY(MessageCache)
+		T tMessage;
+		bool bBusy;
+	public:
+		/// Messages larger than this, in their encoded form, are
+		/// dropped after use so they don't keep their memory.
+		static const int iMaxSize = 4096;
+
+		MessageCache() : bBusy(false) {}
+
+		/// Lease hands out the cached message for as long as it
+		/// exists.
+		///
+		/// If the cached message is already leased, which happens
+		/// when a handler causes another message of the same type
+		/// to be handled, e.g. from a nested event loop, the lease
+		/// uses a message of its own instead.
+		class Lease {
+			private:
+				Q_DISABLE_COPY(Lease)
+				MessageCache *pCache;
+				int iSize;
+				T tOwn;
+			public:
+				/// size is the length of the encoded message.
+				Lease(MessageCache &cache, int size) : pCache(cache.bBusy ? NULL : &cache), iSize(size) {
+					if (pCache)
+						pCache->bBusy = true;
+				}
+				~Lease() {
+					if (! pCache)
+						return;
+					if (iSize > iMaxSize)
+						T().Swap(&pCache->tMessage);
+					pCache->bBusy = false;
+				}
+				T &message() {
+					return pCache ? pCache->tMessage : tOwn;
+				}
+		};
+};
+
+#endif
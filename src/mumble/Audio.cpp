@@ -116,7 +116,7 @@ void LoopUser::addFrame(const QByteArray &packet) {
 		AudioOutputPtr ao = g.ao;
 		if (ao) {
 			MessageHandler::UDPMessageType msgType = static_cast<MessageHandler::UDPMessageType>((packet.at(0) >> 5) & 0x7);
-			ao->addFrameToBuffer(this, QByteArray(), 0, msgType);
+			ao->addFrameToBuffer(this, 0, NULL, 0, 0, msgType);
 		}
 	}
 
@@ -146,14 +146,9 @@ void LoopUser::fetchFrames() {
 
 		pds >> iSeq;
 
-		QByteArray qba;
-		qba.reserve(pds.left() + 1);
-		qba.append(static_cast<char>(msgFlags));
-		qba.append(pds.dataBlock(pds.left()));
-
 		MessageHandler::UDPMessageType msgType = static_cast<MessageHandler::UDPMessageType>((msgFlags >> 5) & 0x7);
 
-		ao->addFrameToBuffer(this, qba, iSeq, msgType);
+		ao->addFrameToBuffer(this, msgFlags, pds.charPtr(), pds.left(), iSeq, msgType);
 		i = qmPackets.erase(i);
 	}
 
@@ -182,14 +177,9 @@ void RecordUser::addFrame(const QByteArray &packet) {
 
 	pds >> iSeq;
 
-	QByteArray qba;
-	qba.reserve(pds.left() + 1);
-	qba.append(static_cast<char>(msgFlags));
-	qba.append(pds.dataBlock(pds.left()));
-
 	MessageHandler::UDPMessageType msgType = static_cast<MessageHandler::UDPMessageType>((msgFlags >> 5) & 0x7);
 
-	ao->addFrameToBuffer(this, qba, iSeq, msgType);
+	ao->addFrameToBuffer(this, msgFlags, pds.charPtr(), pds.left(), iSeq, msgType);
 }
 
 void Audio::startOutput(const QString &output) {
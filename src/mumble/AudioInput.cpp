@@ -7,6 +7,7 @@
 
 #include "AudioInput.h"
 
+#include "AudioMix.h"
 #include "AudioOutput.h"
 #include "CELTCodec.h"
 #include "ServerHandler.h"
@@ -16,6 +17,7 @@
 #include "Plugins.h"
 #include "Message.h"
 #include "Global.h"
+#include "LatencyProbe.h"
 #include "NetworkConfig.h"
 #include "VoiceRecorder.h"
 
@@ -103,7 +105,7 @@ AudioInput::AudioInput() : opusBuffer(g.s.iFramesPerPacket * (SAMPLE_RATE / 100)
 
 	sppPreprocess = NULL;
 	sesEcho = NULL;
-	srsMic = srsEcho = NULL;
+	rsMic = rsEcho = NULL;
 	iJitterSeq = 0;
 	iMinBuffered = 1000;
 
@@ -111,6 +113,10 @@ AudioInput::AudioInput() : opusBuffer(g.s.iFramesPerPacket * (SAMPLE_RATE / 100)
 	psClean = new short[iFrameSize];
 
 	psSpeaker = NULL;
+	psEchoFrames = NULL;
+	pfEchoPower = NULL;
+	iEchoHead = iEchoCount = 0;
+	fSpeakerPower = 0.0f;
 
 	iEchoChannels = iMicChannels = 0;
 	iEchoFilled = iMicFilled = 0;
@@ -149,18 +155,16 @@ AudioInput::~AudioInput() {
 		cCodec->celt_encoder_destroy(ceEncoder);
 	}
 
-	foreach(short *buf, qlEchoFrames)
-		delete [] buf;
+	delete [] psEchoFrames;
+	delete [] pfEchoPower;
 
 	if (sppPreprocess)
 		speex_preprocess_state_destroy(sppPreprocess);
 	if (sesEcho)
 		speex_echo_state_destroy(sesEcho);
 
-	if (srsMic)
-		speex_resampler_destroy(srsMic);
-	if (srsEcho)
-		speex_resampler_destroy(srsEcho);
+	delete rsMic;
+	delete rsEcho;
 
 	delete [] psMic;
 	delete [] psClean;
@@ -288,18 +292,13 @@ AudioInput::inMixerFunc AudioInput::chooseMixer(const unsigned int nchan, Sample
 }
 
 void AudioInput::initializeMixer() {
-	int err;
-
-	if (srsMic)
-		speex_resampler_destroy(srsMic);
-	if (srsEcho)
-		speex_resampler_destroy(srsEcho);
+	delete rsMic;
+	delete rsEcho;
 	delete [] pfMicInput;
 	delete [] pfEchoInput;
 	delete [] pfOutput;
 
-	if (iMicFreq != iSampleRate)
-		srsMic = speex_resampler_init(1, iMicFreq, iSampleRate, 3, &err);
+	rsMic = (iMicFreq != iSampleRate) ? new Resampler(1, iMicFreq, iSampleRate, 3) : NULL;
 
 	iMicLength = (iFrameSize * iMicFreq) / iSampleRate;
 
@@ -308,17 +307,37 @@ void AudioInput::initializeMixer() {
 
 	if (iEchoChannels > 0) {
 		bEchoMulti = g.s.bEchoMulti;
-		if (iEchoFreq != iSampleRate)
-			srsEcho = speex_resampler_init(bEchoMulti ? iEchoChannels : 1, iEchoFreq, iSampleRate, 3, &err);
+		rsEcho = (iEchoFreq != iSampleRate) ? new Resampler(bEchoMulti ? iEchoChannels : 1, iEchoFreq, iSampleRate, 3) : NULL;
 		iEchoLength = (iFrameSize * iEchoFreq) / iSampleRate;
 		iEchoMCLength = bEchoMulti ? iEchoLength * iEchoChannels : iEchoLength;
 		iEchoFrameSize = bEchoMulti ? iFrameSize * iEchoChannels : iFrameSize;
 		pfEchoInput = new float[iEchoMCLength];
 	} else {
-		srsEcho = NULL;
+		rsEcho = NULL;
 		pfEchoInput = NULL;
 	}
 
+	{
+		// The frames may have changed size, so start over.
+		QMutexLocker l(&qmEcho);
+
+		delete [] psEchoFrames;
+		delete [] pfEchoPower;
+		delete [] psSpeaker;
+		psSpeaker = NULL;
+
+		if (iEchoChannels > 0) {
+			psEchoFrames = new short[iEchoFrames * iEchoFrameSize];
+			pfEchoPower = new float[iEchoFrames];
+		} else {
+			psEchoFrames = NULL;
+			pfEchoPower = NULL;
+		}
+		iEchoHead = iEchoCount = 0;
+		iJitterSeq = 0;
+		iMinBuffered = 1000;
+	}
+
 	imfMic = chooseMixer(iMicChannels, eMicFormat);
 	imfEcho = chooseMixer(iEchoChannels, eEchoFormat);
 
@@ -354,51 +373,51 @@ void AudioInput::addMic(const void *data, unsigned int nsamp) {
 			iMicFilled = 0;
 
 			// If needed resample frame
-			float *ptr = srsMic ? pfOutput : pfMicInput;
+			float *ptr = rsMic ? pfOutput : pfMicInput;
 
-			if (srsMic) {
-				spx_uint32_t inlen = iMicLength;
-				spx_uint32_t outlen = iFrameSize;
-				speex_resampler_process_float(srsMic, 0, pfMicInput, &inlen, pfOutput, &outlen);
+			if (rsMic) {
+				unsigned int inlen = iMicLength;
+				unsigned int outlen = iFrameSize;
+				rsMic->process(pfMicInput, inlen, pfOutput, outlen);
 			}
 
-			// Convert float to 16bit PCM
-			const float mul = 32768.f;
-			for (int j = 0; j < iFrameSize; ++j)
-				psMic[j] = static_cast<short>(qBound(-32768.f, (ptr[j] * mul), 32767.f));
+			// Convert float to 16bit PCM, and measure the level on the way
+			float micPeak;
+			const float micPower = AudioMix::toShortPower(psMic, ptr, iFrameSize, micPeak);
 
 			// If we have echo chancellation enabled...
 			if (iEchoChannels > 0) {
-				short *echo = NULL;
+				QMutexLocker l(&qmEcho);
 
-				{
-					QMutexLocker l(&qmEcho);
+				if (iEchoCount == 0) {
+					iJitterSeq = 0;
+					iMinBuffered = 1000;
+				} else {
+					// Compensate for drift between the microphone and the echo source
+					iMinBuffered = qMin(iMinBuffered, iEchoCount);
 
-					if (qlEchoFrames.isEmpty()) {
+					if ((iJitterSeq > 100) && (iMinBuffered > 1)) {
 						iJitterSeq = 0;
 						iMinBuffered = 1000;
-					} else {
-						// Compensate for drift between the microphone and the echo source
-						iMinBuffered = qMin(iMinBuffered, qlEchoFrames.count());
-
-						if ((iJitterSeq > 100) && (iMinBuffered > 1)) {
-							iJitterSeq = 0;
-							iMinBuffered = 1000;
-							delete [] qlEchoFrames.takeFirst();
-						}
-						echo = qlEchoFrames.takeFirst();
+						iEchoHead = (iEchoHead + 1) % iEchoFrames;
+						--iEchoCount;
 					}
-				}
 
-				if (echo) {
 					// We have echo data for the current frame, remember that
-					delete [] psSpeaker;
-					psSpeaker = echo;
+					if (! psSpeaker)
+						psSpeaker = new short[iEchoFrameSize];
+					memcpy(psSpeaker, psEchoFrames + iEchoHead * iEchoFrameSize, iEchoFrameSize * sizeof(short));
+					fSpeakerPower = pfEchoPower[iEchoHead];
+					iEchoHead = (iEchoHead + 1) % iEchoFrames;
+					--iEchoCount;
 				}
 			}
 
+			if (LatencyProbe::lpProbe)
+				LatencyProbe::lpProbe->framed(iMicLength);
+
 			// Encode and send frame
-			encodeAudioFrame();
+			encodeAudioFrame(micPower, micPeak);
 		}
 	}
 }
@@ -442,26 +461,30 @@ void AudioInput::addEcho(const void *data, unsigned int nsamp) {
 			iEchoFilled = 0;
 
 			// Resample if necessary
-			float *ptr = srsEcho ? pfOutput : pfEchoInput;
+			float *ptr = rsEcho ? pfOutput : pfEchoInput;
 
-			if (srsEcho) {
-				spx_uint32_t inlen = iEchoLength;
-				spx_uint32_t outlen = iFrameSize;
-				speex_resampler_process_interleaved_float(srsEcho, pfEchoInput, &inlen, pfOutput, &outlen);
+			if (rsEcho) {
+				unsigned int inlen = iEchoLength;
+				unsigned int outlen = iFrameSize;
+				rsEcho->process(pfEchoInput, inlen, pfOutput, outlen);
 			}
 
-			short *outbuff = new short[iEchoFrameSize];
-
-			// float -> 16bit PCM
-			const float mul = 32768.f;
-			for (unsigned int j=0;j<iEchoFrameSize;++j)
-				outbuff[j] = static_cast<short>(ptr[j] * mul);
-
 			// Push frame into the echo chancellers jitter buffer
 			QMutexLocker l(&qmEcho);
 
+			// Nobody is taking the frames; make room.
+			if (iEchoCount == iEchoFrames) {
+				iEchoHead = (iEchoHead + 1) % iEchoFrames;
+				--iEchoCount;
+			}
+
+			// float -> 16bit PCM, measuring the level for the statistics
+			const unsigned int slot = (iEchoHead + iEchoCount) % iEchoFrames;
+			float peak;
+			pfEchoPower[slot] = AudioMix::toShortPower(psEchoFrames + slot * iEchoFrameSize, ptr, iEchoFrameSize, peak);
+
 			iJitterSeq = qMin(iJitterSeq + 1,10000U);
-			qlEchoFrames.append(outbuff);
+			++iEchoCount;
 		}
 	}
 }
@@ -688,10 +711,14 @@ int AudioInput::encodeCELTFrame(short *psSource, EncodingOutputBuffer& buffer) {
 }
 
 void AudioInput::encodeAudioFrame() {
+	float micPeak;
+	const float micPower = AudioMix::power(psMic, iFrameSize, micPeak);
+	encodeAudioFrame(micPower, micPeak);
+}
+
+void AudioInput::encodeAudioFrame(float micPower, float micPeak) {
 	int iArg;
-	int i;
 	float sum;
-	short max;
 
 	short *psSource;
 
@@ -700,20 +727,11 @@ void AudioInput::encodeAudioFrame() {
 	if (! bRunning)
 		return;
 
-	sum=1.0f;
-	max = 1;
-	for (i=0;i<iFrameSize;i++) {
-		sum += static_cast<float>(psMic[i] * psMic[i]);
-		max = std::max(static_cast<short>(abs(psMic[i])), max);
-	}
-	dPeakMic = qMax(20.0f*log10f(sqrtf(sum / static_cast<float>(iFrameSize)) / 32768.0f), -96.0f);
-	dMaxMic = max;
+	dPeakMic = qMax(20.0f*log10f(sqrtf((1.0f + micPower) / static_cast<float>(iFrameSize)) / 32768.0f), -96.0f);
+	dMaxMic = qMax(micPeak, 1.0f);
 
 	if (psSpeaker && (iEchoChannels > 0)) {
-		sum=1.0f;
-		for (i=0;i<iFrameSize;i++)
-			sum += static_cast<float>(psSpeaker[i] * psSpeaker[i]);
-		dPeakSpeaker = qMax(20.0f*log10f(sqrtf(sum / static_cast<float>(iFrameSize)) / 32768.0f), -96.0f);
+		dPeakSpeaker = qMax(20.0f*log10f(sqrtf((1.0f + fSpeakerPower) / static_cast<float>(iEchoFrameSize)) / 32768.0f), -96.0f);
 	} else {
 		dPeakSpeaker = 0.0;
 	}
@@ -735,9 +753,11 @@ void AudioInput::encodeAudioFrame() {
 		psSource = psMic;
 	}
 
-	sum=1.0f;
-	for (i=0;i<iFrameSize;i++)
-		sum += static_cast<float>(psSource[i] * psSource[i]);
+	if (LatencyProbe::lpProbe)
+		LatencyProbe::lpProbe->preprocessed(iFrameCounter - 1);
+
+	float peak;
+	sum = 1.0f + AudioMix::power(psSource, iFrameSize, peak);
 	float micLevel = sqrtf(sum / static_cast<float>(iFrameSize));
 	dPeakSignal = qMax(20.0f*log10f(micLevel / 32768.0f), -96.0f);
 
@@ -922,9 +942,13 @@ void AudioInput::flushCheck(const QByteArray &frame, bool terminator) {
 	int frames = iBufferedFrames;
 	iBufferedFrames = 0;
 
+	// The CELT terminator added below carries no audio.
+	const int seq = iFrameCounter - frames;
+	const int audioFrames = frames;
+
 	PacketDataStream pds(data + 1, 1023);
 	// Sequence number
-	pds << iFrameCounter - frames;
+	pds << seq;
 
 	if (umtType == MessageHandler::UDPVoiceOpus) {
 		const QByteArray &qba = qlFrames.takeFirst();
@@ -949,12 +973,16 @@ void AudioInput::flushCheck(const QByteArray &frame, bool terminator) {
 		}
 	}
 
-	if (g.s.bTransmitPosition && g.p && ! g.bCenterPosition && g.p->fetch()) {
-		pds << g.p->fPosition[0];
-		pds << g.p->fPosition[1];
-		pds << g.p->fPosition[2];
+	PositionSample ps;
+	if (g.s.bTransmitPosition && g.p && ! g.bCenterPosition && g.p->pbPositions.latest(prPosition, ps)) {
+		pds << ps.fPosition[0];
+		pds << ps.fPosition[1];
+		pds << ps.fPosition[2];
 	}
 
+	if (LatencyProbe::lpProbe)
+		LatencyProbe::lpProbe->sent(seq, audioFrames);
+
 	sendAudioFrame(data, pds);
 
 	Q_ASSERT(qlFrames.isEmpty());
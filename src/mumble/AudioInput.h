@@ -11,15 +11,16 @@
 #include <speex/speex.h>
 #include <speex/speex_echo.h>
 #include <speex/speex_preprocess.h>
-#include <speex/speex_resampler.h>
 #include <QtCore/QObject>
 #include <QtCore/QThread>
 #include <vector>
 
 #include "Audio.h"
+#include "PositionBuffer.h"
 #include "Settings.h"
 #include "Timer.h"
 #include "Message.h"
+#include "Resampler.h"
 
 class AudioInput;
 class CELTCodec;
@@ -60,12 +61,25 @@ class AudioInput : public QThread {
 		typedef enum { SampleShort, SampleFloat } SampleFormat;
 		typedef void (*inMixerFunc)(float * RESTRICT, const void * RESTRICT, unsigned int, unsigned int);
 	private:
-		SpeexResamplerState *srsMic, *srsEcho;
+		Resampler *rsMic, *rsEcho;
 
+		/// Number of echo frames that can wait for their microphone
+		/// frames. If the microphone stops, the oldest are dropped.
+		static const unsigned int iEchoFrames = 50;
+
+		/// Guards the echo frames.
 		QMutex qmEcho;
-		QList<short *> qlEchoFrames;
+		/// A ring of iEchoFrames echo frames, iEchoFrameSize samples each,
+		/// and the sum of the squares of each frame.
+		short *psEchoFrames;
+		float *pfEchoPower;
+		/// The oldest echo frame, and the number of frames in the ring.
+		unsigned int iEchoHead;
+		unsigned int iEchoCount;
 		unsigned int iJitterSeq;
-		int iMinBuffered;
+		unsigned int iMinBuffered;
+		/// Sum of the squares of psSpeaker.
+		float fSpeakerPower;
 
 		unsigned int iMicFilled, iEchoFilled;
 		inMixerFunc imfMic, imfEcho;
@@ -120,6 +134,10 @@ class AudioInput : public QThread {
 
 		std::vector<short> opusBuffer;
 
+		/// Processes and sends psMic. micPower is the sum of the
+		/// squares of its samples, and micPeak its largest magnitude.
+		void encodeAudioFrame(float micPower, float micPeak);
+		/// Measures psMic, then processes and sends it.
 		void encodeAudioFrame();
 		void addMic(const void *data, unsigned int nsamp);
 		void addEcho(const void *data, unsigned int nsamp);
@@ -133,6 +151,8 @@ class AudioInput : public QThread {
 		int iBufferedFrames;
 
 		QList<QByteArray> qlFrames;
+		/// Where the positional audio sent with each frame was last found.
+		PositionBuffer::Reader prPosition;
 		void flushCheck(const QByteArray &, bool terminator);
 
 		void initializeMixer();
@@ -0,0 +1,598 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "AudioMix.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define AUDIOMIX_SSE2
+# include <emmintrin.h>
+#endif
+
+// AVX2 is chosen at runtime, so it is compiled in even if the rest of
+// the build doesn't target it.
+#if (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) && (defined(__x86_64__) || defined(__i386__))
+# define AUDIOMIX_AVX2
+# define AUDIOMIX_TARGET_AVX2 __attribute__((target("avx2")))
+# include <immintrin.h>
+#elif defined(_MSC_VER) && (_MSC_VER >= 1800) && (defined(_M_X64) || defined(_M_IX86))
+# define AUDIOMIX_AVX2
+# define AUDIOMIX_TARGET_AVX2
+# include <immintrin.h>
+# include <intrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define AUDIOMIX_NEON
+# include <arm_neon.h>
+#endif
+
+// The plain loops. The vector kernels use them for the samples that
+// don't fill a whole vector, starting at sample i.
+
+static inline void addTail(float * RESTRICT dst, const float * RESTRICT src, unsigned int i, unsigned int n, float gain) {
+	for (; i < n; ++i)
+		dst[i] += src[i] * gain;
+}
+
+static inline void addRampTail(float * RESTRICT dst, const float * RESTRICT src, unsigned int i, unsigned int n, float gain, float inc) {
+	for (; i < n; ++i)
+		dst[i] += src[i] * (gain + inc * static_cast<float>(i));
+}
+
+static inline void interleaveTail(float * RESTRICT dst, const float * RESTRICT src, unsigned int nchan, unsigned int i, unsigned int n) {
+	for (; i < n; ++i)
+		for (unsigned int s = 0; s < nchan; ++s)
+			dst[i * nchan + s] = src[s * n + i];
+}
+
+static inline void clipTail(float *buf, unsigned int i, unsigned int n) {
+	for (; i < n; ++i)
+		buf[i] = qBound(-1.0f, buf[i], 1.0f);
+}
+
+static inline void toShortTail(short * RESTRICT dst, const float * RESTRICT src, unsigned int i, unsigned int n) {
+	for (; i < n; ++i)
+		dst[i] = static_cast<short>(qBound(-32768.f, (src[i] * 32768.f), 32767.f));
+}
+
+static inline void toShortPowerTail(short * RESTRICT dst, const float * RESTRICT src, unsigned int i, unsigned int n, float &sum, float &peak) {
+	for (; i < n; ++i) {
+		const float v = qBound(-32768.f, (src[i] * 32768.f), 32767.f);
+		dst[i] = static_cast<short>(v);
+		sum += v * v;
+		peak = qMax(peak, qAbs(v));
+	}
+}
+
+static inline void powerTail(const short *src, unsigned int i, unsigned int n, float &sum, float &peak) {
+	for (; i < n; ++i) {
+		const float v = static_cast<float>(src[i]);
+		sum += v * v;
+		peak = qMax(peak, qAbs(v));
+	}
+}
+
+static inline float dotTail(const float *a, const float *b, unsigned int i, unsigned int n) {
+	float sum = 0.0f;
+	for (; i < n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+static void addPlain(float *dst, const float *src, unsigned int n, float gain) {
+	addTail(dst, src, 0, n, gain);
+}
+
+static void addRampPlain(float *dst, const float *src, unsigned int n, float gain, float inc) {
+	addRampTail(dst, src, 0, n, gain, inc);
+}
+
+static void interleaveStereoPlain(float *dst, const float *src, unsigned int n) {
+	interleaveTail(dst, src, 2, 0, n);
+}
+
+static void clipPlain(float *buf, unsigned int n) {
+	clipTail(buf, 0, n);
+}
+
+static void toShortPlain(short *dst, const float *src, unsigned int n) {
+	toShortTail(dst, src, 0, n);
+}
+
+static float toShortPowerPlain(short *dst, const float *src, unsigned int n, float &peak) {
+	float sum = 0.0f;
+	peak = 0.0f;
+	toShortPowerTail(dst, src, 0, n, sum, peak);
+	return sum;
+}
+
+static float powerPlain(const short *src, unsigned int n, float &peak) {
+	float sum = 0.0f;
+	peak = 0.0f;
+	powerTail(src, 0, n, sum, peak);
+	return sum;
+}
+
+static float dotPlain(const float *a, const float *b, unsigned int n) {
+	return dotTail(a, b, 0, n);
+}
+
+#ifdef AUDIOMIX_SSE2
+static void addSSE2(float *dst, const float *src, unsigned int n, float gain) {
+	const __m128 g = _mm_set1_ps(gain);
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+	addTail(dst, src, i, n, gain);
+}
+
+static void addRampSSE2(float *dst, const float *src, unsigned int n, float gain, float inc) {
+	const __m128 g = _mm_set1_ps(gain);
+	const __m128 d = _mm_set1_ps(inc);
+	const __m128 step = _mm_set1_ps(4.0f);
+	__m128 idx = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 v = _mm_add_ps(g, _mm_mul_ps(d, idx));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), v)));
+		idx = _mm_add_ps(idx, step);
+	}
+	addRampTail(dst, src, i, n, gain, inc);
+}
+
+static void interleaveStereoSSE2(float *dst, const float *src, unsigned int n) {
+	const float *l = src;
+	const float *r = src + n;
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 a = _mm_loadu_ps(l + i);
+		const __m128 b = _mm_loadu_ps(r + i);
+		_mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(a, b));
+		_mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(a, b));
+	}
+	interleaveTail(dst, src, 2, i, n);
+}
+
+static void clipSSE2(float *buf, unsigned int n) {
+	const __m128 lo = _mm_set1_ps(-1.0f);
+	const __m128 hi = _mm_set1_ps(1.0f);
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(buf + i, _mm_max_ps(_mm_min_ps(_mm_loadu_ps(buf + i), hi), lo));
+	clipTail(buf, i, n);
+}
+
+static void toShortSSE2(short *dst, const float *src, unsigned int n) {
+	const __m128 scale = _mm_set1_ps(32768.f);
+	const __m128 lo = _mm_set1_ps(-32768.f);
+	const __m128 hi = _mm_set1_ps(32767.f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), hi), lo);
+		const __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), hi), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+	toShortTail(dst, src, i, n);
+}
+
+static inline float sumSSE2(__m128 v) {
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+static inline float maxSSE2(__m128 v) {
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+static float toShortPowerSSE2(short *dst, const float *src, unsigned int n, float &peak) {
+	const __m128 scale = _mm_set1_ps(32768.f);
+	const __m128 lo = _mm_set1_ps(-32768.f);
+	const __m128 hi = _mm_set1_ps(32767.f);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 sum = _mm_setzero_ps();
+	__m128 max = _mm_setzero_ps();
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), hi), lo);
+		const __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), hi), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+		sum = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+		max = _mm_max_ps(max, _mm_max_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b)));
+	}
+	float s = sumSSE2(sum);
+	peak = maxSSE2(max);
+	toShortPowerTail(dst, src, i, n, s, peak);
+	return s;
+}
+
+static float powerSSE2(const short *src, unsigned int n, float &peak) {
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 sum = _mm_setzero_ps();
+	__m128 max = _mm_setzero_ps();
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		// Sign extend to 32 bits by shifting the samples back down.
+		const __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+		const __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+		sum = _mm_add_ps(sum, _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+		max = _mm_max_ps(max, _mm_max_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b)));
+	}
+	float s = sumSSE2(sum);
+	peak = maxSSE2(max);
+	powerTail(src, i, n, s, peak);
+	return s;
+}
+
+static float dotSSE2(const float *a, const float *b, unsigned int n) {
+	__m128 s0 = _mm_setzero_ps();
+	__m128 s1 = _mm_setzero_ps();
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	return sumSSE2(_mm_add_ps(s0, s1)) + dotTail(a, b, i, n);
+}
+#endif
+
+#ifdef AUDIOMIX_AVX2
+AUDIOMIX_TARGET_AVX2 static void addAVX2(float *dst, const float *src, unsigned int n, float gain) {
+	const __m256 g = _mm256_set1_ps(gain);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+	addTail(dst, src, i, n, gain);
+}
+
+AUDIOMIX_TARGET_AVX2 static void addRampAVX2(float *dst, const float *src, unsigned int n, float gain, float inc) {
+	const __m256 g = _mm256_set1_ps(gain);
+	const __m256 d = _mm256_set1_ps(inc);
+	const __m256 step = _mm256_set1_ps(8.0f);
+	__m256 idx = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 v = _mm256_add_ps(g, _mm256_mul_ps(d, idx));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), v)));
+		idx = _mm256_add_ps(idx, step);
+	}
+	addRampTail(dst, src, i, n, gain, inc);
+}
+
+AUDIOMIX_TARGET_AVX2 static void interleaveStereoAVX2(float *dst, const float *src, unsigned int n) {
+	const float *l = src;
+	const float *r = src + n;
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 a = _mm256_loadu_ps(l + i);
+		const __m256 b = _mm256_loadu_ps(r + i);
+		// Unpacking works within 128 bit lanes, so the halves
+		// have to be put back in order.
+		const __m256 lo = _mm256_unpacklo_ps(a, b);
+		const __m256 hi = _mm256_unpackhi_ps(a, b);
+		_mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	interleaveTail(dst, src, 2, i, n);
+}
+
+AUDIOMIX_TARGET_AVX2 static void clipAVX2(float *buf, unsigned int n) {
+	const __m256 lo = _mm256_set1_ps(-1.0f);
+	const __m256 hi = _mm256_set1_ps(1.0f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(buf + i, _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(buf + i), hi), lo));
+	clipTail(buf, i, n);
+}
+
+AUDIOMIX_TARGET_AVX2 static void toShortAVX2(short *dst, const float *src, unsigned int n) {
+	const __m256 scale = _mm256_set1_ps(32768.f);
+	const __m256 lo = _mm256_set1_ps(-32768.f);
+	const __m256 hi = _mm256_set1_ps(32767.f);
+	unsigned int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), hi), lo);
+		const __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), hi), lo);
+		// Packing works within 128 bit lanes as well.
+		const __m256i p = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(p, 0xd8));
+	}
+	toShortTail(dst, src, i, n);
+}
+
+AUDIOMIX_TARGET_AVX2 static inline float sumAVX2(__m256 v) {
+	__m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+	h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+	return _mm_cvtss_f32(h);
+}
+
+AUDIOMIX_TARGET_AVX2 static inline float maxAVX2(__m256 v) {
+	__m128 h = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+	h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+	return _mm_cvtss_f32(h);
+}
+
+AUDIOMIX_TARGET_AVX2 static float toShortPowerAVX2(short *dst, const float *src, unsigned int n, float &peak) {
+	const __m256 scale = _mm256_set1_ps(32768.f);
+	const __m256 lo = _mm256_set1_ps(-32768.f);
+	const __m256 hi = _mm256_set1_ps(32767.f);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 sum = _mm256_setzero_ps();
+	__m256 max = _mm256_setzero_ps();
+	unsigned int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), hi), lo);
+		const __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), hi), lo);
+		const __m256i p = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(p, 0xd8));
+		sum = _mm256_add_ps(sum, _mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b)));
+		max = _mm256_max_ps(max, _mm256_max_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b)));
+	}
+	float s = sumAVX2(sum);
+	peak = maxAVX2(max);
+	toShortPowerTail(dst, src, i, n, s, peak);
+	return s;
+}
+
+AUDIOMIX_TARGET_AVX2 static float powerAVX2(const short *src, unsigned int n, float &peak) {
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 sum = _mm256_setzero_ps();
+	__m256 max = _mm256_setzero_ps();
+	unsigned int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m128i *p = reinterpret_cast<const __m128i *>(src + i);
+		const __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(p)));
+		const __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(p + 1)));
+		sum = _mm256_add_ps(sum, _mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b)));
+		max = _mm256_max_ps(max, _mm256_max_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b)));
+	}
+	float s = sumAVX2(sum);
+	peak = maxAVX2(max);
+	powerTail(src, i, n, s, peak);
+	return s;
+}
+
+AUDIOMIX_TARGET_AVX2 static float dotAVX2(const float *a, const float *b, unsigned int n) {
+	__m256 s0 = _mm256_setzero_ps();
+	__m256 s1 = _mm256_setzero_ps();
+	unsigned int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+		s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+	}
+	if (i + 8 <= n) {
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+		i += 8;
+	}
+	return sumAVX2(_mm256_add_ps(s0, s1)) + dotTail(a, b, i, n);
+}
+
+static bool cpuHasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	// The OS has to save the AVX registers as well.
+	__cpuid(info, 1);
+	const int osxsaveavx = (1 << 27) | (1 << 28);
+	if ((info[2] & osxsaveavx) != osxsaveavx)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef AUDIOMIX_NEON
+static void addNEON(float *dst, const float *src, unsigned int n, float gain) {
+	const float32x4_t g = vdupq_n_f32(gain);
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vld1q_f32(src + i), g)));
+	addTail(dst, src, i, n, gain);
+}
+
+static void addRampNEON(float *dst, const float *src, unsigned int n, float gain, float inc) {
+	static const float first[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	const float32x4_t g = vdupq_n_f32(gain);
+	const float32x4_t d = vdupq_n_f32(inc);
+	const float32x4_t step = vdupq_n_f32(4.0f);
+	float32x4_t idx = vld1q_f32(first);
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t v = vaddq_f32(g, vmulq_f32(d, idx));
+		vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vmulq_f32(vld1q_f32(src + i), v)));
+		idx = vaddq_f32(idx, step);
+	}
+	addRampTail(dst, src, i, n, gain, inc);
+}
+
+static void interleaveStereoNEON(float *dst, const float *src, unsigned int n) {
+	const float *l = src;
+	const float *r = src + n;
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float32x4x2_t v;
+		v.val[0] = vld1q_f32(l + i);
+		v.val[1] = vld1q_f32(r + i);
+		vst2q_f32(dst + 2 * i, v);
+	}
+	interleaveTail(dst, src, 2, i, n);
+}
+
+static void clipNEON(float *buf, unsigned int n) {
+	const float32x4_t lo = vdupq_n_f32(-1.0f);
+	const float32x4_t hi = vdupq_n_f32(1.0f);
+	unsigned int i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(buf + i, vmaxq_f32(vminq_f32(vld1q_f32(buf + i), hi), lo));
+	clipTail(buf, i, n);
+}
+
+static void toShortNEON(short *dst, const float *src, unsigned int n) {
+	const float32x4_t scale = vdupq_n_f32(32768.f);
+	const float32x4_t lo = vdupq_n_f32(-32768.f);
+	const float32x4_t hi = vdupq_n_f32(32767.f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const float32x4_t a = vmaxq_f32(vminq_f32(vmulq_f32(vld1q_f32(src + i), scale), hi), lo);
+		const float32x4_t b = vmaxq_f32(vminq_f32(vmulq_f32(vld1q_f32(src + i + 4), scale), hi), lo);
+		vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+	}
+	toShortTail(dst, src, i, n);
+}
+
+static inline float sumNEON(float32x4_t v) {
+	const float32x2_t h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpadd_f32(h, h), 0);
+}
+
+static inline float maxNEON(float32x4_t v) {
+	const float32x2_t h = vmax_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpmax_f32(h, h), 0);
+}
+
+static float toShortPowerNEON(short *dst, const float *src, unsigned int n, float &peak) {
+	const float32x4_t scale = vdupq_n_f32(32768.f);
+	const float32x4_t lo = vdupq_n_f32(-32768.f);
+	const float32x4_t hi = vdupq_n_f32(32767.f);
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	float32x4_t max = vdupq_n_f32(0.0f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const float32x4_t a = vmaxq_f32(vminq_f32(vmulq_f32(vld1q_f32(src + i), scale), hi), lo);
+		const float32x4_t b = vmaxq_f32(vminq_f32(vmulq_f32(vld1q_f32(src + i + 4), scale), hi), lo);
+		vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+		sum = vaddq_f32(sum, vaddq_f32(vmulq_f32(a, a), vmulq_f32(b, b)));
+		max = vmaxq_f32(max, vmaxq_f32(vabsq_f32(a), vabsq_f32(b)));
+	}
+	float s = sumNEON(sum);
+	peak = maxNEON(max);
+	toShortPowerTail(dst, src, i, n, s, peak);
+	return s;
+}
+
+static float powerNEON(const short *src, unsigned int n, float &peak) {
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	float32x4_t max = vdupq_n_f32(0.0f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t v = vld1q_s16(src + i);
+		const float32x4_t a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+		const float32x4_t b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+		sum = vaddq_f32(sum, vaddq_f32(vmulq_f32(a, a), vmulq_f32(b, b)));
+		max = vmaxq_f32(max, vmaxq_f32(vabsq_f32(a), vabsq_f32(b)));
+	}
+	float s = sumNEON(sum);
+	peak = maxNEON(max);
+	powerTail(src, i, n, s, peak);
+	return s;
+}
+
+static float dotNEON(const float *a, const float *b, unsigned int n) {
+	float32x4_t s0 = vdupq_n_f32(0.0f);
+	float32x4_t s1 = vdupq_n_f32(0.0f);
+	unsigned int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+		s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+	}
+	return sumNEON(vaddq_f32(s0, s1)) + dotTail(a, b, i, n);
+}
+#endif
+
+struct AudioMixKernels {
+	const char *name;
+	void (*add)(float *, const float *, unsigned int, float);
+	void (*addRamp)(float *, const float *, unsigned int, float, float);
+	void (*interleaveStereo)(float *, const float *, unsigned int);
+	void (*clip)(float *, unsigned int);
+	void (*toShort)(short *, const float *, unsigned int);
+	float (*toShortPower)(short *, const float *, unsigned int, float &);
+	float (*power)(const short *, unsigned int, float &);
+	float (*dot)(const float *, const float *, unsigned int);
+};
+
+static const AudioMixKernels kernelsPlain = { "plain", addPlain, addRampPlain, interleaveStereoPlain, clipPlain, toShortPlain, toShortPowerPlain, powerPlain, dotPlain };
+#ifdef AUDIOMIX_SSE2
+static const AudioMixKernels kernelsSSE2 = { "SSE2", addSSE2, addRampSSE2, interleaveStereoSSE2, clipSSE2, toShortSSE2, toShortPowerSSE2, powerSSE2, dotSSE2 };
+#endif
+#ifdef AUDIOMIX_AVX2
+static const AudioMixKernels kernelsAVX2 = { "AVX2", addAVX2, addRampAVX2, interleaveStereoAVX2, clipAVX2, toShortAVX2, toShortPowerAVX2, powerAVX2, dotAVX2 };
+#endif
+#ifdef AUDIOMIX_NEON
+static const AudioMixKernels kernelsNEON = { "NEON", addNEON, addRampNEON, interleaveStereoNEON, clipNEON, toShortNEON, toShortPowerNEON, powerNEON, dotNEON };
+#endif
+
+static const AudioMixKernels *chooseKernels() {
+#ifdef AUDIOMIX_AVX2
+	if (cpuHasAVX2())
+		return &kernelsAVX2;
+#endif
+#if defined(AUDIOMIX_SSE2)
+	return &kernelsSSE2;
+#elif defined(AUDIOMIX_NEON)
+	return &kernelsNEON;
+#else
+	return &kernelsPlain;
+#endif
+}
+
+// Chosen during static initialization, before any audio thread runs.
+static const AudioMixKernels *kernels = chooseKernels();
+
+void AudioMix::add(float *dst, const float *src, unsigned int n, float gain) {
+	kernels->add(dst, src, n, gain);
+}
+
+void AudioMix::addRamp(float *dst, const float *src, unsigned int n, float gain, float inc) {
+	kernels->addRamp(dst, src, n, gain, inc);
+}
+
+void AudioMix::interleave(float *dst, const float *src, unsigned int nchan, unsigned int n) {
+	if (nchan == 1)
+		memcpy(dst, src, sizeof(float) * n);
+	else if (nchan == 2)
+		kernels->interleaveStereo(dst, src, n);
+	else
+		interleaveTail(dst, src, nchan, 0, n);
+}
+
+void AudioMix::clip(float *buf, unsigned int n) {
+	kernels->clip(buf, n);
+}
+
+void AudioMix::toShort(short *dst, const float *src, unsigned int n) {
+	kernels->toShort(dst, src, n);
+}
+
+float AudioMix::toShortPower(short *dst, const float *src, unsigned int n, float &peak) {
+	return kernels->toShortPower(dst, src, n, peak);
+}
+
+float AudioMix::power(const short *src, unsigned int n, float &peak) {
+	return kernels->power(src, n, peak);
+}
+
+float AudioMix::dot(const float *a, const float *b, unsigned int n) {
+	return kernels->dot(a, b, n);
+}
+
+const char *AudioMix::implementation() {
+	return kernels->name;
+}
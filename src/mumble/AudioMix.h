@@ -0,0 +1,54 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_AUDIOMIX_H_
+#define MUMBLE_MUMBLE_AUDIOMIX_H_
+
+/// Sample kernels for the output mixer, the capture path and the
+/// resampler.
+///
+/// The best implementation for the CPU is picked once on startup:
+/// AVX2 if the CPU supports it, SSE2 on other x86 CPUs, NEON on ARM,
+/// and plain loops everywhere else. All implementations compute the
+/// same results as the plain loops, except where noted.
+///
+/// Buffers don't need to be aligned, but must not overlap.
+namespace AudioMix {
+	/// Adds src, multiplied by gain, to dst.
+	void add(float *dst, const float *src, unsigned int n, float gain);
+
+	/// Adds src to dst with a gain that starts at gain and changes
+	/// by inc for every sample, i.e. dst[i] += src[i] * (gain + inc * i).
+	void addRamp(float *dst, const float *src, unsigned int n, float gain, float inc);
+
+	/// Interleaves nchan channels of n samples each, stored one after
+	/// the other in src, into dst.
+	void interleave(float *dst, const float *src, unsigned int nchan, unsigned int n);
+
+	/// Clips the n samples in buf to [-1, 1].
+	void clip(float *buf, unsigned int n);
+
+	/// Converts n samples to 16 bit, clipping them.
+	void toShort(short *dst, const float *src, unsigned int n);
+
+	/// Converts like toShort(), and measures the level on the way:
+	/// returns the sum of the squares of the clipped samples, and
+	/// stores the largest magnitude in peak, both on the 16 bit scale.
+	float toShortPower(short *dst, const float *src, unsigned int n, float &peak);
+
+	/// Returns the sum of the squares of n 16 bit samples, and stores
+	/// the largest magnitude in peak.
+	float power(const short *src, unsigned int n, float &peak);
+
+	/// Returns the sum of a[i] * b[i]. The vector kernels add in a
+	/// different order, so the result may differ from the plain loop
+	/// in the last bits.
+	float dot(const float *a, const float *b, unsigned int n);
+
+	/// Returns the name of the implementation in use.
+	const char *implementation();
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include "AudioOutput.h"
 
 #include "AudioInput.h"
+#include "AudioMix.h"
 #include "AudioOutputSample.h"
 #include "AudioOutputSpeech.h"
 #include "User.h"
@@ -75,11 +76,32 @@ bool AudioOutputRegistrar::canExclusive() const {
 	return false;
 }
 
+/// A thread that decodes speech ahead of the audio callback.
+class AudioOutputDecoder : public QThread {
+	private:
+		Q_DISABLE_COPY(AudioOutputDecoder)
+	protected:
+		AudioOutput *aoOutput;
+		void run() Q_DECL_OVERRIDE;
+	public:
+		AudioOutputDecoder(AudioOutput *ao) : aoOutput(ao) {}
+};
+
+void AudioOutputDecoder::run() {
+	unsigned int generation = 0;
+	while (aoOutput->waitForMix(generation))
+		aoOutput->decodeAhead();
+}
+
 AudioOutput::AudioOutput()
     : fSpeakers(NULL)
     , fSpeakerVolume(NULL)
     , bSpeakerPositional(NULL)
     
+    , iDecodeGeneration(0)
+    , bDecoding(true)
+    , iDecodeAhead(0)
+    
     , eSampleFormat(SampleFloat)
     
     , bRunning(true)
@@ -90,14 +112,33 @@ AudioOutput::AudioOutput()
     , iSampleSize(0)
     
     , qrwlOutputs()
-    , qmOutputs() {
+    , qmOutputs()
+    
+    , iPlayoutTarget(0)
+    , iPlayoutDelay(0) {
 	
-	// Nothing
+	// Leave a core for the audio thread.
+	const int decoders = qBound(1, QThread::idealThreadCount() - 1, 4);
+	for (int i = 0; i < decoders; ++i) {
+		AudioOutputDecoder *aod = new AudioOutputDecoder(this);
+		aod->start(QThread::HighPriority);
+		qlDecoders << aod;
+	}
 }
 
 AudioOutput::~AudioOutput() {
 	bRunning = false;
 	wait();
+
+	qmDecode.lock();
+	bDecoding = false;
+	qwcDecode.wakeAll();
+	qmDecode.unlock();
+	foreach(AudioOutputDecoder *aod, qlDecoders) {
+		aod->wait();
+		delete aod;
+	}
+
 	wipe();
 
 	delete [] fSpeakers;
@@ -154,7 +195,7 @@ const float *AudioOutput::getSpeakerPos(unsigned int &speakers) {
 	return NULL;
 }
 
-void AudioOutput::addFrameToBuffer(ClientUser *user, const QByteArray &qbaPacket, unsigned int iSeq, MessageHandler::UDPMessageType type) {
+void AudioOutput::addFrameToBuffer(ClientUser *user, unsigned int flags, const char *data, unsigned int len, unsigned int iSeq, MessageHandler::UDPMessageType type) {
 	if (iChannels == 0)
 		return;
 	qrwlOutputs.lockForRead();
@@ -178,7 +219,7 @@ void AudioOutput::addFrameToBuffer(ClientUser *user, const QByteArray &qbaPacket
 		qmOutputs.replace(user, aop);
 	}
 
-	aop->addFrameToBuffer(qbaPacket, iSeq);
+	aop->addFrameToBuffer(flags, data, len, iSeq);
 
 	qrwlOutputs.unlock();
 }
@@ -193,6 +234,12 @@ void AudioOutput::removeBuffer(AudioOutputUser *aop) {
 	for (i=qmOutputs.begin(); i != qmOutputs.end(); ++i) {
 		if (i.value() == aop) {
 			qmOutputs.erase(i);
+			// No decoder can pick it up anymore, but one may still
+			// be decoding it.
+			if (aop->aosSpeech) {
+				while (! aop->aosSpeech->claim())
+					QThread::yieldCurrentThread();
+			}
 			delete aop;
 			break;
 		}
@@ -342,14 +389,15 @@ void AudioOutput::initializeMixer(const unsigned int *chanmasks, bool forceheadp
 		}
 	}
 	iSampleSize = static_cast<int>(iChannels * ((eSampleFormat == SampleFloat) ? sizeof(float) : sizeof(short)));
-	qWarning("AudioOutput: Initialized %d channel %d hz mixer", iChannels, iMixerFreq);
+	qWarning("AudioOutput: Initialized %d channel %d hz mixer using %s kernels", iChannels, iMixerFreq, AudioMix::implementation());
 }
 
 bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
-	QList<AudioOutputUser *> qlMix;
-	QList<AudioOutputUser *> qlDel;
+	mixList.clear();
+	delList.clear();
 	
 	if (g.s.fVolume < 0.01f) {
+		iPlayoutTarget = iPlayoutDelay = 0;
 		return false;
 	}
 
@@ -365,14 +413,22 @@ bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
 	qrwlOutputs.lockForRead();
 	
 	bool prioritySpeakerActive = false;
+	int playoutTarget = 0;
+	int playoutDelay = 0;
 	
 	QMultiHash<const ClientUser *, AudioOutputUser *>::const_iterator it = qmOutputs.constBegin();
 	while (it != qmOutputs.constEnd()) {
 		AudioOutputUser *aop = it.value();
 		if (! aop->needSamples(nsamp)) {
-			qlDel.append(aop);
+			delList.push_back(aop);
 		} else {
-			qlMix.append(aop);
+			mixList.push_back(aop);
+			
+			const AudioOutputSpeech *speech = aop->aosSpeech;
+			if (speech && (speech->iTargetDelay > playoutTarget)) {
+				playoutTarget = speech->iTargetDelay;
+				playoutDelay = speech->iCurrentDelay;
+			}
 			
 			const ClientUser *user = it.key();
 			if (user && user->bPrioritySpeaker) {
@@ -386,30 +442,51 @@ bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
 		prioritySpeakerActive = true;
 	}
 
-	if (! qlMix.isEmpty()) {
+	iPlayoutTarget = playoutTarget;
+	iPlayoutDelay = playoutDelay;
+
+	// Have the decoders refill what was just taken while we mix. They
+	// keep two callbacks' worth ready, so that they have a whole
+	// period to catch up.
+	iDecodeAhead = 2 * nsamp;
+	qmDecode.lock();
+	++iDecodeGeneration;
+	qwcDecode.wakeAll();
+	qmDecode.unlock();
+
+	if (! mixList.empty()) {
 		STACKVAR(float, speaker, iChannels*3);
 		STACKVAR(float, svol, iChannels);
 
-		STACKVAR(float, fOutput, iChannels * nsamp);
-		float *output = (eSampleFormat == SampleFloat) ? reinterpret_cast<float *>(outbuff) : fOutput;
+		// Each channel is mixed on its own, so that the kernels work
+		// on consecutive samples, and interleaved at the end.
+		if (planarBuffer.size() < nsamp * nchan)
+			planarBuffer.resize(nsamp * nchan);
+		float *planar = &planarBuffer[0];
 		bool validListener = false;
 
-		memset(output, 0, sizeof(float) * nsamp * iChannels);
+		memset(planar, 0, sizeof(float) * nsamp * nchan);
 
-		boost::shared_array<float> recbuff;
+		const bool mixDown = recorder && recorder->isInMixDownMode();
+		float *recbuff = NULL;
 		if (recorder) {
-			recbuff = boost::shared_array<float>(new float[nsamp]);
-			memset(recbuff.get(), 0, sizeof(float) * nsamp);
+			if (mixDown) {
+				if (recordBuffer.size() < nsamp)
+					recordBuffer.resize(nsamp);
+				recbuff = &recordBuffer[0];
+				memset(recbuff, 0, sizeof(float) * nsamp);
+			}
 			recorder->prepareBufferAdds();
 		}
 
 		for (unsigned int i=0;i<iChannels;++i)
 			svol[i] = mul * fSpeakerVolume[i];
 
-		if (g.s.bPositionalAudio && (iChannels > 1) && g.p->fetch() && (g.bPosTest || g.p->fCameraPosition[0] != 0 || g.p->fCameraPosition[1] != 0 || g.p->fCameraPosition[2] != 0)) {
+		PositionSample listener;
+		if (g.s.bPositionalAudio && (iChannels > 1) && g.p->pbPositions.interpolated(prListener, listener) && (g.bPosTest || listener.fCameraPosition[0] != 0 || listener.fCameraPosition[1] != 0 || listener.fCameraPosition[2] != 0)) {
 
-			float front[3] = { g.p->fCameraFront[0], g.p->fCameraFront[1], g.p->fCameraFront[2] };
-			float top[3] = { g.p->fCameraTop[0], g.p->fCameraTop[1], g.p->fCameraTop[2] };
+			float front[3] = { listener.fCameraFront[0], listener.fCameraFront[1], listener.fCameraFront[2] };
+			float top[3] = { listener.fCameraTop[0], listener.fCameraTop[1], listener.fCameraTop[2] };
 
 			// Front vector is dominant; if it's zero we presume all is zero.
 
@@ -471,11 +548,12 @@ bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
 			validListener = true;
 		}
 
-		foreach(AudioOutputUser *aop, qlMix) {
+		for (size_t m = 0; m < mixList.size(); ++m) {
+			AudioOutputUser *aop = mixList[m];
 			const float * RESTRICT pfBuffer = aop->pfBuffer;
 			float volumeAdjustment = 1;
 
-			AudioOutputSpeech *speech = qobject_cast<AudioOutputSpeech *>(aop);
+			AudioOutputSpeech *speech = aop->aosSpeech;
 			if (speech) {
 				const ClientUser *user = speech->p;
 				volumeAdjustment *= user->fLocalVolume;
@@ -490,33 +568,23 @@ bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
 			}
 
 			if (recorder) {
-				AudioOutputSpeech *aos = qobject_cast<AudioOutputSpeech *>(aop);
+				AudioOutputSpeech *aos = aop->aosSpeech;
 
 				if (aos) {
-					for (unsigned int i = 0; i < nsamp; ++i) {
-						recbuff[i] += pfBuffer[i] * volumeAdjustment;
-					}
-
-					if (!recorder->isInMixDownMode()) {
-						if (aos) {
-							recorder->addBuffer(aos->p, recbuff, nsamp);
-						} else {
-							// this should be unreachable
-							Q_ASSERT(false);
-						}
-						recbuff = boost::shared_array<float>(new float[nsamp]);
-						memset(recbuff.get(), 0, sizeof(float) * nsamp);
-					}
+					if (mixDown)
+						AudioMix::add(recbuff, pfBuffer, nsamp, volumeAdjustment);
+					else
+						recorder->addBuffer(aos->p, pfBuffer, nsamp, volumeAdjustment);
 
 					// Don't add the local audio to the real output
-					if (qobject_cast<RecordUser *>(aos->p)) {
+					if (aos->bRecordOnly) {
 						continue;
 					}
 				}
 			}
 
 			if (validListener && ((aop->fPos[0] != 0.0f) || (aop->fPos[1] != 0.0f) || (aop->fPos[2] != 0.0f))) {
-				float dir[3] = { aop->fPos[0] - g.p->fCameraPosition[0], aop->fPos[1] - g.p->fCameraPosition[1], aop->fPos[2] - g.p->fCameraPosition[2] };
+				float dir[3] = { aop->fPos[0] - listener.fCameraPosition[0], aop->fPos[1] - listener.fCameraPosition[1], aop->fPos[2] - listener.fCameraPosition[2] };
 				float len = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
 				if (len > 0.0f) {
 					dir[0] /= len;
@@ -535,7 +603,7 @@ bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
 				for (unsigned int s=0;s<nchan;++s) {
 					const float dot = bSpeakerPositional[s] ? dir[0] * speaker[s*3+0] + dir[1] * speaker[s*3+1] + dir[2] * speaker[s*3+2] : 1.0f;
 					const float str = svol[s] * calcGain(dot, len) * volumeAdjustment;
-					float * RESTRICT o = output + s;
+					float * RESTRICT o = planar + s * nsamp;
 					const float old = (aop->pfVolume[s] >= 0.0f) ? aop->pfVolume[s] : str;
 					const float inc = (str - old) / static_cast<float>(nsamp);
 					aop->pfVolume[s] = str;
@@ -543,38 +611,82 @@ bool AudioOutput::mix(void *outbuff, unsigned int nsamp) {
 										qWarning("%d: Pos %f %f %f : Dot %f Len %f Str %f", s, speaker[s*3+0], speaker[s*3+1], speaker[s*3+2], dot, len, str);
 					*/
 					if ((old >= 0.00000001f) || (str >= 0.00000001f))
-						for (unsigned int i=0;i<nsamp;++i)
-							o[i*nchan] += pfBuffer[i] * (old + inc*static_cast<float>(i));
+						AudioMix::addRamp(o, pfBuffer, nsamp, old, inc);
 				}
 			} else {
 				for (unsigned int s=0;s<nchan;++s) {
 					const float str = svol[s] * volumeAdjustment;
-					float * RESTRICT o = output + s;
-					for (unsigned int i=0;i<nsamp;++i)
-						o[i*nchan] += pfBuffer[i] * str;
+					AudioMix::add(planar + s * nsamp, pfBuffer, nsamp, str);
 				}
 			}
 		}
 
-		if (recorder && recorder->isInMixDownMode()) {
-			recorder->addBuffer(NULL, recbuff, nsamp);
+		if (mixDown) {
+			recorder->addBuffer(NULL, recbuff, nsamp, 1.0f);
 		}
 
-		// Clip
-		if (eSampleFormat == SampleFloat)
-			for (unsigned int i=0;i<nsamp*iChannels;i++)
-				output[i] = qBound(-1.0f, output[i], 1.0f);
-		else
-			for (unsigned int i=0;i<nsamp*iChannels;i++)
-				reinterpret_cast<short *>(outbuff)[i] = static_cast<short>(qBound(-32768.f, (output[i] * 32768.f), 32767.f));
+		// Interleave and clip
+		if (eSampleFormat == SampleFloat) {
+			float *output = reinterpret_cast<float *>(outbuff);
+			AudioMix::interleave(output, planar, nchan, nsamp);
+			AudioMix::clip(output, nsamp * nchan);
+		} else {
+			if (interleavedBuffer.size() < nsamp * nchan)
+				interleavedBuffer.resize(nsamp * nchan);
+			float *output = &interleavedBuffer[0];
+			AudioMix::interleave(output, planar, nchan, nsamp);
+			AudioMix::toShort(reinterpret_cast<short *>(outbuff), output, nsamp * nchan);
+		}
 	}
 
 	qrwlOutputs.unlock();
 
-	foreach(AudioOutputUser *aop, qlDel)
-		removeBuffer(aop);
+	for (size_t m = 0; m < delList.size(); ++m)
+		removeBuffer(delList[m]);
 	
-	return (! qlMix.isEmpty());
+	return (! mixList.empty());
+}
+
+bool AudioOutput::waitForMix(unsigned int &generation) {
+	QMutexLocker lock(&qmDecode);
+	while (bDecoding && (generation == iDecodeGeneration))
+		qwcDecode.wait(&qmDecode);
+	generation = iDecodeGeneration;
+	return bDecoding;
+}
+
+void AudioOutput::decodeAhead() {
+	qrwlOutputs.lockForRead();
+	const bool loopy = qmOutputs.contains(&LoopUser::lpLoopy);
+	qrwlOutputs.unlock();
+
+	// Loopback packets are due by time, and need to be queued before
+	// they can be decoded.
+	if (loopy)
+		LoopUser::lpLoopy.fetchFrames();
+
+	const unsigned int lead = iDecodeAhead;
+
+	forever {
+		AudioOutputSpeech *aos = NULL;
+
+		qrwlOutputs.lockForRead();
+		QMultiHash<const ClientUser *, AudioOutputUser *>::const_iterator it;
+		for (it = qmOutputs.constBegin(); it != qmOutputs.constEnd(); ++it) {
+			AudioOutputSpeech *speech = it.value()->aosSpeech;
+			if (speech && speech->needsDecode(lead) && speech->claim()) {
+				aos = speech;
+				break;
+			}
+		}
+		qrwlOutputs.unlock();
+
+		if (! aos)
+			return;
+
+		aos->decodeAhead(lead);
+		aos->release();
+	}
 }
 
 bool AudioOutput::isAlive() const {
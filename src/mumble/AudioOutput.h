@@ -7,8 +7,11 @@
 #define MUMBLE_MUMBLE_AUDIOOUTPUT_H_
 
 #include <boost/shared_ptr.hpp>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
 #include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+#include <vector>
 
 // AudioOutput depends on User being valid. This means it's important
 // to removeBuffer from here BEFORE MainWindow gets any UserLeft
@@ -39,11 +42,13 @@
 
 #include "Audio.h"
 #include "Message.h"
+#include "PositionBuffer.h"
 
 class AudioOutput;
 class ClientUser;
 class AudioOutputUser;
 class AudioOutputSample;
+class AudioOutputDecoder;
 
 typedef boost::shared_ptr<AudioOutput> AudioOutputPtr;
 
@@ -76,6 +81,33 @@ class AudioOutput : public QThread {
 		float *fSpeakers;
 		float *fSpeakerVolume;
 		bool *bSpeakerPositional;
+
+		/// Buffers that mix() reuses between callbacks, so that it
+		/// doesn't allocate while the backend waits for audio. They
+		/// only grow.
+		std::vector<AudioOutputUser *> mixList;
+		std::vector<AudioOutputUser *> delList;
+		/// Mix of each channel, one after the other.
+		std::vector<float> planarBuffer;
+		/// Interleaved mix, for backends that want 16 bit samples.
+		std::vector<float> interleavedBuffer;
+		/// Mix of the speech for the recorder in mixdown mode.
+		std::vector<float> recordBuffer;
+
+		/// Threads that decode speech ahead of mix(), so that the
+		/// audio callback only has to mix.
+		QList<AudioOutputDecoder *> qlDecoders;
+		/// Guards iDecodeGeneration and bDecoding. mix() only holds
+		/// it to wake the decoders.
+		QMutex qmDecode;
+		QWaitCondition qwcDecode;
+		/// Bumped by every mix().
+		unsigned int iDecodeGeneration;
+		bool bDecoding;
+		/// Samples the decoders keep ready for every speaker.
+		volatile unsigned int iDecodeAhead;
+		/// Where mix() last found the listener.
+		PositionBuffer::Reader prListener;
 	protected:
 		enum { SampleShort, SampleFloat } eSampleFormat;
 		volatile bool bRunning;
@@ -90,12 +122,31 @@ class AudioOutput : public QThread {
 		void initializeMixer(const unsigned int *chanmasks, bool forceheadphone = false);
 		bool mix(void *output, unsigned int nsamp);
 	public:
+		/// Target and current delay, in microseconds, of the playout
+		/// buffer with the largest target among the users that are
+		/// speaking, or 0 if nobody is.
+		volatile int iPlayoutTarget;
+		volatile int iPlayoutDelay;
+
 		void wipe();
 
+		/// Waits until mix() has run since generation, and updates
+		/// it. Returns false when the decoders should stop.
+		bool waitForMix(unsigned int &generation);
+		/// Decodes speech until every speaker has enough audio ready,
+		/// spreading the speakers over the threads that call it.
+		void decodeAhead();
+
 		AudioOutput();
 		~AudioOutput() Q_DECL_OVERRIDE;
 
-		void addFrameToBuffer(ClientUser *, const QByteArray &, unsigned int iSeq, MessageHandler::UDPMessageType type);
+		/// Queues a voice packet of user for playback, creating the
+		/// user's buffer if needed. flags are the low bits of the UDP
+		/// header, and data is the part of the packet after the
+		/// sequence number. With len 0, only the buffer is created.
+		///
+		/// Packets of each user must come from a single thread.
+		void addFrameToBuffer(ClientUser *user, unsigned int flags, const char *data, unsigned int len, unsigned int iSeq, MessageHandler::UDPMessageType type);
 		void removeBuffer(const ClientUser *);
 		AudioOutputSample *playSample(const QString &filename, bool loop = false);
 		void run() Q_DECL_OVERRIDE = 0;
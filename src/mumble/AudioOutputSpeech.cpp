@@ -11,15 +11,22 @@
 #include "CELTCodec.h"
 #include "ClientUser.h"
 #include "Global.h"
+#include "LatencyProbe.h"
 #include "PacketDataStream.h"
+#include "TimeStretch.h"
+#include "Timer.h"
 
 #ifdef USE_OPUS
 #include "opus.h"
 #endif
 
-AudioOutputSpeech::AudioOutputSpeech(ClientUser *user, unsigned int freq, MessageHandler::UDPMessageType type) : AudioOutputUser(user->qsName) {
-	int err;
+// Clock for packet arrival and playout times.
+static Timer tClock;
+
+AudioOutputSpeech::AudioOutputSpeech(ClientUser *user, unsigned int freq, MessageHandler::UDPMessageType type) : AudioOutputUser(user->qsName), srDecoded(freq / 2), qaiFinished(0), qaiBusy(0) {
 	p = user;
+	aosSpeech = this;
+	bRecordOnly = (qobject_cast<RecordUser *>(user) != NULL);
 	umtType = type;
 	iMixerFreq = freq;
 
@@ -51,20 +58,23 @@ AudioOutputSpeech::AudioOutputSpeech(ClientUser *user, unsigned int freq, Messag
 		iAudioBufferSize = iFrameSize;
 	}
 
+	// Room for lengthening the decoded audio.
+	iAudioBufferSize += iAudioBufferSize / 2;
+
 	iOutputSize = static_cast<unsigned int>(ceilf(static_cast<float>(iAudioBufferSize * iMixerFreq) / static_cast<float>(iSampleRate)));
 	if (bStereo) {
 		iAudioBufferSize *= 2;
 		iOutputSize *= 2;
 	}
 
-	srs = NULL;
+	rsOutput = NULL;
 	fResamplerBuffer = NULL;
 	if (iMixerFreq != iSampleRate) {
-		srs = speex_resampler_init(bStereo ? 2 : 1, iSampleRate, iMixerFreq, 3, &err);
+		rsOutput = new Resampler(bStereo ? 2 : 1, iSampleRate, iMixerFreq, 3);
 		fResamplerBuffer = new float[iAudioBufferSize];
 	}
+	fDecodeBuffer = new float[iOutputSize];
 
-	iBufferOffset = iBufferFilled = iLastConsume = 0;
 	bLastAlive = true;
 
 	iMissCount = 0;
@@ -72,9 +82,14 @@ AudioOutputSpeech::AudioOutputSpeech(ClientUser *user, unsigned int freq, Messag
 
 	ucFlags = 0xFF;
 
-	jbJitter = jitter_buffer_init(iFrameSize);
-	int margin = g.s.iJitterBufferSize * iFrameSize;
-	jitter_buffer_ctl(jbJitter, JITTER_BUFFER_SET_MARGIN, &margin);
+	const int minDelay = static_cast<int>((static_cast<quint64>(g.s.iJitterBufferSize * iFrameSize) * 1000000ULL) / iSampleRate);
+	pbPlayout = new PlayoutBuffer(iFrameSize, iSampleRate, &user->jhJitter, static_cast<float>(g.s.iJitterBufferPercentile), minDelay);
+	iTargetDelay = pbPlayout->targetDelay();
+	iCurrentDelay = 0;
+	iNextFrame = 0;
+	iPacketSeq = 0;
+
+	bProbed = (user == &LoopUser::lpLoopy) || (g.uiSession && (user->uiSession == g.uiSession));
 
 	fFadeIn = new float[iFrameSize];
 	fFadeOut = new float[iFrameSize];
@@ -96,26 +111,21 @@ AudioOutputSpeech::~AudioOutputSpeech() {
 		speex_decoder_destroy(dsSpeex);
 	}
 
-	if (srs)
-		speex_resampler_destroy(srs);
+	delete rsOutput;
 
-	jitter_buffer_destroy(jbJitter);
+	delete pbPlayout;
 
 	delete [] fFadeIn;
 	delete [] fFadeOut;
 	delete [] fResamplerBuffer;
+	delete [] fDecodeBuffer;
 }
 
-void AudioOutputSpeech::addFrameToBuffer(const QByteArray &qbaPacket, unsigned int iSeq) {
-	QMutexLocker lock(&qmJitter);
-
-	if (qbaPacket.size() < 2)
+void AudioOutputSpeech::addFrameToBuffer(unsigned int flags, const char *data, unsigned int len, unsigned int iSeq) {
+	if ((len < 1) || (len >= VoicePacket::iMaxSize))
 		return;
 
-	PacketDataStream pds(qbaPacket);
-
-	// skip flags
-	pds.next();
+	PacketDataStream pds(data, len);
 
 	int samples = 0;
 	if (umtType == MessageHandler::UDPVoiceOpus) {
@@ -126,17 +136,17 @@ void AudioOutputSpeech::addFrameToBuffer(const QByteArray &qbaPacket, unsigned i
 			return;
 		}
 
-		const QByteArray &qba = pds.dataBlock(size);
-		if (size != qba.size() || !pds.isValid()) {
+		if (static_cast<unsigned int>(size) > pds.left() || !pds.isValid()) {
 			return;
 		}
 
-		const unsigned char *packet = reinterpret_cast<const unsigned char*>(qba.constData());
+		const unsigned char *packet = pds.dataPtr();
 
 #ifdef USE_OPUS
 		int frames = opus_packet_get_nb_frames(packet, size);
 		samples = frames * opus_packet_get_samples_per_frame(packet, SAMPLE_RATE);
 #else
+		Q_UNUSED(packet);
 		return;
 #endif
 
@@ -153,232 +163,249 @@ void AudioOutputSpeech::addFrameToBuffer(const QByteArray &qbaPacket, unsigned i
 	}
 
 	if (pds.isValid()) {
-		JitterBufferPacket jbp;
-		jbp.data = const_cast<char *>(qbaPacket.constData());
-		jbp.len = qbaPacket.size();
-		jbp.span = samples;
-		jbp.timestamp = iFrameSize * iSeq;
+		VoicePacket *vp = vprIncoming.reserve();
+		if (! vp)
+			return;
+
+		vp->iSeq = iSeq;
+		vp->uiArrival = tClock.elapsed();
+		vp->iSamples = samples;
+		vp->iSize = len + 1;
+		vp->cData[0] = static_cast<char>(flags);
+		memcpy(vp->cData + 1, data, len);
+		vprIncoming.commit();
 
-		jitter_buffer_put(jbJitter, &jbp);
+		if (bProbed && LatencyProbe::lpProbe)
+			LatencyProbe::lpProbe->received(iSeq, samples / iFrameSize);
 	}
 }
 
-bool AudioOutputSpeech::needSamples(unsigned int snum) {
-	for (unsigned int i=iLastConsume;i<iBufferFilled;++i)
-		pfBuffer[i-iLastConsume]=pfBuffer[i];
-	iBufferFilled -= iLastConsume;
+void AudioOutputSpeech::takePackets() {
+	const VoicePacket *vp;
+	while ((vp = vprIncoming.front())) {
+		pbPlayout->put(*vp);
+		vprIncoming.pop();
+	}
+}
 
-	iLastConsume = snum;
+void AudioOutputSpeech::addFrame(PacketDataStream &pds, unsigned int size) {
+	const int offset = static_cast<int>(pds.size());
+	const bool valid = (size <= pds.left());
+	pds.skip(size);
+	qvlaFrames.append(qMakePair(offset, valid ? static_cast<int>(size) : 0));
+}
 
-	if (iBufferFilled >= snum)
-		return bLastAlive;
+int AudioOutputSpeech::decodeFrame(float *pOut, bool &nextalive) {
+	int decodedSamples = iFrameSize;
 
-	float *pOut;
-	bool nextalive = bLastAlive;
+	takePackets();
 
-	while (iBufferFilled < snum) {
-		int decodedSamples = iFrameSize;
-		resizeBuffer(iBufferFilled + iOutputSize);
+	// The frame is played after everything that is already decoded
+	// ahead, so the playout buffer is asked about that moment rather
+	// than about now.
+	const unsigned int channels = bStereo ? 2 : 1;
+	const quint64 ahead = static_cast<quint64>(srDecoded.available() / channels) * 1000000ULL / iMixerFreq;
+	const quint64 playout = tClock.elapsed() + ahead;
+	if (! pbPlayout->ready(playout)) {
+		++iMissCount;
+		if (iMissCount < 20) {
+			memset(pOut, 0, iFrameSize * sizeof(float));
+			return decodedSamples;
+		}
+	}
+	const bool starting = ! pbPlayout->started();
 
-		pOut = (srs) ? fResamplerBuffer : (pfBuffer + iBufferFilled);
+	if (iNextFrame >= qvlaFrames.size()) {
+		const VoicePacket *vp = pbPlayout->get(playout);
+		if (vp) {
+			if (bProbed && LatencyProbe::lpProbe)
+				LatencyProbe::lpProbe->dequeued(vp->iSeq, vp->iSamples / iFrameSize);
 
-		if (! bLastAlive) {
-			memset(pOut, 0, iFrameSize * sizeof(float));
-		} else {
-			if (p == &LoopUser::lpLoopy) {
-				LoopUser::lpLoopy.fetchFrames();
-			}
+			iPacketSeq = vp->iSeq;
+			memcpy(cPacket, vp->cData, vp->iSize);
+			PacketDataStream pds(cPacket, vp->iSize);
 
-			int avail = 0;
-			int ts = jitter_buffer_get_pointer_timestamp(jbJitter);
-			jitter_buffer_ctl(jbJitter, JITTER_BUFFER_GET_AVAILABLE_COUNT, &avail);
-
-			if (p && (ts == 0)) {
-				int want = iroundf(p->fAverageAvailable);
-				if (avail < want) {
-					++iMissCount;
-					if (iMissCount < 20) {
-						memset(pOut, 0, iFrameSize * sizeof(float));
-						goto nextframe;
-					}
-				}
+			qvlaFrames.resize(0);
+			iNextFrame = 0;
+
+			iMissCount = 0;
+			ucFlags = static_cast<unsigned char>(pds.next());
+
+			bHasTerminator = false;
+			if (umtType == MessageHandler::UDPVoiceOpus) {
+				int size;
+				pds >> size;
+
+				bHasTerminator = size & 0x2000;
+				addFrame(pds, size & 0x1fff);
+			} else {
+				unsigned int header = 0;
+				do {
+					header = static_cast<unsigned int>(pds.next());
+					if (header)
+						addFrame(pds, header & 0x7f);
+					else
+						bHasTerminator = true;
+				} while ((header & 0x80) && pds.isValid());
 			}
 
-			if (qlFrames.isEmpty()) {
-				QMutexLocker lock(&qmJitter);
-
-				char data[4096];
-				JitterBufferPacket jbp;
-				jbp.data = data;
-				jbp.len = 4096;
-
-				spx_int32_t startofs = 0;
-
-				if (jitter_buffer_get(jbJitter, &jbp, iFrameSize, &startofs) == JITTER_BUFFER_OK) {
-					PacketDataStream pds(jbp.data, jbp.len);
-
-					iMissCount = 0;
-					ucFlags = static_cast<unsigned char>(pds.next());
-
-					bHasTerminator = false;
-					if (umtType == MessageHandler::UDPVoiceOpus) {
-						int size;
-						pds >> size;
-
-						bHasTerminator = size & 0x2000;
-						qlFrames << pds.dataBlock(size & 0x1fff);
-					} else {
-						unsigned int header = 0;
-						do {
-							header = static_cast<unsigned int>(pds.next());
-							if (header)
-								qlFrames << pds.dataBlock(header & 0x7f);
-							else
-								bHasTerminator = true;
-						} while ((header & 0x80) && pds.isValid());
-					}
-
-					if (pds.left()) {
-						pds >> fPos[0];
-						pds >> fPos[1];
-						pds >> fPos[2];
-					} else {
-						fPos[0] = fPos[1] = fPos[2] = 0.0f;
-					}
-
-					if (p) {
-						float a = static_cast<float>(avail);
-						if (avail >= p->fAverageAvailable)
-							p->fAverageAvailable = a;
-						else
-							p->fAverageAvailable *= 0.99f;
-					}
-				} else {
-					jitter_buffer_update_delay(jbJitter, &jbp, NULL);
+			if (pds.left()) {
+				pds >> fPos[0];
+				pds >> fPos[1];
+				pds >> fPos[2];
+			} else {
+				fPos[0] = fPos[1] = fPos[2] = 0.0f;
+			}
+		} else {
+			iMissCount++;
+			if (iMissCount > 10)
+				nextalive = false;
+		}
+	}
 
-					iMissCount++;
-					if (iMissCount > 10)
-						nextalive = false;
+	if (iNextFrame < qvlaFrames.size()) {
+		const QPair<int, int> &frame = qvlaFrames.at(iNextFrame++);
+		const unsigned char *frameData = frame.second ? reinterpret_cast<const unsigned char *>(cPacket + frame.first) : NULL;
+		const int frameSize = frame.second;
+
+		if (umtType == MessageHandler::UDPVoiceCELTAlpha || umtType == MessageHandler::UDPVoiceCELTBeta) {
+			int wantversion = (umtType == MessageHandler::UDPVoiceCELTAlpha) ? g.iCodecAlpha : g.iCodecBeta;
+			if ((p == &LoopUser::lpLoopy) && (! g.qmCodecs.isEmpty())) {
+				QMap<int, CELTCodec *>::const_iterator i = g.qmCodecs.constEnd();
+				--i;
+				wantversion = i.key();
+			}
+			if (cCodec && (cCodec->bitstreamVersion() != wantversion)) {
+				cCodec->celt_decoder_destroy(cdDecoder);
+				cdDecoder = NULL;
+			}
+			if (! cCodec) {
+				cCodec = g.qmCodecs.value(wantversion);
+				if (cCodec) {
+					cdDecoder = cCodec->decoderCreate();
 				}
 			}
-
-			if (! qlFrames.isEmpty()) {
-				QByteArray qba = qlFrames.takeFirst();
-
-				if (umtType == MessageHandler::UDPVoiceCELTAlpha || umtType == MessageHandler::UDPVoiceCELTBeta) {
-					int wantversion = (umtType == MessageHandler::UDPVoiceCELTAlpha) ? g.iCodecAlpha : g.iCodecBeta;
-					if ((p == &LoopUser::lpLoopy) && (! g.qmCodecs.isEmpty())) {
-						QMap<int, CELTCodec *>::const_iterator i = g.qmCodecs.constEnd();
-						--i;
-						wantversion = i.key();
-					}
-					if (cCodec && (cCodec->bitstreamVersion() != wantversion)) {
-						cCodec->celt_decoder_destroy(cdDecoder);
-						cdDecoder = NULL;
-					}
-					if (! cCodec) {
-						cCodec = g.qmCodecs.value(wantversion);
-						if (cCodec) {
-							cdDecoder = cCodec->decoderCreate();
-						}
-					}
-					if (cdDecoder)
-						cCodec->decode_float(cdDecoder, qba.isEmpty() ? NULL : reinterpret_cast<const unsigned char *>(qba.constData()), qba.size(), pOut);
-					else
-						memset(pOut, 0, sizeof(float) * iFrameSize);
-				} else if (umtType == MessageHandler::UDPVoiceOpus) {
+			if (cdDecoder)
+				cCodec->decode_float(cdDecoder, frameData, frameSize, pOut);
+			else
+				memset(pOut, 0, sizeof(float) * iFrameSize);
+		} else if (umtType == MessageHandler::UDPVoiceOpus) {
 #ifdef USE_OPUS
-					decodedSamples = opus_decode_float(opusState,
-					                                   qba.isEmpty() ?
-					                                       NULL :
-					                                       reinterpret_cast<const unsigned char *>(qba.constData()),
-					                                   qba.size(),
-					                                   pOut,
-					                                   iAudioBufferSize,
-					                                   0);
-					if (decodedSamples < 0) {
-						decodedSamples = iFrameSize;
-						memset(pOut, 0, iFrameSize * sizeof(float));
-					}
+			decodedSamples = opus_decode_float(opusState,
+			                                   frameData,
+			                                   frameSize,
+			                                   pOut,
+			                                   iAudioBufferSize,
+			                                   0);
+			if (decodedSamples < 0) {
+				decodedSamples = iFrameSize;
+				memset(pOut, 0, iFrameSize * sizeof(float));
+			}
 #endif
-				} else {
-					if (qba.isEmpty()) {
-						speex_decode(dsSpeex, NULL, pOut);
-					} else {
-						speex_bits_read_from(&sbBits, qba.data(), qba.size());
-						speex_decode(dsSpeex, &sbBits, pOut);
-					}
-					for (unsigned int i=0;i<iFrameSize;++i)
-						pOut[i] *= (1.0f / 32767.f);
-				}
+		} else {
+			if (! frameData) {
+				speex_decode(dsSpeex, NULL, pOut);
+			} else {
+				speex_bits_read_from(&sbBits, cPacket + frame.first, frameSize);
+				speex_decode(dsSpeex, &sbBits, pOut);
+			}
+			for (unsigned int i=0;i<iFrameSize;++i)
+				pOut[i] *= (1.0f / 32767.f);
+		}
 
-				bool update = true;
-				if (p) {
-					float &fPowerMax = p->fPowerMax;
-					float &fPowerMin = p->fPowerMin;
-
-					float pow = 0.0f;
-					for (int i = 0; i < decodedSamples; ++i)
-						pow += pOut[i] * pOut[i];
-					pow = sqrtf(pow / static_cast<float>(decodedSamples));
-
-					if (pow >= fPowerMax) {
-						fPowerMax = pow;
-					} else {
-						if (pow <= fPowerMin) {
-							fPowerMin = pow;
-						} else {
-							fPowerMax = 0.99f * fPowerMax;
-							fPowerMin += 0.0001f * pow;
-						}
-					}
-
-					update = (pow < (fPowerMin + 0.01f * (fPowerMax - fPowerMin)));
-				}
-				if (qlFrames.isEmpty() && update)
-					jitter_buffer_update_delay(jbJitter, NULL, NULL);
+		// An Opus packet is a single entry in qvlaFrames, however many
+		// frames it holds.
+		if (bProbed && LatencyProbe::lpProbe)
+			LatencyProbe::lpProbe->decoded(iPacketSeq + iNextFrame - 1, qMax(1U, static_cast<unsigned int>(decodedSamples) / iFrameSize));
+
+		bool quiet = true;
+		if (p) {
+			float &fPowerMax = p->fPowerMax;
+			float &fPowerMin = p->fPowerMin;
 
-				if (qlFrames.isEmpty() && bHasTerminator)
-					nextalive = false;
+			float pow = 0.0f;
+			for (int i = 0; i < decodedSamples; ++i)
+				pow += pOut[i] * pOut[i];
+			pow = sqrtf(pow / static_cast<float>(decodedSamples));
+
+			if (pow >= fPowerMax) {
+				fPowerMax = pow;
 			} else {
-				if (umtType == MessageHandler::UDPVoiceCELTAlpha || umtType == MessageHandler::UDPVoiceCELTBeta) {
-					if (cdDecoder)
-						cCodec->decode_float(cdDecoder, NULL, 0, pOut);
-					else
-						memset(pOut, 0, sizeof(float) * iFrameSize);
-				} else if (umtType == MessageHandler::UDPVoiceOpus) {
-#ifdef USE_OPUS
-					decodedSamples = opus_decode_float(opusState, NULL, 0, pOut, iFrameSize, 0);
-					if (decodedSamples < 0) {
-						decodedSamples = iFrameSize;
-						memset(pOut, 0, iFrameSize * sizeof(float));
-					}
-#endif
+				if (pow <= fPowerMin) {
+					fPowerMin = pow;
 				} else {
-					speex_decode(dsSpeex, NULL, pOut);
-					for (unsigned int i=0;i<iFrameSize;++i)
-						pOut[i] *= (1.0f / 32767.f);
+					fPowerMax = 0.99f * fPowerMax;
+					fPowerMin += 0.0001f * pow;
 				}
 			}
 
-			if (! nextalive) {
-				for (unsigned int i=0;i<iFrameSize;++i)
-					pOut[i] *= fFadeOut[i];
-			} else if (ts == 0) {
-				for (unsigned int i=0;i<iFrameSize;++i)
-					pOut[i] *= fFadeIn[i];
+			quiet = (pow < (fPowerMin + 0.01f * (fPowerMax - fPowerMin)));
+		}
+		if ((iNextFrame >= qvlaFrames.size()) && bHasTerminator)
+			nextalive = false;
+
+		// Move towards the target delay by cutting or repeating
+		// a pitch period, but not while fading in or out.
+		if (! bStereo && nextalive && ! starting) {
+			const PlayoutBuffer::Adjustment adj = pbPlayout->adjustment(quiet);
+			if (adj != PlayoutBuffer::Keep) {
+				const unsigned int minLag = iSampleRate / 400;
+				const unsigned int maxLag = (iSampleRate * 3) / 200;
+				const unsigned int n = static_cast<unsigned int>(decodedSamples);
+				const unsigned int stretched = (adj == PlayoutBuffer::Shorten) ? TimeStretch::shorten(pOut, n, minLag, maxLag) : TimeStretch::lengthen(pOut, n, minLag, maxLag);
+				pbPlayout->stretched(static_cast<int>(stretched) - decodedSamples);
+				decodedSamples = static_cast<int>(stretched);
 			}
-
-			for (int i = decodedSamples / iFrameSize; i > 0; --i) {
-				jitter_buffer_tick(jbJitter);
+		}
+	} else {
+		if (umtType == MessageHandler::UDPVoiceCELTAlpha || umtType == MessageHandler::UDPVoiceCELTBeta) {
+			if (cdDecoder)
+				cCodec->decode_float(cdDecoder, NULL, 0, pOut);
+			else
+				memset(pOut, 0, sizeof(float) * iFrameSize);
+		} else if (umtType == MessageHandler::UDPVoiceOpus) {
+#ifdef USE_OPUS
+			decodedSamples = opus_decode_float(opusState, NULL, 0, pOut, iFrameSize, 0);
+			if (decodedSamples < 0) {
+				decodedSamples = iFrameSize;
+				memset(pOut, 0, iFrameSize * sizeof(float));
 			}
+#endif
+		} else {
+			speex_decode(dsSpeex, NULL, pOut);
+			for (unsigned int i=0;i<iFrameSize;++i)
+				pOut[i] *= (1.0f / 32767.f);
 		}
-nextframe:
-		spx_uint32_t inlen = decodedSamples;
-		spx_uint32_t outlen = static_cast<unsigned int>(ceilf(static_cast<float>(decodedSamples * iMixerFreq) / static_cast<float>(iSampleRate)));
-		if (srs && bLastAlive)
-			speex_resampler_process_float(srs, 0, fResamplerBuffer, &inlen, pfBuffer + iBufferFilled, &outlen);
-		iBufferFilled += outlen;
+	}
+
+	if (! nextalive) {
+		for (unsigned int i=0;i<iFrameSize;++i)
+			pOut[i] *= fFadeOut[i];
+	} else if (starting) {
+		for (unsigned int i=0;i<iFrameSize;++i)
+			pOut[i] *= fFadeIn[i];
+	}
+
+	iTargetDelay = pbPlayout->targetDelay();
+	iCurrentDelay = pbPlayout->currentDelay();
+
+	return decodedSamples;
+}
+
+void AudioOutputSpeech::decodeAhead(unsigned int lead) {
+	bool nextalive = bLastAlive;
+
+	while (nextalive && (srDecoded.available() < lead) && (srDecoded.space() >= iOutputSize)) {
+		float *pOut = (rsOutput) ? fResamplerBuffer : fDecodeBuffer;
+		const int decodedSamples = decodeFrame(pOut, nextalive);
+
+		// The resampler counts frames of all channels.
+		const unsigned int channels = bStereo ? 2 : 1;
+		unsigned int inlen = static_cast<unsigned int>(decodedSamples) / channels;
+		unsigned int outlen = static_cast<unsigned int>(ceilf(static_cast<float>(inlen * iMixerFreq) / static_cast<float>(iSampleRate)));
+		if (rsOutput)
+			rsOutput->process(fResamplerBuffer, inlen, fDecodeBuffer, outlen);
+		srDecoded.write(fDecodeBuffer, outlen * channels);
 	}
 
 	if (p) {
@@ -402,7 +429,30 @@ nextframe:
 		p->setTalking(ts);
 	}
 
-	bool tmp = bLastAlive;
-	bLastAlive = nextalive;
-	return tmp;
+	// The audio thread plays what is left and then lets go of us.
+	if (bLastAlive && ! nextalive) {
+		bLastAlive = false;
+		qaiFinished.fetchAndStoreRelease(1);
+	}
+}
+
+bool AudioOutputSpeech::needSamples(unsigned int snum) {
+	resizeBuffer(snum);
+
+	unsigned int done = srDecoded.read(pfBuffer, snum);
+
+	// The decoding threads fell behind. Decode here rather than drop
+	// out, unless one of them is at it right now.
+	if ((done < snum) && claim()) {
+		decodeAhead(snum - done);
+		release();
+		done += srDecoded.read(pfBuffer + done, snum - done);
+	}
+
+	if (done < snum) {
+		if ((done == 0) && qaiFinished.fetchAndAddAcquire(0))
+			return false;
+		memset(pfBuffer + done, 0, (snum - done) * sizeof(float));
+	}
+	return true;
 }
@@ -8,17 +8,21 @@
 
 #include <stdint.h>
 #include <speex/speex.h>
-#include <speex/speex_resampler.h>
-#include <speex/speex_jitter.h>
 #include <celt.h>
 
-#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QVarLengthArray>
 
 #include "AudioOutputUser.h"
 #include "Message.h"
+#include "PlayoutBuffer.h"
+#include "Resampler.h"
+#include "SampleRing.h"
+#include "VoicePacketRing.h"
 
 class CELTCodec;
 class ClientUser;
+class PacketDataStream;
 struct OpusDecoder;
 
 class AudioOutputSpeech : public AudioOutputUser {
@@ -27,10 +31,7 @@ class AudioOutputSpeech : public AudioOutputUser {
 		Q_DISABLE_COPY(AudioOutputSpeech)
 	protected:
 		unsigned int iAudioBufferSize;
-		unsigned int iBufferOffset;
-		unsigned int iBufferFilled;
 		unsigned int iOutputSize;
-		unsigned int iLastConsume;
 		unsigned int iFrameSize;
 		unsigned int iSampleRate;
 		unsigned int iMixerFreq;
@@ -41,11 +42,15 @@ class AudioOutputSpeech : public AudioOutputUser {
 		float *fFadeIn;
 		float *fFadeOut;
 		float *fResamplerBuffer;
+		float *fDecodeBuffer;
 
-		SpeexResamplerState *srs;
+		Resampler *rsOutput;
 
-		QMutex qmJitter;
-		JitterBuffer *jbJitter;
+		/// Packets from the network thread. Only the thread that
+		/// decodes touches the playout buffer; it moves the packets
+		/// over before it decodes.
+		VoicePacketRing vprIncoming;
+		PlayoutBuffer *pbPlayout;
 		int iMissCount;
 
 		CELTCodec *cCodec;
@@ -56,17 +61,69 @@ class AudioOutputSpeech : public AudioOutputUser {
 		SpeexBits sbBits;
 		void *dsSpeex;
 
-		QList<QByteArray> qlFrames;
+		/// Copy of the packet that is being decoded, and the frames
+		/// in it that are left, as offset and size, from iNextFrame.
+		char cPacket[VoicePacket::iMaxSize];
+		QVarLengthArray<QPair<int, int>, 16> qvlaFrames;
+		int iNextFrame;
+		/// Sequence number of the packet in cPacket.
+		unsigned int iPacketSeq;
+
+		/// Whether the latency probe follows our packets; true for
+		/// our own voice only.
+		bool bProbed;
+
+		/// Audio decoded ahead, at the mixer's rate, for the audio
+		/// thread.
+		SampleRing srDecoded;
+		/// Set once the last frame is in srDecoded.
+		QAtomicInt qaiFinished;
+		/// Set while a thread decodes; see claim().
+		QAtomicInt qaiBusy;
+
+		void takePackets();
+		void addFrame(PacketDataStream &pds, unsigned int size);
+		/// Decodes or conceals the next frame into pOut, and returns
+		/// its length. Clears nextalive when the speech ends.
+		int decodeFrame(float *pOut, bool &nextalive);
 
 		unsigned char ucFlags;
 	public:
 		MessageHandler::UDPMessageType umtType;
 		int iMissedFrames;
 		ClientUser *p;
-
+		/// Target and current delay of the playout buffer, in
+		/// microseconds, as of the last frame.
+		int iTargetDelay;
+		int iCurrentDelay;
+
+		/// Only one thread at a time may decode. Returns true if the
+		/// calling thread may, until it calls release().
+		bool claim() {
+			return qaiBusy.testAndSetAcquire(0, 1);
+		}
+		void release() {
+			qaiBusy.fetchAndStoreRelease(0);
+		}
+
+		/// Whether fewer than lead samples are decoded ahead, and
+		/// there is room for more.
+		bool needsDecode(unsigned int lead) {
+			return ! qaiFinished.fetchAndAddAcquire(0) && (srDecoded.available() < lead) && (srDecoded.space() >= iOutputSize);
+		}
+
+		/// Decodes until lead samples at the mixer's rate are ready,
+		/// or the speech ends. The caller must have claimed us.
+		void decodeAhead(unsigned int lead);
+
+		/// Plays the audio decoded ahead. If there isn't enough, and
+		/// no other thread is decoding, decodes the rest right away.
 		virtual bool needSamples(unsigned int snum) Q_DECL_OVERRIDE;
 
-		void addFrameToBuffer(const QByteArray &, unsigned int iBaseSeq);
+		/// Queues a packet for the audio thread. data is the part of
+		/// the UDP packet after the header, session and sequence
+		/// number. Must only be called from one thread.
+		void addFrameToBuffer(unsigned int flags, const char *data, unsigned int len, unsigned int iSeq);
 		AudioOutputSpeech(ClientUser *, unsigned int freq, MessageHandler::UDPMessageType type);
 		~AudioOutputSpeech() Q_DECL_OVERRIDE;
 };
@@ -11,6 +11,8 @@ AudioOutputUser::AudioOutputUser(const QString& name) : qsName(name) {
 	iBufferSize = 0;
 	pfBuffer = NULL;
 	pfVolume = NULL;
+	aosSpeech = NULL;
+	bRecordOnly = false;
 	fPos[0]=fPos[1]=fPos[2]=0.0;
 }
 
@@ -8,6 +8,8 @@
 
 #include <QtCore/QObject>
 
+class AudioOutputSpeech;
+
 class AudioOutputUser : public QObject {
 	private:
 		Q_OBJECT
@@ -22,6 +24,13 @@ class AudioOutputUser : public QObject {
 		float *pfBuffer;
 		float *pfVolume;
 		float fPos[3];
+		/// This buffer as speech, or NULL if it is a sample. Set on
+		/// construction, so the mixer doesn't have to cast every
+		/// buffer on every callback.
+		AudioOutputSpeech *aosSpeech;
+		/// The speech of the local user, which goes to the voice
+		/// recorder but is not played back while recording.
+		bool bRecordOnly;
 		virtual bool needSamples(unsigned int snum) = 0;
 };
 
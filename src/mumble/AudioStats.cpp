@@ -8,6 +8,7 @@
 #include "AudioStats.h"
 
 #include "AudioInput.h"
+#include "AudioOutput.h"
 #include "Global.h"
 #include "smallft.h"
 
@@ -299,6 +300,13 @@ AudioStats::~AudioStats() {
 }
 
 void AudioStats::on_Tick_timeout() {
+	AudioOutputPtr ao = g.ao;
+	const int target = ao ? ao->iPlayoutTarget : 0;
+	if (target > 0)
+		qlPlayoutDelay->setText(tr("%1 ms (target %2 ms)").arg(ao->iPlayoutDelay / 1000).arg(target / 1000));
+	else
+		qlPlayoutDelay->setText(QString());
+
 	AudioInputPtr ai = g.ai;
 
 	if (ai.get() == NULL || ! ai->sppPreprocess)
@@ -9,6 +9,7 @@
 #include <QtCore/QReadWriteLock>
 
 #include "User.h"
+#include "PlayoutBuffer.h"
 #include "Timer.h"
 #include "Settings.h"
 
@@ -23,7 +24,9 @@ class ClientUser : public QObject, public User {
 		bool bLocalMute;
 
 		float fPowerMin, fPowerMax;
-		float fAverageAvailable;
+		/// Jitter of the user's voice packets, kept across talk
+		/// spurts. Only the audio thread uses it.
+		JitterHistogram jhJitter;
 		float fLocalVolume;
 
 		int iFrames;
@@ -0,0 +1,183 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "LatencyProbe.h"
+
+LatencyProbe *LatencyProbe::lpProbe = NULL;
+
+const float LatencyProbe::fAmplitude = 0.5f;
+const float LatencyProbe::fThreshold = 0.1f;
+
+// Frequency of the burst. Low enough for every codec to keep it.
+static const double dBurstFrequency = 1000.0;
+
+// What each stage spans, ending at the stage of the same index.
+static const char *cStageNames[LatencyProbe::Stages] = {
+	"total",
+	"framing",
+	"preprocessing",
+	"encoding",
+	"network",
+	"jitter buffer",
+	"decoding",
+	"mixing"
+};
+
+LatencyProbe::LatencyProbe(int bursts) : iBursts(bursts), uiCaptured(0), uiFramed(0), bArmed(false), bInFrame(false), iSeq(0), iLost(0) {
+	// Give the codecs and buffers a second to settle first.
+	uiBurst = iRate;
+	memset(uiTimes, 0, sizeof(uiTimes));
+}
+
+quint64 LatencyProbe::now() const {
+	return tTime.elapsed();
+}
+
+void LatencyProbe::next(quint64 after) {
+	bArmed = false;
+	bInFrame = false;
+	uiBurst = after + (uiInterval * iRate) / 1000000ULL;
+}
+
+void LatencyProbe::mark(Stage s, quint64 t) {
+	// Each stage counts once, and only after the one before it.
+	if (uiTimes[s] || ((s > Captured) && ! uiTimes[s - 1]))
+		return;
+	uiTimes[s] = t;
+}
+
+bool LatencyProbe::contains(unsigned int seq, unsigned int frames) const {
+	return bArmed && uiTimes[Preprocessed] && ((iSeq - seq) < frames);
+}
+
+void LatencyProbe::finish() {
+	QList<quint64> times;
+	for (int i = 0; i < Stages; ++i)
+		times << uiTimes[i];
+	qlResults << times;
+	next(uiCaptured);
+
+	if (finished())
+		QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+}
+
+void LatencyProbe::capture(float *buf, unsigned int n) {
+	QMutexLocker l(&qmLock);
+	const quint64 end = now();
+
+	if (bArmed && (uiTimes[Captured] + uiTimeout < end)) {
+		qWarning("LatencyProbe: Burst %d got lost", qlResults.count() + iLost);
+		++iLost;
+		next(uiCaptured);
+	}
+
+	for (unsigned int i = 0; i < n; ++i) {
+		const quint64 pos = uiCaptured + i;
+		if ((pos >= uiBurst) && (pos < uiBurst + iBurst))
+			buf[i] = fAmplitude * static_cast<float>(sin(2.0 * M_PI * dBurstFrequency * static_cast<double>(pos - uiBurst) / iRate));
+		else
+			buf[i] = 0.0f;
+	}
+
+	if (! bArmed && ! finished() && (uiBurst >= uiCaptured) && (uiBurst < uiCaptured + n)) {
+		memset(uiTimes, 0, sizeof(uiTimes));
+		bArmed = true;
+		// The block was captured at an even pace, ending now.
+		mark(Captured, end - ((uiCaptured + n - uiBurst) * 1000000ULL) / iRate);
+	}
+	uiCaptured += n;
+}
+
+void LatencyProbe::framed(unsigned int n) {
+	QMutexLocker l(&qmLock);
+	if (bArmed && (uiBurst >= uiFramed) && (uiBurst < uiFramed + n)) {
+		mark(Framed, now());
+		bInFrame = true;
+	}
+	uiFramed += n;
+}
+
+void LatencyProbe::preprocessed(unsigned int seq) {
+	QMutexLocker l(&qmLock);
+	if (bArmed && bInFrame) {
+		bInFrame = false;
+		iSeq = seq;
+		mark(Preprocessed, now());
+	}
+}
+
+void LatencyProbe::sent(unsigned int seq, unsigned int frames) {
+	QMutexLocker l(&qmLock);
+	if (contains(seq, frames))
+		mark(Sent, now());
+}
+
+void LatencyProbe::received(unsigned int seq, unsigned int frames) {
+	QMutexLocker l(&qmLock);
+	if (contains(seq, frames))
+		mark(Received, now());
+}
+
+void LatencyProbe::dequeued(unsigned int seq, unsigned int frames) {
+	QMutexLocker l(&qmLock);
+	if (contains(seq, frames))
+		mark(Dequeued, now());
+}
+
+void LatencyProbe::decoded(unsigned int seq, unsigned int frames) {
+	QMutexLocker l(&qmLock);
+	if (contains(seq, frames))
+		mark(Decoded, now());
+}
+
+void LatencyProbe::played(const float *buf, unsigned int n, unsigned int channels) {
+	QMutexLocker l(&qmLock);
+	if (! bArmed || ! uiTimes[Decoded])
+		return;
+
+	const quint64 start = now();
+	for (unsigned int i = 0; i < n; ++i) {
+		for (unsigned int c = 0; c < channels; ++c) {
+			if (qAbs(buf[i * channels + c]) > fThreshold) {
+				mark(Played, start + (i * 1000000ULL) / iRate);
+				finish();
+				return;
+			}
+		}
+	}
+}
+
+bool LatencyProbe::finished() const {
+	return qlResults.count() + iLost >= iBursts;
+}
+
+QString LatencyProbe::report() const {
+	QMutexLocker l(&qmLock);
+
+	QString r = QString::fromLatin1("Mouth-to-ear latency of %1 bursts (%2 lost), in ms:\n").arg(qlResults.count()).arg(iLost);
+	r += QString::fromLatin1("%1 %2 %3 %4\n").arg(QLatin1String("stage"), -16).arg(QLatin1String("mean"), 8).arg(QLatin1String("min"), 8).arg(QLatin1String("max"), 8);
+	if (qlResults.isEmpty())
+		return r;
+
+	// The stages in order, and the total last.
+	for (int k = 1; k <= Stages; ++k) {
+		const int s = k % Stages;
+		double sum = 0.0;
+		double min = 1e30;
+		double max = 0.0;
+		foreach(const QList<quint64> &times, qlResults) {
+			const quint64 from = s ? times.at(s - 1) : times.at(Captured);
+			const quint64 to = s ? times.at(s) : times.at(Played);
+			const double ms = static_cast<double>(to - from) / 1000.0;
+			sum += ms;
+			min = qMin(min, ms);
+			max = qMax(max, ms);
+		}
+		r += QString::fromLatin1("%1 %2 %3 %4\n").arg(QLatin1String(cStageNames[s]), -16).arg(sum / qlResults.count(), 8, 'f', 1).arg(min, 8, 'f', 1).arg(max, 8, 'f', 1);
+	}
+	return r;
+}
@@ -0,0 +1,110 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_LATENCYPROBE_H_
+#define MUMBLE_MUMBLE_LATENCYPROBE_H_
+
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "Timer.h"
+
+/// LatencyProbe measures the client's mouth-to-ear latency, stage by
+/// stage, without sound hardware.
+///
+/// The null input backend (see NullAudio) asks it for every block of
+/// "microphone" audio, and it puts a short tone burst into one of them
+/// from time to time. The capture and playback code report when the
+/// frame or packet with the burst passes them, by sequence number. The
+/// null output backend hands it every mixed block, and it looks for the
+/// burst's onset there. Only one burst is in flight at a time; a burst
+/// that doesn't come out within a second counts as lost.
+///
+/// The probe only exists in latency test runs (see lpProbe), so the
+/// hooks in the audio path cost a pointer check otherwise. It takes a
+/// lock, which is fine for a test, but not for a normal session.
+class LatencyProbe {
+	private:
+		Q_DISABLE_COPY(LatencyProbe)
+	public:
+		/// The points a burst passes, in order.
+		enum Stage { Captured, Framed, Preprocessed, Sent, Received, Dequeued, Decoded, Played, Stages };
+
+		/// The probe of the running test, or NULL.
+		static LatencyProbe *lpProbe;
+
+		/// Samples per second of the null backends.
+		static const unsigned int iRate = 48000;
+		/// Length of a burst in samples, and its amplitude.
+		static const unsigned int iBurst = 480;
+		static const float fAmplitude;
+		/// Output level that counts as the burst's onset.
+		static const float fThreshold;
+		/// Time between bursts, and how long one may take, in
+		/// microseconds.
+		static const quint64 uiInterval = 250000;
+		static const quint64 uiTimeout = 1000000;
+	protected:
+		mutable QMutex qmLock;
+		Timer tTime;
+		int iBursts;
+
+		/// Samples given to capture() so far, and the position of the
+		/// next burst among them.
+		quint64 uiCaptured;
+		quint64 uiBurst;
+		/// Samples that AudioInput has cut into frames so far.
+		quint64 uiFramed;
+
+		bool bArmed;
+		/// The frame with the burst is being encoded.
+		bool bInFrame;
+		/// Sequence number of the frame with the burst.
+		unsigned int iSeq;
+		quint64 uiTimes[Stages];
+
+		/// Times of the bursts that came through.
+		QList<QList<quint64> > qlResults;
+		int iLost;
+
+		void mark(Stage s, quint64 t);
+		bool contains(unsigned int seq, unsigned int frames) const;
+		void finish();
+		void next(quint64 after);
+	public:
+		/// Measures bursts bursts, then quits the application.
+		explicit LatencyProbe(int bursts);
+
+		/// Microseconds since the probe was created.
+		quint64 now() const;
+
+		/// Fills the n samples the input backend just captured, which
+		/// end now, with the test signal.
+		void capture(float *buf, unsigned int n);
+		/// AudioInput finished a frame of n microphone samples, and
+		/// will encode it right away.
+		void framed(unsigned int n);
+		/// The frame being encoded got sequence number seq and went
+		/// through the preprocessor.
+		void preprocessed(unsigned int seq);
+		/// A packet with frames frames from seq on was sent.
+		void sent(unsigned int seq, unsigned int frames);
+		/// A packet with frames frames from seq on arrived, was taken
+		/// from the jitter buffer, or was decoded.
+		void received(unsigned int seq, unsigned int frames);
+		void dequeued(unsigned int seq, unsigned int frames);
+		void decoded(unsigned int seq, unsigned int frames);
+		/// The output backend starts playing n frames of channels
+		/// interleaved channels now.
+		void played(const float *buf, unsigned int n, unsigned int channels);
+
+		/// Whether all bursts are measured.
+		bool finished() const;
+		/// A table of the mean, minimum and maximum time of each stage.
+		QString report() const;
+};
+
+#endif
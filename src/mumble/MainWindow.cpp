@@ -2727,6 +2727,7 @@ void MainWindow::serverConnected() {
 
 void MainWindow::serverDisconnected(QAbstractSocket::SocketError err, QString reason) {
 	g.uiSession = 0;
+	qhPendingTextMessages.clear();
 	g.pPermissions = ChanACL::None;
 	g.bAttenuateOthers = false;
 	qaServerDisconnect->setEnabled(false);
@@ -2995,14 +2996,16 @@ void MainWindow::customEvent(QEvent *evt) {
 
 #ifdef QT_NO_DEBUG
 #define MUMBLE_MH_MSG(x) case MessageHandler:: x : { \
-		MumbleProto:: x msg; \
+		MessageCache<MumbleProto:: x>::Lease lease(mc##x, shme->qbaMsg.size()); \
+		MumbleProto:: x &msg = lease.message(); \
 		if (msg.ParseFromArray(shme->qbaMsg.constData(), shme->qbaMsg.size())) \
 			msg##x(msg); \
 		break; \
 	}
 #else
 #define MUMBLE_MH_MSG(x) case MessageHandler:: x : { \
-		MumbleProto:: x msg; \
+		MessageCache<MumbleProto:: x>::Lease lease(mc##x, shme->qbaMsg.size()); \
+		MumbleProto:: x &msg = lease.message(); \
 		if (msg.ParseFromArray(shme->qbaMsg.constData(), shme->qbaMsg.size())) { \
 			printf("%s:\n", #x); \
 			msg.PrintDebugString(); \
@@ -23,6 +23,7 @@
 
 #include "CustomElements.h"
 #include "Message.h"
+#include "MessageCache.h"
 #include "Mumble.pb.h"
 #include "Usage.h"
 #include "UserLocalVolumeDialog.h"
@@ -145,6 +146,14 @@ class MainWindow : public QMainWindow, public MessageHandler, public Ui::MainWin
 		Channel *mapChannel(int idx) const;
 		int iTargetCounter;
 		QMap<unsigned int, UserInformation *> qmUserInformations;
+		/// Text messages that were sent by hash, waiting for the
+		/// server to send the message itself.
+		QHash<QByteArray, QList<MumbleProto::TextMessage> > qhPendingTextMessages;
+		/// Messages that customEvent() parses server messages into,
+		/// one per type.
+#define MUMBLE_MH_MSG(x) MessageCache<MumbleProto:: x> mc##x;
+		MUMBLE_MH_ALL
+#undef MUMBLE_MH_MSG
 
 		PTTButtonWidget *qwPTTButtonWidget;
 
@@ -668,6 +668,53 @@ void MainWindow::msgChannelRemove(const MumbleProto::ChannelRemove &msg) {
 }
 
 void MainWindow::msgTextMessage(const MumbleProto::TextMessage &msg) {
+	if (msg.has_message_hash()) {
+		const QByteArray &hash = blob(msg.message_hash());
+
+		// The server no longer has the message.
+		if (msg.message_unavailable()) {
+			const QList<MumbleProto::TextMessage> pending = qhPendingTextMessages.take(hash);
+			foreach(MumbleProto::TextMessage mptm, pending) {
+				mptm.clear_message_hash();
+				mptm.set_message(u8(tr("<i>(This message is no longer available on the server.)</i>")));
+				msgTextMessage(mptm);
+			}
+			return;
+		}
+
+		// The answer to a RequestBlob.
+		if (! msg.message().empty()) {
+			const QList<MumbleProto::TextMessage> pending = qhPendingTextMessages.take(hash);
+			if (sha1(blob(msg.message())) != hash)
+				return;
+			Database::setBlob(hash, blob(msg.message()));
+			foreach(MumbleProto::TextMessage mptm, pending) {
+				mptm.clear_message_hash();
+				mptm.set_message(msg.message());
+				msgTextMessage(mptm);
+			}
+			return;
+		}
+
+		const QByteArray &text = Database::blob(hash);
+		if (text.isEmpty()) {
+			bool requested = qhPendingTextMessages.contains(hash);
+			qhPendingTextMessages[hash] << msg;
+			if (! requested) {
+				MumbleProto::RequestBlob mprb;
+				mprb.add_text_message(msg.message_hash());
+				g.sh->sendMessage(mprb);
+			}
+			return;
+		}
+
+		MumbleProto::TextMessage mptm(msg);
+		mptm.clear_message_hash();
+		mptm.set_message(blob(text));
+		msgTextMessage(mptm);
+		return;
+	}
+
 	ACTOR_INIT;
 	QString target;
 
@@ -900,3 +947,6 @@ void MainWindow::msgSuggestConfig(const MumbleProto::SuggestConfig &msg) {
 			g.l->log(Log::Warning, tr("The server requests Push-to-Talk be disabled."));
 	}
 }
+
+void MainWindow::msgUserInterest(const MumbleProto::UserInterest &) {
+}
@@ -0,0 +1,166 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "NullAudio.h"
+
+#include "Global.h"
+#include "LatencyProbe.h"
+#include "Timer.h"
+
+// Length of a block in microseconds.
+static const quint64 uiBlockLength = 10000;
+
+class NullAudioInputRegistrar : public AudioInputRegistrar {
+	public:
+		NullAudioInputRegistrar();
+		virtual AudioInput *create();
+		virtual const QList<audioDevice> getDeviceChoices();
+		virtual void setDeviceChoice(const QVariant &, Settings &);
+		virtual bool canEcho(const QString &) const;
+};
+
+class NullAudioOutputRegistrar : public AudioOutputRegistrar {
+	public:
+		NullAudioOutputRegistrar();
+		virtual AudioOutput *create();
+		virtual const QList<audioDevice> getDeviceChoices();
+		virtual void setDeviceChoice(const QVariant &, Settings &);
+		bool usesOutputDelay() const Q_DECL_OVERRIDE;
+};
+
+// Registered with the lowest priority, so that they are only used
+// when chosen.
+static NullAudioInputRegistrar airNull;
+static NullAudioOutputRegistrar aorNull;
+
+NullAudioInputRegistrar::NullAudioInputRegistrar() : AudioInputRegistrar(QLatin1String("Null"), -1000) {
+}
+
+AudioInput *NullAudioInputRegistrar::create() {
+	return new NullAudioInput();
+}
+
+const QList<audioDevice> NullAudioInputRegistrar::getDeviceChoices() {
+	QList<audioDevice> qlReturn;
+	qlReturn << audioDevice(QLatin1String("Silence"), QString());
+	return qlReturn;
+}
+
+void NullAudioInputRegistrar::setDeviceChoice(const QVariant &, Settings &) {
+}
+
+bool NullAudioInputRegistrar::canEcho(const QString &) const {
+	return false;
+}
+
+NullAudioOutputRegistrar::NullAudioOutputRegistrar() : AudioOutputRegistrar(QLatin1String("Null"), -1000) {
+}
+
+AudioOutput *NullAudioOutputRegistrar::create() {
+	return new NullAudioOutput();
+}
+
+const QList<audioDevice> NullAudioOutputRegistrar::getDeviceChoices() {
+	QList<audioDevice> qlReturn;
+	qlReturn << audioDevice(QLatin1String("Nowhere"), QString());
+	return qlReturn;
+}
+
+void NullAudioOutputRegistrar::setDeviceChoice(const QVariant &, Settings &) {
+}
+
+bool NullAudioOutputRegistrar::usesOutputDelay() const {
+	return false;
+}
+
+NullAudioInput::NullAudioInput() {
+	bRunning = true;
+}
+
+NullAudioInput::~NullAudioInput() {
+	bRunning = false;
+	wait();
+}
+
+void NullAudioInput::run() {
+	iMicChannels = 1;
+	iMicFreq = LatencyProbe::iRate;
+	eMicFormat = SampleFloat;
+	initializeMixer();
+
+	const unsigned int block = (iMicFreq * uiBlockLength) / 1000000ULL;
+	float *buffer = new float[block];
+
+	qWarning("NullAudioInput: Starting");
+
+	Timer t;
+	quint64 deadline = 0;
+	while (bRunning) {
+		// Blocks are timed against the start, so that the pace
+		// doesn't drift when a sleep runs long.
+		deadline += uiBlockLength;
+		const quint64 now = t.elapsed();
+		if (deadline > now)
+			usleep(static_cast<unsigned long>(deadline - now));
+
+		LatencyProbe *probe = LatencyProbe::lpProbe;
+		if (probe)
+			probe->capture(buffer, block);
+		else
+			memset(buffer, 0, block * sizeof(float));
+		addMic(buffer, block);
+	}
+
+	qWarning("NullAudioInput: Releasing");
+	delete [] buffer;
+}
+
+NullAudioOutput::NullAudioOutput() {
+	bRunning = true;
+}
+
+NullAudioOutput::~NullAudioOutput() {
+	bRunning = false;
+	wipe();
+	wait();
+}
+
+void NullAudioOutput::run() {
+	const unsigned int chanmasks[32] = {
+		SPEAKER_FRONT_LEFT,
+		SPEAKER_FRONT_RIGHT
+	};
+
+	iChannels = g.s.doPositionalAudio() ? 2 : 1;
+	iMixerFreq = LatencyProbe::iRate;
+	eSampleFormat = SampleFloat;
+	initializeMixer(chanmasks);
+
+	const unsigned int block = (iMixerFreq * uiBlockLength) / 1000000ULL;
+	float *buffer = new float[block * iChannels];
+
+	qWarning("NullAudioOutput: Starting");
+
+	Timer t;
+	quint64 deadline = 0;
+	while (bRunning) {
+		// Blocks are timed against the start, so that the pace
+		// doesn't drift when a sleep runs long.
+		deadline += uiBlockLength;
+		const quint64 now = t.elapsed();
+		if (deadline > now)
+			usleep(static_cast<unsigned long>(deadline - now));
+
+		const bool mixed = mix(buffer, block);
+		LatencyProbe *probe = LatencyProbe::lpProbe;
+		if (probe && mixed)
+			probe->played(buffer, block, iChannels);
+	}
+
+	qWarning("NullAudioOutput: Releasing");
+	delete [] buffer;
+}
@@ -0,0 +1,37 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_NULLAUDIO_H_
+#define MUMBLE_MUMBLE_NULLAUDIO_H_
+
+#include "AudioInput.h"
+#include "AudioOutput.h"
+
+/// An audio system without hardware, which keeps time with the system
+/// clock: the input captures silence and the output throws the mix
+/// away, both in 10 ms blocks. During a latency test, the input
+/// captures LatencyProbe's test signal, and the output hands it the
+/// mix.
+class NullAudioInput : public AudioInput {
+	private:
+		Q_OBJECT
+		Q_DISABLE_COPY(NullAudioInput)
+	public:
+		NullAudioInput();
+		~NullAudioInput() Q_DECL_OVERRIDE;
+		void run() Q_DECL_OVERRIDE;
+};
+
+class NullAudioOutput : public AudioOutput {
+	private:
+		Q_OBJECT
+		Q_DISABLE_COPY(NullAudioOutput)
+	public:
+		NullAudioOutput();
+		~NullAudioOutput() Q_DECL_OVERRIDE;
+		void run() Q_DECL_OVERRIDE;
+};
+
+#endif
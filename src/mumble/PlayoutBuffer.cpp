@@ -0,0 +1,215 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "PlayoutBuffer.h"
+
+// Weight a packet loses with every newer one; after about 350
+// packets, it counts half.
+static const float fForget = 0.998f;
+
+// Weight of a new measurement in the smoothed delay.
+static const float fDelaySmoothing = 0.1f;
+
+JitterHistogram::JitterHistogram() {
+	reset();
+}
+
+void JitterHistogram::reset() {
+	for (int i = 0; i < iBins; ++i)
+		fBins[i] = 0.0f;
+	fTotal = 0.0f;
+}
+
+void JitterHistogram::add(quint64 usec) {
+	for (int i = 0; i < iBins; ++i)
+		fBins[i] *= fForget;
+
+	const int bin = static_cast<int>(qMin(usec / iBinWidth, static_cast<quint64>(iBins - 1)));
+	fBins[bin] += 1.0f;
+	fTotal = fTotal * fForget + 1.0f;
+}
+
+int JitterHistogram::percentile(float pct) const {
+	if (fTotal <= 0.0f)
+		return 0;
+
+	const float want = fTotal * pct / 100.0f;
+	float sum = 0.0f;
+	for (int i = 0; i < iBins; ++i) {
+		sum += fBins[i];
+		if (sum >= want)
+			return (i + 1) * iBinWidth;
+	}
+	return iBins * iBinWidth;
+}
+
+PlayoutBuffer::PlayoutBuffer(unsigned int frameSize, unsigned int sampleRate, JitterHistogram *jh, float pct, int minDelay) {
+	jhJitter = jh;
+	fPercentile = pct;
+	iMinDelay = minDelay;
+	iFrameSize = frameSize;
+	iSampleRate = sampleRate;
+	uiFrameLength = (static_cast<quint64>(frameSize) * 1000000ULL) / sampleRate;
+
+	for (int i = 0; i < iSlots; ++i)
+		bStored[i] = false;
+	iStored = 0;
+
+	bStarted = false;
+	iPlaySeq = 0;
+	uiFirstArrival = 0;
+	iFirstSeq = iEndSeq = 0;
+
+	iNextTransit = 0;
+	iTransitCount = 0;
+	iMinTransit = 0;
+
+	fDelay = 0.0f;
+
+	iLate = iLost = iUnderruns = 0;
+}
+
+bool PlayoutBuffer::put(const VoicePacket &vp) {
+	// The fastest recent packet is the baseline the others are late
+	// against. Late packets count too, as they are what the target
+	// delay is about.
+	const qint64 transit = static_cast<qint64>(vp.uiArrival) - static_cast<qint64>(vp.iSeq * uiFrameLength);
+	iTransit[iNextTransit] = transit;
+	iNextTransit = (iNextTransit + 1) % iTransits;
+	if (iTransitCount < iTransits)
+		++iTransitCount;
+
+	iMinTransit = transit;
+	for (int i = 0; i < iTransitCount; ++i)
+		iMinTransit = qMin(iMinTransit, iTransit[i]);
+
+	jhJitter->add(static_cast<quint64>(transit - iMinTransit));
+
+	const unsigned int frames = qMax(vp.iSamples / iFrameSize, 1U);
+
+	if (bStarted) {
+		if (vp.iSeq < iPlaySeq) {
+			++iLate;
+			return false;
+		}
+		if (vp.iSeq >= iPlaySeq + iSlots)
+			return false;
+	} else if (iTransitCount == 1) {
+		uiFirstArrival = vp.uiArrival;
+		iFirstSeq = vp.iSeq;
+		iEndSeq = vp.iSeq + frames;
+	} else {
+		iFirstSeq = qMin(iFirstSeq, vp.iSeq);
+		iEndSeq = qMax(iEndSeq, vp.iSeq + frames);
+	}
+
+	const int slot = vp.iSeq % iSlots;
+	if (bStored[slot]) {
+		if (vpSlots[slot].iSeq == vp.iSeq)
+			return false;
+	} else {
+		bStored[slot] = true;
+		++iStored;
+	}
+
+	VoicePacket &dst = vpSlots[slot];
+	dst.iSeq = vp.iSeq;
+	dst.uiArrival = vp.uiArrival;
+	dst.iSamples = vp.iSamples;
+	dst.iSize = vp.iSize;
+	memcpy(dst.cData, vp.cData, vp.iSize);
+
+	return true;
+}
+
+bool PlayoutBuffer::started() const {
+	return bStarted;
+}
+
+bool PlayoutBuffer::ready(quint64 now) const {
+	if (bStarted)
+		return true;
+	if (! iStored || (now < uiFirstArrival))
+		return false;
+
+	// Wait for the target delay after the first packet, unless enough
+	// packets have piled up already, in which case the first one was
+	// late itself.
+	const quint64 target = static_cast<quint64>(targetDelay());
+	return ((now - uiFirstArrival) >= target) || ((iEndSeq - iFirstSeq) * uiFrameLength >= target);
+}
+
+void PlayoutBuffer::dropPlayed() {
+	for (int i = 0; i < iSlots; ++i) {
+		if (bStored[i] && (vpSlots[i].iSeq < iPlaySeq)) {
+			bStored[i] = false;
+			--iStored;
+		}
+	}
+}
+
+const VoicePacket *PlayoutBuffer::get(quint64 now) {
+	const bool first = ! bStarted;
+	if (first) {
+		if (! iStored)
+			return NULL;
+		bStarted = true;
+		iPlaySeq = iFirstSeq;
+	}
+
+	const float delay = static_cast<float>(static_cast<qint64>(now) - static_cast<qint64>(iPlaySeq * uiFrameLength) - iMinTransit);
+	if (first)
+		fDelay = delay;
+	else
+		fDelay += fDelaySmoothing * (delay - fDelay);
+
+	const int slot = iPlaySeq % iSlots;
+	if (bStored[slot] && (vpSlots[slot].iSeq == iPlaySeq)) {
+		const VoicePacket &vp = vpSlots[slot];
+		bStored[slot] = false;
+		--iStored;
+		iPlaySeq += qMax(vp.iSamples / iFrameSize, 1U);
+		dropPlayed();
+		return &vp;
+	}
+
+	// With later packets waiting, this one is lost and skipped.
+	// Otherwise it may still come, and waiting for it grows the delay.
+	if (iStored) {
+		++iLost;
+		++iPlaySeq;
+		dropPlayed();
+	} else {
+		++iUnderruns;
+	}
+	return NULL;
+}
+
+PlayoutBuffer::Adjustment PlayoutBuffer::adjustment(bool quiet) const {
+	if (! bStarted)
+		return Keep;
+
+	const float error = fDelay - static_cast<float>(targetDelay());
+	const float threshold = static_cast<float>(uiFrameLength) * (quiet ? 0.5f : 1.0f);
+	if (error > threshold)
+		return Shorten;
+	if (error < -threshold)
+		return Lengthen;
+	return Keep;
+}
+
+void PlayoutBuffer::stretched(int samples) {
+	fDelay += static_cast<float>(samples) * 1000000.0f / static_cast<float>(iSampleRate);
+}
+
+int PlayoutBuffer::targetDelay() const {
+	return qMin(qMax(jhJitter->percentile(fPercentile), iMinDelay), static_cast<int>(iMaxDelay));
+}
+
+int PlayoutBuffer::currentDelay() const {
+	return bStarted ? iroundf(fDelay) : 0;
+}
@@ -0,0 +1,137 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_PLAYOUTBUFFER_H_
+#define MUMBLE_MUMBLE_PLAYOUTBUFFER_H_
+
+#include "VoicePacketRing.h"
+
+/// Distribution of how late a speaker's packets arrive, compared to
+/// the fastest of their recent packets.
+///
+/// Old packets are forgotten exponentially, so that the distribution
+/// follows the network. It outlives single talk spurts, as it belongs
+/// to the speaker rather than to their AudioOutputSpeech.
+class JitterHistogram {
+	public:
+		static const int iBins = 256;
+		/// Width of a bin in microseconds.
+		static const int iBinWidth = 2000;
+	protected:
+		float fBins[iBins];
+		float fTotal;
+	public:
+		JitterHistogram();
+		void reset();
+		/// Records a packet that was usec microseconds late.
+		void add(quint64 usec);
+		/// Returns how late, in microseconds, a packet may be so that
+		/// pct percent of the packets arrive in time.
+		int percentile(float pct) const;
+};
+
+/// PlayoutBuffer reorders the packets of one talk spurt and decides
+/// when to play them.
+///
+/// The delay it aims for is the percentile of the speaker's jitter
+/// the user chose, but at least the configured minimum. The buffer
+/// doesn't skip or insert audio to get there; instead, it asks the
+/// caller to shorten or lengthen the decoded audio a little at a time
+/// (see TimeStretch), and is told by how much with stretched().
+///
+/// All times are in microseconds on one clock, which also stamps
+/// VoicePacket::uiArrival.
+class PlayoutBuffer {
+	private:
+		Q_DISABLE_COPY(PlayoutBuffer)
+	public:
+		static const int iSlots = 64;
+		/// Number of recent packets the fastest transit time is taken
+		/// from.
+		static const int iTransits = 128;
+		/// Largest delay the buffer aims for.
+		static const int iMaxDelay = 500000;
+
+		enum Adjustment { Keep, Shorten, Lengthen };
+	protected:
+		JitterHistogram *jhJitter;
+		float fPercentile;
+		int iMinDelay;
+		/// Length of a frame in microseconds.
+		quint64 uiFrameLength;
+		unsigned int iFrameSize;
+		unsigned int iSampleRate;
+
+		/// Packets, stored at their sequence number modulo iSlots.
+		VoicePacket vpSlots[iSlots];
+		bool bStored[iSlots];
+		int iStored;
+
+		bool bStarted;
+		/// Sequence number of the frame that is played next.
+		unsigned int iPlaySeq;
+		/// Before playout starts: the first packet's arrival, and the
+		/// frames the stored packets span.
+		quint64 uiFirstArrival;
+		unsigned int iFirstSeq;
+		unsigned int iEndSeq;
+
+		/// Transit times (arrival minus send time) of recent packets,
+		/// and the fastest of them.
+		qint64 iTransit[iTransits];
+		int iNextTransit;
+		int iTransitCount;
+		qint64 iMinTransit;
+
+		/// Smoothed delay of the frames that are played, in addition
+		/// to the fastest transit time.
+		float fDelay;
+
+		void dropPlayed();
+	public:
+		/// Packets that arrived after their playout time.
+		unsigned int iLate;
+		/// Frames that were concealed because their packet was lost.
+		unsigned int iLost;
+		/// Frames that were concealed because no packet had arrived yet.
+		unsigned int iUnderruns;
+
+		/// frameSize is the number of samples per sequence number, at
+		/// sampleRate. The histogram is updated with every packet.
+		/// Delays are aimed at percentile pct of the jitter, but are
+		/// at least minDelay.
+		PlayoutBuffer(unsigned int frameSize, unsigned int sampleRate, JitterHistogram *jh, float pct, int minDelay);
+
+		/// Stores a packet. Returns false if it came too late, or was
+		/// a duplicate.
+		bool put(const VoicePacket &vp);
+
+		/// Whether get() has been called.
+		bool started() const;
+
+		/// Whether enough has been buffered to start playing at now.
+		bool ready(quint64 now) const;
+
+		/// Returns the packet to decode at now, or NULL if the next
+		/// frame has to be concealed. The packet is valid until the
+		/// next call to put().
+		const VoicePacket *get(quint64 now);
+
+		/// What to do with the frames of the packet just returned by
+		/// get(). Smaller deviations are corrected while quiet is true, as
+		/// stretching is less audible in pauses.
+		Adjustment adjustment(bool quiet) const;
+
+		/// Reports that the output was made samples longer, or shorter
+		/// if samples is negative.
+		void stretched(int samples);
+
+		/// The delay aimed for, in microseconds.
+		int targetDelay() const;
+		/// The current delay, in microseconds.
+		int currentDelay() const;
+};
+
+#endif
@@ -191,6 +191,40 @@ void PluginConfig::on_qtwPlugins_currentItemChanged(QTreeWidgetItem *current, QT
 	}
 }
 
+PluginSampler::PluginSampler(Plugins *plugins) : p(plugins), bRunning(true) {
+}
+
+PluginSampler::~PluginSampler() {
+	qmWait.lock();
+	bRunning = false;
+	qwcWait.wakeAll();
+	qmWait.unlock();
+	wait();
+}
+
+void PluginSampler::run() {
+	QMutexLocker lock(&qmWait);
+	while (bRunning) {
+		lock.unlock();
+
+		PositionSample ps;
+		ps.bValid = p->fetch();
+		for (int i = 0; i < 3; ++i) {
+			ps.fPosition[i] = p->fPosition[i];
+			ps.fFront[i] = p->fFront[i];
+			ps.fTop[i] = p->fTop[i];
+			ps.fCameraPosition[i] = p->fCameraPosition[i];
+			ps.fCameraFront[i] = p->fCameraFront[i];
+			ps.fCameraTop[i] = p->fCameraTop[i];
+		}
+		p->pbPositions.publish(ps);
+
+		lock.relock();
+		if (bRunning)
+			qwcWait.wait(&qmWait, static_cast<unsigned long>(1000 / qBound(1, g.s.iPluginSampleRate, 1000)));
+	}
+}
+
 Plugins::Plugins(QObject *p) : QObject(p) {
 	QTimer *timer=new QTimer(this);
 	timer->setObjectName(QLatin1String("Timer"));
@@ -199,9 +233,12 @@ Plugins::Plugins(QObject *p) : QObject(p) {
 	bValid = false;
 	iPluginTry = 0;
 	for (int i=0;i<3;i++)
-		fPosition[i]=fFront[i]=fTop[i]= 0.0;
+		fPosition[i]=fFront[i]=fTop[i]=fCameraPosition[i]=fCameraFront[i]=fCameraTop[i]= 0.0;
 	QMetaObject::connectSlotsByName(this);
 
+	psSampler = new PluginSampler(this);
+	psSampler->start();
+
 #ifdef QT_NO_DEBUG
 #ifndef PLUGIN_PATH
 	qsSystemPlugins=QString::fromLatin1("%1/plugins").arg(MumbleApplication::instance()->applicationVersionRootPath());
@@ -245,6 +282,7 @@ Plugins::Plugins(QObject *p) : QObject(p) {
 }
 
 Plugins::~Plugins() {
+	delete psSampler;
 	clearPlugins();
 
 #ifdef Q_OS_WIN
@@ -381,8 +419,6 @@ bool Plugins::fetch() {
 }
 
 void Plugins::on_Timer_timeout() {
-	fetch();
-
 	QReadLocker lock(&qrwlPlugins);
 
 	if (prevlocked) {
@@ -9,12 +9,15 @@
 #include <QtCore/QObject>
 #include <QtCore/QMutex>
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QThread>
 #include <QtCore/QUrl>
+#include <QtCore/QWaitCondition>
 #ifdef Q_OS_WIN
 #include <windows.h>
 #endif
 
 #include "ConfigDialog.h"
+#include "PositionBuffer.h"
 
 #include "ui_Plugins.h"
 
@@ -42,6 +45,26 @@ class PluginConfig : public ConfigWidget, public Ui::PluginConfig {
 };
 
 struct PluginFetchMeta;
+class Plugins;
+
+/// PluginSampler asks the linked plugin for positions
+/// Settings::iPluginSampleRate times a second, and publishes them in
+/// Plugins::pbPositions. Plugins read another process's memory, which
+/// can be slow, so the audio threads never call them.
+class PluginSampler : public QThread {
+	private:
+		Q_OBJECT
+		Q_DISABLE_COPY(PluginSampler)
+	protected:
+		Plugins *p;
+		QMutex qmWait;
+		QWaitCondition qwcWait;
+		bool bRunning;
+	public:
+		PluginSampler(Plugins *plugins);
+		~PluginSampler() Q_DECL_OVERRIDE;
+		void run() Q_DECL_OVERRIDE;
+};
 
 class Plugins : public QObject {
 		friend class PluginConfig;
@@ -59,6 +82,7 @@ class Plugins : public QObject {
 		QMap<QString, PluginFetchMeta> qmPluginFetchMeta;
 		QString qsSystemPlugins;
 		QString qsUserPlugins;
+		PluginSampler *psSampler;
 #ifdef Q_OS_WIN
 		HANDLE hToken;
 		TOKEN_PRIVILEGES tpPrevious;
@@ -71,12 +95,16 @@ class Plugins : public QObject {
 		bool bUnlink;
 		float fPosition[3], fFront[3], fTop[3];
 		float fCameraPosition[3], fCameraFront[3], fCameraTop[3];
+		/// What fetch() last read, for the audio threads.
+		PositionBuffer pbPositions;
 
 		Plugins(QObject *p = NULL);
 		~Plugins() Q_DECL_OVERRIDE;
 	public slots:
 		void on_Timer_timeout();
 		void rescanPlugins();
+		/// Reads the positions from the linked plugin. Only
+		/// PluginSampler calls this.
 		bool fetch();
 		void checkUpdates();
 		void fetchedUpdatePAPlugins(QByteArray, QUrl);
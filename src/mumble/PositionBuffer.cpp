@@ -0,0 +1,110 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "PositionBuffer.h"
+
+static void lerp(float *dst, const float *a, const float *b, float t) {
+	for (int i = 0; i < 3; ++i)
+		dst[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+PositionBuffer::Reader::Reader() : bRead(false) {
+	memset(&psOlder, 0, sizeof(psOlder));
+	memset(&psNewer, 0, sizeof(psNewer));
+}
+
+PositionBuffer::PositionBuffer() : iPublished(0) {
+	memset(psSlots, 0, sizeof(psSlots));
+}
+
+quint64 PositionBuffer::now() const {
+	return tClock.elapsed();
+}
+
+void PositionBuffer::publish(const PositionSample &ps) {
+	const int slot = iPublished % 2;
+
+	qaiVersion[slot].fetchAndAddOrdered(1);
+	psSlots[slot] = ps;
+	psSlots[slot].uiTime = tClock.elapsed();
+	qaiVersion[slot].fetchAndAddOrdered(1);
+
+	++iPublished;
+	qaiPublished.fetchAndStoreRelease(iPublished);
+}
+
+bool PositionBuffer::read(Reader &r, PositionSample &older, PositionSample &newer) {
+	for (int attempt = 0; attempt < iMaxRetries; ++attempt) {
+		const int count = qaiPublished.fetchAndAddAcquire(0);
+		if (! count)
+			return false;
+
+		// Slot 0 holds samples 1, 3, 5..., and slot 1 samples 2, 4, 6...;
+		// each write adds 2 to the version. If a slot's version isn't
+		// what count implies, the writer has moved on and the slots may
+		// hold samples from different rounds.
+		const int n = (count - 1) % 2;
+		const int o = (count > 1) ? (count % 2) : n;
+		const int nv = 2 * ((count + 1 - n) / 2);
+		const int ov = 2 * ((count + 1 - o) / 2);
+		if ((qaiVersion[n].fetchAndAddAcquire(0) != nv) || (qaiVersion[o].fetchAndAddAcquire(0) != ov))
+			continue;
+
+		newer = psSlots[n];
+		older = psSlots[o];
+
+		// A full barrier, so that the copies are done before the
+		// versions are checked again.
+		if ((qaiVersion[n].fetchAndAddOrdered(0) == nv) && (qaiVersion[o].fetchAndAddOrdered(0) == ov)) {
+			r.psOlder = older;
+			r.psNewer = newer;
+			r.bRead = true;
+			return true;
+		}
+	}
+
+	// The writer may have been preempted in the middle of publishing.
+	// Rather than spin on an audio thread until it is scheduled again,
+	// use what was read last.
+	if (! r.bRead)
+		return false;
+	older = r.psOlder;
+	newer = r.psNewer;
+	return true;
+}
+
+bool PositionBuffer::latest(Reader &r, PositionSample &ps) {
+	PositionSample older;
+	if (! read(r, older, ps))
+		return false;
+	return ps.bValid;
+}
+
+bool PositionBuffer::interpolated(Reader &r, PositionSample &ps) {
+	PositionSample older;
+	if (! read(r, older, ps))
+		return false;
+	if (! ps.bValid || ! older.bValid || (ps.uiTime <= older.uiTime))
+		return ps.bValid;
+
+	// Follow one interval behind: when the newer sample comes in,
+	// start from the older one, and reach the newer one an interval
+	// later, when the next one is due.
+	const quint64 interval = ps.uiTime - older.uiTime;
+	const quint64 time = tClock.elapsed();
+	const quint64 since = (time > ps.uiTime) ? (time - ps.uiTime) : 0;
+	const float t = static_cast<float>(qMin(since, interval)) / static_cast<float>(interval);
+
+	const PositionSample newer = ps;
+	lerp(ps.fPosition, older.fPosition, newer.fPosition, t);
+	lerp(ps.fFront, older.fFront, newer.fFront, t);
+	lerp(ps.fTop, older.fTop, newer.fTop, t);
+	lerp(ps.fCameraPosition, older.fCameraPosition, newer.fCameraPosition, t);
+	lerp(ps.fCameraFront, older.fCameraFront, newer.fCameraFront, t);
+	lerp(ps.fCameraTop, older.fCameraTop, newer.fCameraTop, t);
+	return true;
+}
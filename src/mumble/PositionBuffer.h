@@ -0,0 +1,84 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_POSITIONBUFFER_H_
+#define MUMBLE_MUMBLE_POSITIONBUFFER_H_
+
+#include <QtCore/QAtomicInt>
+
+#include "Timer.h"
+
+/// What the positional audio plugin reported at one time.
+struct PositionSample {
+	/// When it was published, in microseconds on the buffer's clock.
+	quint64 uiTime;
+	/// Whether a plugin was linked and reported positions.
+	bool bValid;
+	/// The avatar, whose position is sent along with our voice, and
+	/// the camera, which the other voices are placed around.
+	float fPosition[3], fFront[3], fTop[3];
+	float fCameraPosition[3], fCameraFront[3], fCameraTop[3];
+};
+
+/// PositionBuffer hands the positions the plugin sampler reads to the
+/// audio threads without locks.
+///
+/// It is a double buffer with a single writer and any number of
+/// readers. The writer overwrites the older of the two samples. Each
+/// slot has a version, which is odd while the slot is written; a
+/// reader that doesn't find the versions the number of published
+/// samples implies, or sees them change while copying, tries again.
+/// That only happens when a sample is published during the read. The
+/// readers are audio threads, which must not wait for the writer, so
+/// after iMaxRetries they take the samples they read last instead.
+class PositionBuffer {
+	private:
+		Q_DISABLE_COPY(PositionBuffer)
+	public:
+		/// Attempts a read makes before it gives up on the writer.
+		static const int iMaxRetries = 3;
+
+		/// The samples one reader last copied consistently. Each
+		/// reading thread keeps its own.
+		struct Reader {
+			PositionSample psOlder, psNewer;
+			bool bRead;
+			Reader();
+		};
+	protected:
+		Timer tClock;
+		PositionSample psSlots[2];
+		QAtomicInt qaiVersion[2];
+		/// Number of samples published; the latest is in slot
+		/// (count - 1) % 2. Written by the writer, which keeps its
+		/// own copy in iPublished.
+		QAtomicInt qaiPublished;
+		int iPublished;
+	public:
+		PositionBuffer();
+
+		/// Time on the buffer's clock, in microseconds.
+		quint64 now() const;
+
+		/// Publishes ps, stamped with the current time. Must only be
+		/// called from one thread.
+		void publish(const PositionSample &ps);
+
+		/// Copies the two latest samples. If only one was published,
+		/// both are that one. If the writer is publishing during
+		/// every attempt, they are the samples r last read. Returns
+		/// false if there are none.
+		bool read(Reader &r, PositionSample &older, PositionSample &newer);
+
+		/// Copies the latest sample, and returns whether it is valid.
+		bool latest(Reader &r, PositionSample &ps);
+
+		/// Interpolates between the two latest samples, one sampling
+		/// interval behind, so that positions move smoothly however
+		/// often they are read. Returns whether the result is valid.
+		bool interpolated(Reader &r, PositionSample &ps);
+};
+
+#endif
@@ -0,0 +1,136 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_RECORDBUFFERPOOL_H_
+#define MUMBLE_MUMBLE_RECORDBUFFERPOOL_H_
+
+#include <QtCore/QAtomicInt>
+
+/// A block of audio for the recorder.
+struct RecordBuffer {
+	/// The user the audio belongs to; see VoiceRecorder::indexForUser().
+	int iIndex;
+	/// Position of the first sample in the recording.
+	quint64 uiStart;
+	/// Time the buffer was queued, in microseconds since the recording
+	/// started.
+	quint64 uiQueued;
+	unsigned int iSamples;
+	float *pfSamples;
+};
+
+/// RecordBufferPool hands audio from the mixer to the recorder without
+/// locks or allocations.
+///
+/// All buffers are allocated up front. The mixer (the producer) takes
+/// a free buffer with reserve(), fills it and queues it with commit().
+/// The recorder (the consumer) takes queued buffers with take(), and
+/// gives them back with recycle() when it is done with them, in any
+/// order. When all buffers are in use, reserve() fails, and the mixer
+/// has to drop the audio.
+class RecordBufferPool {
+	private:
+		Q_DISABLE_COPY(RecordBufferPool)
+	protected:
+		/// A ring of buffer numbers with a single producer and a
+		/// single consumer.
+		class Ring {
+			private:
+				Q_DISABLE_COPY(Ring)
+			protected:
+				const int iSize;
+				int *piSlots;
+				QAtomicInt qaiHead;
+				QAtomicInt qaiTail;
+			public:
+				explicit Ring(int size) : iSize(size + 1), piSlots(new int[size + 1]), qaiHead(0), qaiTail(0) {}
+				~Ring() {
+					delete [] piSlots;
+				}
+
+				int count() {
+					return (qaiHead.fetchAndAddAcquire(0) - qaiTail.fetchAndAddAcquire(0) + iSize) % iSize;
+				}
+
+				/// Never fails, as the ring can hold all buffers.
+				void push(int v) {
+					const int head = qaiHead.fetchAndAddAcquire(0);
+					piSlots[head] = v;
+					qaiHead.fetchAndStoreRelease((head + 1) % iSize);
+				}
+
+				/// Returns -1 if the ring is empty.
+				int pop() {
+					const int tail = qaiTail.fetchAndAddAcquire(0);
+					if (tail == qaiHead.fetchAndAddAcquire(0))
+						return -1;
+					const int v = piSlots[tail];
+					qaiTail.fetchAndStoreRelease((tail + 1) % iSize);
+					return v;
+				}
+		};
+
+		const int iBuffers;
+		const unsigned int iBufferSamples;
+		float *pfSamples;
+		RecordBuffer *rbBuffers;
+		/// Free buffers. Filled by the consumer, emptied by the producer.
+		Ring rFree;
+		/// Queued buffers. Filled by the producer, emptied by the consumer.
+		Ring rQueued;
+		/// The buffer returned by reserve(), or -1.
+		int iReserved;
+	public:
+		/// Allocates buffers buffers of samples samples each.
+		RecordBufferPool(int buffers, unsigned int samples) : iBuffers(buffers), iBufferSamples(samples), pfSamples(new float[buffers * samples]), rbBuffers(new RecordBuffer[buffers]), rFree(buffers), rQueued(buffers), iReserved(-1) {
+			for (int i = 0; i < iBuffers; ++i) {
+				rbBuffers[i].pfSamples = pfSamples + i * iBufferSamples;
+				rFree.push(i);
+			}
+		}
+		~RecordBufferPool() {
+			delete [] rbBuffers;
+			delete [] pfSamples;
+		}
+
+		/// The number of samples a buffer holds.
+		unsigned int bufferSamples() const {
+			return iBufferSamples;
+		}
+
+		/// The number of buffers that are queued and not yet taken.
+		int queued() {
+			return rQueued.count();
+		}
+
+		/// Returns a free buffer for the producer to fill, or NULL if
+		/// there is none. Calling it again before commit() returns the
+		/// same buffer.
+		RecordBuffer *reserve() {
+			if (iReserved < 0)
+				iReserved = rFree.pop();
+			return (iReserved < 0) ? NULL : &rbBuffers[iReserved];
+		}
+
+		/// Queues the buffer returned by reserve().
+		void commit() {
+			rQueued.push(iReserved);
+			iReserved = -1;
+		}
+
+		/// Returns the oldest queued buffer, or NULL if there is none.
+		/// The buffer belongs to the consumer until it recycles it.
+		RecordBuffer *take() {
+			const int i = rQueued.pop();
+			return (i < 0) ? NULL : &rbBuffers[i];
+		}
+
+		/// Makes a buffer returned by take() available to the producer.
+		void recycle(RecordBuffer *rb) {
+			rFree.push(static_cast<int>(rb - rbBuffers));
+		}
+};
+
+#endif
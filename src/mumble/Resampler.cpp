@@ -0,0 +1,198 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "Resampler.h"
+
+#include "AudioMix.h"
+
+// The filters speex uses for each quality: base number of taps, cutoff
+// as a fraction of the lower Nyquist frequency when downsampling and
+// when upsampling, and the beta of the Kaiser window.
+struct ResamplerQuality {
+	unsigned int iTaps;
+	double dDownCutoff;
+	double dUpCutoff;
+	double dBeta;
+};
+
+static const ResamplerQuality rqQualities[11] = {
+	{ 8, 0.830, 0.860, 6.0 },
+	{ 16, 0.850, 0.880, 6.0 },
+	{ 32, 0.882, 0.910, 6.0 },
+	{ 48, 0.895, 0.917, 8.0 },
+	{ 64, 0.921, 0.940, 8.0 },
+	{ 80, 0.922, 0.940, 10.0 },
+	{ 96, 0.940, 0.945, 10.0 },
+	{ 128, 0.950, 0.950, 10.0 },
+	{ 160, 0.960, 0.960, 10.0 },
+	{ 192, 0.968, 0.968, 12.0 },
+	{ 256, 0.975, 0.975, 12.0 },
+};
+
+// Input frames the history takes per call to process(), in addition to
+// the filter taps.
+static const unsigned int iChunk = 1024;
+
+static unsigned int gcd(unsigned int a, unsigned int b) {
+	while (b) {
+		const unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Modified Bessel function of the first kind, order 0.
+static double besselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 50; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+Resampler::Resampler(unsigned int channels, unsigned int inRate, unsigned int outRate, int quality) : iChannels(channels), iInRate(inRate), iOutRate(outRate) {
+	const unsigned int g = gcd(iInRate, iOutRate);
+	iNum = iOutRate / g;
+	iDen = iInRate / g;
+
+	const ResamplerQuality &rq = rqQualities[qBound(0, quality, 10)];
+	unsigned int taps = rq.iTaps;
+	double cutoff = rq.dUpCutoff;
+	if (iDen > iNum) {
+		// Downsampling needs a filter that is longer by the ratio, to
+		// keep the same transition band at the lower rate.
+		taps = static_cast<unsigned int>((static_cast<quint64>(taps) * iDen) / iNum);
+		taps = ((taps - 1) & ~7U) + 8;
+		cutoff = rq.dDownCutoff * iNum / iDen;
+	}
+
+	bInterpolate = (iNum > iMaxPhases);
+	iPhases = bInterpolate ? iMaxPhases : iNum;
+	makeFilter(taps, cutoff, rq.dBeta);
+
+	iCapacity = iTaps + iChunk;
+	history.resize(iChannels * iCapacity);
+	reset();
+}
+
+void Resampler::makeFilter(unsigned int taps, double cutoff, double beta) {
+	iTaps = taps;
+	coefficients.resize((iPhases + 1) * iTaps);
+
+	const double half = iTaps / 2;
+	const double norm = besselI0(beta);
+	for (unsigned int p = 0; p <= iPhases; ++p) {
+		float *row = &coefficients[p * iTaps];
+		double sum = 0.0;
+		for (unsigned int j = 0; j < iTaps; ++j) {
+			// Distance of tap j from the output sample, in input samples.
+			const double x = static_cast<double>(j) - half + 1.0 - static_cast<double>(p) / iPhases;
+			const double w = x / half;
+			double h = 0.0;
+			if (qAbs(w) <= 1.0) {
+				const double t = M_PI * cutoff * x;
+				h = cutoff * ((qAbs(t) < 1e-9) ? 1.0 : sin(t) / t) * besselI0(beta * sqrt(1.0 - w * w)) / norm;
+			}
+			row[j] = static_cast<float>(h);
+			sum += h;
+		}
+		// Pass DC unchanged in every phase. Otherwise the truncated
+		// filter has a slightly different gain in each phase, which
+		// turns a constant input into a tone.
+		for (unsigned int j = 0; j < iTaps; ++j)
+			row[j] = static_cast<float>(row[j] / sum);
+	}
+}
+
+void Resampler::reset() {
+	// Start as if iTaps - 1 silent samples had been read, like speex.
+	std::fill(history.begin(), history.end(), 0.0f);
+	iFilled = iTaps - 1;
+	iPos = 0;
+	iPhase = 0;
+}
+
+float Resampler::filter(const float *x, unsigned int phase) const {
+	if (! bInterpolate)
+		return AudioMix::dot(&coefficients[phase * iTaps], x, iTaps);
+
+	const quint64 scaled = static_cast<quint64>(phase) * iPhases;
+	const unsigned int row = static_cast<unsigned int>(scaled / iNum);
+	const float frac = static_cast<float>(scaled % iNum) / static_cast<float>(iNum);
+	const float a = AudioMix::dot(&coefficients[row * iTaps], x, iTaps);
+	const float b = AudioMix::dot(&coefficients[(row + 1) * iTaps], x, iTaps);
+	return a + (b - a) * frac;
+}
+
+void Resampler::process(const float *in, unsigned int &inlen, float *out, unsigned int &outlen) {
+	const unsigned int step = iDen / iNum;
+	const unsigned int frac = iDen % iNum;
+	unsigned int consumed = 0;
+	unsigned int produced = 0;
+
+	while (true) {
+		// Deinterleave as much input as fits, so that the taps of
+		// each channel are contiguous.
+		const unsigned int n = qMin(inlen - consumed, iCapacity - iFilled);
+		for (unsigned int c = 0; c < iChannels; ++c) {
+			float *dst = &history[c * iCapacity + iFilled];
+			const float *src = in + consumed * iChannels + c;
+			for (unsigned int i = 0; i < n; ++i)
+				dst[i] = src[i * iChannels];
+		}
+		iFilled += n;
+		consumed += n;
+
+		while ((produced < outlen) && (iPos + iTaps <= iFilled)) {
+			for (unsigned int c = 0; c < iChannels; ++c)
+				out[produced * iChannels + c] = filter(&history[c * iCapacity + iPos], iPhase);
+			++produced;
+
+			iPos += step;
+			iPhase += frac;
+			if (iPhase >= iNum) {
+				iPhase -= iNum;
+				++iPos;
+			}
+		}
+
+		// Move what the next output sample needs to the front. When
+		// downsampling, iPos may be past the end of the input.
+		const unsigned int drop = qMin(iPos, iFilled);
+		if (drop) {
+			for (unsigned int c = 0; c < iChannels; ++c) {
+				float *h = &history[c * iCapacity];
+				memmove(h, h + drop, (iFilled - drop) * sizeof(float));
+			}
+			iFilled -= drop;
+			iPos -= drop;
+		}
+
+		if ((produced == outlen) || (consumed == inlen))
+			break;
+	}
+
+	inlen = consumed;
+	outlen = produced;
+}
+
+unsigned int Resampler::inputLatency() const {
+	return iTaps / 2;
+}
+
+unsigned int Resampler::taps() const {
+	return iTaps;
+}
+
+bool Resampler::interpolated() const {
+	return bInterpolate;
+}
@@ -0,0 +1,87 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_RESAMPLER_H_
+#define MUMBLE_MUMBLE_RESAMPLER_H_
+
+#include <QtCore/QtGlobal>
+
+#include <vector>
+
+/// Resampler converts interleaved float audio between two sample rates
+/// with a polyphase windowed sinc filter.
+///
+/// It is a drop-in replacement for the speex resampler: quality runs
+/// from 0 to 10 and picks the same filter length, cutoff and Kaiser
+/// window as speex does for that quality, and process() behaves like
+/// speex_resampler_process_interleaved_float(). The difference is that
+/// the filter is computed for every phase up front, so each output
+/// sample is one dot product, which runs on the vector kernels in
+/// AudioMix.
+///
+/// If the rates have no small common ratio (more than iMaxPhases
+/// phases), the filter is tabulated at iMaxPhases phases and each
+/// output sample interpolates between the two nearest.
+///
+/// process() neither allocates nor locks, so it may run on the audio
+/// thread.
+class Resampler {
+	private:
+		Q_DISABLE_COPY(Resampler)
+	public:
+		static const unsigned int iMaxPhases = 1024;
+	protected:
+		const unsigned int iChannels;
+		const unsigned int iInRate;
+		const unsigned int iOutRate;
+		/// The rate ratio in lowest terms: every iDen input samples
+		/// make iNum output samples.
+		unsigned int iNum;
+		unsigned int iDen;
+		/// Number of filter taps, a multiple of 8.
+		unsigned int iTaps;
+		/// Number of tabulated phases. Equal to iNum unless the filter
+		/// is interpolated.
+		unsigned int iPhases;
+		bool bInterpolate;
+		/// iPhases + 1 rows of iTaps coefficients. The last row is
+		/// only used when interpolating.
+		std::vector<float> coefficients;
+
+		/// Per channel input history, iCapacity samples each. The
+		/// first iFilled samples are valid.
+		std::vector<float> history;
+		unsigned int iCapacity;
+		unsigned int iFilled;
+		/// Position of the first tap for the next output sample, and
+		/// its phase in units of 1/iNum of an input sample.
+		unsigned int iPos;
+		unsigned int iPhase;
+
+		void makeFilter(unsigned int taps, double cutoff, double beta);
+		float filter(const float *x, unsigned int phase) const;
+	public:
+		/// Converts channels interleaved channels from inRate to
+		/// outRate Hz with the speex quality quality.
+		Resampler(unsigned int channels, unsigned int inRate, unsigned int outRate, int quality);
+
+		/// Resamples up to inlen frames from in into up to outlen frames
+		/// in out. On return, inlen and outlen hold the number of frames
+		/// consumed and produced. All input is consumed unless out fills
+		/// up first.
+		void process(const float *in, unsigned int &inlen, float *out, unsigned int &outlen);
+
+		/// Clears the history, as if the resampler was just created.
+		void reset();
+
+		/// Delay in input samples, like speex_resampler_get_input_latency().
+		unsigned int inputLatency() const;
+		/// Number of filter taps per output sample.
+		unsigned int taps() const;
+		/// Whether the filter is interpolated between phases.
+		bool interpolated() const;
+};
+
+#endif
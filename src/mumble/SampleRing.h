@@ -0,0 +1,69 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_SAMPLERING_H_
+#define MUMBLE_MUMBLE_SAMPLERING_H_
+
+#include <QtCore/QAtomicInt>
+
+#include <string.h>
+
+/// SampleRing hands audio samples from one thread to another without
+/// locks or allocations.
+///
+/// Like VoicePacketRing, it has a single producer, which calls space()
+/// and write(), and a single consumer, which calls read(). available()
+/// may be called from anywhere.
+class SampleRing {
+	private:
+		Q_DISABLE_COPY(SampleRing)
+	protected:
+		/// One more than the number of samples the ring holds, so that
+		/// a full ring can be told from an empty one.
+		const int iSize;
+		float *pfSamples;
+		/// Position the producer writes next. Written by the producer.
+		QAtomicInt qaiHead;
+		/// Position the consumer reads next. Written by the consumer.
+		QAtomicInt qaiTail;
+	public:
+		/// Creates a ring that holds up to size samples.
+		explicit SampleRing(unsigned int size) : iSize(static_cast<int>(size) + 1), pfSamples(new float[size + 1]), qaiHead(0), qaiTail(0) {}
+		~SampleRing() {
+			delete [] pfSamples;
+		}
+
+		/// Returns the number of samples that can be read.
+		unsigned int available() {
+			return static_cast<unsigned int>((qaiHead.fetchAndAddAcquire(0) - qaiTail.fetchAndAddAcquire(0) + iSize) % iSize);
+		}
+
+		/// Returns the number of samples that can be written.
+		unsigned int space() {
+			return static_cast<unsigned int>(iSize - 1) - available();
+		}
+
+		/// Appends n samples, which must fit.
+		void write(const float *src, unsigned int n) {
+			const int head = qaiHead.fetchAndAddAcquire(0);
+			const unsigned int first = qMin(n, static_cast<unsigned int>(iSize - head));
+			memcpy(pfSamples + head, src, first * sizeof(float));
+			memcpy(pfSamples, src + first, (n - first) * sizeof(float));
+			qaiHead.fetchAndStoreRelease((head + static_cast<int>(n)) % iSize);
+		}
+
+		/// Takes up to n samples. Returns the number of samples read.
+		unsigned int read(float *dst, unsigned int n) {
+			n = qMin(n, available());
+			const int tail = qaiTail.fetchAndAddAcquire(0);
+			const unsigned int first = qMin(n, static_cast<unsigned int>(iSize - tail));
+			memcpy(dst, pfSamples + tail, first * sizeof(float));
+			memcpy(dst + first, pfSamples, (n - first) * sizeof(float));
+			qaiTail.fetchAndStoreRelease((tail + static_cast<int>(n)) % iSize);
+			return n;
+		}
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "SSL.h"
 #include "User.h"
 #include "Net.h"
+#include "VoiceSocket.h"
 
 ServerHandlerMessageEvent::ServerHandlerMessageEvent(const QByteArray &msg, unsigned int mtype, bool flush) : QEvent(static_cast<QEvent::Type>(SERVERSEND_EVENT)) {
 	qbaMsg = msg;
@@ -63,7 +64,7 @@ static HANDLE loadQoS() {
 
 ServerHandler::ServerHandler() {
 	cConnection.reset();
-	qusUdp = NULL;
+	vsUdp = NULL;
 	bStrong = false;
 	usPort = 0;
 	bUdp = true;
@@ -135,16 +136,11 @@ void ServerHandler::customEvent(QEvent *evt) {
 }
 
 void ServerHandler::udpReady() {
-	while (qusUdp->hasPendingDatagrams()) {
-		char encrypted[2048];
-		char buffer[2048];
-		unsigned int buflen = static_cast<unsigned int>(qusUdp->pendingDatagramSize());
-		QHostAddress senderAddr;
-		quint16 senderPort;
-		qusUdp->readDatagram(encrypted, qMin(2048U, buflen), &senderAddr, &senderPort);
-
-		if (!(HostAddress(senderAddr) == HostAddress(qhaRemote)) || (senderPort != usPort))
-			continue;
+	int count;
+	do {
+		count = vsUdp->receive();
+		if (! count)
+			break;
 
 		ConnectionPtr connection(cConnection);
 		if (! connection)
@@ -153,42 +149,48 @@ void ServerHandler::udpReady() {
 		if (! connection->csCrypt.isValid())
 			continue;
 
-		if (buflen < 5)
-			continue;
-
-		if (! connection->csCrypt.decrypt(reinterpret_cast<const unsigned char *>(encrypted), reinterpret_cast<unsigned char *>(buffer), buflen)) {
-			if (connection->csCrypt.tLastGood.elapsed() > 5000000ULL) {
-				if (connection->csCrypt.tLastRequest.elapsed() > 5000000ULL) {
-					connection->csCrypt.tLastRequest.restart();
-					MumbleProto::CryptSetup mpcs;
-					sendMessage(mpcs);
+		for (int i = 0; i < count; ++i) {
+			unsigned int buflen = vsUdp->size(i);
+			if (buflen < 5)
+				continue;
+
+			// Decrypt where the datagram was received; the voice
+			// data is only copied once, into the speaker's queue.
+			unsigned char *buffer = reinterpret_cast<unsigned char *>(vsUdp->data(i));
+			if (! connection->csCrypt.decrypt(buffer, buffer, buflen)) {
+				if (connection->csCrypt.tLastGood.elapsed() > 5000000ULL) {
+					if (connection->csCrypt.tLastRequest.elapsed() > 5000000ULL) {
+						connection->csCrypt.tLastRequest.restart();
+						MumbleProto::CryptSetup mpcs;
+						sendMessage(mpcs);
+					}
 				}
+				continue;
 			}
-			continue;
-		}
 
-		PacketDataStream pds(buffer + 1, buflen-5);
-
-		MessageHandler::UDPMessageType msgType = static_cast<MessageHandler::UDPMessageType>((buffer[0] >> 5) & 0x7);
-		unsigned int msgFlags = buffer[0] & 0x1f;
-
-		switch (msgType) {
-			case MessageHandler::UDPPing: {
-					quint64 t;
-					pds >> t;
-					accUDP(static_cast<double>(tTimestamp.elapsed() - t) / 1000.0);
-				}
-				break;
-			case MessageHandler::UDPVoiceCELTAlpha:
-			case MessageHandler::UDPVoiceCELTBeta:
-			case MessageHandler::UDPVoiceSpeex:
-			case MessageHandler::UDPVoiceOpus:
-				handleVoicePacket(msgFlags, pds, msgType);
-				break;
-			default:
-				break;
+			PacketDataStream pds(buffer + 1, buflen-5);
+
+			MessageHandler::UDPMessageType msgType = static_cast<MessageHandler::UDPMessageType>((buffer[0] >> 5) & 0x7);
+			unsigned int msgFlags = buffer[0] & 0x1f;
+
+			switch (msgType) {
+				case MessageHandler::UDPPing: {
+						quint64 t;
+						pds >> t;
+						accUDP(static_cast<double>(tTimestamp.elapsed() - t) / 1000.0);
+					}
+					break;
+				case MessageHandler::UDPVoiceCELTAlpha:
+				case MessageHandler::UDPVoiceCELTBeta:
+				case MessageHandler::UDPVoiceSpeex:
+				case MessageHandler::UDPVoiceOpus:
+					handleVoicePacket(msgFlags, pds, msgType);
+					break;
+				default:
+					break;
+			}
 		}
-	}
+	} while (count == VoiceSocket::iBatch);
 }
 
 void ServerHandler::handleVoicePacket(unsigned int msgFlags, PacketDataStream &pds, MessageHandler::UDPMessageType type) {
@@ -199,11 +201,7 @@ void ServerHandler::handleVoicePacket(unsigned int msgFlags, PacketDataStream &p
 	if (ao && p && ! p->bLocalMute && !(((msgFlags & 0x1f) == 2) && g.s.bWhisperFriends && p->qsFriendName.isEmpty())) {
 		unsigned int iSeq;
 		pds >> iSeq;
-		QByteArray qba;
-		qba.reserve(pds.left() + 1);
-		qba.append(static_cast<char>(msgFlags));
-		qba.append(pds.dataBlock(pds.left()));
-		ao->addFrameToBuffer(p, qba, iSeq, type);
+		ao->addFrameToBuffer(p, msgFlags, pds.charPtr(), pds.left(), iSeq, type);
 	}
 }
 
@@ -212,7 +210,7 @@ void ServerHandler::sendMessage(const char *data, int len, bool force) {
 
 	QMutexLocker qml(&qmUdp);
 
-	if (! qusUdp)
+	if (! vsUdp)
 		return;
 
 	ConnectionPtr connection(cConnection);
@@ -231,7 +229,7 @@ void ServerHandler::sendMessage(const char *data, int len, bool force) {
 		QApplication::postEvent(this, new ServerHandlerMessageEvent(qba, MessageHandler::UDPTunnel, true));
 	} else {
 		connection->csCrypt.encrypt(reinterpret_cast<const unsigned char *>(data), crypto, len);
-		qusUdp->writeDatagram(reinterpret_cast<const char *>(crypto), len + 4, qhaRemote, usPort);
+		vsUdp->send(reinterpret_cast<const char *>(crypto), len + 4);
 	}
 }
 
@@ -311,7 +309,7 @@ void ServerHandler::run() {
 
 	exec();
 
-	if (qusUdp) {
+	if (vsUdp) {
 		QMutexLocker qml(&qmUdp);
 
 #ifdef Q_OS_WIN
@@ -321,8 +319,8 @@ void ServerHandler::run() {
 			dwFlowUDP = 0;
 		}
 #endif
-		delete qusUdp;
-		qusUdp = NULL;
+		delete vsUdp;
+		vsUdp = NULL;
 	}
 
 	ticker->stop();
@@ -396,7 +394,7 @@ void ServerHandler::sendPing() {
 
 	quint64 t = tTimestamp.elapsed();
 
-	if (qusUdp) {
+	if (vsUdp) {
 		unsigned char buffer[256];
 		PacketDataStream pds(buffer + 1, 255);
 		buffer[0] = MessageHandler::UDPPing << 5;
@@ -449,7 +447,8 @@ void ServerHandler::message(unsigned int msgType, const QByteArray &qbaMsg) {
 				break;
 		}
 	} else if (msgType == MessageHandler::Ping) {
-		MumbleProto::Ping msg;
+		MessageCache<MumbleProto::Ping>::Lease lease(mcPing, qbaMsg.size());
+		MumbleProto::Ping &msg = lease.message();
 		if (msg.ParseFromArray(qbaMsg.constData(), qbaMsg.size())) {
 			ConnectionPtr connection(cConnection);
 			if (!connection) return;
@@ -579,6 +578,7 @@ void ServerHandler::serverConnectionConnected() {
 #else
 	mpa.set_opus(false);
 #endif
+	mpa.set_text_message_blobs(true);
 	sendMessage(mpa);
 
 	{
@@ -586,29 +586,24 @@ void ServerHandler::serverConnectionConnected() {
 
 		qhaRemote = connection->peerAddress();
 
-		qusUdp = new QUdpSocket(this);
-		if (qhaRemote.protocol() == QAbstractSocket::IPv6Protocol)
-			qusUdp->bind(QHostAddress(QHostAddress::AnyIPv6), 0);
-		else
-			qusUdp->bind(QHostAddress(QHostAddress::Any), 0);
-
-		connect(qusUdp, SIGNAL(readyRead()), this, SLOT(udpReady()));
+		vsUdp = new VoiceSocket(qhaRemote, usPort, this);
+		connect(vsUdp, SIGNAL(readyRead()), this, SLOT(udpReady()));
 
 		if (g.s.bQoS) {
 
 #if defined(Q_OS_UNIX)
 			int val = 0xe0;
-			if (setsockopt(static_cast<int>(qusUdp->socketDescriptor()), IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
+			if (setsockopt(static_cast<int>(vsUdp->socketDescriptor()), IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
 				val = 0x80;
-				if (setsockopt(static_cast<int>(qusUdp->socketDescriptor()), IPPROTO_IP, IP_TOS, &val, sizeof(val)))
+				if (setsockopt(static_cast<int>(vsUdp->socketDescriptor()), IPPROTO_IP, IP_TOS, &val, sizeof(val)))
 					qWarning("ServerHandler: Failed to set TOS for UDP Socket");
 			}
 #if defined(SO_PRIORITY)
 			socklen_t optlen = sizeof(val);
-			if (getsockopt(static_cast<int>(qusUdp->socketDescriptor()), SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
+			if (getsockopt(static_cast<int>(vsUdp->socketDescriptor()), SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
 				if (val == 0) {
 					val = 6;
-					setsockopt(static_cast<int>(qusUdp->socketDescriptor()), SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
+					setsockopt(static_cast<int>(vsUdp->socketDescriptor()), SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
 				}
 			}
 #endif
@@ -621,7 +616,7 @@ void ServerHandler::serverConnectionConnected() {
 				addr.sin_addr.s_addr = htonl(qhaRemote.toIPv4Address());
 
 				dwFlowUDP = 0;
-				if (! QOSAddSocketToFlow(hQoS, qusUdp->socketDescriptor(), reinterpret_cast<sockaddr *>(&addr), QOSTrafficTypeVoice, QOS_NON_ADAPTIVE_FLOW, &dwFlowUDP))
+				if (! QOSAddSocketToFlow(hQoS, vsUdp->socketDescriptor(), reinterpret_cast<sockaddr *>(&addr), QOSTrafficTypeVoice, QOS_NON_ADAPTIVE_FLOW, &dwFlowUDP))
 					qWarning("ServerHandler: Failed to add UDP to QOS");
 			}
 #endif
@@ -31,13 +31,14 @@
 
 #include "Timer.h"
 #include "Message.h"
+#include "MessageCache.h"
 #include "Mumble.pb.h"
 
 class Connection;
 class Message;
 class PacketDataStream;
-class QUdpSocket;
 class VoiceRecorder;
+class VoiceSocket;
 
 class ServerHandlerMessageEvent : public QEvent {
 	public:
@@ -67,9 +68,13 @@ class ServerHandler : public QThread {
 #endif
 
 		QHostAddress qhaRemote;
-		QUdpSocket *qusUdp;
+		VoiceSocket *vsUdp;
 		QMutex qmUdp;
 
+		/// Ping messages are parsed on this thread; the others in
+		/// MainWindow::customEvent().
+		MessageCache<MumbleProto::Ping> mcPing;
+
 		void handleVoicePacket(unsigned int msgFlags, PacketDataStream &pds, MessageHandler::UDPMessageType type);
 	public:
 		Timer tTimestamp;
@@ -238,6 +238,7 @@ Settings::Settings() {
 	iMinLoudness = 1000;
 	iVoiceHold = 50;
 	iJitterBufferSize = 1;
+	iJitterBufferPercentile = 95;
 	iFramesPerPacket = 2;
 	iNoiseSuppress = -30;
 
@@ -323,6 +324,7 @@ Settings::Settings() {
 	fAudioMaxDistance = 15.0f;
 	fAudioMaxDistVolume = 0.80f;
 	fAudioBloom = 0.5f;
+	iPluginSampleRate = 50;
 
 	// OverlayPrivateWin
 	iOverlayWinHelperRestartCooldownMsec = 10000;
@@ -584,12 +586,14 @@ void Settings::load(QSettings* settings_ptr) {
 	SAVELOAD(bExclusiveOutput, "audio/exclusiveoutput");
 	SAVELOAD(bPositionalAudio, "audio/positional");
 	SAVELOAD(bPositionalHeadphone, "audio/headphone");
+	SAVELOAD(iPluginSampleRate, "audio/pluginsamplerate");
 	SAVELOAD(qsAudioInput, "audio/input");
 	SAVELOAD(qsAudioOutput, "audio/output");
 	SAVELOAD(bWhisperFriends, "audio/whisperfriends");
 	SAVELOAD(bTransmitPosition, "audio/postransmit");
 
 	SAVELOAD(iJitterBufferSize, "net/jitterbuffer");
+	SAVELOAD(iJitterBufferPercentile, "net/jitterpercentile");
 	SAVELOAD(iFramesPerPacket, "net/framesperpacket");
 
 	SAVELOAD(bASIOEnable, "asio/enable");
@@ -894,12 +898,14 @@ void Settings::save() {
 	SAVELOAD(bExclusiveOutput, "audio/exclusiveoutput");
 	SAVELOAD(bPositionalAudio, "audio/positional");
 	SAVELOAD(bPositionalHeadphone, "audio/headphone");
+	SAVELOAD(iPluginSampleRate, "audio/pluginsamplerate");
 	SAVELOAD(qsAudioInput, "audio/input");
 	SAVELOAD(qsAudioOutput, "audio/output");
 	SAVELOAD(bWhisperFriends, "audio/whisperfriends");
 	SAVELOAD(bTransmitPosition, "audio/postransmit");
 
 	SAVELOAD(iJitterBufferSize, "net/jitterbuffer");
+	SAVELOAD(iJitterBufferPercentile, "net/jitterpercentile");
 	SAVELOAD(iFramesPerPacket, "net/framesperpacket");
 
 	SAVELOAD(bASIOEnable, "asio/enable");
@@ -172,6 +172,10 @@ struct Settings {
 	///backend.
 	QString qsTTSLanguage;
 	int iQuality, iMinLoudness, iVoiceHold, iJitterBufferSize;
+	/// Percentage of voice packets the jitter buffer tries to have
+	/// arrived in time. iJitterBufferSize is the smallest delay it
+	/// uses for that.
+	int iJitterBufferPercentile;
 	int iNoiseSuppress;
 
 	// Idle auto actions
@@ -211,6 +215,9 @@ struct Settings {
 	bool bPositionalAudio;
 	bool bPositionalHeadphone;
 	float fAudioMinDistance, fAudioMaxDistance, fAudioMaxDistVolume, fAudioBloom;
+	/// How many times a second the positional audio plugin is
+	/// asked for positions.
+	int iPluginSampleRate;
 	QMap<QString, bool> qmPositionalAudioPlugins;
 
 	OverlaySettings os;
@@ -0,0 +1,87 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "TimeStretch.h"
+
+// Normalized correlation a period has to reach to be cut or repeated.
+static const float fMinCorrelation = 0.7f;
+
+// Below this mean power (-60 dBFS) the signal is treated as silence,
+// where any lag will do.
+static const float fSilence = 1e-6f;
+
+// Finds the lag at which buf[0, lag) best matches buf[lag, 2 * lag).
+// Returns false if stretching the signal at that lag would be audible.
+static bool bestLag(const float *buf, unsigned int n, unsigned int minLag, unsigned int maxLag, unsigned int &lag) {
+	maxLag = qMin(maxLag, n / 2);
+	if ((minLag == 0) || (minLag > maxLag))
+		return false;
+
+	// Energy of buf[0, L) and of buf[0, 2 * L), updated as L grows.
+	float e1 = 0.0f;
+	float e2 = 0.0f;
+	for (unsigned int i = 0; i < minLag; ++i)
+		e1 += buf[i] * buf[i];
+	for (unsigned int i = 0; i < 2 * minLag; ++i)
+		e2 += buf[i] * buf[i];
+
+	float best = -1.0f;
+	lag = minLag;
+
+	for (unsigned int l = minLag; l <= maxLag; ++l) {
+		if (l > minLag) {
+			e1 += buf[l - 1] * buf[l - 1];
+			e2 += buf[2 * l - 2] * buf[2 * l - 2] + buf[2 * l - 1] * buf[2 * l - 1];
+		}
+
+		float c = 0.0f;
+		for (unsigned int i = 0; i < l; ++i)
+			c += buf[i] * buf[i + l];
+
+		const float e = e1 * (e2 - e1);
+		const float score = (e > 0.0f) ? c / sqrtf(e) : 0.0f;
+		if (score > best) {
+			best = score;
+			lag = l;
+		}
+	}
+
+	return (best >= fMinCorrelation) || (e2 < fSilence * static_cast<float>(2 * maxLag));
+}
+
+unsigned int TimeStretch::shorten(float *buf, unsigned int n, unsigned int minLag, unsigned int maxLag) {
+	unsigned int lag;
+	if (! bestLag(buf, n, minLag, maxLag, lag))
+		return n;
+
+	// Fade from the first period into the second, then skip the second.
+	const float inc = 1.0f / static_cast<float>(lag);
+	for (unsigned int i = 0; i < lag; ++i) {
+		const float w = static_cast<float>(i) * inc;
+		buf[i] = buf[i] * (1.0f - w) + buf[i + lag] * w;
+	}
+	memmove(buf + lag, buf + 2 * lag, (n - 2 * lag) * sizeof(float));
+
+	return n - lag;
+}
+
+unsigned int TimeStretch::lengthen(float *buf, unsigned int n, unsigned int minLag, unsigned int maxLag) {
+	unsigned int lag;
+	if (! bestLag(buf, n, minLag, maxLag, lag))
+		return n;
+
+	// Make room for one more period after the first, and fill it by
+	// fading from the second period back into the first.
+	memmove(buf + 2 * lag, buf + lag, (n - lag) * sizeof(float));
+	const float inc = 1.0f / static_cast<float>(lag);
+	for (unsigned int i = 0; i < lag; ++i) {
+		const float w = static_cast<float>(i) * inc;
+		buf[lag + i] = buf[2 * lag + i] * (1.0f - w) + buf[i] * w;
+	}
+
+	return n + lag;
+}
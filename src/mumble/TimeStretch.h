@@ -0,0 +1,31 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_TIMESTRETCH_H_
+#define MUMBLE_MUMBLE_TIMESTRETCH_H_
+
+/// Time-scale modification of decoded speech, which lets the playout
+/// buffer change its delay without gaps or skips.
+///
+/// Both functions look for the lag between minLag and maxLag samples
+/// at which the signal best matches itself, i.e. a multiple of the
+/// pitch period, and remove or repeat one such period, cross-fading
+/// over it (WSOLA). When no lag matches well enough and the signal
+/// isn't silent, they leave it alone, as stretching it would be
+/// audible.
+///
+/// The buffer must hold at least 2 * maxLag samples.
+namespace TimeStretch {
+	/// Shortens the n samples in buf by one period. Returns the new
+	/// length, which is n if nothing was removed.
+	unsigned int shorten(float *buf, unsigned int n, unsigned int minLag, unsigned int maxLag);
+
+	/// Lengthens the n samples in buf by one period. buf must have room
+	/// for n + maxLag samples. Returns the new length, which is n if
+	/// nothing was added.
+	unsigned int lengthen(float *buf, unsigned int n, unsigned int minLag, unsigned int maxLag);
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_VOICEPACKETRING_H_
+#define MUMBLE_MUMBLE_VOICEPACKETRING_H_
+
+#include <QtCore/QAtomicInt>
+
+/// A voice packet as it is stored in the jitter buffer: the flags
+/// byte of the UDP header followed by the payload.
+struct VoicePacket {
+	/// Largest packet that fits. The server never sends UDP packets
+	/// larger than 1024 bytes, and the header is smaller than the
+	/// parts of it that are stripped.
+	static const unsigned int iMaxSize = 1024;
+
+	unsigned int iSeq;
+	/// Time the packet arrived, in microseconds.
+	quint64 uiArrival;
+	/// Number of samples in the packet.
+	unsigned int iSamples;
+	unsigned int iSize;
+	char cData[iMaxSize];
+};
+
+/// VoicePacketRing hands voice packets from the network thread to
+/// the audio thread without locks or allocations.
+///
+/// It is a ring of preallocated packets with a single producer and
+/// a single consumer: only one thread may reserve() and commit(),
+/// and only one other thread may front() and pop(). The ring holds
+/// iSlots - 1 packets; when it is full, the producer drops packets,
+/// as the audio thread isn't keeping up anyway.
+class VoicePacketRing {
+	private:
+		Q_DISABLE_COPY(VoicePacketRing)
+	public:
+		static const int iSlots = 64;
+	protected:
+		/// Slot the producer fills next. Written by the producer.
+		QAtomicInt qaiHead;
+		/// Slot the consumer reads next. Written by the consumer.
+		QAtomicInt qaiTail;
+		/// The producer's and consumer's own copies of their index,
+		/// which they can read without synchronization.
+		int iHead;
+		int iTail;
+		VoicePacket vpSlots[iSlots];
+	public:
+		VoicePacketRing() : qaiHead(0), qaiTail(0), iHead(0), iTail(0) {}
+
+		/// Returns the next free packet for the producer to fill,
+		/// or NULL if the ring is full.
+		VoicePacket *reserve() {
+			const int next = (iHead + 1) % iSlots;
+			if (next == qaiTail.fetchAndAddAcquire(0))
+				return NULL;
+			return &vpSlots[iHead];
+		}
+
+		/// Hands the packet returned by reserve() to the consumer.
+		void commit() {
+			iHead = (iHead + 1) % iSlots;
+			qaiHead.fetchAndStoreRelease(iHead);
+		}
+
+		/// Returns the oldest packet, or NULL if the ring is empty.
+		/// The packet stays valid until pop().
+		const VoicePacket *front() {
+			if (iTail == qaiHead.fetchAndAddAcquire(0))
+				return NULL;
+			return &vpSlots[iTail];
+		}
+
+		/// Releases the packet returned by front().
+		void pop() {
+			iTail = (iTail + 1) % iSlots;
+			qaiTail.fetchAndStoreRelease(iTail);
+		}
+};
+
+#endif
@@ -7,25 +7,76 @@
 
 #include "VoiceRecorder.h"
 
+#include "AudioMix.h"
 #include "AudioOutput.h"
 #include "ClientUser.h"
 #include "Global.h"
+#include "RecordBufferPool.h"
 #include "ServerHandler.h"
 
 #include "../Timer.h"
 
-VoiceRecorder::RecordBuffer::RecordBuffer(
-		int recordInfoIndex_,
-		boost::shared_array<float> buffer_,
-		int samples_,
-		quint64 absoluteStartSample_)
+/// A thread that encodes and writes the buffers of some of the users.
+class RecordWriter : public QThread {
+	private:
+		Q_DISABLE_COPY(RecordWriter)
+	protected:
+		VoiceRecorder *vrRecorder;
+		SF_INFO sfiInfo;
+		QMutex qmQueue;
+		QWaitCondition qwcQueue;
+		/// Buffers to write, and the users they belong to.
+		QList<QPair<VoiceRecorder::RecordInfo *, RecordBuffer *> > qlQueue;
+		/// Buffers that were written.
+		QList<RecordBuffer *> qlDone;
+		bool bFinish;
+		void run() Q_DECL_OVERRIDE;
+	public:
+		RecordWriter(VoiceRecorder *vr, const SF_INFO &sfi) : vrRecorder(vr), sfiInfo(sfi), bFinish(false) {}
+
+		void queue(VoiceRecorder::RecordInfo *ri, RecordBuffer *rb);
+		/// Moves the buffers that were written to |done|.
+		void takeDone(QList<RecordBuffer *> &done);
+		/// Stops the thread once everything queued is written.
+		void finish();
+};
+
+void RecordWriter::queue(VoiceRecorder::RecordInfo *ri, RecordBuffer *rb) {
+	QMutexLocker l(&qmQueue);
+	qlQueue << qMakePair(ri, rb);
+	qwcQueue.wakeAll();
+}
 
-	: recordInfoIndex(recordInfoIndex_)
-	, buffer(buffer_)
-	, samples(samples_)
-	, absoluteStartSample(absoluteStartSample_) {
-	
-	// Nothing
+void RecordWriter::takeDone(QList<RecordBuffer *> &done) {
+	QMutexLocker l(&qmQueue);
+	done << qlDone;
+	qlDone.clear();
+}
+
+void RecordWriter::finish() {
+	QMutexLocker l(&qmQueue);
+	bFinish = true;
+	qwcQueue.wakeAll();
+}
+
+void RecordWriter::run() {
+	QMutexLocker l(&qmQueue);
+
+	forever {
+		while (qlQueue.isEmpty() && !bFinish)
+			qwcQueue.wait(&qmQueue);
+		if (qlQueue.isEmpty())
+			break;
+
+		const QPair<VoiceRecorder::RecordInfo *, RecordBuffer *> job = qlQueue.takeFirst();
+		l.unlock();
+
+		if (!vrRecorder->m_abort)
+			vrRecorder->writeBuffer(sfiInfo, job.first, job.second);
+
+		l.relock();
+		qlDone << job.second;
+	}
 }
 
 VoiceRecorder::RecordInfo::RecordInfo(const QString& userName_)
@@ -45,18 +96,25 @@ VoiceRecorder::VoiceRecorder(QObject *p, const Config& config)
     : QThread(p)
     , m_recordUser(new RecordUser())
     , m_timestamp(new Timer())
-	, m_config(config)
+    , m_pool(new RecordBufferPool(iPoolBuffers, config.sampleRate / 50))
+    , m_silence(new float[config.sampleRate])
+    , m_writeLag(0)
+    , m_maxWriteLag(0)
+    , m_droppedBuffers(0)
+    , m_config(config)
     , m_recording(false)
     , m_abort(false)
     , m_recordingStartTime(QDateTime::currentDateTime())
     , m_absoluteSampleEstimation(0) {
 	
-	// Nothing
+	memset(m_silence, 0, sizeof(float) * config.sampleRate);
 }
 
 VoiceRecorder::~VoiceRecorder() {
 	stop();
 	wait();
+
+	delete [] m_silence;
 }
 
 QString VoiceRecorder::sanitizeFilenameOrPathComponent(const QString &str) const {
@@ -172,6 +230,21 @@ int VoiceRecorder::indexForUser(const ClientUser *clientUser) const {
 	return (m_config.mixDownMode) ? 0 : clientUser->uiSession;
 }
 
+QString VoiceRecorder::userNameForIndex(int index) const {
+	if (m_config.mixDownMode)
+		return QLatin1String("Mixdown");
+
+	// The local user is recorded through the RecordUser, whose
+	// session is 0.
+	if (index == 0)
+		return m_recordUser->qsName;
+
+	// The user may have left while their last buffers were queued.
+	QReadLocker lock(&ClientUser::c_qrwlUsers);
+	const ClientUser *p = ClientUser::c_qmUsers.value(static_cast<unsigned int>(index));
+	return p ? p->qsName : QLatin1String("Unknown");
+}
+
 SF_INFO VoiceRecorder::createSoundFileInfo() const {
 	Q_ASSERT(m_config.sampleRate != 0);
 
@@ -220,13 +293,24 @@ SF_INFO VoiceRecorder::createSoundFileInfo() const {
 			sfinfo.seekable = 0;
 			qWarning() << "VoiceRecorder: recording started to" << m_config.fileName << "@" << m_config.sampleRate << "hz in FLAC format";
 			break;
+#ifdef USE_SNDFILE_OPUS
+		case VoiceRecorderFormat::OPUS:
+			sfinfo.frames = 0;
+			sfinfo.samplerate = m_config.sampleRate;
+			sfinfo.channels = 1;
+			sfinfo.format = SF_FORMAT_OGG | SF_FORMAT_OPUS;
+			sfinfo.sections = 0;
+			sfinfo.seekable = 0;
+			qWarning() << "VoiceRecorder: recording started to" << m_config.fileName << "@" << m_config.sampleRate << "hz in OGG/Opus format";
+			break;
+#endif
 	}
 
 	Q_ASSERT(sf_format_check(&sfinfo));
 	return sfinfo;
 }
 
-bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, boost::shared_ptr<RecordInfo>& ri) {
+bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, RecordInfo *ri) {
 	if (ri->soundFile != NULL) {
 		// Nothing to do
 		return true;
@@ -234,6 +318,8 @@ bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, boost::shared_
 	
 	QString filename = expandTemplateVariables(m_config.fileName, ri->userName);
 
+	QMutexLocker l(&m_fileLock);
+
 	// Try to find a unique filename.
 	{
 		int cnt = 1;
@@ -256,9 +342,7 @@ bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, boost::shared_
 	// Create the target path.
 	if (!QDir().mkpath(fi.absolutePath())) {
 		qWarning() << "Failed to create target directory: " << fi.absolutePath();
-		m_recording = false;
 		emit error(CreateDirectoryFailed, tr("Recorder failed to create directory '%1'").arg(fi.absolutePath()));
-		emit recording_stopped();
 		return false;
 	}
 
@@ -270,9 +354,7 @@ bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, boost::shared_
 #endif
 	if (ri->soundFile == NULL) {
 		qWarning() << "Failed to open file for recorder: "<< sf_strerror(NULL);
-		m_recording = false;
 		emit error(CreateFileFailed, tr("Recorder failed to open file '%1'").arg(filename));
-		emit recording_stopped();
 		return false;
 	}
 
@@ -281,6 +363,9 @@ bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, boost::shared_
 	
 	// Enable hard-clipping for non-float formats to prevent wrapping
 	if ((soundFileInfo.format & SF_FORMAT_SUBMASK) != SF_FORMAT_FLOAT &&
+#ifdef USE_SNDFILE_OPUS
+	    (soundFileInfo.format & SF_FORMAT_SUBMASK) != SF_FORMAT_OPUS &&
+#endif
 	    (soundFileInfo.format & SF_FORMAT_SUBMASK) != SF_FORMAT_VORBIS) {
 		
 		sf_command(ri->soundFile, SFC_SET_CLIPPING, NULL, SF_TRUE);
@@ -289,6 +374,64 @@ bool VoiceRecorder::ensureFileIsOpenedFor(SF_INFO& soundFileInfo, boost::shared_
 	return true;
 }
 
+void VoiceRecorder::writeBuffer(SF_INFO &soundFileInfo, RecordInfo *ri, const RecordBuffer *rb) {
+	// Create the file for this RecordInfo instance if it's not yet open.
+	// Without it, there is no point in writing the other files either.
+	if (!ensureFileIsOpenedFor(soundFileInfo, ri)) {
+		m_abort = true;
+		m_sleepCondition.wakeAll();
+		return;
+	}
+
+	const qint64 missingSamples = rb->uiStart - ri->lastWrittenAbsoluteSample;
+
+	// Nobody talked in between. Fill the gap in as few writes as
+	// possible; the compressed formats store it in next to nothing.
+	const qint64 heuristicSilenceThreshold = m_config.sampleRate / 10; // 100ms
+	if (missingSamples > heuristicSilenceThreshold) {
+		qint64 rest = missingSamples;
+		for (; rest > m_config.sampleRate && !m_abort; rest -= m_config.sampleRate)
+			sf_write_float(ri->soundFile, m_silence, m_config.sampleRate);
+
+		if (rest > 0)
+			sf_write_float(ri->soundFile, m_silence, rest);
+
+		ri->lastWrittenAbsoluteSample += missingSamples;
+	}
+
+	// Write the audio buffer and update the timestamp in |ri|.
+	sf_write_float(ri->soundFile, rb->pfSamples, rb->iSamples);
+	ri->lastWrittenAbsoluteSample += rb->iSamples;
+
+	const int lag = static_cast<int>(qMin(m_timestamp->elapsed() - rb->uiQueued, static_cast<quint64>(INT_MAX)));
+	m_writeLag.fetchAndStoreRelaxed(lag);
+	int maxLag = m_maxWriteLag.fetchAndAddRelaxed(0);
+	while (lag > maxLag && !m_maxWriteLag.testAndSetRelaxed(maxLag, lag))
+		maxLag = m_maxWriteLag.fetchAndAddRelaxed(0);
+}
+
+void VoiceRecorder::dispatchBuffers() {
+	QList<RecordBuffer *> done;
+	foreach(RecordWriter *rw, m_writers)
+		rw->takeDone(done);
+	foreach(RecordBuffer *rb, done)
+		m_pool->recycle(rb);
+
+	RecordBuffer *rb;
+	while ((rb = m_pool->take())) {
+		// Create a new RecordInfo object if this is a new user.
+		boost::shared_ptr<RecordInfo> ri = m_recordInfo.value(rb->iIndex);
+		if (!ri) {
+			ri = boost::make_shared<RecordInfo>(userNameForIndex(rb->iIndex));
+			m_recordInfo.insert(rb->iIndex, ri);
+		}
+
+		// A user's buffers always go to the same writer, so that they
+		// are written in order.
+		m_writers.at(rb->iIndex % m_writers.count())->queue(ri.get(), rb);
+	}
+}
+
 void VoiceRecorder::run() {
 	Q_ASSERT(!m_recording);
 	
@@ -296,80 +439,48 @@ void VoiceRecorder::run() {
 		return;
 
 	SF_INFO soundFileInfo = createSoundFileInfo();
+
+	// Leave a core for the audio thread. Mixed down, there is only
+	// one file to write.
+	const int writers = m_config.mixDownMode ? 1 : qBound(1, QThread::idealThreadCount() - 1, 4);
+	for (int i = 0; i < writers; ++i) {
+		RecordWriter *rw = new RecordWriter(this, soundFileInfo);
+		rw->start();
+		m_writers << rw;
+	}
 	
 	m_recording = true;
 	emit recording_started();
 	
 	forever {
-		// Sleep until there is new data for us to process.
+		// The audio thread doesn't wake us, as that would take a lock,
+		// so look for new buffers every 20ms.
 		m_sleepLock.lock();
-		m_sleepCondition.wait(&m_sleepLock);
+		if (m_recording && !m_abort)
+			m_sleepCondition.wait(&m_sleepLock, 20);
+		m_sleepLock.unlock();
 
-		if (!m_recording || m_abort || (g.sh && g.sh->uiVersion < 0201003)) {
-			m_sleepLock.unlock();
+		if (!m_recording || m_abort || (g.sh && g.sh->uiVersion < 0201003))
 			break;
-		}
-
-		while (!m_abort && !m_recordBuffer.isEmpty()) {
-			boost::shared_ptr<RecordBuffer> rb;
-			{
-				QMutexLocker l(&m_bufferLock);
-				rb = m_recordBuffer.takeFirst();
-			}
-			
-			// Create the file for this RecordInfo instance if it's not yet open.
-			
-			Q_ASSERT(m_recordInfo.contains(rb->recordInfoIndex));
-			boost::shared_ptr<RecordInfo> ri = m_recordInfo.value(rb->recordInfoIndex);
-			
-			if (!ensureFileIsOpenedFor(soundFileInfo, ri)) {
-				return;
-			}
-
-			const qint64 missingSamples = rb->absoluteStartSample - ri->lastWrittenAbsoluteSample;
-			
-			static const qint64 heuristicSilenceThreshold = m_config.sampleRate / 10; // 100ms
-			if (missingSamples > heuristicSilenceThreshold) {
-				static const qint64 maxSamplesPerIteration = m_config.sampleRate * 1; // 1s
-				
-				const bool requeue = missingSamples > maxSamplesPerIteration;
-				
-				// Write |missingSamples| samples of silence up to |maxSamplesPerIteration|
-				const float buffer[1024] = {};
-				
-				const qint64 silenceToWrite = std::min(missingSamples, maxSamplesPerIteration);
-				qint64 rest = silenceToWrite;
-				
-				for (; rest > 1024; rest -= 1024)
-					sf_write_float(ri->soundFile, buffer, 1024);
-
-				if (rest > 0)
-					sf_write_float(ri->soundFile, buffer, rest);
-				
-				ri->lastWrittenAbsoluteSample += silenceToWrite;
-				
-				if (requeue) {
-					// Requeue the writing for this buffer to keep thread responsive
-					QMutexLocker l(&m_bufferLock);
-					m_recordBuffer.prepend(rb);
-					continue;
-				}
-			}
-
-			// Write the audio buffer and update the timestamp in |ri|.
-			sf_write_float(ri->soundFile, rb->buffer.get(), rb->samples);
-			ri->lastWrittenAbsoluteSample += rb->samples;
-		}
 
-		m_sleepLock.unlock();
+		dispatchBuffers();
 	}
-	
+
+	// Write what is left, unless told not to.
 	m_recording = false;
-	{
-		QMutexLocker l(&m_bufferLock);
-		m_recordInfo.clear();
-		m_recordBuffer.clear();
+	dispatchBuffers();
+	foreach(RecordWriter *rw, m_writers) {
+		rw->finish();
+		rw->wait();
+		delete rw;
 	}
+	m_writers.clear();
+
+	// Anything queued since is lost.
+	RecordBuffer *rb;
+	while ((rb = m_pool->take()))
+		m_pool->recycle(rb);
+	m_recordInfo.clear();
 	
 	emit recording_stopped();
 	qWarning() << "VoiceRecorder: recording stopped";
@@ -390,42 +501,55 @@ void VoiceRecorder::prepareBufferAdds() {
 }
 
 void VoiceRecorder::addBuffer(const ClientUser *clientUser,
-                              boost::shared_array<float> buffer,
-                              int samples) {
+                              const float *buffer,
+                              int samples,
+                              float volume) {
 	
 	Q_ASSERT(!m_config.mixDownMode || clientUser == NULL);
 
 	if (!m_recording)
 		return;
 	
-	// Create a new RecordInfo object if this is a new user.
 	const int index = indexForUser(clientUser);
-	
-	if (!m_recordInfo.contains(index)) {
-		boost::shared_ptr<RecordInfo> ri = boost::make_shared<RecordInfo>(
-		            m_config.mixDownMode ? QLatin1String("Mixdown")
-		                                 : clientUser->qsName);
-		
-		m_recordInfo.insert(index, ri);
-	}
+	const quint64 now = m_timestamp->elapsed();
+
+	// Buffers longer than the pool's are split up.
+	for (int offset = 0; offset < samples; ) {
+		RecordBuffer *rb = m_pool->reserve();
+		if (!rb) {
+			m_droppedBuffers.fetchAndAddRelaxed(1);
+			return;
+		}
 
-	{
-		// Save the buffer in |qlRecordBuffer|.
-		QMutexLocker l(&m_bufferLock);
-		boost::shared_ptr<RecordBuffer> rb = boost::make_shared<RecordBuffer>(
-		            index, buffer, samples, m_absoluteSampleEstimation);
-		
-		m_recordBuffer << rb;
-	}
+		const unsigned int n = qMin(static_cast<unsigned int>(samples - offset), m_pool->bufferSamples());
+		rb->iIndex = index;
+		rb->uiStart = m_absoluteSampleEstimation + offset;
+		rb->uiQueued = now;
+		rb->iSamples = n;
+		memset(rb->pfSamples, 0, sizeof(float) * n);
+		AudioMix::add(rb->pfSamples, buffer + offset, n, volume);
+		m_pool->commit();
 
-	// Tell the main loop that we have new audio data.
-	m_sleepCondition.wakeAll();
+		offset += static_cast<int>(n);
+	}
 }
 
 quint64 VoiceRecorder::getElapsedTime() const {
 	return m_timestamp->elapsed();
 }
 
+quint64 VoiceRecorder::getWriteLag() const {
+	return static_cast<quint64>(m_writeLag.fetchAndAddRelaxed(0));
+}
+
+quint64 VoiceRecorder::getMaxWriteLag() const {
+	return static_cast<quint64>(m_maxWriteLag.fetchAndAddRelaxed(0));
+}
+
+unsigned int VoiceRecorder::getDroppedBuffers() const {
+	return static_cast<unsigned int>(m_droppedBuffers.fetchAndAddRelaxed(0));
+}
+
 RecordUser &VoiceRecorder::getRecordUser() const {
 	return *m_recordUser;
 }
@@ -446,6 +570,10 @@ QString VoiceRecorderFormat::getFormatDescription(VoiceRecorderFormat::Format fm
 			return VoiceRecorder::tr(".au - Uncompressed");
 		case VoiceRecorderFormat::FLAC:
 			return VoiceRecorder::tr(".flac - Lossless compressed");
+#ifdef USE_SNDFILE_OPUS
+		case VoiceRecorderFormat::OPUS:
+			return VoiceRecorder::tr(".opus - Compressed");
+#endif
 		default:
 			return QString();
 	}
@@ -463,6 +591,10 @@ QString VoiceRecorderFormat::getFormatDefaultExtension(VoiceRecorderFormat::Form
 			return QLatin1String("au");
 		case VoiceRecorderFormat::FLAC:
 			return QLatin1String("flac");
+#ifdef USE_SNDFILE_OPUS
+		case VoiceRecorderFormat::OPUS:
+			return QLatin1String("opus");
+#endif
 		default:
 			return QString();
 	}
@@ -8,10 +8,11 @@
 
 #ifndef Q_MOC_RUN
 # include <boost/scoped_ptr.hpp>
-# include <boost/shared_array.hpp>
+# include <boost/shared_ptr.hpp>
 #endif
 
 #include <sndfile.h>
+#include <QtCore/QAtomicInt>
 #include <QtCore/QDateTime>
 #include <QtCore/QHash>
 #include <QtCore/QMutex>
@@ -20,8 +21,11 @@
 #include <QtCore/QWaitCondition>
 
 class ClientUser;
+class RecordBufferPool;
 class RecordUser;
+class RecordWriter;
 class Timer;
+struct RecordBuffer;
 
 /// Utilities and enums for voice recorder format handling
 namespace VoiceRecorderFormat {
@@ -40,6 +44,10 @@ namespace VoiceRecorderFormat {
 		AU,
 		/// FLAC Format
 		FLAC,
+#ifdef USE_SNDFILE_OPUS
+		/// Ogg Opus Format
+		OPUS,
+#endif
 		kEnd
 	};
 
@@ -57,8 +65,14 @@ namespace VoiceRecorderFormat {
 /// which is then encoded using one of the formats of VoiceRecordingFormat::Format
 /// and written to disk.
 ///
+/// addBuffer is called by the audio thread, so it neither locks nor
+/// allocates: it copies the audio into preallocated buffers, which the
+/// recorder thread collects and spreads over a few writer threads.
+/// Each user's file is encoded and written by one of the writers.
+///
 class VoiceRecorder : public QThread {
 		Q_OBJECT
+		friend class RecordWriter;
 	public:
 		/// Possible error conditions inside the recorder
 		enum Error { Unspecified, CreateDirectoryFailed, CreateFileFailed, InvalidSampleRate };
@@ -92,15 +106,27 @@ class VoiceRecorder : public QThread {
 		/// Remembers the current time for a set of coming addBuffer calls
 		void prepareBufferAdds();
 		
-		/// Adds an audio buffer which contains |samples| audio samples to the recorder.
+		/// Adds |samples| audio samples, multiplied by |volume|, to the recorder.
 		/// The audio data will be assumed to be recorded at the time
 		/// prepareBufferAdds was last called.
+		/// If the writers fall too far behind, the audio is dropped.
 		/// @param clientUser User for which to add the audio data. NULL in mixdown mode.
-		void addBuffer(const ClientUser *clientUser, boost::shared_array<float> buffer, int samples);
+		void addBuffer(const ClientUser *clientUser, const float *buffer, int samples, float volume);
 		
 		/// Returns the elapsed time since the recording started.
 		quint64 getElapsedTime() const;
 
+		/// Returns how long, in microseconds, the last buffer that was
+		/// written had been queued.
+		quint64 getWriteLag() const;
+
+		/// Returns the longest time a buffer has been queued.
+		quint64 getMaxWriteLag() const;
+
+		/// Returns the number of buffers that were dropped because the
+		/// writers fell behind.
+		unsigned int getDroppedBuffers() const;
+
 		/// Returns a refence to the record user which is used to record local audio.
 		RecordUser &getRecordUser() const;
 
@@ -117,26 +143,9 @@ signals:
 		
 	private:
 		
-		/// Stores information about a recording buffer.
-		struct RecordBuffer {
-			/// Constructs a new RecordBuffer object.
-			RecordBuffer(int recordInfoIndex_,
-			             boost::shared_array<float> buffer_,
-			             int samples_,
-			             quint64 absoluteStartSample_);
-
-			/// Hashmap index for the user
-			const int recordInfoIndex;
-
-			/// The buffer.
-			boost::shared_array<float> buffer;
-
-			/// The number of samples in the buffer.
-			int samples;
-
-			/// Absolute sample number at the start of this buffer
-			quint64 absoluteStartSample;
-		};
+		/// Number of buffers in the pool. With 20ms buffers, it lasts
+		/// for well over a second with 30 users talking at once.
+		static const int iPoolBuffers = 2048;
 
 		/// Stores the recording state for one user.
 		struct RecordInfo {
@@ -163,33 +172,58 @@ signals:
 
 		/// Returns the RecordInfo hashmap index for the given user
 		int indexForUser(const ClientUser *clientUser) const;
+
+		/// Returns the name of the user with the given index, for their file name.
+		QString userNameForIndex(int index) const;
 		
 		/// Create a sndfile SF_INFO structure describing the currently configured recording format
 		SF_INFO createSoundFileInfo() const;
 		
 		/// Opens the file for the given recording information
-		/// Helper function for run method. Will abort recording on failure.
-		bool ensureFileIsOpenedFor(SF_INFO &soundFileInfo, boost::shared_ptr<RecordInfo> &ri);
-		
+		/// Helper function for writeBuffer method. Will abort recording on failure.
+		bool ensureFileIsOpenedFor(SF_INFO &soundFileInfo, RecordInfo *ri);
+
+		/// Writes the silence before |rb| and then |rb| to the file of |ri|.
+		/// Called by the writer threads.
+		void writeBuffer(SF_INFO &soundFileInfo, RecordInfo *ri, const RecordBuffer *rb);
+
+		/// Hands the queued buffers to the writers, and recycles the
+		/// buffers they are done with.
+		void dispatchBuffers();
+
 		/// Hash which maps the |uiSession| of all users for which we have to keep a recording state to the corresponding RecordInfo object.
+		/// Only used by the recorder thread.
 		RecordInfoMap m_recordInfo;
 
-		/// List containing all unprocessed RecordBuffer objects.
-		QList< boost::shared_ptr<RecordBuffer> > m_recordBuffer;
-
 		/// The user which is used to record local audio.
 		boost::scoped_ptr<RecordUser> m_recordUser;
 
 		/// High precision timer for buffer timestamps.
 		boost::scoped_ptr<Timer> m_timestamp;
 
-		/// Protects the buffer list |qlRecordBuffer|.
-		QMutex m_bufferLock;
+		/// Buffers between the audio thread and the recorder thread.
+		boost::scoped_ptr<RecordBufferPool> m_pool;
 
-		/// Wait condition and mutex to block until there is new data.
+		/// Threads that encode and write the files.
+		QList<RecordWriter *> m_writers;
+
+		/// A second of silence.
+		float *m_silence;
+
+		/// Write lag statistics, in microseconds.
+		mutable QAtomicInt m_writeLag;
+		mutable QAtomicInt m_maxWriteLag;
+
+		/// Buffers dropped because the pool was empty.
+		mutable QAtomicInt m_droppedBuffers;
+
+		/// Wait condition and mutex to sleep between looking for new buffers.
 		QMutex m_sleepLock;
 		QWaitCondition m_sleepCondition;
 
+		/// Keeps writers from picking the same file name.
+		QMutex m_fileLock;
+
 		/// Configuration for this instance
 		const Config m_config;
 
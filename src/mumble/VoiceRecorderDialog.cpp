@@ -228,6 +228,10 @@ void VoiceRecorderDialog::on_qtTimer_timeout() {
 
 	const QTime elapsedTime = QTime(0,0).addMSecs(static_cast<int>(recorder->getElapsedTime() / 1000));
 	qlTime->setText(elapsedTime.toString());
+	qlTime->setToolTip(tr("Write lag: %1 ms (max %2 ms)\nDropped buffers: %3")
+	                   .arg(recorder->getWriteLag() / 1000)
+	                   .arg(recorder->getMaxWriteLag() / 1000)
+	                   .arg(recorder->getDroppedBuffers()));
 }
 
 void VoiceRecorderDialog::on_qpbTargetDirectoryBrowse_clicked() {
@@ -267,6 +271,7 @@ void VoiceRecorderDialog::onRecorderStopped() {
 
 void VoiceRecorderDialog::onRecorderStarted() {
 	qlTime->setText(QLatin1String("00:00:00"));
+	qlTime->setToolTip(QString());
 	qtTimer->start();
 }
 
@@ -0,0 +1,157 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "mumble_pch.hpp"
+
+#include "VoiceSocket.h"
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+
+// Whether from has the address and port of remote. Both are of the
+// socket's family, which is that of remote.
+static inline bool sameSockaddr(const struct sockaddr_storage &from, const struct sockaddr_storage &remote) {
+	if (from.ss_family != remote.ss_family)
+		return false;
+	if (from.ss_family == AF_INET6) {
+		const struct sockaddr_in6 *a = reinterpret_cast<const struct sockaddr_in6 *>(&from);
+		const struct sockaddr_in6 *b = reinterpret_cast<const struct sockaddr_in6 *>(&remote);
+		return (a->sin6_port == b->sin6_port) && (memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(a->sin6_addr)) == 0);
+	}
+	const struct sockaddr_in *a = reinterpret_cast<const struct sockaddr_in *>(&from);
+	const struct sockaddr_in *b = reinterpret_cast<const struct sockaddr_in *>(&remote);
+	return (a->sin_port == b->sin_port) && (a->sin_addr.s_addr == b->sin_addr.s_addr);
+}
+
+VoiceSocket::VoiceSocket(const QHostAddress &remote, unsigned short port, QObject *p) : QObject(p), haRemote(remote), usRemotePort(port), qsnRead(NULL) {
+	memset(uiSizes, 0, sizeof(uiSizes));
+
+	haRemote.toSockaddr(&ssRemote);
+	if (ssRemote.ss_family == AF_INET6) {
+		reinterpret_cast<struct sockaddr_in6 *>(&ssRemote)->sin6_port = htons(port);
+		slRemote = sizeof(struct sockaddr_in6);
+	} else {
+		reinterpret_cast<struct sockaddr_in *>(&ssRemote)->sin_port = htons(port);
+		slRemote = sizeof(struct sockaddr_in);
+	}
+
+	iSocket = ::socket(ssRemote.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+	if (iSocket < 0) {
+		qWarning("VoiceSocket: Failed to create socket: %s", strerror(errno));
+		return;
+	}
+
+	// Any address and port, like QUdpSocket::bind().
+	struct sockaddr_storage local;
+	memset(&local, 0, sizeof(local));
+	local.ss_family = ssRemote.ss_family;
+	if (::bind(iSocket, reinterpret_cast<struct sockaddr *>(&local), slRemote) != 0)
+		qWarning("VoiceSocket: Failed to bind socket: %s", strerror(errno));
+
+	// The headers point at the buffers for good; receive() only
+	// resets what recvmmsg() changes.
+	memset(mmsgHeaders, 0, sizeof(mmsgHeaders));
+	for (int i = 0; i < iBatch; ++i) {
+		iovBuffers[i].iov_base = cBuffers[i];
+		iovBuffers[i].iov_len = iMaxSize;
+		mmsgHeaders[i].msg_hdr.msg_iov = &iovBuffers[i];
+		mmsgHeaders[i].msg_hdr.msg_iovlen = 1;
+		mmsgHeaders[i].msg_hdr.msg_name = &ssFrom[i];
+	}
+
+	qsnRead = new QSocketNotifier(iSocket, QSocketNotifier::Read, this);
+	connect(qsnRead, SIGNAL(activated(int)), this, SIGNAL(readyRead()));
+}
+
+VoiceSocket::~VoiceSocket() {
+	delete qsnRead;
+	if (iSocket >= 0)
+		::close(iSocket);
+}
+
+quintptr VoiceSocket::socketDescriptor() const {
+	return static_cast<quintptr>(iSocket);
+}
+
+void VoiceSocket::send(const char *data, unsigned int len) {
+	if (iSocket >= 0)
+		::sendto(iSocket, data, len, 0, reinterpret_cast<const struct sockaddr *>(&ssRemote), slRemote);
+}
+
+int VoiceSocket::receive() {
+	if (iSocket < 0)
+		return 0;
+
+	for (int i = 0; i < iBatch; ++i)
+		mmsgHeaders[i].msg_hdr.msg_namelen = sizeof(ssFrom[i]);
+
+	int count;
+	do {
+		count = ::recvmmsg(iSocket, mmsgHeaders, iBatch, MSG_DONTWAIT, NULL);
+	} while ((count < 0) && (errno == EINTR));
+	if (count <= 0)
+		return 0;
+
+	for (int i = 0; i < count; ++i) {
+		const struct msghdr &msg = mmsgHeaders[i].msg_hdr;
+
+		if ((msg.msg_flags & MSG_TRUNC) || ! sameSockaddr(ssFrom[i], ssRemote))
+			uiSizes[i] = 0;
+		else
+			uiSizes[i] = mmsgHeaders[i].msg_len;
+	}
+	return count;
+}
+
+#else
+
+VoiceSocket::VoiceSocket(const QHostAddress &remote, unsigned short port, QObject *p) : QObject(p), haRemote(remote), usRemotePort(port), qhaRemote(remote) {
+	memset(uiSizes, 0, sizeof(uiSizes));
+
+	qusSocket = new QUdpSocket(this);
+	if (remote.protocol() == QAbstractSocket::IPv6Protocol)
+		qusSocket->bind(QHostAddress(QHostAddress::AnyIPv6), 0);
+	else
+		qusSocket->bind(QHostAddress(QHostAddress::Any), 0);
+
+	connect(qusSocket, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+}
+
+VoiceSocket::~VoiceSocket() {
+	delete qusSocket;
+}
+
+quintptr VoiceSocket::socketDescriptor() const {
+	return static_cast<quintptr>(qusSocket->socketDescriptor());
+}
+
+void VoiceSocket::send(const char *data, unsigned int len) {
+	qusSocket->writeDatagram(data, len, qhaRemote, usRemotePort);
+}
+
+int VoiceSocket::receive() {
+	int count = 0;
+	while ((count < iBatch) && qusSocket->hasPendingDatagrams()) {
+		const qint64 pending = qusSocket->pendingDatagramSize();
+		QHostAddress senderAddr;
+		quint16 senderPort;
+		const qint64 len = qusSocket->readDatagram(cBuffers[count], iMaxSize, &senderAddr, &senderPort);
+		if (len < 0)
+			break;
+
+		if ((pending > static_cast<qint64>(iMaxSize)) || (senderPort != usRemotePort) || !(HostAddress(senderAddr) == haRemote))
+			uiSizes[count] = 0;
+		else
+			uiSizes[count] = static_cast<unsigned int>(len);
+		++count;
+	}
+	return count;
+}
+
+#endif
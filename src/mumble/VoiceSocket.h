@@ -0,0 +1,87 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MUMBLE_VOICESOCKET_H_
+#define MUMBLE_MUMBLE_VOICESOCKET_H_
+
+#include <QtCore/QObject>
+#include <QtNetwork/QHostAddress>
+
+#include "Net.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#endif
+
+class QSocketNotifier;
+class QUdpSocket;
+
+/// VoiceSocket is the client's UDP socket to the server.
+///
+/// It reads datagrams in batches into buffers it owns, so that they
+/// can be decrypted and parsed where they are, and drops those that
+/// don't come from the server. On Linux it is a native socket, which
+/// reads a whole batch with one recvmmsg() call and compares the
+/// sender in binary form. Elsewhere it wraps a QUdpSocket.
+class VoiceSocket : public QObject {
+	private:
+		Q_OBJECT
+		Q_DISABLE_COPY(VoiceSocket)
+	public:
+		/// Largest datagram that is read; longer ones are dropped.
+		static const unsigned int iMaxSize = 2048;
+		/// Most datagrams read by one call to receive().
+		static const int iBatch = 32;
+	protected:
+		char cBuffers[iBatch][iMaxSize];
+		unsigned int uiSizes[iBatch];
+
+		HostAddress haRemote;
+		unsigned short usRemotePort;
+
+#ifdef Q_OS_LINUX
+		int iSocket;
+		QSocketNotifier *qsnRead;
+		/// The server's address and port, which datagrams are
+		/// sent to and compared with in binary form.
+		struct sockaddr_storage ssRemote;
+		socklen_t slRemote;
+		struct sockaddr_storage ssFrom[iBatch];
+		struct iovec iovBuffers[iBatch];
+		struct mmsghdr mmsgHeaders[iBatch];
+#else
+		QHostAddress qhaRemote;
+		QUdpSocket *qusSocket;
+#endif
+	public:
+		/// Opens a socket on an ephemeral port, for talking to port
+		/// of remote.
+		VoiceSocket(const QHostAddress &remote, unsigned short port, QObject *parent = NULL);
+		~VoiceSocket() Q_DECL_OVERRIDE;
+
+		/// The native socket, for setting options, or -1.
+		quintptr socketDescriptor() const;
+
+		/// Sends a datagram to the server.
+		void send(const char *data, unsigned int len);
+
+		/// Reads up to iBatch datagrams, and returns how many. Ones
+		/// that didn't come from the server, or didn't fit, have size
+		/// 0. If iBatch were read, more may be waiting. The datagrams
+		/// stay valid, and may be changed in place, until the next
+		/// call.
+		int receive();
+		char *data(int i) {
+			return cBuffers[i];
+		}
+		unsigned int size(int i) const {
+			return uiSizes[i];
+		}
+	signals:
+		/// Datagrams are waiting to be received.
+		void readyRead();
+};
+
+#endif
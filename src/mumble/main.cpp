@@ -16,6 +16,7 @@
 #include "Log.h"
 #include "Plugins.h"
 #include "Global.h"
+#include "LatencyProbe.h"
 #include "LCD.h"
 #ifdef USE_BONJOUR
 #include "BonjourClient.h"
@@ -111,6 +112,7 @@ int main(int argc, char **argv) {
 	bool suppressIdentity = false;
 	bool bRpcMode = false;
 	QString rpcCommand;
+	QString latencyTest;
 	QUrl url;
 	if (a.arguments().count() > 1) {
 		QStringList args = a.arguments();
@@ -136,6 +138,11 @@ int main(int argc, char **argv) {
 					"                Allow multiple instances of the client to be started.\n"
 					"  -n, --noidentity\n"
 					"                Suppress loading of identity files (i.e., certificates.)\n"
+					"  --latency-test <file>\n"
+					"                Measure the mouth-to-ear latency of the audio path on\n"
+					"                silent audio devices, write the results to <file> (or\n"
+					"                standard output for -) and exit. Settings are not saved.\n"
+					"                Add -platform offscreen to run without a display.\n"
 					"\n"
 				);
 				QString rpcHelpBanner = MainWindow::tr(
@@ -176,6 +183,14 @@ int main(int argc, char **argv) {
 			} else if (args.at(i) == QLatin1String("-n") || args.at(i) == QLatin1String("--noidentity")) {
 				suppressIdentity = true;
 				g.s.bSuppressIdentity = true;
+			} else if (args.at(i) == QLatin1String("--latency-test")) {
+				if (args.count() - 1 > i) {
+					latencyTest = args.at(++i);
+					bAllowMultiple = true;
+				} else {
+					printf("%s\n", qPrintable(MainWindow::tr("Error: No file for the latency test specified")));
+					return 1;
+				}
 			} else if (args.at(i) == QLatin1String("rpc")) {
 				bRpcMode = true;
 				if (args.count() - 1 > i) {
@@ -293,6 +308,18 @@ int main(int argc, char **argv) {
 	// Load preferences
 	g.s.load();
 
+	if (! latencyTest.isEmpty()) {
+		// Send our own voice through the local loopback, from and to
+		// the null backends, without a server or its jitter.
+		g.s.qsAudioInput = g.s.qsAudioOutput = QLatin1String("Null");
+		g.s.lmLoopMode = Settings::Local;
+		g.s.atTransmit = Settings::Continuous;
+		g.s.dPacketLoss = 0.0f;
+		g.s.dMaxPacketDelay = 0.0f;
+		g.s.bMute = g.s.bDeaf = false;
+		LatencyProbe::lpProbe = new LatencyProbe(40);
+	}
+
 	// Check whether we need to enable accessibility features
 #ifdef Q_OS_WIN
 	// Only windows for now. Could not find any information on how to query this for osx or linux
@@ -426,7 +453,7 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	if (runaudiowizard) {
+	if (runaudiowizard && ! LatencyProbe::lpProbe) {
 		AudioWizard *aw = new AudioWizard(g.mw);
 		aw->exec();
 		delete aw;
@@ -434,7 +461,7 @@ int main(int argc, char **argv) {
 
 	g.s.uiUpdateCounter = 2;
 
-	if (! CertWizard::validateCert(g.s.kpCertificate)) {
+	if (! LatencyProbe::lpProbe && ! CertWizard::validateCert(g.s.kpCertificate)) {
 #if QT_VERSION >= 0x050000
 		QDir qd(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
 #else
@@ -463,22 +490,24 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	if (QDateTime::currentDateTime().daysTo(g.s.kpCertificate.first.first().expiryDate()) < 14)
+	if (! LatencyProbe::lpProbe && QDateTime::currentDateTime().daysTo(g.s.kpCertificate.first.first().expiryDate()) < 14)
 		g.l->log(Log::Warning, CertWizard::tr("<b>Certificate Expiry:</b> Your certificate is about to expire. You need to renew it, or you will no longer be able to connect to servers you are registered on."));
 
+	if (! LatencyProbe::lpProbe) {
 #ifdef QT_NO_DEBUG
 #ifndef SNAPSHOT_BUILD
-	if (g.s.bUpdateCheck)
+		if (g.s.bUpdateCheck)
 #endif
-		new VersionCheck(true, g.mw);
+			new VersionCheck(true, g.mw);
 #ifdef SNAPSHOT_BUILD
-	new VersionCheck(false, g.mw, true);
+		new VersionCheck(false, g.mw, true);
 #endif
 #else
-	g.mw->msgBox(MainWindow::tr("Skipping version check in debug mode."));
+		g.mw->msgBox(MainWindow::tr("Skipping version check in debug mode."));
 #endif
-	if (g.s.bPluginCheck) {
-		g.p->checkUpdates();
+		if (g.s.bPluginCheck) {
+			g.p->checkUpdates();
+		}
 	}
 
 	if (url.isValid()) {
@@ -489,14 +518,33 @@ int main(int argc, char **argv) {
 		OpenURLEvent *oue = new OpenURLEvent(a.quLaunchURL);
 		qApp->postEvent(g.mw, oue);
 #endif
-	} else {
+	} else if (! LatencyProbe::lpProbe) {
 		g.mw->on_qaServerConnect_triggered(true);
 	}
 
 	if (! g.bQuit)
 		res=a.exec();
 
-	g.s.save();
+	if (LatencyProbe::lpProbe) {
+		// Stop the audio first, so that the results don't change
+		// while they are written. The settings were only changed
+		// for the test, so they aren't saved.
+		Audio::stop();
+
+		const QString report = LatencyProbe::lpProbe->report();
+		QFile qf(latencyTest);
+		if ((latencyTest == QLatin1String("-")) ? qf.open(stdout, QIODevice::WriteOnly) : qf.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			qf.write(report.toUtf8());
+			qf.close();
+		} else {
+			qWarning("Failed to write the latency test results to %s", qPrintable(latencyTest));
+			res = 1;
+		}
+		if (! LatencyProbe::lpProbe->finished())
+			res = 1;
+	} else {
+		g.s.save();
+	}
 
 	url.clear();
 	
@@ -508,6 +556,9 @@ int main(int argc, char **argv) {
 
 	Audio::stop();
 
+	delete LatencyProbe::lpProbe;
+	LatencyProbe::lpProbe = NULL;
+
 	if (sh)
 		sh->disconnect();
 
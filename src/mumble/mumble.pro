@@ -100,14 +100,21 @@ HEADERS *= BanEditor.h \
     AudioConfigDialog.h \
     AudioStats.h \
     AudioInput.h \
+    AudioMix.h \
     AudioOutput.h \
     AudioOutputSample.h \
     AudioOutputSpeech.h \
+    PlayoutBuffer.h \
+    TimeStretch.h \
+    Resampler.h \
+    LatencyProbe.h \
+    NullAudio.h \
     AudioOutputUser.h \
     CELTCodec.h \
     CustomElements.h \
     MainWindow.h \
     ServerHandler.h \
+    VoiceSocket.h \
     About.h \
     ConnectDialog.h \
     GlobalShortcut.h \
@@ -120,6 +127,7 @@ HEADERS *= BanEditor.h \
     Audio.h \
     ConfigDialog.h \
     Plugins.h \
+    PositionBuffer.h \
     PTTButtonWidget.h \
     LookConfig.h \
     Overlay.h \
@@ -142,6 +150,9 @@ HEADERS *= BanEditor.h \
     UserInformation.h \
     SocketRPC.h \
     VoiceRecorder.h \
+    VoicePacketRing.h \
+    SampleRing.h \
+    RecordBufferPool.h \
     VoiceRecorderDialog.h \
     WebFetch.h \
     ../SignalCurry.h \
@@ -164,15 +175,22 @@ SOURCES *= BanEditor.cpp \
     AudioConfigDialog.cpp \
     AudioStats.cpp \
     AudioInput.cpp \
+    AudioMix.cpp \
     AudioOutput.cpp \
     AudioOutputSample.cpp \
     AudioOutputSpeech.cpp \
+    PlayoutBuffer.cpp \
+    TimeStretch.cpp \
+    Resampler.cpp \
+    LatencyProbe.cpp \
+    NullAudio.cpp \
     AudioOutputUser.cpp \
     main.cpp \
     CELTCodec.cpp \
     CustomElements.cpp \
     MainWindow.cpp \
     ServerHandler.cpp \
+    VoiceSocket.cpp \
     About.cpp \
     ConnectDialog.cpp \
     Settings.cpp \
@@ -183,6 +201,7 @@ SOURCES *= BanEditor.cpp \
     Audio.cpp \
     ConfigDialog.cpp \
     Plugins.cpp \
+    PositionBuffer.cpp \
     PTTButtonWidget.cpp \
     LookConfig.cpp \
     OverlayClient.cpp \
@@ -352,6 +371,14 @@ CONFIG(no-vorbis-recording) {
   DEFINES *= NO_VORBIS_RECORDING
 }
 
+# Ogg Opus recording needs libsndfile 1.0.29 or newer.
+unix:system(pkg-config --atleast-version=1.0.29 sndfile) {
+  DEFINES *= USE_SNDFILE_OPUS
+}
+CONFIG(sndfile-opus) {
+  DEFINES *= USE_SNDFILE_OPUS
+}
+
 unix:!CONFIG(bundled-opus):system(pkg-config --exists opus) {
   must_pkgconfig(opus)
   DEFINES *= USE_OPUS
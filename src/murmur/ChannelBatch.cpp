@@ -0,0 +1,398 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "murmur_pch.h"
+
+#include "ChannelBatch.h"
+
+#include "Channel.h"
+#include "ControlThread.h"
+#include "Group.h"
+#include "Message.h"
+#include "Server.h"
+#include "ServerDB.h"
+#include "ServerUser.h"
+
+// Returns the parent of a channel while the batch is being checked, or -1
+// for the root channel. A batch never moves channels, so only channels
+// added by the batch need special handling.
+static int batchParent(const Server *s, const ChannelBatch &batch, int id) {
+	if (ChannelBatch::isRef(id))
+		return batch.qlOps.at(ChannelBatch::refIndex(id)).iChannel;
+	const Channel *c = s->qhChannels.value(id);
+	return (c && c->cParent) ? c->cParent->iId : -1;
+}
+
+// Returns true if operation op may use channel id: the channel exists, or
+// is added by an earlier operation, and neither it nor one of its parents
+// has been removed by an earlier operation.
+static bool batchAlive(const Server *s, const ChannelBatch &batch, int op, const QSet<int> &removed, int id) {
+	if (ChannelBatch::isRef(id)) {
+		int index = ChannelBatch::refIndex(id);
+		if ((index >= op) || (batch.qlOps.at(index).type != ChannelBatch::Add))
+			return false;
+	} else if (! s->qhChannels.contains(id)) {
+		return false;
+	}
+
+	for (int i = id; i != -1; i = batchParent(s, batch, i))
+		if (removed.contains(i))
+			return false;
+	return true;
+}
+
+static int batchLevel(const Server *s, const ChannelBatch &batch, int id) {
+	int level = 0;
+	for (int i = batchParent(s, batch, id); i != -1; i = batchParent(s, batch, i))
+		++level;
+	return level;
+}
+
+// Appends the state of c to the messages of the batch broadcast. Clients
+// since 1.2.2 get the hash of a long description instead of the text, as in
+// Server::msgChannelState(). Older clients get desc, which is the full text
+// even when the description of c is loaded lazily.
+static void batchChannelState(QList<MumbleProto::ChannelState> &states, QList<unsigned int> &versions, MumbleProto::ChannelState &mpcs, const Channel *c, const QString &desc) {
+	if (mpcs.has_description() && ! c->qbaDescHash.isEmpty()) {
+		mpcs.set_description(u8(desc));
+		states << mpcs;
+		versions << ~ 0x010202;
+		mpcs.clear_description();
+		mpcs.set_description_hash(blob(c->qbaDescHash));
+		states << mpcs;
+		versions << 0x010202;
+	} else {
+		states << mpcs;
+		versions << 0;
+	}
+}
+
+ChannelBatch::Error Server::applyChannelBatch(const ChannelBatch &batch, QList<int> &added, QString &err) {
+	added.clear();
+
+	// Check the whole batch before anything is changed, so that it is
+	// either applied completely or not at all.
+	QSet<int> removed;
+	for (int i = 0; i < batch.qlOps.count(); ++i) {
+		const ChannelBatch::Op &op = batch.qlOps.at(i);
+
+		if (! batchAlive(this, batch, i, removed, op.iChannel)) {
+			err = QString::fromLatin1("operation %1: invalid channel").arg(i);
+			return ChannelBatch::InvalidChannel;
+		}
+
+		switch (op.type) {
+			case ChannelBatch::Add:
+				if (op.qsName.isEmpty()) {
+					err = QString::fromLatin1("operation %1: missing name").arg(i);
+					return ChannelBatch::InvalidOperation;
+				}
+				if (batchLevel(this, batch, op.iChannel) >= iChannelNestingLimit) {
+					err = QString::fromLatin1("operation %1: cannot nest channel in given parent").arg(i);
+					return ChannelBatch::NestingLimit;
+				}
+				break;
+			case ChannelBatch::Remove:
+				if (op.iChannel == 0) {
+					err = QString::fromLatin1("operation %1: cannot remove the root channel").arg(i);
+					return ChannelBatch::InvalidOperation;
+				}
+				removed.insert(op.iChannel);
+				break;
+			case ChannelBatch::Update:
+				if (! op.qsName.isNull() && op.qsName.isEmpty()) {
+					err = QString::fromLatin1("operation %1: empty name").arg(i);
+					return ChannelBatch::InvalidOperation;
+				}
+				break;
+			case ChannelBatch::Link:
+			case ChannelBatch::Unlink:
+				if ((op.iOther == op.iChannel) || ! batchAlive(this, batch, i, removed, op.iOther)) {
+					err = QString::fromLatin1("operation %1: invalid link").arg(i);
+					return ChannelBatch::InvalidChannel;
+				}
+				break;
+			case ChannelBatch::SetACL:
+				break;
+		}
+	}
+
+	// Users in removed channels move to the closest remaining parent they
+	// may enter, as in removeChannel(). This happens before the tree is
+	// changed, so the permissions from before the batch apply.
+	foreach(int id, removed) {
+		if (ChannelBatch::isRef(id))
+			continue;
+
+		Channel *chan = qhChannels.value(id);
+		Channel *dest = chan->cParent;
+		while (dest->cParent && removed.contains(dest->iId))
+			dest = dest->cParent;
+
+		QList<Channel *> subtree;
+		subtree << chan;
+		for (int i = 0; i < subtree.count(); ++i)
+			subtree << subtree.at(i)->qlChannels;
+
+		foreach(Channel *c, subtree) {
+			foreach(User *p, c->qlUsers) {
+				Channel *target = dest;
+				while (target->cParent && ! hasPermission(static_cast<ServerUser *>(p), target, ChanACL::Enter))
+					target = target->cParent;
+
+				MumbleProto::UserState mpus;
+				mpus.set_session(p->uiSession);
+				mpus.set_channel_id(target->iId);
+				userEnterChannel(p, target, mpus);
+				sendAll(mpus);
+				ListenerCall lc(this);
+				emit userStateChanged(p);
+			}
+		}
+	}
+
+	QHash<int, Channel *> qhAdded;
+	QList<Channel *> qlAdded;
+	QList<Channel *> qlRemoved;
+	QSet<Channel *> qsRemoved;
+	QSet<Channel *> qsChanged;
+	QSet<Channel *> qsLinks;
+	QSet<Channel *> qsACL;
+
+	struct LinkChange {
+		Channel *c;
+		Channel *l;
+		bool bAdd;
+	};
+	QList<LinkChange> qlLinkChanges;
+
+	{
+		// All database changes of the batch are made in one transaction.
+		TransactionHolder th;
+
+		{
+			QWriteLocker wl(&qrwlVoiceThread);
+
+			for (int i = 0; i < batch.qlOps.count(); ++i) {
+				const ChannelBatch::Op &op = batch.qlOps.at(i);
+				Channel *c = ChannelBatch::isRef(op.iChannel) ? qhAdded.value(ChannelBatch::refIndex(op.iChannel)) : qhChannels.value(op.iChannel);
+
+				switch (op.type) {
+					case ChannelBatch::Add: {
+							Channel *nc = addChannel(c, op.qsName, false, op.bPosition ? op.iPosition : 0);
+							if (! op.qsDesc.isNull())
+								hashAssign(nc->qsDesc, nc->qbaDescHash, op.qsDesc);
+							qhAdded.insert(i, nc);
+							qlAdded << nc;
+							added << nc->iId;
+						}
+						break;
+					case ChannelBatch::Remove: {
+							// Remove the subchannels before their parents.
+							QList<Channel *> subtree;
+							subtree << c;
+							for (int j = 0; j < subtree.count(); ++j)
+								subtree << subtree.at(j)->qlChannels;
+
+							for (int j = subtree.count() - 1; j >= 0; --j) {
+								Channel *r = subtree.at(j);
+								foreach(Channel *l, r->qsPermLinks)
+									qsLinks.insert(l);
+								r->unlink(NULL);
+
+								// Listeners of channelRemoved get the full
+								// description, as in removeChannel().
+								r->qsDesc = channelDescription(r);
+								removeChannelDB(r);
+								r->cParent->removeChannel(r);
+
+								qlRemoved << r;
+								qsRemoved.insert(r);
+							}
+						}
+						break;
+					case ChannelBatch::Update:
+						if (! op.qsName.isNull())
+							c->qsName = op.qsName;
+						if (! op.qsDesc.isNull())
+							hashAssign(c->qsDesc, c->qbaDescHash, op.qsDesc);
+						if (op.bPosition)
+							c->iPosition = op.iPosition;
+						qsChanged.insert(c);
+						break;
+					case ChannelBatch::Link:
+					case ChannelBatch::Unlink: {
+							Channel *l = ChannelBatch::isRef(op.iOther) ? qhAdded.value(ChannelBatch::refIndex(op.iOther)) : qhChannels.value(op.iOther);
+							LinkChange lc;
+							lc.c = c;
+							lc.l = l;
+							lc.bAdd = (op.type == ChannelBatch::Link);
+							if (lc.bAdd)
+								c->link(l);
+							else
+								c->unlink(l);
+							qlLinkChanges << lc;
+							qsLinks.insert(c);
+							qsLinks.insert(l);
+						}
+						break;
+					case ChannelBatch::SetACL: {
+							QHash<QString, QSet<int> > hOldTemp;
+							foreach(Group *g, c->qhGroups) {
+								hOldTemp.insert(g->qsName, g->qsTemporary);
+								delete g;
+							}
+							foreach(ChanACL *acl, c->qlACL)
+								delete acl;
+
+							c->qhGroups.clear();
+							c->qlACL.clear();
+
+							c->bInheritACL = op.bInheritACL;
+
+							foreach(const ChannelBatch::Group &bg, op.qlGroups) {
+								Group *g = new Group(c, bg.qsName);
+								g->bInherit = bg.bInherit;
+								g->bInheritable = bg.bInheritable;
+								g->qsAdd = bg.qsAdd;
+								g->qsRemove = bg.qsRemove;
+								g->qsTemporary = hOldTemp.value(bg.qsName);
+							}
+
+							foreach(const ChannelBatch::ACL &ba, op.qlACLs) {
+								ChanACL *acl = new ChanACL(c);
+								acl->bApplyHere = ba.bApplyHere;
+								acl->bApplySubs = ba.bApplySubs;
+								acl->iUserId = ba.iUserId;
+								acl->qsGroup = ba.qsGroup;
+								acl->pDeny = ba.pDeny & ChanACL::All;
+								acl->pAllow = ba.pAllow & ChanACL::All;
+							}
+							qsACL.insert(c);
+						}
+						break;
+				}
+			}
+		}
+
+		foreach(const LinkChange &lc, qlLinkChanges) {
+			if (qsRemoved.contains(lc.c) || qsRemoved.contains(lc.l))
+				continue;
+			if (lc.bAdd)
+				addLinkDB(lc.c, lc.l);
+			else
+				removeLinkDB(lc.c, lc.l);
+		}
+
+		QSet<Channel *> store = qsChanged;
+		store.unite(qsACL);
+		foreach(Channel *c, qlAdded)
+			store.insert(c);
+		store.subtract(qsRemoved);
+		foreach(Channel *c, store)
+			updateChannel(c);
+
+		foreach(Channel *c, qsACL)
+			if (! qsRemoved.contains(c))
+				markSnapshotACL(c);
+	}
+
+	clearACLCache();
+
+	// Tell the users about the final state of every channel the batch
+	// touched, in one pass over the users. New channels are sent first,
+	// parents before children, and links once all channels are known.
+	QSet<Channel *> qsNew = QSet<Channel *>::fromList(qlAdded);
+	QList<MumbleProto::ChannelState> states;
+
+	// A lazily loaded description is only read back from the database when
+	// a client too old for description hashes needs the text.
+	bool legacy = false;
+	foreach(ServerUser *u, qhUsers)
+		if ((u->sState == ServerUser::Authenticated) && (u->uiVersion < 0x010202))
+			legacy = true;
+
+	QList<unsigned int> versions;
+
+	foreach(Channel *c, qlAdded) {
+		if (qsRemoved.contains(c))
+			continue;
+		MumbleProto::ChannelState mpcs;
+		mpcs.set_channel_id(c->iId);
+		mpcs.set_parent(c->cParent->iId);
+		mpcs.set_name(u8(c->qsName));
+		mpcs.set_position(c->iPosition);
+		if (! c->qsDesc.isEmpty() || ! c->qbaDescHash.isEmpty())
+			mpcs.set_description(u8(c->qsDesc));
+		batchChannelState(states, versions, mpcs, c, legacy ? channelDescription(c) : c->qsDesc);
+	}
+
+	QSet<Channel *> qsUpdated = qsChanged;
+	qsUpdated.unite(qsLinks);
+	qsUpdated.subtract(qsRemoved);
+	foreach(Channel *c, qsUpdated) {
+		MumbleProto::ChannelState mpcs;
+		mpcs.set_channel_id(c->iId);
+		if (qsChanged.contains(c) && ! qsNew.contains(c)) {
+			mpcs.set_name(u8(c->qsName));
+			mpcs.set_position(c->iPosition);
+			mpcs.set_description(u8(c->qsDesc));
+		}
+		if (qsLinks.contains(c)) {
+			// An empty links list would not unlink anything.
+			if (c->qsPermLinks.isEmpty()) {
+				foreach(const LinkChange &lc, qlLinkChanges)
+					if (! lc.bAdd && ((lc.c == c) || (lc.l == c)))
+						mpcs.add_links_remove((lc.c == c) ? lc.l->iId : lc.c->iId);
+			} else {
+				foreach(const Channel *l, c->qsPermLinks)
+					mpcs.add_links(l->iId);
+			}
+		}
+		batchChannelState(states, versions, mpcs, c, legacy ? channelDescription(c) : c->qsDesc);
+	}
+
+	QList<MumbleProto::ChannelRemove> removes;
+	foreach(Channel *r, qlRemoved) {
+		if (qsNew.contains(r))
+			continue;
+		MumbleProto::ChannelRemove mpcr;
+		mpcr.set_channel_id(r->iId);
+		removes << mpcr;
+	}
+
+	QVector<QByteArray> stateCache(states.count());
+	QVector<QByteArray> removeCache(removes.count());
+	foreach(ServerUser *u, qhUsers) {
+		if (u->sState != ServerUser::Authenticated)
+			continue;
+		for (int i = 0; i < states.count(); ++i) {
+			unsigned int version = versions.at(i);
+			if ((version == 0) || (u->uiVersion >= version) || ((version & 0x80000000) && (u->uiVersion < (~version))))
+				u->sendMessage(states.at(i), MessageHandler::ChannelState, stateCache[i]);
+		}
+		for (int i = 0; i < removes.count(); ++i)
+			u->sendMessage(removes.at(i), MessageHandler::ChannelRemove, removeCache[i]);
+	}
+
+	{
+		ListenerCall lc(this);
+		foreach(Channel *c, qlAdded)
+			if (! qsRemoved.contains(c))
+				emit channelCreated(c);
+		foreach(Channel *c, qsUpdated)
+			if (! qsNew.contains(c))
+				emit channelStateChanged(c);
+		foreach(Channel *r, qlRemoved) {
+			if (! qsNew.contains(r))
+				emit channelRemoved(r);
+		}
+	}
+	foreach(Channel *r, qlRemoved)
+		delete r;
+
+	log(QString("Applied a batch of %1 channel operations").arg(batch.qlOps.count()));
+	return ChannelBatch::Ok;
+}
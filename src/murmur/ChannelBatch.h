@@ -0,0 +1,86 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CHANNELBATCH_H_
+#define MUMBLE_MURMUR_CHANNELBATCH_H_
+
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+#include "ACL.h"
+
+/// ChannelBatch is a list of changes to the channel tree of a
+/// server that Server::applyChannelBatch() applies as one unit:
+/// either all of them are applied, or none.
+///
+/// Operations refer to channels by ID. Channels added by the batch
+/// don't have an ID yet; later operations refer to them with ref(),
+/// using the index of the Add operation in qlOps.
+struct ChannelBatch {
+	enum OpType { Add, Remove, Update, Link, Unlink, SetACL };
+
+	enum Error { Ok, InvalidChannel, NestingLimit, InvalidOperation };
+
+	struct Group {
+		QString qsName;
+		bool bInherit;
+		bool bInheritable;
+		QSet<int> qsAdd;
+		QSet<int> qsRemove;
+
+		Group() : bInherit(true), bInheritable(true) {}
+	};
+
+	struct ACL {
+		bool bApplyHere;
+		bool bApplySubs;
+		/// The user the ACL applies to, or -1 for qsGroup.
+		int iUserId;
+		QString qsGroup;
+		ChanACL::Permissions pAllow;
+		ChanACL::Permissions pDeny;
+
+		ACL() : bApplyHere(true), bApplySubs(true), iUserId(-1), pAllow(ChanACL::None), pDeny(ChanACL::None) {}
+	};
+
+	struct Op {
+		OpType type;
+		/// The channel to change, or the parent of a new channel.
+		int iChannel;
+		/// The other channel of Link and Unlink.
+		int iOther;
+
+		/// Name, description and position of Add and Update. Null
+		/// strings and an unset bPosition leave them unchanged.
+		QString qsName;
+		QString qsDesc;
+		bool bPosition;
+		int iPosition;
+
+		/// The new ACLs and groups of SetACL.
+		bool bInheritACL;
+		QList<Group> qlGroups;
+		QList<ACL> qlACLs;
+
+		Op() : type(Add), iChannel(0), iOther(0), bPosition(false), iPosition(0), bInheritACL(true) {}
+	};
+
+	QList<Op> qlOps;
+
+	/// Returns the channel ID that refers to the channel created by
+	/// the Add operation at index.
+	static int ref(int index) {
+		return -1 - index;
+	}
+	static bool isRef(int id) {
+		return id < 0;
+	}
+	static int refIndex(int id) {
+		return -1 - id;
+	}
+};
+
+#endif
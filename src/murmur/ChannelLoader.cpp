@@ -0,0 +1,139 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "murmur_pch.h"
+
+#include "ChannelLoader.h"
+
+#include "ACL.h"
+#include "Channel.h"
+#include "Group.h"
+#include "Message.h"
+#include "ServerDB.h"
+
+// Ordering by name keeps siblings in the same order as when they were
+// read one parent at a time.
+const char *ChannelLoader::cChannelsQuery = "SELECT `channel_id`, `parent_id`, `name`, `inheritacl` FROM `%1channels` WHERE `server_id` = ? ORDER BY `name`";
+const char *ChannelLoader::cChannelInfoQuery = "SELECT `channel_id`, `key`, `value` FROM `%1channel_info` WHERE `server_id` = ?";
+const char *ChannelLoader::cGroupsQuery = "SELECT `group_id`, `channel_id`, `name`, `inherit`, `inheritable` FROM `%1groups` WHERE `server_id` = ?";
+const char *ChannelLoader::cGroupMembersQuery = "SELECT `group_id`, `user_id`, `addit` FROM `%1group_members` WHERE `server_id` = ?";
+const char *ChannelLoader::cACLQuery = "SELECT `channel_id`, `user_id`, `group_name`, `apply_here`, `apply_sub`, `grantpriv`, `revokepriv` FROM `%1acl` WHERE `server_id` = ? ORDER BY `channel_id`, `priority`";
+
+ChannelLoader::ChannelLoader() {
+}
+
+void ChannelLoader::readChannels(QSqlQuery &query) {
+	while (query.next()) {
+		Channel *c = new Channel(query.value(0).toInt(), query.value(2).toString());
+		c->bInheritACL = query.value(3).toBool();
+		qhParents.insert(c->iId, query.value(1).isNull() ? -1 : query.value(1).toInt());
+		qlRead << c;
+	}
+}
+
+void ChannelLoader::link(QObject *root) {
+	QHash<int, Channel *> unattached;
+	foreach(Channel *c, qlRead)
+		unattached.insert(c->iId, c);
+
+	QQueue<Channel *> q;
+	foreach(Channel *c, qlRead) {
+		int parentid = qhParents.value(c->iId);
+		if (parentid == -1) {
+			c->setParent(root);
+			q.enqueue(c);
+		} else {
+			Channel *p = unattached.value(parentid);
+			if (p && (p != c))
+				p->addChannel(c);
+		}
+	}
+
+	// Only channels reachable from a top level channel are used.
+	while (! q.isEmpty()) {
+		Channel *c = q.dequeue();
+		qhChannels.insert(c->iId, c);
+		unattached.remove(c->iId);
+		foreach(Channel *chld, c->qlChannels)
+			q.enqueue(chld);
+	}
+
+	// Anything left is orphaned. Detach everything before handing it
+	// out so no channel is deleted twice through its parent.
+	foreach(Channel *c, unattached) {
+		if (c->cParent)
+			c->cParent->removeChannel(c);
+	}
+	qlOrphans = unattached.values();
+
+	qlRead.clear();
+	qhParents.clear();
+}
+
+void ChannelLoader::readChannelInfo(QSqlQuery &query) {
+	while (query.next()) {
+		Channel *c = qhChannels.value(query.value(0).toInt());
+		if (! c)
+			continue;
+		int key = query.value(1).toInt();
+		const QString &value = query.value(2).toString();
+		if (key == ServerDB::Channel_Description) {
+			// Long descriptions are only ever sent to clients by hash
+			// unless they ask for them, so only keep the hash around.
+			if (value.length() >= BLOB_HASH_THRESHOLD) {
+				c->qsDesc = QString();
+				c->qbaDescHash = sha1(value);
+			} else {
+				c->qsDesc = value;
+				c->qbaDescHash = QByteArray();
+			}
+		} else if (key == ServerDB::Channel_Position) {
+			c->iPosition = QVariant(value).toInt(); // If the conversion fails it'll return the default value 0
+		} else if (key == ServerDB::Channel_Max_Users) {
+			c->uiMaxUsers = QVariant(value).toUInt(); // If the conversion fails it'll return the default value 0
+		}
+	}
+}
+
+void ChannelLoader::readGroups(QSqlQuery &query) {
+	while (query.next()) {
+		Channel *c = qhChannels.value(query.value(1).toInt());
+		if (! c)
+			continue;
+		Group *g = new Group(c, query.value(2).toString());
+		g->bInherit = query.value(3).toBool();
+		g->bInheritable = query.value(4).toBool();
+		qhGroups.insert(query.value(0).toInt(), g);
+	}
+}
+
+void ChannelLoader::readGroupMembers(QSqlQuery &query) {
+	while (query.next()) {
+		Group *g = qhGroups.value(query.value(0).toInt());
+		if (! g)
+			continue;
+		int uid = query.value(1).toInt();
+		if (query.value(2).toBool())
+			g->qsAdd << uid;
+		else
+			g->qsRemove << uid;
+	}
+	qhGroups.clear();
+}
+
+void ChannelLoader::readACL(QSqlQuery &query) {
+	while (query.next()) {
+		Channel *c = qhChannels.value(query.value(0).toInt());
+		if (! c)
+			continue;
+		ChanACL *acl = new ChanACL(c);
+		acl->iUserId = query.value(1).isNull() ? -1 : query.value(1).toInt();
+		acl->qsGroup = query.value(2).toString();
+		acl->bApplyHere = query.value(3).toBool();
+		acl->bApplySubs = query.value(4).toBool();
+		acl->pAllow = static_cast<ChanACL::Permissions>(query.value(5).toInt());
+		acl->pDeny = static_cast<ChanACL::Permissions>(query.value(6).toInt());
+	}
+}
@@ -0,0 +1,63 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CHANNELLOADER_H_
+#define MUMBLE_MURMUR_CHANNELLOADER_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+
+class Channel;
+class Group;
+class QObject;
+class QSqlQuery;
+
+/// ChannelLoader builds the channel tree of a virtual server and its
+/// privileges from the database, with one query per table rather than
+/// a handful per channel.
+///
+/// The caller runs each query below, with the table prefix as %1 and
+/// the server number as its only bound value, and hands the result to
+/// the matching read function, in the order they are declared.
+/// Server::readChannels() does so through ServerDB; src/tests/ChannelLoad
+/// does the same against a generated database.
+class ChannelLoader {
+	private:
+		Q_DISABLE_COPY(ChannelLoader)
+		/// Every channel read, in the order of the query.
+		QList<Channel *> qlRead;
+		/// Parent of each channel read, or -1 for top level channels.
+		QHash<int, int> qhParents;
+		/// Groups read, by group ID.
+		QHash<int, Group *> qhGroups;
+	public:
+		static const char *cChannelsQuery;
+		static const char *cChannelInfoQuery;
+		static const char *cGroupsQuery;
+		static const char *cGroupMembersQuery;
+		static const char *cACLQuery;
+
+		/// Channels reachable from a top level channel, by ID.
+		QHash<int, Channel *> qhChannels;
+		/// Channels that aren't, detached from the tree. The caller
+		/// deletes them.
+		QList<Channel *> qlOrphans;
+
+		ChannelLoader();
+
+		void readChannels(QSqlQuery &query);
+		/// Links the channels read into a tree, and sorts them into
+		/// qhChannels and qlOrphans. Top level channels become
+		/// children of root.
+		void link(QObject *root);
+		/// Long descriptions are only kept as their hash; see
+		/// Server::channelDescription().
+		void readChannelInfo(QSqlQuery &query);
+		void readGroups(QSqlQuery &query);
+		void readGroupMembers(QSqlQuery &query);
+		void readACL(QSqlQuery &query);
+};
+
+#endif
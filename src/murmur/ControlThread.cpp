@@ -0,0 +1,101 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "murmur_pch.h"
+
+#include "ControlThread.h"
+
+#include "Meta.h"
+#include "Server.h"
+
+QThreadStorage<QList<Server *> > ListenerCall::qtsServers;
+
+class ControlExecutor : public QObject {
+	protected:
+		void customEvent(QEvent *evt) Q_DECL_OVERRIDE {
+			if (evt->type() == EXEC_QEVENT)
+				static_cast<ExecEvent *>(evt)->execute();
+		}
+};
+
+ControlThread::ControlThread(QObject *p) : QThread(p) {
+	qoExecutor = new ControlExecutor();
+	qoExecutor->moveToThread(this);
+}
+
+ControlThread::~ControlThread() {
+	quit();
+	wait();
+	delete qoExecutor;
+}
+
+void ControlThread::post(QEvent *evt) {
+	QCoreApplication::postEvent(qoExecutor, evt);
+}
+
+void ControlThread::addServer(Server *s) {
+	qlServers << s;
+	s->moveToControlThread(this);
+}
+
+static void deleteServer(Server *s, QSemaphore *done) {
+	delete s;
+	done->release();
+}
+
+void ControlThread::destroyServer(Server *s) {
+	qlServers.removeAll(s);
+
+	QSemaphore done;
+	post(new ExecEvent(boost::bind(&deleteServer, s, &done)));
+	done.acquire();
+}
+
+ControlThread *ControlThread::forServer(int srvnum) {
+	const QList<ControlThread *> &threads = meta->qlControlThreads;
+	if (threads.isEmpty())
+		return NULL;
+	return threads.at(srvnum % threads.count());
+}
+
+void ControlThread::execute(int srvnum, boost::function<void ()> fn) {
+	ControlThread *t = forServer(srvnum);
+	if (! t || (t == QThread::currentThread()))
+		fn();
+	else
+		t->post(new ExecEvent(fn));
+}
+
+static void callDone(boost::function<void ()> fn, QSemaphore *done) {
+	fn();
+	done->release();
+}
+
+void ControlThread::call(int srvnum, boost::function<void ()> fn) {
+	ControlThread *t = forServer(srvnum);
+	if (! t || (t == QThread::currentThread())) {
+		fn();
+		return;
+	}
+
+	QSemaphore done;
+	t->post(new ExecEvent(boost::bind(&callDone, fn, &done)));
+	done.acquire();
+}
+
+ListenerCall::ListenerCall(Server *s) {
+	qtsServers.localData().append(s);
+}
+
+ListenerCall::~ListenerCall() {
+	qtsServers.localData().removeLast();
+}
+
+Server *ListenerCall::server() {
+	if (! qtsServers.hasLocalData())
+		return NULL;
+	const QList<Server *> &servers = qtsServers.localData();
+	return servers.isEmpty() ? NULL : servers.last();
+}
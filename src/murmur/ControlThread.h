@@ -0,0 +1,95 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CONTROLTHREAD_H_
+#define MUMBLE_MURMUR_CONTROLTHREAD_H_
+
+#include <QtCore/QList>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+
+#include <boost/function.hpp>
+
+class QEvent;
+class Server;
+
+/// ControlThread runs the event loop of the virtual servers that
+/// Meta assigns to it: their TCP connections, message handlers
+/// and timers. Voice still runs on each server's own thread.
+///
+/// Control threads are only used if MetaParams::iServerThreads is
+/// set. Otherwise all servers are handled on the main thread.
+///
+/// A server must only be accessed from its thread. Work from other
+/// threads, such as RPC calls, is handed to it with post(),
+/// execute() or call(). The work has to look the server up with
+/// Meta::server() when it runs, as the server may have been stopped
+/// in the meantime.
+class ControlThread : public QThread {
+	private:
+		Q_OBJECT
+		Q_DISABLE_COPY(ControlThread)
+	protected:
+		/// Lives on this thread and executes the ExecEvents
+		/// posted to it.
+		QObject *qoExecutor;
+	public:
+		/// Servers that run on this thread. Only accessed from
+		/// the main thread.
+		QList<Server *> qlServers;
+
+		ControlThread(QObject *p = NULL);
+		~ControlThread();
+
+		/// Posts an ExecEvent to this thread, which takes
+		/// ownership of it.
+		void post(QEvent *evt);
+
+		/// Moves s to this thread.
+		void addServer(Server *s);
+		/// Deletes s on this thread, and waits until it is gone.
+		void destroyServer(Server *s);
+
+		/// Returns the thread that server number srvnum runs on,
+		/// or NULL if servers run on the main thread. Servers are
+		/// pinned to a thread by number, so this doesn't depend
+		/// on whether the server is running.
+		static ControlThread *forServer(int srvnum);
+		/// Runs fn on the thread of server number srvnum. If that
+		/// is the current thread, fn runs right away.
+		static void execute(int srvnum, boost::function<void ()> fn);
+		/// Runs fn on the thread of server number srvnum, and waits
+		/// for it to finish. Must not be called from another
+		/// control thread.
+		static void call(int srvnum, boost::function<void ()> fn);
+};
+
+/// ListenerCall has to exist around every emit of a signal that RPC
+/// listeners and authenticators connect to.
+///
+/// Listeners are called directly on the thread of the server, so
+/// servers on different threads call them at the same time; state
+/// that a listener shares between servers has to be guarded. Qt
+/// doesn't know the sender of direct calls from other threads, so
+/// listeners get the server that calls them from server() instead
+/// of QObject::sender().
+///
+/// Servers must not emit these signals inside a TransactionHolder,
+/// as listeners may access the database.
+class ListenerCall {
+	private:
+		Q_DISABLE_COPY(ListenerCall)
+		/// The servers calling listeners on each thread,
+		/// innermost last.
+		static QThreadStorage<QList<Server *> > qtsServers;
+	public:
+		ListenerCall(Server *s);
+		~ListenerCall();
+		/// Returns the server that is calling listeners on the
+		/// current thread.
+		static Server *server();
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include "DBus.h"
 
 #include "Connection.h"
+#include "ControlThread.h"
 #include "Message.h"
 #include "Server.h"
 #include "ServerUser.h"
@@ -521,6 +522,7 @@ void MurmurDBus::setACL(int id, const QList<ACLInfo> &acls, const QList<GroupInf
 
 	server->clearACLCache();
 	server->updateChannel(cChannel);
+	server->markSnapshotACL(cChannel);
 }
 
 void MurmurDBus::getBans(QList<BanInfo> &bi) {
@@ -850,14 +852,18 @@ void MetaDBus::getConf(int server_id, const QString &key, const QDBusMessage &ms
 	}
 }
 
+static void setLiveConf(int server_id, const QString &key, const QString &value) {
+	Server *s = meta->server(server_id);
+	if (s)
+		s->setLiveConf(key, value);
+}
+
 void MetaDBus::setConf(int server_id, const QString &key, const QString &value, const QDBusMessage &msg) {
 	if (! ServerDB::serverExists(server_id)) {
 		MurmurDBus::qdbc.send(msg.createErrorReply("net.sourceforge.mumble.Error.server", "Invalid server id"));
 	} else {
 		ServerDB::setConf(server_id, key, value);
-		Server *s = meta->qhServers.value(server_id);
-		if (s)
-			s->setLiveConf(key, value);
+		ControlThread::execute(server_id, boost::bind(&setLiveConf, server_id, key, value));
 	}
 }
 
@@ -0,0 +1,158 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "murmur_pch.h"
+
+#include "Channel.h"
+#include "Server.h"
+#include "ServerUser.h"
+
+void Server::fillUserState(ServerUser *u, ServerUser *recipient, MumbleProto::UserState &mpus) {
+	mpus.set_session(u->uiSession);
+	mpus.set_name(u8(u->qsName));
+	if (u->iId >= 0)
+		mpus.set_user_id(u->iId);
+	if (recipient->uiVersion >= 0x010202) {
+		if (! u->qbaTextureHash.isEmpty())
+			mpus.set_texture_hash(blob(u->qbaTextureHash));
+		else if (! u->qbaTexture.isEmpty())
+			mpus.set_texture(blob(u->qbaTexture));
+	} else if ((recipient->qbaTexture.length() >= 4) && (qFromBigEndian<unsigned int>(reinterpret_cast<const unsigned char *>(recipient->qbaTexture.constData())) == 600 * 60 * 4)) {
+		mpus.set_texture(blob(u->qbaTexture));
+	}
+	if (u->cChannel->iId != 0)
+		mpus.set_channel_id(u->cChannel->iId);
+	if (u->bDeaf)
+		mpus.set_deaf(true);
+	else if (u->bMute)
+		mpus.set_mute(true);
+	if (u->bSuppress)
+		mpus.set_suppress(true);
+	if (u->bPrioritySpeaker)
+		mpus.set_priority_speaker(true);
+	if (u->bRecording)
+		mpus.set_recording(true);
+	if (u->bSelfDeaf)
+		mpus.set_self_deaf(true);
+	else if (u->bSelfMute)
+		mpus.set_self_mute(true);
+	if ((recipient->uiVersion >= 0x010202) && ! u->qbaCommentHash.isEmpty())
+		mpus.set_comment_hash(blob(u->qbaCommentHash));
+	else if (! u->qsComment.isEmpty())
+		mpus.set_comment(u8(u->qsComment));
+	if (! u->qsHash.isEmpty())
+		mpus.set_hash(u8(u->qsHash));
+}
+
+bool Server::isInterested(const ServerUser *r, const Channel *c) const {
+	if (c == r->cChannel)
+		return true;
+	for (; c; c = c->cParent)
+		if (r->qsInterest.contains(c->iId))
+			return true;
+	return false;
+}
+
+bool Server::scopeUserMessage(ServerUser *r, const ::google::protobuf::Message &msg, unsigned int msgType) {
+	if (msgType == MessageHandler::UserRemove) {
+		const MumbleProto::UserRemove &mpur = static_cast<const MumbleProto::UserRemove &>(msg);
+		return (mpur.session() == r->uiSession) || r->qsKnownSessions.remove(mpur.session());
+	}
+	if (msgType != MessageHandler::UserState)
+		return true;
+
+	const MumbleProto::UserState &mpus = static_cast<const MumbleProto::UserState &>(msg);
+	if (! mpus.has_session() || (mpus.session() == r->uiSession))
+		return true;
+
+	ServerUser *u = qhUsers.value(mpus.session());
+	if (! u || (u->sState != ServerUser::Authenticated))
+		return true;
+
+	const bool known = r->qsKnownSessions.contains(u->uiSession);
+	if (isInterested(r, u->cChannel)) {
+		if (known)
+			return true;
+
+		// The client doesn't have this user yet, so the change
+		// alone isn't enough.
+		r->qsKnownSessions.insert(u->uiSession);
+		MumbleProto::UserState full;
+		fillUserState(u, r, full);
+		sendMessage(r, full);
+		return false;
+	}
+
+	// The user moved out of the interest set. The client is sent the
+	// move and forgets the user.
+	if (known) {
+		r->qsKnownSessions.remove(u->uiSession);
+		return true;
+	}
+	return false;
+}
+
+void Server::updateInterest(ServerUser *r) {
+	QSet<unsigned int> known;
+	foreach(ServerUser *u, qhUsers) {
+		if ((u == r) || (u->sState != ServerUser::Authenticated) || ! isInterested(r, u->cChannel))
+			continue;
+		if (! r->qsKnownSessions.contains(u->uiSession)) {
+			MumbleProto::UserState mpus;
+			fillUserState(u, r, mpus);
+			sendMessage(r, mpus);
+		}
+		known.insert(u->uiSession);
+	}
+	r->qsKnownSessions = known;
+
+	sendUserCounts(r);
+}
+
+void Server::sendUserCounts(ServerUser *r) {
+	MumbleProto::UserInterest mpui;
+	foreach(const Channel *c, qhChannels) {
+		if (c->qlUsers.isEmpty() || isInterested(r, c))
+			continue;
+		MumbleProto::UserInterest_Count *count = mpui.add_counts();
+		count->set_channel_id(c->iId);
+		count->set_users(c->qlUsers.count());
+	}
+	sendMessage(r, mpui);
+}
+
+void Server::markUserCount(const Channel *c) {
+	if (! c)
+		return;
+	qsUserCountChannels.insert(c->iId);
+	if (! bUserCountsScheduled) {
+		bUserCountsScheduled = true;
+		QCoreApplication::instance()->postEvent(this, new ExecEvent(boost::bind(&Server::flushUserCounts, this)));
+	}
+}
+
+void Server::flushUserCounts() {
+	bUserCountsScheduled = false;
+
+	const QSet<int> channels = qsUserCountChannels;
+	qsUserCountChannels.clear();
+
+	foreach(ServerUser *r, qhUsers) {
+		if (! r->bScopedUserState || (r->sState != ServerUser::Authenticated))
+			continue;
+
+		MumbleProto::UserInterest mpui;
+		foreach(int id, channels) {
+			const Channel *c = qhChannels.value(id);
+			if (! c || isInterested(r, c))
+				continue;
+			MumbleProto::UserInterest_Count *count = mpui.add_counts();
+			count->set_channel_id(id);
+			count->set_users(c->qlUsers.count());
+		}
+		if (mpui.counts_size() > 0)
+			sendMessage(r, mpui);
+	}
+}
@@ -10,6 +10,7 @@
 #include "ACL.h"
 #include "Group.h"
 #include "Message.h"
+#include "ControlThread.h"
 #include "ServerDB.h"
 #include "Connection.h"
 #include "Server.h"
@@ -118,16 +119,9 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		ok = true;
 	}
 
-	ServerUser *uOld = NULL;
-	foreach(ServerUser *u, qhUsers) {
-		if (u == uSource)
-			continue;
-		if (((u->iId>=0) && (u->iId == uSource->iId)) ||
-		        (u->qsName.toLower() == uSource->qsName.toLower())) {
-			uOld = u;
-			break;
-		}
-	}
+	ServerUser *uOld = userById(uSource->iId);
+	if (! uOld)
+		uOld = userByName(uSource->qsName);
 
 	// Allow reuse of name from same IP
 	if (ok && uOld && (uSource->iId == -1)) {
@@ -215,6 +209,9 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		fake_celt_support = true;
 	}
 	uSource->bOpus = msg.opus();
+	uSource->bScopedUserState = msg.scoped_user_state();
+	uSource->bTextMessageBlobs = msg.text_message_blobs();
+	addCodecUser(uSource);
 	recheckCodecVersions(uSource);
 
 	MumbleProto::CodecVersion mpcv;
@@ -251,8 +248,8 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 
 		if ((uSource->uiVersion >= 0x010202) && ! c->qbaDescHash.isEmpty())
 			mpcs.set_description_hash(blob(c->qbaDescHash));
-		else if (! c->qsDesc.isEmpty())
-			mpcs.set_description(u8(c->qsDesc));
+		else if (! c->qbaDescHash.isEmpty() || ! c->qsDesc.isEmpty())
+			mpcs.set_description(u8(channelDescription(c)));
 
 		mpcs.set_max_users(c->uiMaxUsers);
 
@@ -283,6 +280,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		QWriteLocker wl(&qrwlVoiceThread);
 		uSource->sState = ServerUser::Authenticated;
 	}
+	indexUser(uSource);
 
 	mpus.set_session(uSource->uiSession);
 	mpus.set_name(u8(uSource->qsName));
@@ -326,45 +324,20 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		if (u == uSource)
 			continue;
 
-		mpus.Clear();
-		mpus.set_session(u->uiSession);
-		mpus.set_name(u8(u->qsName));
-		if (u->iId >= 0)
-			mpus.set_user_id(u->iId);
-		if (uSource->uiVersion >= 0x010202) {
-			if (! u->qbaTextureHash.isEmpty())
-				mpus.set_texture_hash(blob(u->qbaTextureHash));
-			else if (! u->qbaTexture.isEmpty())
-				mpus.set_texture(blob(u->qbaTexture));
-		} else if ((uSource->qbaTexture.length() >= 4) && (qFromBigEndian<unsigned int>(reinterpret_cast<const unsigned char *>(uSource->qbaTexture.constData())) == 600 * 60 * 4)) {
-			mpus.set_texture(blob(u->qbaTexture));
-		}
-		if (u->cChannel->iId != 0)
-			mpus.set_channel_id(u->cChannel->iId);
-		if (u->bDeaf)
-			mpus.set_deaf(true);
-		else if (u->bMute)
-			mpus.set_mute(true);
-		if (u->bSuppress)
-			mpus.set_suppress(true);
-		if (u->bPrioritySpeaker)
-			mpus.set_priority_speaker(true);
-		if (u->bRecording)
-			mpus.set_recording(true);
-		if (u->bSelfDeaf)
-			mpus.set_self_deaf(true);
-		else if (u->bSelfMute)
-			mpus.set_self_mute(true);
-		if ((uSource->uiVersion >= 0x010202) && ! u->qbaCommentHash.isEmpty())
-			mpus.set_comment_hash(blob(u->qbaCommentHash));
-		else if (! u->qsComment.isEmpty())
-			mpus.set_comment(u8(u->qsComment));
-		if (! u->qsHash.isEmpty())
-			mpus.set_hash(u8(u->qsHash));
+		if (uSource->bScopedUserState) {
+			if (! isInterested(uSource, u->cChannel))
+				continue;
+			uSource->qsKnownSessions.insert(u->uiSession);
+		}
 
+		mpus.Clear();
+		fillUserState(u, uSource, mpus);
 		sendMessage(uSource, mpus);
 	}
 
+	if (uSource->bScopedUserState)
+		sendUserCounts(uSource);
+
 	// Send syncronisation packet
 	MumbleProto::ServerSync mpss;
 	mpss.set_session(uSource->uiSession);
@@ -402,6 +375,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 
 	log(uSource, "Authenticated");
 
+	ListenerCall lc(this);
 	emit userConnected(uSource);
 }
 
@@ -736,7 +710,7 @@ void Server::msgUserState(ServerUser *uSource, MumbleProto::UserState &msg) {
 			info.insert(ServerDB::User_Email, pDstServerUser->qslEmail.first());
 		int id = registerUser(info);
 		if (id > 0) {
-			pDstServerUser->iId = id;
+			setUserId(pDstServerUser, id);
 			setLastChannel(pDstServerUser);
 			msg.set_user_id(id);
 			bDstAclChanged = true;
@@ -778,6 +752,7 @@ void Server::msgUserState(ServerUser *uSource, MumbleProto::UserState &msg) {
 			clearACLCache(pDstServerUser);
 	}
 
+	ListenerCall lc(this);
 	emit userStateChanged(pDstServerUser);
 }
 
@@ -934,10 +909,14 @@ void Server::msgChannelState(ServerUser *uSource, MumbleProto::ChannelState &msg
 			clearACLCache();
 		}
 		updateChannel(c);
+		markSnapshotACL(c);
 
 		msg.set_channel_id(c->iId);
 		log(uSource, QString("Added channel %1 under %2").arg(QString(*c), QString(*p)));
-		emit channelCreated(c);
+		{
+			ListenerCall lc(this);
+			emit channelCreated(c);
+		}
 
 		sendAll(msg, ~ 0x010202);
 		if (! c->qbaDescHash.isEmpty()) {
@@ -953,6 +932,7 @@ void Server::msgChannelState(ServerUser *uSource, MumbleProto::ChannelState &msg
 			mpus.set_channel_id(c->iId);
 			userEnterChannel(uSource, c, mpus);
 			sendAll(mpus);
+			ListenerCall lc(this);
 			emit userStateChanged(uSource);
 		}
 	} else {
@@ -1081,7 +1061,10 @@ void Server::msgChannelState(ServerUser *uSource, MumbleProto::ChannelState &msg
 			c->uiMaxUsers = msg.max_users();
 
 		updateChannel(c);
-		emit channelStateChanged(c);
+		{
+			ListenerCall lc(this);
+			emit channelStateChanged(c);
+		}
 
 		sendAll(msg, ~ 0x010202);
 		if (msg.has_description() && ! c->qbaDescHash.isEmpty()) {
@@ -1111,6 +1094,65 @@ void Server::msgChannelRemove(ServerUser *uSource, MumbleProto::ChannelRemove &m
 
 void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg) {
 	MSG_SETUP(ServerUser::Authenticated);
+
+	// A connected text message filter may take the message, and hand
+	// back its verdict later through textMessageFiltered(). Messages are
+	// processed in the order they were sent, so while earlier messages
+	// are being filtered, this one has to wait as well.
+	quint64 id = ++uiTextMessageId;
+	bool pending = false;
+	{
+		ListenerCall lc(this);
+		emit textMessageFilterSig(pending, id, uSource, msg);
+	}
+
+	if (! pending && qmPendingTextMessages.isEmpty()) {
+		processTextMessage(uSource, msg);
+		return;
+	}
+
+	PendingTextMessage &ptm = qmPendingTextMessages[id];
+	ptm.uiSession = uSource->uiSession;
+	ptm.msg = msg;
+	ptm.bFiltered = ! pending;
+	ptm.iResult = 0;
+}
+
+void Server::textMessageFiltered(quint64 id, int result, const QString &text) {
+	QMap<quint64, PendingTextMessage>::iterator i = qmPendingTextMessages.find(id);
+	if (i == qmPendingTextMessages.end())
+		return;
+
+	PendingTextMessage &ptm = i.value();
+	ptm.bFiltered = true;
+	ptm.iResult = result;
+	if ((result == 0) && ! text.isNull())
+		ptm.msg.set_message(u8(text));
+
+	while (! qmPendingTextMessages.isEmpty() && qmPendingTextMessages.begin().value().bFiltered) {
+		PendingTextMessage next = qmPendingTextMessages.take(qmPendingTextMessages.begin().key());
+
+		ServerUser *uSource = qhUsers.value(next.uiSession);
+		if (! uSource || (uSource->sState != ServerUser::Authenticated))
+			continue;
+
+		switch (next.iResult) {
+			// Accept
+			case 0:
+				processTextMessage(uSource, next.msg);
+				break;
+			// Reject
+			case 1:
+				PERM_DENIED(uSource, uSource->cChannel, ChanACL::TextMessage);
+				break;
+			// Drop
+			default:
+				break;
+		}
+	}
+}
+
+void Server::processTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg) {
 	QMutexLocker qml(&qmCache);
 
 	TextMessage tm; // for signal userTextMessage
@@ -1118,22 +1160,6 @@ void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg)
 	QSet<ServerUser *> users;
 	QQueue<Channel *> q;
 
-	int res = 0;
-	emit textMessageFilterSig(res, uSource, msg);
-	switch (res) {
-		// Accept
-		case 0:
-			// No-op.
-			break;
-		// Reject
-		case 1:
-			PERM_DENIED(uSource, uSource->cChannel, ChanACL::TextMessage);
-			return;
-		// Drop
-		case 2:
-			return;
-	}
-
 	QString text = u8(msg.message());
 	bool changed = false;
 
@@ -1218,12 +1244,58 @@ void Server::msgTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg)
 
 	users.remove(uSource);
 
-	foreach(ServerUser *u, users)
-		sendMessage(u, msg);
+	broadcastTextMessage(users, msg);
 
+	ListenerCall lc(this);
 	emit userTextMessage(uSource, tm);
 }
 
+void Server::broadcastTextMessage(const QSet<ServerUser *> &users, MumbleProto::TextMessage &msg) {
+	QList<ServerUser *> hashUsers;
+	if ((iTextMessageBlobLength > 0) && (msg.message().size() > static_cast<size_t>(iTextMessageBlobLength))) {
+		foreach(ServerUser *u, users)
+			if (u->bTextMessageBlobs)
+				hashUsers << u;
+	}
+
+	if (hashUsers.isEmpty()) {
+		foreach(ServerUser *u, users)
+			sendMessage(u, msg);
+		return;
+	}
+
+	// Take the message out instead of copying it for each kind of
+	// recipient; it is only copied once, into the blob store.
+	std::string message;
+	msg.mutable_message()->swap(message);
+
+	const QByteArray &hash = sha1(QByteArray::fromRawData(message.data(), static_cast<int>(message.size())));
+
+	QHash<QByteArray, TextBlob>::iterator i = qhTextBlobs.find(hash);
+	if (i == qhTextBlobs.end()) {
+		while (! qlTextBlobs.isEmpty() && (iTextBlobBytes + static_cast<int>(message.size()) > iMaxTextBlobBytes))
+			iTextBlobBytes -= static_cast<int>(qhTextBlobs.take(qlTextBlobs.takeFirst()).ssMessage.size());
+		i = qhTextBlobs.insert(hash, TextBlob());
+		i.value().ssMessage = message;
+		iTextBlobBytes += static_cast<int>(message.size());
+	} else {
+		qlTextBlobs.removeOne(hash);
+	}
+	qlTextBlobs.append(hash);
+
+	msg.set_message_hash(blob(hash));
+	foreach(ServerUser *u, hashUsers) {
+		i.value().qsSessions.insert(u->uiSession);
+		sendMessage(u, msg);
+	}
+	msg.clear_message_hash();
+
+	msg.mutable_message()->swap(message);
+	foreach(ServerUser *u, users)
+		if (! u->bTextMessageBlobs)
+			sendMessage(u, msg);
+}
+
 void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 	MSG_SETUP(ServerUser::Authenticated);
 
@@ -1393,6 +1465,7 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 
 
 		updateChannel(c);
+		markSnapshotACL(c);
 		log(uSource, QString("Updated ACL in channel %1").arg(*c));
 	}
 }
@@ -1488,6 +1561,7 @@ void Server::msgContextAction(ServerUser *uSource, MumbleProto::ContextAction &m
 		return;
 	if ((id >= 0) && ! qhChannels.contains(id))
 		return;
+	ListenerCall lc(this);
 	emit contextAction(uSource, u8(msg.action()), session, id);
 }
 
@@ -1495,11 +1569,11 @@ void Server::msgVersion(ServerUser *uSource, MumbleProto::Version &msg) {
 	if (msg.has_version())
 		uSource->uiVersion=msg.version();
 	if (msg.has_release())
-		uSource->qsRelease = u8(msg.release());
+		uSource->qsRelease = ServerUser::intern(u8(msg.release()));
 	if (msg.has_os()) {
-		uSource->qsOS = u8(msg.os());
+		uSource->qsOS = ServerUser::intern(u8(msg.os()));
 		if (msg.has_os_version())
-			uSource->qsOSVersion = u8(msg.os_version());
+			uSource->qsOSVersion = ServerUser::intern(u8(msg.os_version()));
 	}
 
 	log(uSource, QString("Client version %1 (%2: %3)").arg(MumbleVersion::toString(uSource->uiVersion)).arg(uSource->qsOS).arg(uSource->qsRelease));
@@ -1554,12 +1628,10 @@ void Server::msgUserList(ServerUser *uSource, MumbleProto::UserList &msg) {
 					setInfo(id, info);
 
 					MumbleProto::UserState mpus;
-					foreach(ServerUser *serverUser, qhUsers) {
-						if (serverUser->iId == id) {
-							serverUser->qsName = name;
-							mpus.set_session(serverUser->uiSession);
-							break;
-						}
+					ServerUser *serverUser = userById(id);
+					if (serverUser) {
+						setUserName(serverUser, name);
+						mpus.set_session(serverUser->uiSession);
 					}
 					if (mpus.has_session()) {
 						mpus.set_actor(uSource->uiSession);
@@ -1728,19 +1800,40 @@ void Server::msgRequestBlob(ServerUser *uSource, MumbleProto::RequestBlob &msg)
 	int ntextures = msg.session_texture_size();
 	int ncomments = msg.session_comment_size();
 	int ndescriptions = msg.channel_description_size();
+	int ntexts = msg.text_message_size();
 
 	if (ndescriptions) {
 		MumbleProto::ChannelState mpcs;
 		for (int i=0;i<ndescriptions;++i) {
 			int id = msg.channel_description(i);
 			Channel *c = qhChannels.value(id);
-			if (c && ! c->qsDesc.isEmpty()) {
+			if (! c)
+				continue;
+			const QString &desc = channelDescription(c);
+			if (! desc.isEmpty()) {
 				mpcs.set_channel_id(id);
-				mpcs.set_description(u8(c->qsDesc));
+				mpcs.set_description(u8(desc));
 				sendMessage(uSource, mpcs);
 			}
 		}
 	}
+	if (ntexts) {
+		MumbleProto::TextMessage mptm;
+		for (int i=0;i<ntexts;++i) {
+			QHash<QByteArray, TextBlob>::const_iterator tb = qhTextBlobs.constFind(blob(msg.text_message(i)));
+			mptm.set_message_hash(msg.text_message(i));
+			// Tell the client when the message was evicted, so that it
+			// stops waiting for it.
+			if ((tb == qhTextBlobs.constEnd()) || ! tb.value().qsSessions.contains(uSource->uiSession)) {
+				mptm.set_message(std::string());
+				mptm.set_message_unavailable(true);
+			} else {
+				mptm.set_message(tb.value().ssMessage);
+				mptm.clear_message_unavailable();
+			}
+			sendMessage(uSource, mptm);
+		}
+	}
 	if (ntextures || ncomments) {
 		MumbleProto::UserState mpus;
 		for (int i=0;i<ntextures;++i) {
@@ -1771,3 +1864,29 @@ void Server::msgServerConfig(ServerUser *, MumbleProto::ServerConfig &) {
 
 void Server::msgSuggestConfig(ServerUser *, MumbleProto::SuggestConfig &) {
 }
+
+void Server::msgUserInterest(ServerUser *uSource, MumbleProto::UserInterest &msg) {
+	MSG_SETUP_NO_UNIDLE(ServerUser::Authenticated);
+
+	if (! uSource->bScopedUserState)
+		return;
+
+	for (int i=0;i<msg.session_size();++i) {
+		ServerUser *u = qhUsers.value(msg.session(i));
+		if (! u || (u->sState != ServerUser::Authenticated))
+			continue;
+		MumbleProto::UserState mpus;
+		fillUserState(u, uSource, mpus);
+		sendMessage(uSource, mpus);
+	}
+
+	if (msg.session_size() == 0) {
+		uSource->qsInterest.clear();
+		for (int i=0;i<msg.channel_id_size();++i) {
+			int id = msg.channel_id(i);
+			if (qhChannels.contains(id))
+				uSource->qsInterest.insert(id);
+		}
+		updateInterest(uSource);
+	}
+}
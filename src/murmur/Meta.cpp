@@ -8,6 +8,7 @@
 #include "Meta.h"
 
 #include "Connection.h"
+#include "ControlThread.h"
 #include "Net.h"
 #include "ServerDB.h"
 #include "Server.h"
@@ -34,6 +35,7 @@ MetaParams::MetaParams() {
 	iMaxUsersPerChannel = 0;
 	iMaxTextMessageLength = 5000;
 	iMaxImageMessageLength = 131072;
+	iTextMessageBlobLength = 0;
 	legacyPasswordHash = false;
 	kdfIterations = -1;
 	bAllowHTML = true;
@@ -67,6 +69,13 @@ MetaParams::MetaParams() {
 
 	iChannelNestingLimit = 10;
 
+	iServerThreads = 0;
+
+	iGRPCEventQueue = 1000;
+	qsGRPCEventPolicy = QLatin1String("coalesce");
+	iGRPCFilterTimeout = 1000;
+	qsGRPCFilterPolicy = QLatin1String("accept");
+
 	qrUserName = QRegExp(QLatin1String("[-=\\w\\[\\]\\{\\}\\(\\)\\@\\|\\.]+"));
 	qrChannelName = QRegExp(QLatin1String("[ \\-=\\w\\#\\[\\]\\{\\}\\(\\)\\@\\|]+"));
 
@@ -258,6 +267,7 @@ void MetaParams::read(QString fname) {
 	iTimeout = typeCheckedFromSettings("timeout", iTimeout);
 	iMaxTextMessageLength = typeCheckedFromSettings("textmessagelength", iMaxTextMessageLength);
 	iMaxImageMessageLength = typeCheckedFromSettings("imagemessagelength", iMaxImageMessageLength);
+	iTextMessageBlobLength = typeCheckedFromSettings("textmessagebloblength", iTextMessageBlobLength);
 	legacyPasswordHash = typeCheckedFromSettings("legacypasswordhash", legacyPasswordHash);
 	kdfIterations = typeCheckedFromSettings("kdfiterations", -1);
 	bAllowHTML = typeCheckedFromSettings("allowhtml", bAllowHTML);
@@ -288,6 +298,10 @@ void MetaParams::read(QString fname) {
 	qsGRPCAddress = typeCheckedFromSettings("grpc", qsGRPCAddress);
 	qsGRPCCert = typeCheckedFromSettings("grpccert", qsGRPCCert);
 	qsGRPCKey = typeCheckedFromSettings("grpckey", qsGRPCKey);
+	iGRPCEventQueue = typeCheckedFromSettings("grpceventqueue", iGRPCEventQueue);
+	qsGRPCEventPolicy = typeCheckedFromSettings("grpceventpolicy", qsGRPCEventPolicy);
+	iGRPCFilterTimeout = typeCheckedFromSettings("grpcfiltertimeout", iGRPCFilterTimeout);
+	qsGRPCFilterPolicy = typeCheckedFromSettings("grpcfilterpolicy", qsGRPCFilterPolicy);
 
 	iLogDays = typeCheckedFromSettings("logdays", iLogDays);
 
@@ -323,6 +337,8 @@ void MetaParams::read(QString fname) {
 
 	iChannelNestingLimit = typeCheckedFromSettings("channelnestinglimit", iChannelNestingLimit);
 
+	iServerThreads = qMax(0, typeCheckedFromSettings("serverthreads", iServerThreads));
+
 #ifdef Q_OS_UNIX
 	qsName = qsSettings->value("uname").toString();
 	if (geteuid() == 0) {
@@ -563,9 +579,19 @@ Meta::Meta() {
 			Connection::setQoS(hQoS);
 	}
 #endif
+
+	for (int i = 0; i < mp.iServerThreads; ++i) {
+		ControlThread *t = new ControlThread(this);
+		t->start();
+		qlControlThreads << t;
+	}
 }
 
 Meta::~Meta() {
+	foreach(ControlThread *t, qlControlThreads)
+		delete t;
+	qlControlThreads.clear();
+
 #ifdef Q_OS_WIN
 	if (hQoS) {
 		QOSCloseHandle(hQoS);
@@ -595,8 +621,19 @@ bool Meta::boot(int srvnum) {
 		delete s;
 		return false;
 	}
-	qhServers.insert(srvnum, s);
+	// Listeners connect to the server while it is still on the main
+	// thread. It is only visible to other threads once it has moved
+	// to its own, so work posted there never sees it before.
 	emit started(s);
+	// Servers are pinned to a thread by number, so they always
+	// share a thread with the same servers.
+	ControlThread *t = ControlThread::forServer(srvnum);
+	if (t)
+		t->addServer(s);
+	{
+		QWriteLocker l(&qrwlServers);
+		qhServers.insert(srvnum, s);
+	}
 
 #ifdef Q_OS_UNIX
 	unsigned int sockets = 19; // Base
@@ -628,26 +665,51 @@ bool Meta::boot(int srvnum) {
 	return true;
 }
 
+Server *Meta::server(int srvnum) {
+	QReadLocker l(&qrwlServers);
+	return qhServers.value(srvnum);
+}
+
 void Meta::kill(int srvnum) {
-	Server *s = qhServers.take(srvnum);
+	Server *s;
+	{
+		QWriteLocker l(&qrwlServers);
+		s = qhServers.take(srvnum);
+	}
 	if (!s)
 		return;
 	emit stopped(s);
-	delete s;
+	destroy(s);
 }
 
 void Meta::killAll() {
-	foreach(Server *s, qhServers) {
+	QHash<int, Server *> servers;
+	{
+		QWriteLocker l(&qrwlServers);
+		servers.swap(qhServers);
+	}
+	foreach(Server *s, servers) {
 		emit stopped(s);
-		delete s;
+		destroy(s);
 	}
-	qhServers.clear();
+}
+
+void Meta::destroy(Server *s) {
+	foreach(ControlThread *t, qlControlThreads) {
+		if (t->qlServers.contains(s)) {
+			t->destroyServer(s);
+			return;
+		}
+	}
+	delete s;
 }
 
 bool Meta::banCheck(const QHostAddress &addr) {
 	if ((mp.iBanTries == 0) || (mp.iBanTimeframe == 0))
 		return false;
 
+	QMutexLocker l(&qmBans);
+
 	if (qhBans.contains(addr)) {
 		Timer t = qhBans.value(addr);
 		if (t.elapsed() < (1000000ULL * mp.iBanTime))
@@ -8,6 +8,8 @@
 
 #include <QtCore/QDir>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
 #include <QtCore/QUrl>
 #include <QtCore/QVariant>
 #include <QtNetwork/QHostAddress>
@@ -19,6 +21,7 @@
 
 #include "Timer.h"
 
+class ControlThread;
 class Server;
 class QSettings;
 
@@ -36,8 +39,14 @@ public:
 	bool bRememberChan;
 	int iMaxTextMessageLength;
 	int iMaxImageMessageLength;
+	/// Text messages longer than this are sent by hash to clients
+	/// that can fetch them, or 0 to always send them in full.
+	int iTextMessageBlobLength;
 	int iOpusThreshold;
 	int iChannelNestingLimit;
+	/// Number of threads that run the control plane of the
+	/// virtual servers, or 0 to run them all on the main thread.
+	int iServerThreads;
 	/// If true the old SHA1 password hashing is used instead of PBKDF2
 	bool legacyPasswordHash;
 	/// Contains the default number of PBKDF2 iterations to use
@@ -80,6 +89,10 @@ public:
 	QString qsGRPCAddress;
 	QString qsGRPCCert;
 	QString qsGRPCKey;
+	int iGRPCEventQueue;
+	QString qsGRPCEventPolicy;
+	int iGRPCFilterTimeout;
+	QString qsGRPCFilterPolicy;
 
 	QString qsRegName;
 	QString qsRegPassword;
@@ -126,7 +139,17 @@ class Meta : public QObject {
 		Q_DISABLE_COPY(Meta);
 	public:
 		static MetaParams mp;
+		/// Running servers. Only the main thread changes it, with
+		/// qrwlServers locked for writing, and can read it without
+		/// locking. Other threads use server().
 		QHash<int, Server *> qhServers;
+		QReadWriteLock qrwlServers;
+		/// The control threads servers are assigned to, if
+		/// MetaParams::iServerThreads is set.
+		QList<ControlThread *> qlControlThreads;
+		/// Protects qhAttempts and qhBans, which banCheck() updates
+		/// from every control thread.
+		QMutex qmBans;
 		QHash<QHostAddress, QList<Timer> > qhAttempts;
 		QHash<QHostAddress, Timer> qhBans;
 		QString qsOS, qsOSVersion;
@@ -139,10 +162,17 @@ class Meta : public QObject {
 		Meta();
 		~Meta();
 		void bootAll();
+		/// Returns running server srvnum, or NULL. Can be called
+		/// from any thread, but the server must only be used on
+		/// its own; see ControlThread.
+		Server *server(int srvnum);
 		bool boot(int);
 		bool banCheck(const QHostAddress &);
 		void kill(int);
 		void killAll();
+		/// Deletes a server that has been removed from qhServers,
+		/// on the thread it runs on.
+		void destroy(Server *);
 		void getOSInfo();
 		void connectListener(QObject *);
 		static void getVersion(int &major, int &minor, int &patch, QString &string);
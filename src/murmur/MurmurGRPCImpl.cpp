@@ -18,6 +18,24 @@
 #include "ServerUser.h"
 #include "Server.h"
 #include "Channel.h"
+#include "ControlThread.h"
+
+#include <google/protobuf/descriptor.h>
+
+// Read-only methods that are answered from a ServerSnapshot when possible.
+// The specializations must be declared before the wrapper classes use them.
+#define MURMUR_RPC_SNAPSHOT_HANDLER(x) \
+	template <> \
+	struct RPCSnapshotHandler< ::MurmurRPC::Wrapper::x > { \
+		static bool handle(::MurmurRPC::Wrapper::x *call); \
+	};
+
+MURMUR_RPC_SNAPSHOT_HANDLER(V1_UserQuery)
+MURMUR_RPC_SNAPSHOT_HANDLER(V1_UserGet)
+MURMUR_RPC_SNAPSHOT_HANDLER(V1_ChannelQuery)
+MURMUR_RPC_SNAPSHOT_HANDLER(V1_ChannelGet)
+MURMUR_RPC_SNAPSHOT_HANDLER(V1_TreeQuery)
+#undef MURMUR_RPC_SNAPSHOT_HANDLER
 
 #include "MurmurRPC.proto.Wrapper.cpp"
 
@@ -74,8 +92,18 @@
 //    is notified of this and executes the "tag" (recall, tags are pointers to
 //    functions). The wrapper method "impl(bool)" for the corresponding RPC
 //    method ends up being called. It is important to note that this impl
-//    method gets executed in the main thread. This prevents data corruption
-//    of murmur's data structures without the need of locks.
+//    method gets executed on the thread of the server that the request is
+//    for (see ControlThread), or in the main thread for requests that are
+//    not for a single server. A server is only ever used from its own
+//    thread, so murmur's data structures need no locks. The few structures
+//    of MurmurRPCImpl that servers share, such as the listener lists, are
+//    guarded by mutexes.
+//
+//    Read-only methods (UserQuery, UserGet, ChannelQuery, ChannelGet and
+//    TreeQuery) are the exception: they are answered directly on the
+//    completion queue thread from the server's published ServerSnapshot,
+//    see RPCSnapshotHandler. They only fall back to the server's thread
+//    when the snapshot cannot answer them.
 //
 //    Additionally, the execution of tags are wrapped with a try-catch. This
 //    try-catch catches any grpc::Status that is thrown. If one is caught, the
@@ -132,7 +160,36 @@ void GRPCStop() {
 	}
 }
 
-MurmurRPCImpl::MurmurRPCImpl(const QString &address, std::shared_ptr<::grpc::ServerCredentials> credentials) : m_cleanupTimer(this) {
+MurmurRPCImpl::MurmurRPCImpl(const QString &address, std::shared_ptr<::grpc::ServerCredentials> credentials) : m_cleanupTimer(this), m_filterTimer(this) {
+	m_eventQueueLimit = qMax(meta->mp.iGRPCEventQueue, 0);
+	const QString &policy = meta->mp.qsGRPCEventPolicy;
+	if (policy == QLatin1String("dropoldest")) {
+		m_eventPolicy = RPCStreamDropOldest;
+	} else if (policy == QLatin1String("disconnect")) {
+		m_eventPolicy = RPCStreamDisconnect;
+	} else {
+		if (policy != QLatin1String("coalesce")) {
+			qWarning("GRPC: unknown event policy '%s', using 'coalesce'", qPrintable(policy));
+		}
+		m_eventPolicy = RPCStreamCoalesce;
+	}
+
+	m_filterTimeout = qMax(meta->mp.iGRPCFilterTimeout, 1);
+	const QString &filterPolicy = meta->mp.qsGRPCFilterPolicy;
+	if (filterPolicy == QLatin1String("reject")) {
+		m_filterFailResult = ::MurmurRPC::TextMessage_Filter_Action_Reject;
+	} else if (filterPolicy == QLatin1String("drop")) {
+		m_filterFailResult = ::MurmurRPC::TextMessage_Filter_Action_Drop;
+	} else {
+		if (filterPolicy != QLatin1String("accept")) {
+			qWarning("GRPC: unknown filter policy '%s', using 'accept'", qPrintable(filterPolicy));
+		}
+		m_filterFailResult = ::MurmurRPC::TextMessage_Filter_Action_Accept;
+	}
+	m_filterClock.start();
+	connect(&m_filterTimer, SIGNAL(timeout()), this, SLOT(expireTextMessageFilters()));
+	m_filterTimer.setSingleShot(true);
+
 	::grpc::ServerBuilder builder;
 	builder.AddListeningPort(u8(address), credentials);
 	builder.RegisterService(&m_V1Service);
@@ -148,6 +205,26 @@ MurmurRPCImpl::MurmurRPCImpl(const QString &address, std::shared_ptr<::grpc::Ser
 MurmurRPCImpl::~MurmurRPCImpl() {
 }
 
+// Applies the configured queue limit and overflow policy to an event stream.
+template <class T>
+void MurmurRPCImpl::limitEventStream(T *listener) {
+	listener->setQueueLimit(m_eventQueueLimit, m_eventPolicy);
+}
+
+// Logs the backlog of an event stream whose client has fallen behind since
+// the last cleanup.
+template <class T>
+void MurmurRPCImpl::logEventStream(T *listener, const char *kind) {
+	RPCStreamStats stats = listener->takeStats();
+	if (stats.uiCoalesced == 0 && stats.uiDropped == 0 && stats.iLag < 1000) {
+		return;
+	}
+	qWarning("GRPC: %s stream %s is lagging: %d queued (peak %d), oldest %lld ms, %llu written, %llu coalesced, %llu dropped",
+		kind, qPrintable(QString::fromStdString(listener->context.peer())), stats.iQueued, stats.iPeak,
+		static_cast<long long>(stats.iLag), static_cast<unsigned long long>(stats.uiWritten),
+		static_cast<unsigned long long>(stats.uiCoalesced), static_cast<unsigned long long>(stats.uiDropped));
+}
+
 // This function periodically runs to clean up disconnected listeners. We need
 // this because (as of 2015-07-21) the grpc library does not tell us when a
 // client disconnects.
@@ -158,10 +235,12 @@ void MurmurRPCImpl::cleanup() {
 			i = m_metaServiceListeners.erase(i);
 			listener->deref();
 		} else {
+			logEventStream(listener, "event");
 			++i;
 		}
 	}
 
+	QMutexLocker l(&qmListenersLock);
 	for (auto i = m_contextActionListeners.begin(); i != m_contextActionListeners.end(); ) {
 		auto &ref = i.value();
 		for (auto j = ref.begin(); j != ref.end(); ) {
@@ -187,10 +266,24 @@ void MurmurRPCImpl::cleanup() {
 			i = m_serverServiceListeners.erase(i);
 			listener->deref();
 		} else {
+			logEventStream(listener, "server event");
+			++i;
+		}
+	}
+
+	for (auto i = m_stateSyncListeners.begin(); i != m_stateSyncListeners.end(); ) {
+		auto listener = i.value();
+		if (listener->context.IsCancelled()) {
+			i = m_stateSyncListeners.erase(i);
+			listener->deref();
+		} else {
+			logEventStream(listener, "state sync");
 			++i;
 		}
 	}
+	l.unlock();
 
+	QMutexLocker al(&qmAuthenticatorsLock);
 	for (auto i = m_authenticators.begin(); i != m_authenticators.end(); ) {
 		auto listener = i.value();
 		if (listener->context.IsCancelled()) {
@@ -212,7 +305,7 @@ void ToRPC(const ::Server *srv, const ::Channel *c, ::MurmurRPC::Channel *rc) {
 		rc->mutable_parent()->mutable_server()->set_id(srv->iServerNum);
 		rc->mutable_parent()->set_id(c->cParent->iId);
 	}
-	rc->set_description(u8(c->qsDesc));
+	rc->set_description(u8(srv->channelDescription(c)));
 	rc->set_position(c->iPosition);
 	foreach(::Channel *chn, c->qsPermLinks) {
 		::MurmurRPC::Channel *linked = rc->add_links();
@@ -259,6 +352,120 @@ void ToRPC(const ::Server *srv, const ::User *u, ::MurmurRPC::User *ru) {
 	ru->set_address(su->haAddress.toStdString());
 }
 
+// Returns false if the description is lazy and not in the description
+// cache, in which case it is left empty.
+bool ToRPC(const ::ServerSnapshot &snapshot, const ::ChannelSnapshot &c, ::MurmurRPC::Channel *rc) {
+	rc->mutable_server()->set_id(snapshot.iServerNum);
+
+	rc->set_id(c.iId);
+	rc->set_name(u8(c.qsName));
+	if (c.iParent >= 0) {
+		rc->mutable_parent()->mutable_server()->set_id(snapshot.iServerNum);
+		rc->mutable_parent()->set_id(c.iParent);
+	}
+	QString desc;
+	const bool described = c.description(desc);
+	rc->set_description(u8(desc));
+	rc->set_position(c.iPosition);
+	foreach(int id, c.qlLinks) {
+		::MurmurRPC::Channel *linked = rc->add_links();
+		linked->mutable_server()->set_id(snapshot.iServerNum);
+		linked->set_id(id);
+	}
+	rc->set_temporary(c.bTemporary);
+	return described;
+}
+
+void ToRPC(const ::ServerSnapshot &snapshot, const ::UserSnapshot &u, ::MurmurRPC::User *ru) {
+	ru->mutable_server()->set_id(snapshot.iServerNum);
+
+	ru->set_session(u.uiSession);
+	if (u.iId >= 0) {
+		ru->set_id(u.iId);
+	}
+	ru->set_name(u8(u.qsName));
+	ru->set_mute(u.bMute);
+	ru->set_deaf(u.bDeaf);
+	ru->set_suppress(u.bSuppress);
+	ru->set_recording(u.bRecording);
+	ru->set_priority_speaker(u.bPrioritySpeaker);
+	ru->set_self_mute(u.bSelfMute);
+	ru->set_self_deaf(u.bSelfDeaf);
+	ru->mutable_channel()->mutable_server()->set_id(snapshot.iServerNum);
+	ru->mutable_channel()->set_id(u.iChannel);
+	ru->set_comment(u8(u.qsComment));
+
+	ru->set_online_secs(u.iOnlineSecs);
+	ru->set_bytes_per_sec(u.iBandwidth);
+	ru->mutable_version()->set_version(u.uiVersion);
+	ru->mutable_version()->set_release(u8(u.qsRelease));
+	ru->mutable_version()->set_os(u8(u.qsOS));
+	ru->mutable_version()->set_os_version(u8(u.qsOSVersion));
+	ru->set_plugin_identity(u8(u.qsIdentity));
+	ru->set_plugin_context(u.ssContext);
+	ru->set_idle_secs(u.iIdleSecs);
+	ru->set_udp_ping_msecs(u.fUDPPing);
+	ru->set_tcp_ping_msecs(u.fTCPPing);
+
+	ru->set_tcp_only(u.bTcpOnly);
+
+	ru->set_address(u.haAddress.toStdString());
+}
+
+// Converts a channel of the snapshot of srv. Unlike the read-only snapshot
+// handlers, this runs on the thread of the server, so lazy descriptions that aren't
+// cached are read from the database.
+void ToRPC(const ::Server *srv, const ::ServerSnapshot &snapshot, const ::ChannelSnapshot &c, ::MurmurRPC::Channel *rc) {
+	if (! ToRPC(snapshot, c, rc)) {
+		const ::Channel *channel = srv->qhChannels.value(c.iId);
+		if (channel) {
+			rc->set_description(u8(srv->channelDescription(channel)));
+		}
+	}
+}
+
+// Converts the full state of a snapshot.
+void ToRPC(const ::Server *srv, const ::ServerSnapshot &snapshot, ::MurmurRPC::StateSync *rs) {
+	rs->mutable_server()->set_id(snapshot.iServerNum);
+	rs->set_epoch(snapshot.uiEpoch);
+	rs->set_version(snapshot.uiVersion);
+	rs->set_snapshot(true);
+	for (auto i = snapshot.qhChannels.constBegin(); i != snapshot.qhChannels.constEnd(); ++i) {
+		ToRPC(srv, snapshot, i.value(), rs->add_channels());
+	}
+	for (auto i = snapshot.qhUsers.constBegin(); i != snapshot.qhUsers.constEnd(); ++i) {
+		ToRPC(snapshot, i.value(), rs->add_users());
+	}
+}
+
+// Converts one change of a snapshot.
+void ToRPC(const ::Server *srv, const ::ServerSnapshot &snapshot, const ::SnapshotDelta &delta, ::MurmurRPC::StateSync *rs) {
+	rs->mutable_server()->set_id(snapshot.iServerNum);
+	rs->set_epoch(snapshot.uiEpoch);
+	rs->set_version(delta.uiVersion);
+	foreach(const ::ChannelSnapshot &c, delta.qlChannels) {
+		ToRPC(srv, snapshot, c, rs->add_channels());
+	}
+	foreach(int id, delta.qlRemovedChannels) {
+		auto rc = rs->add_removed_channels();
+		rc->mutable_server()->set_id(snapshot.iServerNum);
+		rc->set_id(id);
+	}
+	foreach(int id, delta.qlACLChannels) {
+		auto rc = rs->add_acl_changed();
+		rc->mutable_server()->set_id(snapshot.iServerNum);
+		rc->set_id(id);
+	}
+	foreach(const ::UserSnapshot &u, delta.qlUsers) {
+		ToRPC(snapshot, u, rs->add_users());
+	}
+	foreach(unsigned int session, delta.qlRemovedUsers) {
+		auto ru = rs->add_removed_users();
+		ru->mutable_server()->set_id(snapshot.iServerNum);
+		ru->set_session(session);
+	}
+}
+
 void ToRPC(const ::Server *srv, const QMap<int, QString> &info, const QByteArray &texture, ::MurmurRPC::DatabaseUser *du) {
 	du->mutable_server()->set_id(srv->iServerNum);
 
@@ -402,12 +609,15 @@ void MurmurRPCImpl::sendMetaEvent(const ::MurmurRPC::Event &e) {
 	}
 }
 
-// Called when a server starts.
+// Called when a server starts. The slots connected here are called directly
+// on the thread of the server, and lock the state that they share with other
+// servers.
 void MurmurRPCImpl::started(::Server *server) {
 	server->connectListener(this);
 	server->connectAuthenticator(this);
-	connect(server, SIGNAL(contextAction(const User *, const QString &, unsigned int, int)), this, SLOT(contextAction(const User *, const QString &, unsigned int, int)));
-	connect(server, SIGNAL(textMessageFilterSig(int &, const User *, MumbleProto::TextMessage &)), this, SLOT(textMessageFilter(int &, const User *, MumbleProto::TextMessage &)));
+	connect(server, SIGNAL(contextAction(const User *, const QString &, unsigned int, int)), this, SLOT(contextAction(const User *, const QString &, unsigned int, int)), Qt::DirectConnection);
+	connect(server, SIGNAL(textMessageFilterSig(bool &, quint64, const User *, const MumbleProto::TextMessage &)), this, SLOT(textMessageFilter(bool &, quint64, const User *, const MumbleProto::TextMessage &)), Qt::DirectConnection);
+	connect(server, SIGNAL(stateChanged(const ServerSnapshot &)), this, SLOT(stateChanged(const ServerSnapshot &)), Qt::DirectConnection);
 
 	::MurmurRPC::Event rpcEvent;
 	rpcEvent.set_type(::MurmurRPC::Event_Type_ServerStarted);
@@ -418,6 +628,10 @@ void MurmurRPCImpl::started(::Server *server) {
 // Called when a server stops.
 void MurmurRPCImpl::stopped(::Server *server) {
 	removeActiveContextActions(server);
+	{
+		QMutexLocker l(&qmTextMessageFilterLock);
+		m_pendingFilters.remove(server->iServerNum);
+	}
 
 	::MurmurRPC::Event rpcEvent;
 	rpcEvent.set_type(::MurmurRPC::Event_Type_ServerStopped);
@@ -425,38 +639,198 @@ void MurmurRPCImpl::stopped(::Server *server) {
 	sendMetaEvent(rpcEvent);
 }
 
-// Removes a connected text message filter.
-void MurmurRPCImpl::removeTextMessageFilter(const ::Server *s) {
-	auto filter = m_textMessageFilters.value(s->iServerNum);
+// Removes a connected text message filter. Messages that are still waiting
+// for it have to be failed with failTextMessageFilters. The caller has to
+// hold qmTextMessageFilterLock.
+void MurmurRPCImpl::removeTextMessageFilter(int serverID) {
+	auto filter = m_textMessageFilters.value(serverID);
 	if (!filter) {
 		return;
 	}
-	if (filter->context.IsCancelled()) {
+	// Only a call that is still open is finished, so that the filter
+	// learns that it was detached. Messages that are still queued for
+	// it are dropped; see RPCStreamStreamCall::error().
+	if (!filter->context.IsCancelled()) {
 		filter->ref();
 		filter->error(::grpc::Status(::grpc::CANCELLED, "filter detached"));
 	}
-	m_textMessageFilters.remove(s->iServerNum);
+	m_textMessageFilters.remove(serverID);
 	filter->deref();
 }
 
-// Removes a connected authenticator.
+// Reads the next answer from a text message filter. The filter may answer
+// messages in any order; answers carry the ID of the message they belong to.
+void MurmurRPCImpl::readTextMessageFilter(int serverID, ::MurmurRPC::Wrapper::V1_TextMessageFilter *filter) {
+	filter->ref();
+	auto onRead = [this, serverID] (::MurmurRPC::Wrapper::V1_TextMessageFilter *filter, bool ok) {
+		QMutexLocker l(&qmTextMessageFilterLock);
+		if (m_textMessageFilters.value(serverID) != filter) {
+			// The filter has been replaced or removed.
+			l.unlock();
+			filter->deref();
+			return;
+		}
+		if (!ok) {
+			removeTextMessageFilter(serverID);
+			l.unlock();
+			failTextMessageFilters(serverID);
+			filter->deref();
+			return;
+		}
+
+		const auto &response = filter->request;
+		auto &pending = m_pendingFilters[serverID];
+		int index = -1;
+		if (!response.has_id()) {
+			index = pending.isEmpty() ? -1 : 0;
+		} else {
+			for (int i = 0; i < pending.count(); i++) {
+				if (pending.at(i).id == response.id()) {
+					index = i;
+					break;
+				}
+			}
+		}
+
+		// Answers for messages that have already timed out are ignored.
+		quint64 id = 0;
+		if (index >= 0) {
+			id = pending.takeAt(index).id;
+		}
+		l.unlock();
+
+		if (index >= 0) {
+			QString text;
+			if (response.action() == ::MurmurRPC::TextMessage_Filter_Action_Accept && response.has_message() && response.message().has_text()) {
+				text = u8(response.message().text());
+			}
+			textMessageFiltered(serverID, id, response.action(), text);
+		}
+
+		readTextMessageFilter(serverID, filter);
+		filter->deref();
+	};
+	filter->stream.Read(&filter->request, filter->callback(onRead));
+}
+
+static void applyTextMessageFilter(int serverID, quint64 id, int result, const QString &text) {
+	auto server = meta->server(serverID);
+	if (server) {
+		server->textMessageFiltered(id, result, text);
+	}
+}
+
+// Hands the verdict for a text message back to its server, on the server's
+// thread. Must not be called while holding qmTextMessageFilterLock, as the
+// server may send the next message to the filter right away.
+void MurmurRPCImpl::textMessageFiltered(int serverID, quint64 id, int result, const QString &text) {
+	ControlThread::execute(serverID, ::boost::bind(&applyTextMessageFilter, serverID, id, result, text));
+}
+
+// Applies the configured policy to all messages that wait for the text
+// message filter of a server.
+void MurmurRPCImpl::failTextMessageFilters(int serverID) {
+	QList<PendingFilter> pending;
+	{
+		QMutexLocker l(&qmTextMessageFilterLock);
+		pending = m_pendingFilters.take(serverID);
+	}
+	foreach(const PendingFilter &pf, pending) {
+		textMessageFiltered(serverID, pf.id, m_filterFailResult);
+	}
+}
+
+// Arms the filter timer for the earliest deadline of all pending messages.
+// Only called on the main thread, which the timer lives on.
+void MurmurRPCImpl::armTextMessageFilterTimer() {
+	qint64 next = -1;
+	{
+		QMutexLocker l(&qmTextMessageFilterLock);
+		for (auto i = m_pendingFilters.constBegin(); i != m_pendingFilters.constEnd(); ++i) {
+			if (!i.value().isEmpty() && (next < 0 || i.value().first().deadline < next)) {
+				next = i.value().first().deadline;
+			}
+		}
+	}
+	if (next < 0) {
+		m_filterTimer.stop();
+	} else {
+		m_filterTimer.start(static_cast<int>(qMax(next - m_filterClock.elapsed(), Q_INT64_C(0))));
+	}
+}
+
+// Applies the configured policy to messages whose filter didn't answer in
+// time. All messages share the same timeout, so the oldest message of each
+// server is the first to expire.
+void MurmurRPCImpl::expireTextMessageFilters() {
+	qint64 now = m_filterClock.elapsed();
+	QList<QPair<int, quint64> > expired;
+	{
+		QMutexLocker l(&qmTextMessageFilterLock);
+		for (auto i = m_pendingFilters.begin(); i != m_pendingFilters.end(); ) {
+			auto &pending = i.value();
+			while (!pending.isEmpty() && pending.first().deadline <= now) {
+				expired << qMakePair(i.key(), pending.takeFirst().id);
+			}
+			if (pending.isEmpty()) {
+				i = m_pendingFilters.erase(i);
+			} else {
+				++i;
+			}
+		}
+	}
+
+	for (auto i = expired.constBegin(); i != expired.constEnd(); ++i) {
+		textMessageFiltered((*i).first, (*i).second, m_filterFailResult);
+	}
+	if (!expired.isEmpty()) {
+		qWarning("GRPC: %d text messages timed out in the text message filter", expired.count());
+	}
+
+	armTextMessageFilterTimer();
+}
+
+// Removes a connected authenticator. The caller must not hold
+// qmAuthenticatorsLock, as a round trip of the server may have to finish
+// first.
 void MurmurRPCImpl::removeAuthenticator(const ::Server *s) {
-	auto authenticator = m_authenticators.value(s->iServerNum);
+	::MurmurRPC::Wrapper::V1_AuthenticatorStream *authenticator;
+	{
+		QMutexLocker l(&qmAuthenticatorsLock);
+		authenticator = m_authenticators.take(s->iServerNum);
+	}
 	if (!authenticator) {
 		return;
 	}
 	if (!authenticator->context.IsCancelled()) {
+		QMutexLocker l(&authenticator->m_callLock);
 		authenticator->ref();
 		authenticator->error(::grpc::Status(::grpc::CANCELLED, "authenticator detached"));
 	}
-	m_authenticators.remove(s->iServerNum);
 	authenticator->deref();
 }
 
+// Sends the request in the authenticator's response field, and waits for the
+// answer. Round trips of servers on different threads run in parallel. An
+// authenticator whose stream fails is removed.
+template <class T>
+bool MurmurRPCImpl::authenticatorWriteRead(const ::Server *s, T &authenticator) {
+	{
+		QMutexLocker l(&authenticator->m_callLock);
+		if (authenticator->writeRead()) {
+			return true;
+		}
+	}
+	removeAuthenticator(s);
+	return false;
+}
+
 // Called when a connecting user needs to be authenticated.
 void MurmurRPCImpl::authenticateSlot(int &res, QString &uname, int sessionId, const QList<QSslCertificate> &certlist, const QString &certhash, bool certstrong, const QString &pw) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -476,13 +850,9 @@ void MurmurRPCImpl::authenticateSlot(int &res, QString &uname, int sessionId, co
 		request.mutable_authenticate()->set_strong_certificate(certstrong);
 	}
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			res = -1;
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		res = -1;
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -522,8 +892,10 @@ void MurmurRPCImpl::authenticateSlot(int &res, QString &uname, int sessionId, co
 
 // Called when a user is being registered on the server.
 void MurmurRPCImpl::registerUserSlot(int &res, const QMap<int, QString> &info) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -532,12 +904,8 @@ void MurmurRPCImpl::registerUserSlot(int &res, const QMap<int, QString> &info) {
 	request.Clear();
 	ToRPC(s, info, QByteArray(), request.mutable_register_()->mutable_user());
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -559,8 +927,10 @@ void MurmurRPCImpl::registerUserSlot(int &res, const QMap<int, QString> &info) {
 
 // Called when a user is being deregistered on the server.
 void MurmurRPCImpl::unregisterUserSlot(int &res, int id) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -570,12 +940,8 @@ void MurmurRPCImpl::unregisterUserSlot(int &res, int id) {
 	request.mutable_deregister()->mutable_user()->mutable_server()->set_id(s->iServerNum);
 	request.mutable_deregister()->mutable_user()->set_id(id);
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -587,8 +953,10 @@ void MurmurRPCImpl::unregisterUserSlot(int &res, int id) {
 
 // Called when a list of registered users is requested.
 void MurmurRPCImpl::getRegisteredUsersSlot(const QString &filter, QMap<int, QString> &res) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -599,12 +967,8 @@ void MurmurRPCImpl::getRegisteredUsersSlot(const QString &filter, QMap<int, QStr
 		request.mutable_query()->set_filter(u8(filter));
 	}
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -620,8 +984,10 @@ void MurmurRPCImpl::getRegisteredUsersSlot(const QString &filter, QMap<int, QStr
 
 // Called when information about a registered user is requested.
 void MurmurRPCImpl::getRegistrationSlot(int &res, int id, QMap<int, QString> &info) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -632,12 +998,8 @@ void MurmurRPCImpl::getRegistrationSlot(int &res, int id, QMap<int, QString> &in
 
 	res = -1;
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -649,8 +1011,10 @@ void MurmurRPCImpl::getRegistrationSlot(int &res, int id, QMap<int, QString> &in
 
 // Called when information about a registered user is being updated.
 void MurmurRPCImpl::setInfoSlot(int &res, int id, const QMap<int, QString> &info) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -662,12 +1026,8 @@ void MurmurRPCImpl::setInfoSlot(int &res, int id, const QMap<int, QString> &info
 
 	res = 0;
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -685,8 +1045,10 @@ void MurmurRPCImpl::setInfoSlot(int &res, int id, const QMap<int, QString> &info
 
 // Called when a texture for a registered user is being updated.
 void MurmurRPCImpl::setTextureSlot(int &res, int id, const QByteArray &texture) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -696,12 +1058,8 @@ void MurmurRPCImpl::setTextureSlot(int &res, int id, const QByteArray &texture)
 	request.mutable_update()->mutable_user()->set_id(id);
 	request.mutable_update()->mutable_user()->set_texture(texture.constData(), texture.size());
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -712,8 +1070,10 @@ void MurmurRPCImpl::setTextureSlot(int &res, int id, const QByteArray &texture)
 
 // Called when a user name needs to be converted to a user ID.
 void MurmurRPCImpl::nameToIdSlot(int &res, const QString &name) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -722,12 +1082,8 @@ void MurmurRPCImpl::nameToIdSlot(int &res, const QString &name) {
 	request.Clear();
 	request.mutable_find()->set_name(u8(name));
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -738,8 +1094,10 @@ void MurmurRPCImpl::nameToIdSlot(int &res, const QString &name) {
 
 // Called when a user ID needs to be converted to a user name.
 void MurmurRPCImpl::idToNameSlot(QString &res, int id) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -748,12 +1106,8 @@ void MurmurRPCImpl::idToNameSlot(QString &res, int id) {
 	request.Clear();
 	request.mutable_find()->set_id(id);
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -764,8 +1118,10 @@ void MurmurRPCImpl::idToNameSlot(QString &res, int id) {
 
 // Called when a texture for a given registered user is requested.
 void MurmurRPCImpl::idToTextureSlot(QByteArray &res, int id) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmAuthenticatorsLock);
 	auto authenticator = RPCCall::Ref<::MurmurRPC::Wrapper::V1_AuthenticatorStream>(m_authenticators.value(s->iServerNum));
+	l.unlock();
 	if (!authenticator) {
 		return;
 	}
@@ -774,12 +1130,8 @@ void MurmurRPCImpl::idToTextureSlot(QByteArray &res, int id) {
 	request.Clear();
 	request.mutable_find()->set_id(id);
 
-	{
-		QMutexLocker l(&qmAuthenticatorsLock);
-		if (!authenticator->writeRead()) {
-			removeAuthenticator(s);
-			return;
-		}
+	if (!authenticatorWriteRead(s, authenticator)) {
+		return;
 	}
 
 	auto &response = authenticator->request;
@@ -790,27 +1142,91 @@ void MurmurRPCImpl::idToTextureSlot(QByteArray &res, int id) {
 }
 
 // Sends a server event to subscribed listeners.
+//
+// State changes carry a key identifying the user or channel, so that a
+// listener that has fallen behind only receives the newest state of each.
 void MurmurRPCImpl::sendServerEvent(const ::Server *s, const ::MurmurRPC::Server_Event &e) {
-	auto listeners = m_serverServiceListeners;
+	quint64 key = 0;
+	switch (e.type()) {
+		case ::MurmurRPC::Server_Event_Type_UserStateChanged:
+			key = (1ULL << 32) | e.user().session();
+			break;
+		case ::MurmurRPC::Server_Event_Type_ChannelStateChanged:
+			key = (2ULL << 32) | e.channel().id();
+			break;
+		default:
+			break;
+	}
+
 	auto serverID = s->iServerNum;
-	auto i = listeners.find(serverID);
+	QList<::MurmurRPC::Wrapper::V1_ServerEvents *> listeners;
+	{
+		QMutexLocker l(&qmListenersLock);
+		listeners = m_serverServiceListeners.values(serverID);
+		foreach(auto listener, listeners) {
+			listener->ref();
+		}
+	}
 
-	for ( ; i != listeners.end() && i.key() == serverID; ++i) {
-		auto listener = i.value();
-		listener->ref();
+	foreach(auto listener, listeners) {
 		auto cb = [this, listener, serverID] (::MurmurRPC::Wrapper::V1_ServerEvents *, bool ok) {
-			if (!ok && m_serverServiceListeners.remove(serverID, listener) > 0) {
-				listener->deref();
+			if (!ok) {
+				QMutexLocker l(&qmListenersLock);
+				if (m_serverServiceListeners.remove(serverID, listener) > 0) {
+					listener->deref();
+				}
 			}
 			listener->deref();
 		};
-		listener->write(e, listener->callback(cb));
+		listener->write(e, listener->callback(cb), key);
+	}
+}
+
+// Sends a state sync message. A mirror can't skip a change, so a stream that
+// falls too far behind is disconnected, and has to resume from the last
+// version it applied.
+void MurmurRPCImpl::sendStateSync(int serverID, ::MurmurRPC::Wrapper::V1_StateSync *listener, const ::MurmurRPC::StateSync &sync) {
+	listener->ref();
+	auto cb = [this, listener, serverID] (::MurmurRPC::Wrapper::V1_StateSync *, bool ok) {
+		if (!ok) {
+			QMutexLocker l(&qmListenersLock);
+			if (m_stateSyncListeners.remove(serverID, listener) > 0) {
+				listener->deref();
+			}
+		}
+		listener->deref();
+	};
+	listener->write(sync, listener->callback(cb));
+}
+
+// Called when a server publishes a new version of its state.
+void MurmurRPCImpl::stateChanged(const ::ServerSnapshot &snapshot) {
+	::Server *s = ListenerCall::server();
+	auto serverID = s->iServerNum;
+	QList<::MurmurRPC::Wrapper::V1_StateSync *> listeners;
+	{
+		QMutexLocker l(&qmListenersLock);
+		listeners = m_stateSyncListeners.values(serverID);
+		foreach(auto listener, listeners) {
+			listener->ref();
+		}
+	}
+	if (listeners.isEmpty()) {
+		return;
+	}
+
+	::MurmurRPC::StateSync sync;
+	ToRPC(s, snapshot, snapshot.qlDeltas.last(), &sync);
+
+	foreach(auto listener, listeners) {
+		sendStateSync(serverID, listener, sync);
+		listener->deref();
 	}
 }
 
 // Called when a user's state changes.
 void MurmurRPCImpl::userStateChanged(const ::User *user) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	::MurmurRPC::Server_Event event;
 	event.mutable_server()->set_id(s->iServerNum);
@@ -821,7 +1237,7 @@ void MurmurRPCImpl::userStateChanged(const ::User *user) {
 
 // Called when a user sends a text message.
 void MurmurRPCImpl::userTextMessage(const ::User *user, const ::TextMessage &message) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	::MurmurRPC::Server_Event event;
 	event.mutable_server()->set_id(s->iServerNum);
@@ -833,7 +1249,7 @@ void MurmurRPCImpl::userTextMessage(const ::User *user, const ::TextMessage &mes
 
 // Called when a user successfully connects to a server.
 void MurmurRPCImpl::userConnected(const ::User *user) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	::MurmurRPC::Server_Event event;
 	event.mutable_server()->set_id(s->iServerNum);
@@ -844,7 +1260,7 @@ void MurmurRPCImpl::userConnected(const ::User *user) {
 
 // Called when a user disconnects from a server.
 void MurmurRPCImpl::userDisconnected(const ::User *user) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	removeUserActiveContextActions(s, user);
 
@@ -857,7 +1273,7 @@ void MurmurRPCImpl::userDisconnected(const ::User *user) {
 
 // Called when a channel's state changes.
 void MurmurRPCImpl::channelStateChanged(const ::Channel *channel) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	::MurmurRPC::Server_Event event;
 	event.mutable_server()->set_id(s->iServerNum);
@@ -868,7 +1284,7 @@ void MurmurRPCImpl::channelStateChanged(const ::Channel *channel) {
 
 // Called when a channel is created.
 void MurmurRPCImpl::channelCreated(const ::Channel *channel) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	::MurmurRPC::Server_Event event;
 	event.mutable_server()->set_id(s->iServerNum);
@@ -879,7 +1295,7 @@ void MurmurRPCImpl::channelCreated(const ::Channel *channel) {
 
 // Called when a channel is removed.
 void MurmurRPCImpl::channelRemoved(const ::Channel *channel) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	::MurmurRPC::Server_Event event;
 	event.mutable_server()->set_id(s->iServerNum);
@@ -888,17 +1304,21 @@ void MurmurRPCImpl::channelRemoved(const ::Channel *channel) {
 	sendServerEvent(s, event);
 }
 
-// Called when a user sends a text message.
-void MurmurRPCImpl::textMessageFilter(int &res, const User *user, MumbleProto::TextMessage &message) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+// Called when a user sends a text message. The message is sent to the
+// filter of the server, if there is one, and the server holds on to it until
+// the filter answers, or the answer times out.
+void MurmurRPCImpl::textMessageFilter(bool &pending, quint64 id, const User *user, const MumbleProto::TextMessage &message) {
+	::Server *s = ListenerCall::server();
+	QMutexLocker l(&qmTextMessageFilterLock);
 	auto filter = RPCCall::Ref<::MurmurRPC::Wrapper::V1_TextMessageFilter>(m_textMessageFilters.value(s->iServerNum));
+	l.unlock();
 	if (!filter) {
 		return;
 	}
 
-	auto &request = filter->response;
-	request.Clear();
+	::MurmurRPC::TextMessage_Filter request;
 	request.mutable_server()->set_id(s->iServerNum);
+	request.set_id(id);
 	auto m = request.mutable_message();
 	m->mutable_server()->set_id(s->iServerNum);
 	m->mutable_actor()->mutable_server()->set_id(s->iServerNum);
@@ -920,29 +1340,36 @@ void MurmurRPCImpl::textMessageFilter(int &res, const User *user, MumbleProto::T
 	}
 	m->set_text(message.message());
 
-	{
-		QMutexLocker l(&qmTextMessageFilterLock);
-		if (!filter->writeRead()) {
-			removeTextMessageFilter(s);
-			return;
-		}
+	if (!filter->queueWrite(request)) {
+		l.relock();
+		removeTextMessageFilter(s->iServerNum);
+		l.unlock();
+		failTextMessageFilters(s->iServerNum);
+		return;
 	}
 
-	auto &response = filter->request;
-	res = response.action();
-	switch (response.action()) {
-	case ::MurmurRPC::TextMessage_Filter_Action_Accept:
-		if (response.has_message() && response.message().has_text()) {
-			message.set_message(response.message().text());
+	PendingFilter pf;
+	pf.id = id;
+	pf.deadline = m_filterClock.elapsed() + m_filterTimeout;
+	l.relock();
+	m_pendingFilters[s->iServerNum].append(pf);
+	l.unlock();
+
+	// Servers on control threads can't use the timer, which lives on
+	// the main thread. Expiring arms it as well.
+	if (QThread::currentThread() == thread()) {
+		if (!m_filterTimer.isActive()) {
+			armTextMessageFilterTimer();
 		}
-		break;
-	default:
-		break;
+	} else {
+		QMetaObject::invokeMethod(this, "expireTextMessageFilters", Qt::QueuedConnection);
 	}
+	pending = true;
 }
 
 // Has the user been sent the given context action?
 bool MurmurRPCImpl::hasActiveContextAction(const ::Server *s, const ::User *u, const QString &action) {
+	QMutexLocker l(&qmListenersLock);
 	const auto &m = m_activeContextActions;
 	if (!m.contains(s->iServerNum)) {
 		return false;
@@ -960,11 +1387,13 @@ bool MurmurRPCImpl::hasActiveContextAction(const ::Server *s, const ::User *u, c
 
 // Add the context action to the user's active context actions.
 void MurmurRPCImpl::addActiveContextAction(const ::Server *s, const ::User *u, const QString &action) {
+	QMutexLocker l(&qmListenersLock);
 	m_activeContextActions[s->iServerNum][u->uiSession].insert(action);
 }
 
 // Remove the context action to the user's active context actions.
 void MurmurRPCImpl::removeActiveContextAction(const ::Server *s, const ::User *u, const QString &action) {
+	QMutexLocker l(&qmListenersLock);
 	auto &m = m_activeContextActions;
 	if (!m.contains(s->iServerNum)) {
 		return;
@@ -979,6 +1408,7 @@ void MurmurRPCImpl::removeActiveContextAction(const ::Server *s, const ::User *u
 
 // Remove all of the user's active context actions.
 void MurmurRPCImpl::removeUserActiveContextActions(const ::Server *s, const ::User *u) {
+	QMutexLocker l(&qmListenersLock);
 	auto &m = m_activeContextActions;
 	if (m.contains(s->iServerNum)) {
 		m[s->iServerNum].remove(u->uiSession);
@@ -987,6 +1417,7 @@ void MurmurRPCImpl::removeUserActiveContextActions(const ::Server *s, const ::Us
 
 // Remove all of the server's active context actions.
 void MurmurRPCImpl::removeActiveContextActions(const ::Server *s) {
+	QMutexLocker l(&qmListenersLock);
 	auto &m = m_activeContextActions;
 	if (m.contains(s->iServerNum)) {
 		m.remove(s->iServerNum);
@@ -995,7 +1426,7 @@ void MurmurRPCImpl::removeActiveContextActions(const ::Server *s) {
 
 // Called when a context action event is triggered.
 void MurmurRPCImpl::contextAction(const ::User *user, const QString &action, unsigned int session, int channel) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
 	if (!hasActiveContextAction(s, user, action)) {
 		return;
@@ -1016,14 +1447,22 @@ void MurmurRPCImpl::contextAction(const ::User *user, const QString &action, uns
 	}
 
 	auto serverID = s->iServerNum;
-	auto listeners = this->m_contextActionListeners.value(serverID);
-	auto i = listeners.find(action);
-	for ( ; i != listeners.end() && i.key() == action; ++i) {
-		auto listener = i.value();
-		listener->ref();
+	QList<::MurmurRPC::Wrapper::V1_ContextActionEvents *> listeners;
+	{
+		QMutexLocker l(&qmListenersLock);
+		listeners = m_contextActionListeners.value(serverID).values(action);
+		foreach(auto listener, listeners) {
+			listener->ref();
+		}
+	}
+
+	foreach(auto listener, listeners) {
 		auto cb = [this, listener, serverID, action] (::MurmurRPC::Wrapper::V1_ContextActionEvents *, bool ok) {
-			if (!ok && m_contextActionListeners[serverID].remove(action, listener) > 0) {
-				listener->deref();
+			if (!ok) {
+				QMutexLocker l(&qmListenersLock);
+				if (m_contextActionListeners[serverID].remove(action, listener) > 0) {
+					listener->deref();
+				}
 			}
 			listener->deref();
 		};
@@ -1058,7 +1497,7 @@ template <>
 }
 
 ::Server *MustServer(unsigned int id) {
-	auto server = meta->qhServers.value(id);
+	auto server = meta->server(id);
 	if (!server) {
 		throw ::grpc::Status(::grpc::NOT_FOUND, "invalid server");
 	}
@@ -1066,7 +1505,7 @@ template <>
 }
 
 ::Server *MustServer(int id) {
-	auto server = meta->qhServers.value(id);
+	auto server = meta->server(id);
 	if (!server) {
 		throw ::grpc::Status(::grpc::NOT_FOUND, "invalid server");
 	}
@@ -1150,18 +1589,65 @@ template <>
 	return MustChannel(server, msg.id());
 }
 
-// Qt event listener for RPCExecEvents.
+// Qt event listener for RPCExecEvents that are not for a single server.
 void MurmurRPCImpl::customEvent(QEvent *evt) {
 	if (evt->type() == EXEC_QEVENT) {
-		auto event = static_cast<RPCExecEvent *>(evt);
-		try {
-			event->execute();
-		} catch (::grpc::Status &ex) {
-			event->call->error(ex);
+		static_cast<RPCExecEvent *>(evt)->execute();
+	}
+}
+
+void RPCExecEvent::execute() {
+	try {
+		ExecEvent::execute();
+	} catch (::grpc::Status &ex) {
+		call->error(ex);
+	}
+
+	// Make changes made by the call visible to read-only calls that are
+	// answered from snapshots.
+	if (serverID >= 0) {
+		::Server *s = meta->server(serverID);
+		if (s) {
+			s->publishSnapshot();
 		}
 	}
 }
 
+// Returns the id in the "server" field of request, or -1 if the request
+// doesn't name a server.
+static int requestServerID(const ::google::protobuf::Message *request) {
+	if (!request) {
+		return -1;
+	}
+	auto field = request->GetDescriptor()->FindFieldByName("server");
+	if (!field || field->is_repeated() || field->cpp_type() != ::google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE || field->message_type() != ::MurmurRPC::Server::descriptor()) {
+		return -1;
+	}
+	auto reflection = request->GetReflection();
+	if (!reflection->HasField(*request, field)) {
+		return -1;
+	}
+	auto &server = static_cast<const ::MurmurRPC::Server &>(reflection->GetMessage(*request, field));
+	if (!server.has_id()) {
+		return -1;
+	}
+	return static_cast<int>(server.id());
+}
+
+// Executes the impl of a call on the thread of the server that request is
+// for, or on the main thread if it isn't for a single server. Requests that
+// start, stop or remove servers are Server messages themselves, so they
+// always run on the main thread.
+void MurmurRPCImpl::post(RPCExecEvent *ie, const ::google::protobuf::Message *request) {
+	ie->serverID = requestServerID(request);
+	ControlThread *t = (ie->serverID >= 0) ? ControlThread::forServer(ie->serverID) : NULL;
+	if (t) {
+		t->post(ie);
+	} else {
+		QCoreApplication::instance()->postEvent(this, ie);
+	}
+}
+
 // QThread::run() implementation that runs the grpc event loop and executes
 // tags as callback functions.
 void MurmurRPCImpl::run() {
@@ -1184,7 +1670,9 @@ void MurmurRPCImpl::run() {
 }
 
 // The Wrapper implementation methods are below. Implementation methods are
-// executed in the main thread when its corresponding grpc method is invoked.
+// executed on the thread of the server that the request is for, or in the
+// main thread, when its corresponding grpc method is invoked. See
+// MurmurRPCImpl::post.
 //
 // Since the grpc asynchronous API is used, the implementation methods below
 // do not have to complete the call during the lifetime of the method (although
@@ -1262,9 +1750,46 @@ void V1_ServerRemove::impl(bool) {
 
 void V1_ServerEvents::impl(bool) {
 	auto server = MustServer(request);
+	rpc->limitEventStream(this);
+	QMutexLocker l(&rpc->qmListenersLock);
 	rpc->m_serverServiceListeners.insert(server->iServerNum, this);
 }
 
+void V1_StateSync::impl(bool) {
+	auto server = MustServer(request);
+	setQueueLimit(rpc->m_eventQueueLimit, RPCStreamDisconnect);
+
+	// Publish pending changes first, so that the stream continues exactly
+	// where the snapshot or the replayed changes end.
+	server->publishSnapshot();
+	::ServerSnapshot snapshot;
+	::ServerSnapshot::get(server->iServerNum, snapshot);
+
+	// A replay that fills more than half of the queue could overflow it
+	// as soon as live changes come in, which would close the stream on
+	// every attempt to resume. Clients that far behind get the full
+	// state in one message instead.
+	QList< ::SnapshotDelta> deltas;
+	bool replay = request.has_epoch() && request.has_version() && snapshot.deltasSince(request.epoch(), request.version(), deltas);
+	if (replay && (rpc->m_eventQueueLimit > 0) && (deltas.count() > rpc->m_eventQueueLimit / 2)) {
+		replay = false;
+	}
+	if (replay) {
+		foreach(const ::SnapshotDelta &delta, deltas) {
+			::MurmurRPC::StateSync sync;
+			ToRPC(server, snapshot, delta, &sync);
+			rpc->sendStateSync(server->iServerNum, this, sync);
+		}
+	} else {
+		::MurmurRPC::StateSync sync;
+		ToRPC(server, snapshot, &sync);
+		rpc->sendStateSync(server->iServerNum, this, sync);
+	}
+
+	QMutexLocker l(&rpc->qmListenersLock);
+	rpc->m_stateSyncListeners.insert(server->iServerNum, this);
+}
+
 void V1_GetUptime::impl(bool) {
 	::MurmurRPC::Uptime uptime;
 	uptime.set_secs(meta->tUptime.elapsed()/1000000LL);
@@ -1282,6 +1807,7 @@ void V1_GetVersion::impl(bool) {
 }
 
 void V1_Events::impl(bool) {
+	rpc->limitEventStream(this);
 	rpc->m_metaServiceListeners.insert(this);
 }
 
@@ -1347,6 +1873,7 @@ void V1_ContextActionEvents::impl(bool) {
 		throw ::grpc::Status(::grpc::INVALID_ARGUMENT, "missing action");
 	}
 
+	QMutexLocker l(&rpc->qmListenersLock);
 	rpc->m_contextActionListeners[server->iServerNum].insert(u8(request.action()), this);
 }
 
@@ -1386,9 +1913,13 @@ void V1_TextMessageFilter::impl(bool) {
 			return;
 		}
 		auto server = MustServer(request);
-		QMutexLocker l(&rpc->qmTextMessageFilterLock);
-		rpc->removeTextMessageFilter(server);
-		rpc->m_textMessageFilters.insert(server->iServerNum, this);
+		{
+			QMutexLocker l(&rpc->qmTextMessageFilterLock);
+			rpc->removeTextMessageFilter(server->iServerNum);
+			rpc->m_textMessageFilters.insert(server->iServerNum, this);
+		}
+		rpc->failTextMessageFilters(server->iServerNum);
+		rpc->readTextMessageFilter(server->iServerNum, this);
 	};
 	stream.Read(&request, callback(onInitialize));
 }
@@ -1594,6 +2125,93 @@ void V1_ChannelUpdate::impl(bool) {
 	end(rpcChannel);
 }
 
+// Returns the batch channel ID for a channel or a reference to an Add
+// operation of the batch.
+static int BatchChannel(bool hasRef, unsigned int ref, bool hasChannel, const ::MurmurRPC::Channel &channel) {
+	if (hasRef) {
+		return ::ChannelBatch::ref(static_cast<int>(ref));
+	}
+	if (!hasChannel || !channel.has_id()) {
+		throw ::grpc::Status(::grpc::INVALID_ARGUMENT, "missing channel");
+	}
+	return static_cast<int>(channel.id());
+}
+
+void V1_ChannelBatchApply::impl(bool) {
+	auto server = MustServer(request);
+
+	::ChannelBatch batch;
+	for (int i = 0; i < request.operations_size(); i++) {
+		auto &rpcOp = request.operations(i);
+		::ChannelBatch::Op op;
+		op.type = static_cast< ::ChannelBatch::OpType>(rpcOp.type());
+		op.iChannel = BatchChannel(rpcOp.has_channel_ref(), rpcOp.channel_ref(), rpcOp.has_channel(), rpcOp.channel());
+		if (op.type == ::ChannelBatch::Link || op.type == ::ChannelBatch::Unlink) {
+			op.iOther = BatchChannel(rpcOp.has_other_ref(), rpcOp.other_ref(), rpcOp.has_other(), rpcOp.other());
+		}
+		if (rpcOp.has_name()) {
+			op.qsName = u8(rpcOp.name());
+		}
+		if (rpcOp.has_description()) {
+			op.qsDesc = u8(rpcOp.description());
+		}
+		if (rpcOp.has_position()) {
+			op.bPosition = true;
+			op.iPosition = rpcOp.position();
+		}
+		if (op.type == ::ChannelBatch::SetACL) {
+			auto &acl = rpcOp.acl();
+			op.bInheritACL = acl.inherit();
+			for (int j = 0; j < acl.groups_size(); j++) {
+				auto &rpcGroup = acl.groups(j);
+				::ChannelBatch::Group group;
+				group.qsName = u8(rpcGroup.name());
+				group.bInherit = rpcGroup.inherit();
+				group.bInheritable = rpcGroup.inheritable();
+				for (int k = 0; k < rpcGroup.users_add_size(); k++) {
+					group.qsAdd.insert(rpcGroup.users_add(k).id());
+				}
+				for (int k = 0; k < rpcGroup.users_remove_size(); k++) {
+					group.qsRemove.insert(rpcGroup.users_remove(k).id());
+				}
+				op.qlGroups << group;
+			}
+			for (int j = 0; j < acl.acls_size(); j++) {
+				auto &rpcACL = acl.acls(j);
+				::ChannelBatch::ACL batchACL;
+				batchACL.bApplyHere = rpcACL.apply_here();
+				batchACL.bApplySubs = rpcACL.apply_subs();
+				if (rpcACL.has_user()) {
+					batchACL.iUserId = rpcACL.user().id();
+				}
+				if (rpcACL.has_group() && rpcACL.group().has_name()) {
+					batchACL.qsGroup = u8(rpcACL.group().name());
+				}
+				batchACL.pDeny = static_cast<ChanACL::Permissions>(rpcACL.deny()) & ChanACL::All;
+				batchACL.pAllow = static_cast<ChanACL::Permissions>(rpcACL.allow()) & ChanACL::All;
+				op.qlACLs << batchACL;
+			}
+		}
+		batch.qlOps << op;
+	}
+
+	QList<int> added;
+	QString err;
+	if (server->applyChannelBatch(batch, added, err) != ::ChannelBatch::Ok) {
+		throw ::grpc::Status(::grpc::INVALID_ARGUMENT, u8(err));
+	}
+
+	::MurmurRPC::Channel_List list;
+	list.mutable_server()->set_id(server->iServerNum);
+	foreach(int id, added) {
+		auto channel = server->qhChannels.value(id);
+		if (channel) {
+			ToRPC(server, channel, list.add_channels());
+		}
+	}
+	end(list);
+}
+
 void V1_UserQuery::impl(bool) {
 	auto server = MustServer(request);
 
@@ -1622,7 +2240,7 @@ void V1_UserGet::impl(bool) {
 	} else if (request.has_name()) {
 		// Lookup user by name
 		QString qsName = u8(request.name());
-		foreach(const ::ServerUser *user, server->qhUsers) {
+		foreach(const ::ServerUser *user, server->qmhUsersByName.values(qsName.toLower())) {
 			if (user->qsName == qsName) {
 				ToRPC(server, user, &rpcUser);
 				end(rpcUser);
@@ -1888,6 +2506,7 @@ void V1_ACLSet::impl(bool) {
 
 	server->clearACLCache();
 	server->updateChannel(channel);
+	server->markSnapshotACL(channel);
 
 	end();
 }
@@ -1974,8 +2593,8 @@ void V1_AuthenticatorStream::impl(bool) {
 			throw ::grpc::Status(::grpc::INVALID_ARGUMENT, "missing initialize");
 		}
 		auto server = MustServer(request.initialize());
-		QMutexLocker l(&rpc->qmAuthenticatorsLock);
 		rpc->removeAuthenticator(server);
+		QMutexLocker l(&rpc->qmAuthenticatorsLock);
 		rpc->m_authenticators.insert(server->iServerNum, this);
 	};
 	stream.Read(&request, callback(onInitialize));
@@ -2041,19 +2660,17 @@ void V1_DatabaseUserUpdate::impl(bool) {
 	}
 
 	if (info.contains(ServerDB::User_Name) || info.contains(ServerDB::User_Comment)) {
-		foreach(::ServerUser *u, server->qhUsers) {
-			if (static_cast<unsigned int>(u->iId) == request.id()) {
-				QString name = u->qsName;
-				QString comment = u->qsComment;
-				if (info.contains(ServerDB::User_Name)) {
-					comment = info.value(ServerDB::User_Name);
-				}
-				if (info.contains(ServerDB::User_Comment)) {
-					comment = info.value(ServerDB::User_Comment);
-				}
-				server->setUserState(u, u->cChannel, u->bMute, u->bDeaf, u->bSuppress, u->bPrioritySpeaker, name, comment);
-				break;
+		::ServerUser *u = server->userById(static_cast<int>(request.id()));
+		if (u) {
+			QString name = u->qsName;
+			QString comment = u->qsComment;
+			if (info.contains(ServerDB::User_Name)) {
+				comment = info.value(ServerDB::User_Name);
+			}
+			if (info.contains(ServerDB::User_Comment)) {
+				comment = info.value(ServerDB::User_Comment);
 			}
+			server->setUserState(u, u->cChannel, u->bMute, u->bDeaf, u->bSuppress, u->bPrioritySpeaker, name, comment);
 		}
 	}
 
@@ -2170,3 +2787,124 @@ void V1_RedirectWhisperGroupRemove::impl(bool) {
 
 }
 }
+
+// Fetches the snapshot of the server named in msg. Returns false if msg
+// doesn't name a running server.
+// With stats, user statistics are refreshed if they are stale.
+template <class T>
+static bool GetSnapshot(const T &msg, ::ServerSnapshot &snapshot, bool stats = false) {
+	return msg.has_server() && msg.server().has_id() && ::ServerSnapshot::get(msg.server().id(), snapshot, stats);
+}
+
+template <>
+bool GetSnapshot(const ::MurmurRPC::Server &msg, ::ServerSnapshot &snapshot, bool stats) {
+	return msg.has_id() && ::ServerSnapshot::get(msg.id(), snapshot, stats);
+}
+
+bool RPCSnapshotHandler< ::MurmurRPC::Wrapper::V1_UserQuery >::handle(::MurmurRPC::Wrapper::V1_UserQuery *call) {
+	::ServerSnapshot snapshot;
+	if (!GetSnapshot(call->request, snapshot, true)) {
+		return false;
+	}
+
+	::MurmurRPC::User_List list;
+	list.mutable_server()->set_id(snapshot.iServerNum);
+
+	foreach(const ::UserSnapshot &user, snapshot.qhUsers) {
+		ToRPC(snapshot, user, list.add_users());
+	}
+
+	call->end(list);
+	return true;
+}
+
+bool RPCSnapshotHandler< ::MurmurRPC::Wrapper::V1_UserGet >::handle(::MurmurRPC::Wrapper::V1_UserGet *call) {
+	::ServerSnapshot snapshot;
+	if (!call->request.has_session() || !GetSnapshot(call->request, snapshot, true)) {
+		return false;
+	}
+
+	auto user = snapshot.qhUsers.constFind(call->request.session());
+	if (user == snapshot.qhUsers.constEnd()) {
+		return false;
+	}
+
+	::MurmurRPC::User rpcUser;
+	ToRPC(snapshot, user.value(), &rpcUser);
+	call->end(rpcUser);
+	return true;
+}
+
+bool RPCSnapshotHandler< ::MurmurRPC::Wrapper::V1_ChannelQuery >::handle(::MurmurRPC::Wrapper::V1_ChannelQuery *call) {
+	::ServerSnapshot snapshot;
+	if (!GetSnapshot(call->request, snapshot)) {
+		return false;
+	}
+
+	::MurmurRPC::Channel_List list;
+	list.mutable_server()->set_id(snapshot.iServerNum);
+
+	foreach(const ::ChannelSnapshot &channel, snapshot.qhChannels) {
+		if (!ToRPC(snapshot, channel, list.add_channels())) {
+			return false;
+		}
+	}
+
+	call->end(list);
+	return true;
+}
+
+bool RPCSnapshotHandler< ::MurmurRPC::Wrapper::V1_ChannelGet >::handle(::MurmurRPC::Wrapper::V1_ChannelGet *call) {
+	::ServerSnapshot snapshot;
+	if (!call->request.has_id() || !GetSnapshot(call->request, snapshot)) {
+		return false;
+	}
+
+	auto channel = snapshot.qhChannels.constFind(call->request.id());
+	if (channel == snapshot.qhChannels.constEnd()) {
+		return false;
+	}
+
+	::MurmurRPC::Channel rpcChannel;
+	if (!ToRPC(snapshot, channel.value(), &rpcChannel)) {
+		return false;
+	}
+	call->end(rpcChannel);
+	return true;
+}
+
+bool RPCSnapshotHandler< ::MurmurRPC::Wrapper::V1_TreeQuery >::handle(::MurmurRPC::Wrapper::V1_TreeQuery *call) {
+	::ServerSnapshot snapshot;
+	if (!GetSnapshot(call->request, snapshot, true) || !snapshot.qhChannels.contains(0)) {
+		return false;
+	}
+
+	const auto users = snapshot.usersByChannel();
+	const auto channels = snapshot.channelsByParent();
+	::MurmurRPC::Tree root;
+
+	QQueue< QPair<const ::ChannelSnapshot *, ::MurmurRPC::Tree *> > qQueue;
+	qQueue.enqueue(qMakePair(&snapshot.qhChannels.constFind(0).value(), &root));
+
+	while (!qQueue.isEmpty()) {
+		auto current = qQueue.dequeue();
+		auto currentChannel = current.first;
+		auto currentTree = current.second;
+
+		if (!ToRPC(snapshot, *currentChannel, currentTree->mutable_channel())) {
+			return false;
+		}
+
+		foreach(const ::UserSnapshot *u, users.value(currentChannel->iId)) {
+			ToRPC(snapshot, *u, currentTree->add_users());
+		}
+
+		foreach(const ::ChannelSnapshot *subChannel, channels.value(currentChannel->iId)) {
+			auto subTree = currentTree->add_children();
+			qQueue.enqueue(qMakePair(subChannel, subTree));
+		}
+	}
+
+	call->end(root);
+	return true;
+}
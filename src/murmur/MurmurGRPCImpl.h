@@ -18,10 +18,38 @@
 #include <atomic>
 
 #include <QMultiHash>
+#include <QElapsedTimer>
 
 #include <grpc++/grpc++.h>
 
+/// How a stream reacts when its client falls more than the queue limit
+/// behind.
+enum RPCStreamPolicy {
+	/// Queued messages that are superseded by a newer message with the
+	/// same key are dropped. If the queue is still full, the oldest
+	/// queued message is dropped.
+	RPCStreamCoalesce,
+	/// The oldest queued message is dropped.
+	RPCStreamDropOldest,
+	/// The stream is cancelled.
+	RPCStreamDisconnect
+};
+
+/// Backlog statistics of a single stream.
+struct RPCStreamStats {
+	/// Messages waiting to be written, including the one in flight.
+	int iQueued;
+	/// Highest value of iQueued since the statistics were last taken.
+	int iPeak;
+	/// Age of the oldest unwritten message, in milliseconds.
+	qint64 iLag;
+	quint64 uiWritten;
+	quint64 uiCoalesced;
+	quint64 uiDropped;
+};
+
 class RPCCall;
+class RPCExecEvent;
 
 namespace MurmurRPC {
 	namespace Wrapper {
@@ -30,6 +58,12 @@ namespace MurmurRPC {
 		class V1_ServerEvents;
 		class V1_AuthenticatorStream;
 		class V1_TextMessageFilter;
+		class V1_UserQuery;
+		class V1_UserGet;
+		class V1_ChannelQuery;
+		class V1_ChannelGet;
+		class V1_TreeQuery;
+		class V1_StateSync;
 	}
 }
 
@@ -37,24 +71,47 @@ class MurmurRPCImpl : public QThread {
 		Q_OBJECT;
 		std::unique_ptr<grpc::Server> m_server;
 		QTimer m_cleanupTimer;
+		int m_eventQueueLimit;
+		RPCStreamPolicy m_eventPolicy;
+
+		// Text messages sent to a filter and waiting for its answer,
+		// oldest first, by server. Guarded by qmTextMessageFilterLock.
+		struct PendingFilter {
+			quint64 id;
+			qint64 deadline;
+		};
+		QHash<int, QList<PendingFilter> > m_pendingFilters;
+		QElapsedTimer m_filterClock;
+		// Only used on the main thread.
+		QTimer m_filterTimer;
+		int m_filterTimeout;
+		int m_filterFailResult;
 	protected:
 		void customEvent(QEvent *evt);
 	public:
 		MurmurRPCImpl(const QString &address, std::shared_ptr<::grpc::ServerCredentials> credentials);
 		~MurmurRPCImpl();
 		void run();
+		void post(RPCExecEvent *ie, const ::google::protobuf::Message *request);
 		std::unique_ptr<grpc::ServerCompletionQueue> m_completionQueue;
 
 		// Services
 		MurmurRPC::V1::AsyncService m_V1Service;
 
-		// Listeners
+		// Listeners. Servers use them from their own threads, so all
+		// but the meta service listeners, which are only used on the
+		// main thread, are guarded by qmListenersLock, as is
+		// m_activeContextActions.
+		QMutex qmListenersLock;
+
 		QHash<int, QMultiHash<QString, ::MurmurRPC::Wrapper::V1_ContextActionEvents *> > m_contextActionListeners;
 
 		QSet<::MurmurRPC::Wrapper::V1_Events *> m_metaServiceListeners;
 
 		QMultiHash<int, ::MurmurRPC::Wrapper::V1_ServerEvents *> m_serverServiceListeners;
 
+		QMultiHash<int, ::MurmurRPC::Wrapper::V1_StateSync *> m_stateSyncListeners;
+
 		QMutex qmAuthenticatorsLock;
 		QHash<int, ::MurmurRPC::Wrapper::V1_AuthenticatorStream *> m_authenticators;
 
@@ -70,13 +127,22 @@ class MurmurRPCImpl : public QThread {
 		void removeUserActiveContextActions(const ::Server *s, const ::User *u);
 		void removeActiveContextActions(const ::Server *s);
 
-		void removeTextMessageFilter(const ::Server *s);
+		void removeTextMessageFilter(int serverID);
+		void readTextMessageFilter(int serverID, ::MurmurRPC::Wrapper::V1_TextMessageFilter *filter);
+		void textMessageFiltered(int serverID, quint64 id, int result, const QString &text = QString());
+		void failTextMessageFilters(int serverID);
+		void armTextMessageFilterTimer();
 		void removeAuthenticator(const ::Server *s);
+		template <class T> bool authenticatorWriteRead(const ::Server *s, T &authenticator);
 		void sendMetaEvent(const ::MurmurRPC::Event &e);
 		void sendServerEvent(const ::Server *s, const ::MurmurRPC::Server_Event &e);
+		void sendStateSync(int serverID, ::MurmurRPC::Wrapper::V1_StateSync *listener, const ::MurmurRPC::StateSync &sync);
+		template <class T> void limitEventStream(T *listener);
+		template <class T> void logEventStream(T *listener, const char *kind);
 
 	public slots:
 		void cleanup();
+		void expireTextMessageFilters();
 
 		void started(Server *server);
 		void stopped(Server *server);
@@ -99,8 +165,9 @@ class MurmurRPCImpl : public QThread {
 		void channelStateChanged(const Channel *channel);
 		void channelCreated(const Channel *channel);
 		void channelRemoved(const Channel *channel);
+		void stateChanged(const ServerSnapshot &snapshot);
 
-		void textMessageFilter(int &res, const User *user, MumbleProto::TextMessage &message);
+		void textMessageFilter(bool &pending, quint64 id, const User *user, const MumbleProto::TextMessage &message);
 
 		void contextAction(const User *user, const QString &action, unsigned int session, int channel);
 };
@@ -109,8 +176,11 @@ class RPCExecEvent : public ExecEvent {
 	Q_DISABLE_COPY(RPCExecEvent);
 public:
 	RPCCall *call;
-	RPCExecEvent(::boost::function<void()> fn, RPCCall *rpc_call) : ExecEvent(fn), call(rpc_call) {
+	// The server the call is executed for, or -1.
+	int serverID;
+	RPCExecEvent(::boost::function<void()> fn, RPCCall *rpc_call) : ExecEvent(fn), call(rpc_call), serverID(-1) {
 	}
+	void execute() Q_DECL_OVERRIDE;
 };
 
 class RPCCall {
@@ -168,6 +238,20 @@ public:
 	};
 };
 
+/// Read-only methods that can be answered from a ServerSnapshot
+/// specialize RPCSnapshotHandler.
+///
+/// handle() is called on the completion queue thread when the call
+/// arrives. It must not touch live server state. If it cannot answer
+/// the call from the snapshot, it returns false and the call's impl()
+/// is executed on the thread of its server as usual.
+template <class T>
+struct RPCSnapshotHandler {
+	static bool handle(T *) {
+		return false;
+	}
+};
+
 template <class InType, class OutType>
 class RPCSingleSingleCall : public RPCCall {
 public:
@@ -191,63 +275,277 @@ public:
 /// The helper method "write" automatically queues writes to the stream. Without
 /// write queuing, the grpc crashes if a stream.Write is called before a
 /// previous stream.Write completes.
+///
+/// The queue can be bounded with setQueueLimit. While more than one
+/// message is queued, writes are issued with a buffer hint so that grpc
+/// can send a backlog in as few frames as possible.
 template <class InType, class OutType>
 class RPCSingleStreamCall : public RPCCall {
+	struct PendingWrite {
+		OutType msg;
+		void *tag;
+		quint64 key;
+		qint64 queued;
+	};
+
 	QMutex m_writeLock;
-	QQueue< QPair<OutType, void *> > m_writeQueue;
+	QQueue<PendingWrite> m_writeQueue;
+	QHash<quint64, int> m_queuedKeys;
+	int m_queueLimit;
+	RPCStreamPolicy m_policy;
+	bool m_overflowed;
+	QElapsedTimer m_clock;
+	RPCStreamStats m_stats;
 public:
 	InType request;
 	::grpc::ServerAsyncWriter < OutType > stream;
-	RPCSingleStreamCall(MurmurRPCImpl *rpcImpl) : RPCCall(rpcImpl), stream(&context) {
+	RPCSingleStreamCall(MurmurRPCImpl *rpcImpl) : RPCCall(rpcImpl), m_queueLimit(0), m_policy(RPCStreamCoalesce), m_overflowed(false), stream(&context) {
+		m_clock.start();
+		memset(&m_stats, 0, sizeof(m_stats));
 	}
 
 	virtual void error(const ::grpc::Status &err) {
 		stream.Finish(err, done());
 	}
 
-	void write(const OutType &msg, void *tag) {
-		QMutexLocker(&RPCSingleStreamCall::m_writeLock);
-		if (m_writeQueue.size() > 0) {
-			m_writeQueue.enqueue(qMakePair(msg, tag));
-		} else {
-			m_writeQueue.enqueue(qMakePair(OutType(), tag));
-			stream.Write(msg, writeCB());
+	/// Bound the number of queued messages to limit (0 for no limit),
+	/// handling overflow according to policy.
+	void setQueueLimit(int limit, RPCStreamPolicy policy) {
+		QMutexLocker l(&m_writeLock);
+		m_queueLimit = limit;
+		m_policy = policy;
+	}
+
+	/// Returns the backlog statistics of this stream, and resets the
+	/// peak and the counters.
+	RPCStreamStats takeStats() {
+		QMutexLocker l(&m_writeLock);
+		RPCStreamStats stats = m_stats;
+		stats.iQueued = m_writeQueue.size();
+		stats.iLag = m_writeQueue.isEmpty() ? 0 : (m_clock.elapsed() - m_writeQueue.head().queued);
+		memset(&m_stats, 0, sizeof(m_stats));
+		m_stats.iPeak = stats.iQueued;
+		return stats;
+	}
+
+	/// Queue msg for writing. tag is executed once the message has been
+	/// written, or when it is dropped from the queue.
+	///
+	/// A non-zero key marks msg as superseding any queued message with the
+	/// same key; such messages are coalesced under RPCStreamCoalesce.
+	void write(const OutType &msg, void *tag, quint64 key = 0) {
+		QList< QPair<void *, bool> > discarded;
+		{
+			QMutexLocker l(&m_writeLock);
+			if (m_overflowed) {
+				discarded << qMakePair(tag, false);
+			} else if (m_writeQueue.isEmpty()) {
+				// The head of the queue is the message in flight; its
+				// contents have already been handed to grpc.
+				m_writeQueue.enqueue(pending(OutType(), tag, 0));
+				stream.Write(msg, writeCB());
+			} else {
+				if (key && (m_policy == RPCStreamCoalesce) && m_queuedKeys.contains(key)) {
+					for (int i = 1; i < m_writeQueue.size(); ++i) {
+						if (m_writeQueue.at(i).key == key) {
+							discarded << qMakePair(take(i), true);
+							++m_stats.uiCoalesced;
+							break;
+						}
+					}
+				}
+
+				m_writeQueue.enqueue(pending(msg, tag, key));
+
+				if ((m_queueLimit > 0) && (m_writeQueue.size() > m_queueLimit)) {
+					if (m_policy == RPCStreamDisconnect) {
+						// Fail everything that hasn't been handed to grpc
+						// yet; the write in flight completes with an error
+						// once the stream is cancelled.
+						while (m_writeQueue.size() > 1) {
+							discarded << qMakePair(take(1), false);
+							++m_stats.uiDropped;
+						}
+						m_overflowed = true;
+						context.TryCancel();
+					} else {
+						discarded << qMakePair(take(1), true);
+						++m_stats.uiDropped;
+					}
+				}
+			}
+			m_stats.iPeak = qMax(m_stats.iPeak, m_writeQueue.size());
+		}
+
+		for (auto i = discarded.constBegin(); i != discarded.constEnd(); ++i) {
+			complete((*i).first, (*i).second);
 		}
 	}
 
 private:
+	PendingWrite pending(const OutType &msg, void *tag, quint64 key) {
+		PendingWrite pw;
+		pw.msg = msg;
+		pw.tag = tag;
+		pw.key = key;
+		pw.queued = m_clock.elapsed();
+		if (key) {
+			++m_queuedKeys[key];
+		}
+		return pw;
+	}
+
+	void unkey(quint64 key) {
+		if (key && (--m_queuedKeys[key] == 0)) {
+			m_queuedKeys.remove(key);
+		}
+	}
+
+	void *take(int i) {
+		PendingWrite pw = m_writeQueue.takeAt(i);
+		unkey(pw.key);
+		return pw.tag;
+	}
+
+	static void complete(void *tag, bool ok) {
+		if (tag) {
+			auto cb = static_cast< ::boost::function<void(bool)> *>(tag);
+			(*cb)(ok);
+			delete cb;
+		}
+	}
+
 	void *writeCB() {
 		auto callback = ::boost::bind(&RPCSingleStreamCall<InType, OutType>::writeCallback, this, _1);
 		return new ::boost::function<void(bool)>(callback);
 	}
 
 	void writeCallback(bool ok) {
-		QMutexLocker(&RPCSingleStreamCall::m_writeLock);
-		auto processed = m_writeQueue.dequeue();
-		if (processed.second) {
-			auto cb = static_cast< ::boost::function<void(bool)> *>(processed.second);
-			(*cb)(ok);
-			delete cb;
-		}
-		if (m_writeQueue.size() > 0) {
-			stream.Write(m_writeQueue.head().first, writeCB());
+		void *tag;
+		{
+			QMutexLocker l(&m_writeLock);
+			tag = take(0);
+			++m_stats.uiWritten;
+			if (! m_writeQueue.isEmpty()) {
+				PendingWrite &next = m_writeQueue.head();
+				::grpc::WriteOptions options;
+				if (m_writeQueue.size() > 1) {
+					options.set_buffer_hint();
+				}
+				stream.Write(next.msg, options, writeCB());
+				// Once in flight, a message can no longer be coalesced.
+				next.msg.Clear();
+				unkey(next.key);
+				next.key = 0;
+			}
 		}
+		complete(tag, ok);
 	}
 };
 
+/// Base for "stream-stream" RPC methods.
+///
+/// Besides the blocking write() and read() of the generated classes,
+/// messages can be sent with queueWrite(), which returns immediately.
+/// write() and read() complete on the completion queue thread, so
+/// they can be used on any thread.
 template <class InType, class OutType>
 class RPCStreamStreamCall : public RPCCall {
+	QMutex m_writeLock;
+	/// The head of the queue is the message in flight.
+	QQueue<OutType> m_writeQueue;
+	bool m_writeFailed;
+	/// error() has been called. No more writes are started.
+	bool m_finishing;
+	/// Finish waits for the write in flight, and is then called
+	/// with m_finishStatus.
+	bool m_finishPending;
+	::grpc::Status m_finishStatus;
 public:
 	InType request;
 	OutType response;
 	::grpc::ServerAsyncReaderWriter< OutType, InType > stream;
+	/// Held around a round trip with the blocking write() and read(),
+	/// so that the call isn't finished from another thread while the
+	/// round trip is in flight.
+	QMutex m_callLock;
 
-	RPCStreamStreamCall(MurmurRPCImpl *rpcImpl) : RPCCall(rpcImpl), stream(&context) {
+	RPCStreamStreamCall(MurmurRPCImpl *rpcImpl) : RPCCall(rpcImpl), m_writeFailed(false), m_finishing(false), m_finishPending(false), stream(&context) {
 	}
 
+	/// Finishes the call. gRPC doesn't allow Finish while a write is
+	/// in flight, so queued messages are dropped, and the call is
+	/// finished when the write in flight completes. Like Finish, this
+	/// takes over a reference to the call; calling it again only
+	/// releases that reference.
 	virtual void error(const ::grpc::Status &err) {
+		{
+			QMutexLocker l(&m_writeLock);
+			if (m_finishing) {
+				l.unlock();
+				deref();
+				return;
+			}
+			m_finishing = true;
+			m_writeFailed = true;
+			if (!m_writeQueue.isEmpty()) {
+				while (m_writeQueue.size() > 1) {
+					m_writeQueue.removeLast();
+				}
+				m_finishStatus = err;
+				m_finishPending = true;
+				return;
+			}
+		}
 		stream.Finish(err, done());
 	}
+
+	/// Queue msg for writing. Returns false if an earlier write has
+	/// failed or the call is being finished, in which case the stream
+	/// is broken.
+	bool queueWrite(const OutType &msg) {
+		QMutexLocker l(&m_writeLock);
+		if (m_writeFailed) {
+			return false;
+		}
+		m_writeQueue.enqueue(msg);
+		if (m_writeQueue.size() == 1) {
+			// Keep the call alive while writes are in flight.
+			ref();
+			stream.Write(m_writeQueue.head(), writeCB());
+		}
+		return true;
+	}
+
+private:
+	void *writeCB() {
+		auto callback = ::boost::bind(&RPCStreamStreamCall<InType, OutType>::writeCallback, this, _1);
+		return new ::boost::function<void(bool)>(callback);
+	}
+
+	void writeCallback(bool ok) {
+		bool finish = false;
+		::grpc::Status status;
+		{
+			QMutexLocker l(&m_writeLock);
+			m_writeQueue.dequeue();
+			if (m_finishPending) {
+				m_finishPending = false;
+				finish = true;
+				status = m_finishStatus;
+			} else if (!ok) {
+				m_writeFailed = true;
+				m_writeQueue.clear();
+			} else if (!m_writeQueue.isEmpty() && !m_finishing) {
+				stream.Write(m_writeQueue.head(), writeCB());
+				return;
+			}
+		}
+		if (finish) {
+			stream.Finish(status, done());
+		}
+		deref();
+	}
 };
 
 
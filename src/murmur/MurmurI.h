@@ -118,6 +118,10 @@ namespace Murmur {
 			                              ::Ice::Int,
 			                              const Ice::Current&);
 
+			virtual void applyChannelBatch_async(const ::Murmur::AMD_Server_applyChannelBatchPtr&,
+			                                     const ::Murmur::ChannelBatch&,
+			                                     const Ice::Current&);
+
 			virtual void sendMessageChannel_async(const ::Murmur::AMD_Server_sendMessageChannelPtr&,
 			                                      ::Ice::Int,
 			                                      bool,
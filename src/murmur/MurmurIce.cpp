@@ -12,6 +12,7 @@
 #include <IceUtil/IceUtil.h>
 
 #include "Channel.h"
+#include "ControlThread.h"
 #include "Group.h"
 #include "Meta.h"
 #include "MurmurI.h"
@@ -82,11 +83,47 @@ static void userToUser(const ::User *p, Murmur::User &mp) {
 	mp.address = addr;
 }
 
-static void channelToChannel(const ::Channel *c, Murmur::Channel &mc) {
+static void userToUser(const ::UserSnapshot &u, Murmur::User &mp) {
+	mp.session = u.uiSession;
+	mp.userid = u.iId;
+	mp.name = u8(u.qsName);
+	mp.mute = u.bMute;
+	mp.deaf = u.bDeaf;
+	mp.suppress = u.bSuppress;
+	mp.recording = u.bRecording;
+	mp.prioritySpeaker = u.bPrioritySpeaker;
+	mp.selfMute = u.bSelfMute;
+	mp.selfDeaf = u.bSelfDeaf;
+	mp.channel = u.iChannel;
+	mp.comment = u8(u.qsComment);
+
+	mp.onlinesecs = u.iOnlineSecs;
+	mp.bytespersec = u.iBandwidth;
+	mp.version = u.uiVersion;
+	mp.release = u8(u.qsRelease);
+	mp.os = u8(u.qsOS);
+	mp.osversion = u8(u.qsOSVersion);
+	mp.identity = u8(u.qsIdentity);
+	mp.context = u.ssContext;
+	mp.idlesecs = u.iIdleSecs;
+	mp.udpPing = u.fUDPPing;
+	mp.tcpPing = u.fTCPPing;
+
+	mp.tcponly = u.bTcpOnly;
+
+	::Murmur::NetAddress addr(16, 0);
+	const Q_IPV6ADDR &a = u.haAddress.qip6;
+	for (int i=0;i<16;++i)
+		addr[i] = a[i];
+
+	mp.address = addr;
+}
+
+static void channelToChannel(const ::Server *server, const ::Channel *c, Murmur::Channel &mc) {
 	mc.id = c->iId;
 	mc.name = u8(c->qsName);
 	mc.parent = c->cParent ? c->cParent->iId : -1;
-	mc.description = u8(c->qsDesc);
+	mc.description = u8(server->channelDescription(c));
 	mc.position = c->iPosition;
 	mc.links.clear();
 	foreach(::Channel *chn, c->qsPermLinks)
@@ -94,6 +131,25 @@ static void channelToChannel(const ::Channel *c, Murmur::Channel &mc) {
 	mc.temporary = c->bTemporary;
 }
 
+// Returns false if the description is lazy and not in the description
+// cache, so that only the main thread can fill it in.
+static bool channelToChannel(const ::ChannelSnapshot &c, Murmur::Channel &mc) {
+	QString desc;
+	if (! c.description(desc))
+		return false;
+
+	mc.id = c.iId;
+	mc.name = u8(c.qsName);
+	mc.parent = c.iParent;
+	mc.description = u8(desc);
+	mc.position = c.iPosition;
+	mc.links.clear();
+	foreach(int id, c.qlLinks)
+		mc.links.push_back(id);
+	mc.temporary = c.bTemporary;
+	return true;
+}
+
 static void ACLtoACL(const ::ChanACL *acl, Murmur::ACL &ma) {
 	ma.applyHere = acl->bApplyHere;
 	ma.applySubs = acl->bApplySubs;
@@ -175,7 +231,7 @@ class ServerLocator : public virtual Ice::ServantLocator {
 		virtual void deactivate(const std::string &) {};
 };
 
-MurmurIce::MurmurIce() {
+MurmurIce::MurmurIce() : qmCallbacks(QMutex::Recursive) {
 	count = 0;
 
 	if (meta->mp.qsIceEndpoint.isEmpty())
@@ -240,6 +296,28 @@ void MurmurIce::customEvent(QEvent *evt) {
 		static_cast<ExecEvent *>(evt)->execute();
 }
 
+static void execServer(int server_id, boost::function<void ()> fn) {
+	fn();
+
+	// Make changes made by the call visible to read-only calls
+	// that are answered from snapshots.
+	::Server *server = meta->server(server_id);
+	if (server)
+		server->publishSnapshot();
+}
+
+// Calls on a server are executed on its control thread, so that they
+// neither wait for nor block other servers. Calls that start or stop
+// servers are marked MAIN_ and are executed on the main thread.
+static void postServer(int server_id, boost::function<void ()> fn) {
+	ExecEvent *ie = new ExecEvent(boost::bind(&execServer, server_id, fn));
+	ControlThread *t = ControlThread::forServer(server_id);
+	if (t)
+		t->post(ie);
+	else
+		QCoreApplication::instance()->postEvent(mi, ie);
+}
+
 void MurmurIce::badMetaProxy(const ::Murmur::MetaCallbackPrx &prx) {
 	qCritical("Ice MetaCallback %s failed", qPrintable(QString::fromStdString(communicator->proxyToString(prx))));
 	removeMetaCallback(prx);
@@ -252,7 +330,7 @@ void MurmurIce::badServerProxy(const ::Murmur::ServerCallbackPrx &prx, const ::S
 
 void MurmurIce::badAuthenticator(::Server *server) {
 	server->disconnectAuthenticator(this);
-	const ::Murmur::ServerAuthenticatorPrx &prx = qmServerAuthenticator.value(server->iServerNum);
+	const ::Murmur::ServerAuthenticatorPrx prx = getServerAuthenticator(server);
 	server->log(QString("Ice Authenticator %1 failed").arg(QString::fromStdString(communicator->proxyToString(prx))));
 	removeServerAuthenticator(server);
 	removeServerUpdatingAuthenticator(server);
@@ -272,6 +350,7 @@ void MurmurIce::removeMetaCallback(const ::Murmur::MetaCallbackPrx& prx) {
 }
 
 void MurmurIce::addServerCallback(const ::Server* server, const ::Murmur::ServerCallbackPrx& prx) {
+	QMutexLocker l(&qmCallbacks);
 	QList< ::Murmur::ServerCallbackPrx >& cbList = qmServerCallbacks[server->iServerNum];
 
 	if (!cbList.contains(prx)) {
@@ -280,13 +359,20 @@ void MurmurIce::addServerCallback(const ::Server* server, const ::Murmur::Server
 	}
 }
 
+const QList< ::Murmur::ServerCallbackPrx> MurmurIce::getServerCallbacks(const ::Server* server) const {
+	QMutexLocker l(&qmCallbacks);
+	return qmServerCallbacks.value(server->iServerNum);
+}
+
 void MurmurIce::removeServerCallback(const ::Server* server, const ::Murmur::ServerCallbackPrx& prx) {
+	QMutexLocker l(&qmCallbacks);
 	if (qmServerCallbacks[server->iServerNum].removeAll(prx)) {
 		server->log(QString("Removed Ice ServerCallback %1").arg(QString::fromStdString(communicator->proxyToString(prx))));
 	}
 }
 
 void MurmurIce::removeServerCallbacks(const ::Server* server) {
+	QMutexLocker l(&qmCallbacks);
 	if (qmServerCallbacks.contains(server->iServerNum)) {
 		server->log(QString("Removed all Ice ServerCallbacks"));
 		qmServerCallbacks.remove(server->iServerNum);
@@ -294,6 +380,7 @@ void MurmurIce::removeServerCallbacks(const ::Server* server) {
 }
 
 void MurmurIce::addServerContextCallback(const ::Server* server, int session_id, const QString& action, const ::Murmur::ServerContextCallbackPrx& prx) {
+	QMutexLocker l(&qmCallbacks);
 	QMap<QString, ::Murmur::ServerContextCallbackPrx>& callbacks = qmServerContextCallbacks[server->iServerNum][session_id];
 
 	if (!callbacks.contains(action) || callbacks[action] != prx) {
@@ -303,16 +390,30 @@ void MurmurIce::addServerContextCallback(const ::Server* server, int session_id,
 }
 
 const QMap< int, QMap<QString, ::Murmur::ServerContextCallbackPrx> > MurmurIce::getServerContextCallbacks(const ::Server* server) const {
+	QMutexLocker l(&qmCallbacks);
 	return qmServerContextCallbacks[server->iServerNum];
 }
 
+const ::Murmur::ServerContextCallbackPrx MurmurIce::getServerContextCallback(const ::Server* server, int session_id, const QString& action) const {
+	QMutexLocker l(&qmCallbacks);
+	return qmServerContextCallbacks.value(server->iServerNum).value(session_id).value(action);
+}
+
+void MurmurIce::removeUserContextCallbacks(const ::Server* server, int session_id) {
+	QMutexLocker l(&qmCallbacks);
+	if (qmServerContextCallbacks.contains(server->iServerNum))
+		qmServerContextCallbacks[server->iServerNum].remove(session_id);
+}
+
 void MurmurIce::removeServerContextCallback(const ::Server* server, int session_id, const QString& action) {
+	QMutexLocker l(&qmCallbacks);
 	if (qmServerContextCallbacks[server->iServerNum][session_id].remove(action)) {
 		server->log(QString("Removed Ice ServerContextCallback for session %1, action %2").arg(session_id).arg(action));
 	}
 }
 
 void MurmurIce::setServerAuthenticator(const ::Server* server, const ::Murmur::ServerAuthenticatorPrx& prx) {
+	QMutexLocker l(&qmCallbacks);
 	if (prx != qmServerAuthenticator[server->iServerNum]) {
 		server->log(QString("Set Ice Authenticator to %1").arg(QString::fromStdString(communicator->proxyToString(prx))));
 		qmServerAuthenticator[server->iServerNum] = prx;
@@ -320,16 +421,19 @@ void MurmurIce::setServerAuthenticator(const ::Server* server, const ::Murmur::S
 }
 
 const ::Murmur::ServerAuthenticatorPrx MurmurIce::getServerAuthenticator(const ::Server* server) const {
+	QMutexLocker l(&qmCallbacks);
 	return qmServerAuthenticator[server->iServerNum];
 }
 
 void MurmurIce::removeServerAuthenticator(const ::Server* server) {
+	QMutexLocker l(&qmCallbacks);
 	if (qmServerAuthenticator.remove(server->iServerNum)) {
 		server->log(QString("Removed Ice Authenticator %1").arg(QString::fromStdString(communicator->proxyToString(getServerAuthenticator(server)))));
 	}
 }
 
 void MurmurIce::setServerUpdatingAuthenticator(const ::Server* server, const ::Murmur::ServerUpdatingAuthenticatorPrx& prx) {
+	QMutexLocker l(&qmCallbacks);
 	if (prx != qmServerUpdatingAuthenticator[server->iServerNum]) {
 		server->log(QString("Set Ice UpdatingAuthenticator to %1").arg(QString::fromStdString(communicator->proxyToString(prx))));
 		qmServerUpdatingAuthenticator[server->iServerNum] = prx;
@@ -337,10 +441,12 @@ void MurmurIce::setServerUpdatingAuthenticator(const ::Server* server, const ::M
 }
 
 const ::Murmur::ServerUpdatingAuthenticatorPrx MurmurIce::getServerUpdatingAuthenticator(const ::Server* server) const {
+	QMutexLocker l(&qmCallbacks);
 	return qmServerUpdatingAuthenticator[server->iServerNum];
 }
 
 void MurmurIce::removeServerUpdatingAuthenticator(const ::Server* server) {
+	QMutexLocker l(&qmCallbacks);
 	if (qmServerUpdatingAuthenticator.contains(server->iServerNum)) {
 		server->log(QString("Removed Ice UpdatingAuthenticator %1").arg(QString::fromStdString(communicator->proxyToString(getServerUpdatingAuthenticator(server)))));
 		qmServerUpdatingAuthenticator.remove(server->iServerNum);
@@ -357,7 +463,7 @@ static ServerPrx idToProxy(int id, const Ice::ObjectAdapterPtr &adapter) {
 
 void MurmurIce::started(::Server *s) {
 	s->connectListener(mi);
-	connect(s, SIGNAL(contextAction(const User *, const QString &, unsigned int, int)), this, SLOT(contextAction(const User *, const QString &, unsigned int, int)));
+	connect(s, SIGNAL(contextAction(const User *, const QString &, unsigned int, int)), this, SLOT(contextAction(const User *, const QString &, unsigned int, int)), Qt::DirectConnection);
 
 	const QList< ::Murmur::MetaCallbackPrx> &qlList = qlMetaCallbacks;
 
@@ -393,9 +499,9 @@ void MurmurIce::stopped(::Server *s) {
 }
 
 void MurmurIce::userConnected(const ::User *p) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
@@ -413,11 +519,11 @@ void MurmurIce::userConnected(const ::User *p) {
 }
 
 void MurmurIce::userDisconnected(const ::User *p) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	qmServerContextCallbacks[s->iServerNum].remove(p->uiSession);
+	removeUserContextCallbacks(s, p->uiSession);
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
@@ -435,9 +541,9 @@ void MurmurIce::userDisconnected(const ::User *p) {
 }
 
 void MurmurIce::userStateChanged(const ::User *p) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
@@ -455,9 +561,9 @@ void MurmurIce::userStateChanged(const ::User *p) {
 }
 
 void MurmurIce::userTextMessage(const ::User *p, const ::TextMessage &message) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
@@ -478,15 +584,15 @@ void MurmurIce::userTextMessage(const ::User *p, const ::TextMessage &message) {
 }
 
 void MurmurIce::channelCreated(const ::Channel *c) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
 
 	::Murmur::Channel mc;
-	channelToChannel(c, mc);
+	channelToChannel(s, c, mc);
 
 	foreach(const ::Murmur::ServerCallbackPrx &prx, qmList) {
 		try {
@@ -498,15 +604,15 @@ void MurmurIce::channelCreated(const ::Channel *c) {
 }
 
 void MurmurIce::channelRemoved(const ::Channel *c) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
 
 	::Murmur::Channel mc;
-	channelToChannel(c, mc);
+	channelToChannel(s, c, mc);
 
 	foreach(const ::Murmur::ServerCallbackPrx &prx, qmList) {
 		try {
@@ -518,15 +624,15 @@ void MurmurIce::channelRemoved(const ::Channel *c) {
 }
 
 void MurmurIce::channelStateChanged(const ::Channel *c) {
-	::Server *s = qobject_cast< ::Server *> (sender());
+	::Server *s = ListenerCall::server();
 
-	const QList< ::Murmur::ServerCallbackPrx> &qmList = qmServerCallbacks[s->iServerNum];
+	const QList< ::Murmur::ServerCallbackPrx> qmList = getServerCallbacks(s);
 
 	if (qmList.isEmpty())
 		return;
 
 	::Murmur::Channel mc;
-	channelToChannel(c, mc);
+	channelToChannel(s, c, mc);
 
 	foreach(const ::Murmur::ServerCallbackPrx &prx, qmList) {
 		try {
@@ -538,22 +644,12 @@ void MurmurIce::channelStateChanged(const ::Channel *c) {
 }
 
 void MurmurIce::contextAction(const ::User *pSrc, const QString &action, unsigned int session, int iChannel) {
-	::Server *s = qobject_cast< ::Server *> (sender());
-
-	QMap<int, QMap<int, QMap<QString, ::Murmur::ServerContextCallbackPrx> > > &qmAll = qmServerContextCallbacks;
-	if (! qmAll.contains(s->iServerNum))
-		return;
-
-	QMap<int, QMap<QString, ::Murmur::ServerContextCallbackPrx> > &qmServer = qmAll[s->iServerNum];
-	if (! qmServer.contains(pSrc->uiSession))
-		return;
+	::Server *s = ListenerCall::server();
 
-	QMap<QString, ::Murmur::ServerContextCallbackPrx> &qmUser = qmServer[pSrc->uiSession];
-	if (! qmUser.contains(action))
+	const ::Murmur::ServerContextCallbackPrx prx = getServerContextCallback(s, pSrc->uiSession, action);
+	if (! prx)
 		return;
 
-	const ::Murmur::ServerContextCallbackPrx &prx = qmUser[action];
-
 	::Murmur::User mp;
 	userToUser(pSrc, mp);
 
@@ -574,7 +670,7 @@ void MurmurIce::contextAction(const ::User *pSrc, const QString &action, unsigne
 }
 
 void MurmurIce::idToNameSlot(QString &name, int id) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerAuthenticatorPrx prx = getServerAuthenticator(server);
 	try {
@@ -584,7 +680,7 @@ void MurmurIce::idToNameSlot(QString &name, int id) {
 	}
 }
 void MurmurIce::idToTextureSlot(QByteArray &qba, int id) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerAuthenticatorPrx prx = getServerAuthenticator(server);
 	try {
@@ -600,7 +696,7 @@ void MurmurIce::idToTextureSlot(QByteArray &qba, int id) {
 }
 
 void MurmurIce::nameToIdSlot(int &id, const QString &name) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerAuthenticatorPrx prx = getServerAuthenticator(server);
 	try {
@@ -611,7 +707,7 @@ void MurmurIce::nameToIdSlot(int &id, const QString &name) {
 }
 
 void MurmurIce::authenticateSlot(int &res, QString &uname, int sessionId, const QList<QSslCertificate> &certlist, const QString &certhash, bool certstrong, const QString &pw) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerAuthenticatorPrx prx = getServerAuthenticator(server);
 	::std::string newname;
@@ -647,7 +743,7 @@ void MurmurIce::authenticateSlot(int &res, QString &uname, int sessionId, const
 }
 
 void MurmurIce::registerUserSlot(int &res, const QMap<int, QString> &info) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerUpdatingAuthenticatorPrx prx = getServerUpdatingAuthenticator(server);
 	if (! prx)
@@ -664,7 +760,7 @@ void MurmurIce::registerUserSlot(int &res, const QMap<int, QString> &info) {
 }
 
 void MurmurIce::unregisterUserSlot(int &res, int id) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerUpdatingAuthenticatorPrx prx = getServerUpdatingAuthenticator(server);
 	if (! prx)
@@ -677,7 +773,7 @@ void MurmurIce::unregisterUserSlot(int &res, int id) {
 }
 
 void MurmurIce::getRegistrationSlot(int &res, int id, QMap<int, QString> &info) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerUpdatingAuthenticatorPrx prx = getServerUpdatingAuthenticator(server);
 	if (! prx)
@@ -696,7 +792,7 @@ void MurmurIce::getRegistrationSlot(int &res, int id, QMap<int, QString> &info)
 }
 
 void  MurmurIce::getRegisteredUsersSlot(const QString &filter, QMap<int, QString> &m) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerUpdatingAuthenticatorPrx prx = getServerUpdatingAuthenticator(server);
 	if (! prx)
@@ -716,7 +812,7 @@ void  MurmurIce::getRegisteredUsersSlot(const QString &filter, QMap<int, QString
 }
 
 void MurmurIce::setInfoSlot(int &res, int id, const QMap<int, QString> &info) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerUpdatingAuthenticatorPrx prx = getServerUpdatingAuthenticator(server);
 	if (! prx)
@@ -733,7 +829,7 @@ void MurmurIce::setInfoSlot(int &res, int id, const QMap<int, QString> &info) {
 }
 
 void MurmurIce::setTextureSlot(int &res, int id, const QByteArray &texture) {
-	::Server *server = qobject_cast< ::Server *> (sender());
+	::Server *server = ListenerCall::server();
 
 	const ServerUpdatingAuthenticatorPrx prx = getServerUpdatingAuthenticator(server);
 	if (! prx)
@@ -757,7 +853,7 @@ Ice::ObjectPtr ServerLocator::locate(const Ice::Current &, Ice::LocalObjectPtr &
 }
 
 #define FIND_SERVER \
-	::Server *server = meta->qhServers.value(server_id);
+	::Server *server = meta->server(server_id);
 
 #define NEED_SERVER_EXISTS \
 	FIND_SERVER \
@@ -799,11 +895,13 @@ void ServerI::ice_ping(const Ice::Current &current) const {
 }
 
 #define ACCESS_Server_isRunning_READ
+#define MAIN_Server_isRunning
 static void impl_Server_isRunning(const ::Murmur::AMD_Server_isRunningPtr cb, int server_id) {
 	NEED_SERVER_EXISTS;
 	cb->ice_response(server != NULL);
 }
 
+#define MAIN_Server_start
 static void impl_Server_start(const ::Murmur::AMD_Server_startPtr cb, int server_id) {
 	NEED_SERVER_EXISTS;
 	if (server)
@@ -814,12 +912,14 @@ static void impl_Server_start(const ::Murmur::AMD_Server_startPtr cb, int server
 		cb->ice_response();
 }
 
+#define MAIN_Server_stop
 static void impl_Server_stop(const ::Murmur::AMD_Server_stopPtr cb, int server_id) {
 	NEED_SERVER;
 	meta->kill(server_id);
 	cb->ice_response();
 }
 
+#define MAIN_Server_delete
 static void impl_Server_delete(const ::Murmur::AMD_Server_deletePtr cb, int server_id) {
 	NEED_SERVER_EXISTS;
 	if (server) {
@@ -964,13 +1064,33 @@ static void impl_Server_getUsers(const ::Murmur::AMD_Server_getUsersPtr cb, int
 	cb->ice_response(pm);
 }
 
+// getUsers, getChannels, getTree, getState and getChannelState are
+// answered from the server's ServerSnapshot on the Ice thread that
+// receives the call. The snapshot_ functions return false to have
+// the call handled by the impl_ function on the server's thread instead.
+#define SNAPSHOT_Server_getUsers
+static bool snapshot_Server_getUsers(const ::Murmur::AMD_Server_getUsersPtr cb, int server_id) {
+	::ServerSnapshot snapshot;
+	if (! ::ServerSnapshot::get(server_id, snapshot, true))
+		return false;
+
+	::Murmur::UserMap pm;
+	foreach(const ::UserSnapshot &u, snapshot.qhUsers) {
+		::Murmur::User mp;
+		userToUser(u, mp);
+		pm[u.uiSession] = mp;
+	}
+	cb->ice_response(pm);
+	return true;
+}
+
 #define ACCESS_Server_getChannels_READ
 static void impl_Server_getChannels(const ::Murmur::AMD_Server_getChannelsPtr cb, int server_id) {
 	NEED_SERVER;
 	::Murmur::ChannelMap cm;
 	foreach(const ::Channel *c, server->qhChannels) {
 		::Murmur::Channel mc;
-		channelToChannel(c, mc);
+		channelToChannel(server, c, mc);
 		cm[c->iId] = mc;
 	}
 	cb->ice_response(cm);
@@ -984,9 +1104,9 @@ static bool channelSort(const ::Channel *a, const ::Channel *b) {
 	return ::Channel::lessThan(a, b);
 }
 
-TreePtr recurseTree(const ::Channel *c) {
+TreePtr recurseTree(const ::Server *server, const ::Channel *c) {
 	TreePtr t = new Tree();
-	channelToChannel(c, t->c);
+	channelToChannel(server, c, t->c);
 	QList< ::User *> users = c->qlUsers;
 	qSort(users.begin(), users.end(), userSort);
 
@@ -1000,16 +1120,67 @@ TreePtr recurseTree(const ::Channel *c) {
 	qSort(channels.begin(), channels.end(), channelSort);
 
 	foreach(const ::Channel *chn, channels) {
-		t->children.push_back(recurseTree(chn));
+		t->children.push_back(recurseTree(server, chn));
+	}
+
+	return t;
+}
+
+#define SNAPSHOT_Server_getChannels
+static bool snapshot_Server_getChannels(const ::Murmur::AMD_Server_getChannelsPtr cb, int server_id) {
+	::ServerSnapshot snapshot;
+	if (! ::ServerSnapshot::get(server_id, snapshot))
+		return false;
+
+	::Murmur::ChannelMap cm;
+	foreach(const ::ChannelSnapshot &c, snapshot.qhChannels) {
+		::Murmur::Channel mc;
+		if (! channelToChannel(c, mc))
+			return false;
+		cm[c.iId] = mc;
+	}
+	cb->ice_response(cm);
+	return true;
+}
+
+static TreePtr snapshotTree(const ::ChannelSnapshot *c, const QHash<int, QList<const ::UserSnapshot *> > &users, const QHash<int, QList<const ::ChannelSnapshot *> > &channels) {
+	TreePtr t = new Tree();
+	if (! channelToChannel(*c, t->c))
+		return NULL;
+
+	foreach(const ::UserSnapshot *u, users.value(c->iId)) {
+		::Murmur::User mp;
+		userToUser(*u, mp);
+		t->users.push_back(mp);
+	}
+
+	foreach(const ::ChannelSnapshot *chn, channels.value(c->iId)) {
+		TreePtr child = snapshotTree(chn, users, channels);
+		if (! child)
+			return NULL;
+		t->children.push_back(child);
 	}
 
 	return t;
 }
 
+#define SNAPSHOT_Server_getTree
+static bool snapshot_Server_getTree(const ::Murmur::AMD_Server_getTreePtr cb, int server_id) {
+	::ServerSnapshot snapshot;
+	if (! ::ServerSnapshot::get(server_id, snapshot, true) || ! snapshot.qhChannels.contains(0))
+		return false;
+
+	TreePtr t = snapshotTree(&snapshot.qhChannels.constFind(0).value(), snapshot.usersByChannel(), snapshot.channelsByParent());
+	if (! t)
+		return false;
+	cb->ice_response(t);
+	return true;
+}
+
 #define ACCESS_Server_getTree_READ
 static void impl_Server_getTree(const ::Murmur::AMD_Server_getTreePtr cb, int server_id) {
 	NEED_SERVER;
-	cb->ice_response(recurseTree(server->qhChannels.value(0)));
+	cb->ice_response(recurseTree(server, server->qhChannels.value(0)));
 }
 
 #define ACCESS_Server_getCertificateList_READ
@@ -1161,6 +1332,22 @@ static void impl_Server_removeContextCallback(const Murmur::AMD_Server_removeCon
 }
 
 #define ACCESS_Server_getState_READ
+#define SNAPSHOT_Server_getState
+static bool snapshot_Server_getState(const ::Murmur::AMD_Server_getStatePtr cb, int server_id, ::Ice::Int session) {
+	::ServerSnapshot snapshot;
+	if (! ::ServerSnapshot::get(server_id, snapshot, true))
+		return false;
+
+	QHash<unsigned int, ::UserSnapshot>::const_iterator i = snapshot.qhUsers.constFind(session);
+	if (i == snapshot.qhUsers.constEnd())
+		return false;
+
+	::Murmur::User mp;
+	userToUser(i.value(), mp);
+	cb->ice_response(mp);
+	return true;
+}
+
 static void impl_Server_getState(const ::Murmur::AMD_Server_getStatePtr cb, int server_id,  ::Ice::Int session) {
 	NEED_SERVER;
 	NEED_PLAYER;
@@ -1190,12 +1377,29 @@ static void impl_Server_sendMessageChannel(const ::Murmur::AMD_Server_sendMessag
 }
 
 #define ACCESS_Server_getChannelState_READ
+#define SNAPSHOT_Server_getChannelState
+static bool snapshot_Server_getChannelState(const ::Murmur::AMD_Server_getChannelStatePtr cb, int server_id, ::Ice::Int channelid) {
+	::ServerSnapshot snapshot;
+	if (! ::ServerSnapshot::get(server_id, snapshot))
+		return false;
+
+	QHash<int, ::ChannelSnapshot>::const_iterator i = snapshot.qhChannels.constFind(channelid);
+	if (i == snapshot.qhChannels.constEnd())
+		return false;
+
+	::Murmur::Channel mc;
+	if (! channelToChannel(i.value(), mc))
+		return false;
+	cb->ice_response(mc);
+	return true;
+}
+
 static void impl_Server_getChannelState(const ::Murmur::AMD_Server_getChannelStatePtr cb, int server_id,  ::Ice::Int channelid) {
 	NEED_SERVER;
 	NEED_CHANNEL;
 
 	::Murmur::Channel mc;
-	channelToChannel(channel, mc);
+	channelToChannel(server, channel, mc);
 	cb->ice_response(mc);
 }
 
@@ -1265,6 +1469,63 @@ static void impl_Server_addChannel(const ::Murmur::AMD_Server_addChannelPtr cb,
 	cb->ice_response(newid);
 }
 
+static void impl_Server_applyChannelBatch(const ::Murmur::AMD_Server_applyChannelBatchPtr cb, int server_id,  const ::Murmur::ChannelBatch& batch) {
+	NEED_SERVER;
+
+	::ChannelBatch cbBatch;
+	foreach(const ::Murmur::ChannelBatchOperation &mop, batch) {
+		::ChannelBatch::Op op;
+		op.type = static_cast< ::ChannelBatch::OpType>(mop.type);
+		op.iChannel = mop.channel;
+		op.iOther = mop.other;
+		if (! mop.name.empty())
+			op.qsName = u8(mop.name);
+		if (! mop.description.empty())
+			op.qsDesc = u8(mop.description);
+		op.bPosition = mop.setPosition;
+		op.iPosition = mop.position;
+		op.bInheritACL = mop.inherit;
+		foreach(const ::Murmur::Group &gi, mop.groups) {
+			::ChannelBatch::Group g;
+			g.qsName = u8(gi.name);
+			g.bInherit = gi.inherit;
+			g.bInheritable = gi.inheritable;
+			g.qsAdd = QVector<int>::fromStdVector(gi.add).toList().toSet();
+			g.qsRemove = QVector<int>::fromStdVector(gi.remove).toList().toSet();
+			op.qlGroups << g;
+		}
+		foreach(const ::Murmur::ACL &ai, mop.acls) {
+			::ChannelBatch::ACL acl;
+			acl.bApplyHere = ai.applyHere;
+			acl.bApplySubs = ai.applySubs;
+			acl.iUserId = ai.userid;
+			acl.qsGroup = u8(ai.group);
+			acl.pDeny = static_cast<ChanACL::Permissions>(ai.deny) & ChanACL::All;
+			acl.pAllow = static_cast<ChanACL::Permissions>(ai.allow) & ChanACL::All;
+			op.qlACLs << acl;
+		}
+		cbBatch.qlOps << op;
+	}
+
+	QList<int> added;
+	QString err;
+	switch (server->applyChannelBatch(cbBatch, added, err)) {
+		case ::ChannelBatch::Ok:
+			break;
+		case ::ChannelBatch::NestingLimit:
+			cb->ice_exception(::Murmur::NestingLimitException());
+			return;
+		default:
+			cb->ice_exception(::Murmur::InvalidChannelException());
+			return;
+	}
+
+	::Murmur::IntList ids;
+	foreach(int id, added)
+		ids.push_back(id);
+	cb->ice_response(ids);
+}
+
 #define ACCESS_Server_getACL_READ
 static void impl_Server_getACL(const ::Murmur::AMD_Server_getACLPtr cb, int server_id, ::Ice::Int channelid) {
 	NEED_SERVER;
@@ -1367,6 +1628,7 @@ static void impl_Server_setACL(const ::Murmur::AMD_Server_setACLPtr cb, int serv
 
 	server->clearACLCache();
 	server->updateChannel(channel);
+	server->markSnapshotACL(channel);
 	cb->ice_response();
 }
 
@@ -1429,10 +1691,8 @@ static void impl_Server_updateRegistration(const ::Murmur::AMD_Server_updateRegi
 	}
 
 	if (info.contains(ServerDB::User_Comment)) {
-		foreach(ServerUser *u, server->qhUsers) {
-			if (u->iId == id)
-				server->setUserState(u, u->cChannel, u->bMute, u->bDeaf, u->bSuppress, u->bPrioritySpeaker, u->qsName, info.value(ServerDB::User_Comment));
-		}
+		foreach(ServerUser *u, server->qmhUsersById.values(id))
+			server->setUserState(u, u->cChannel, u->bMute, u->bDeaf, u->bSuppress, u->bPrioritySpeaker, u->qsName, info.value(ServerDB::User_Comment));
 	}
 
 	cb->ice_response();
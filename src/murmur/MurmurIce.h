@@ -32,7 +32,12 @@ class MurmurIce : public QObject {
 		void badMetaProxy(const ::Murmur::MetaCallbackPrx &prx);
 		void badServerProxy(const ::Murmur::ServerCallbackPrx &prx, const ::Server* server);
 		void badAuthenticator(::Server *);
+		/// Only accessed from the main thread.
 		QList< ::Murmur::MetaCallbackPrx> qlMetaCallbacks;
+		/// Protects the callbacks and authenticators of the servers,
+		/// which are used on the servers' control threads. Remote
+		/// calls are made without holding it.
+		mutable QMutex qmCallbacks;
 		QMap<int, QList< ::Murmur::ServerCallbackPrx> > qmServerCallbacks;
 		QMap<int, QMap<int, QMap<QString, ::Murmur::ServerContextCallbackPrx> > > qmServerContextCallbacks;
 		QMap<int, ::Murmur::ServerAuthenticatorPrx> qmServerAuthenticator;
@@ -46,10 +51,13 @@ class MurmurIce : public QObject {
 		void addMetaCallback(const ::Murmur::MetaCallbackPrx& prx);
 		void removeMetaCallback(const ::Murmur::MetaCallbackPrx& prx);
 		void addServerCallback(const ::Server* server, const ::Murmur::ServerCallbackPrx& prx);
+		const QList< ::Murmur::ServerCallbackPrx> getServerCallbacks(const ::Server* server) const;
 		void removeServerCallback(const ::Server* server, const ::Murmur::ServerCallbackPrx& prx);
 		void removeServerCallbacks(const ::Server* server);
 		void addServerContextCallback(const ::Server* server, int session_id, const QString& action, const ::Murmur::ServerContextCallbackPrx& prx);
 		const QMap< int, QMap<QString, ::Murmur::ServerContextCallbackPrx> > getServerContextCallbacks(const ::Server* server) const;
+		const ::Murmur::ServerContextCallbackPrx getServerContextCallback(const ::Server* server, int session_id, const QString& action) const;
+		void removeUserContextCallbacks(const ::Server* server, int session_id);
 		void removeServerContextCallback(const ::Server* server, int session_id, const QString& action);
 		void setServerAuthenticator(const ::Server* server, const ::Murmur::ServerAuthenticatorPrx& prx);
 		const ::Murmur::ServerAuthenticatorPrx getServerAuthenticator(const ::Server* server) const;
@@ -28,8 +28,16 @@ void ::Murmur::ServerI::isRunning_async(const ::Murmur::AMD_Server_isRunningPtr
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_isRunning
+	if (snapshot_Server_isRunning(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_isRunning
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_isRunning, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_isRunning, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::start_async(const ::Murmur::AMD_Server_startPtr &cb, const ::Ice::Current &current) {
@@ -58,8 +66,16 @@ void ::Murmur::ServerI::start_async(const ::Murmur::AMD_Server_startPtr &cb, con
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_start
+	if (snapshot_Server_start(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_start
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_start, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_start, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::stop_async(const ::Murmur::AMD_Server_stopPtr &cb, const ::Ice::Current &current) {
@@ -88,8 +104,16 @@ void ::Murmur::ServerI::stop_async(const ::Murmur::AMD_Server_stopPtr &cb, const
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_stop
+	if (snapshot_Server_stop(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_stop
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_stop, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_stop, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::delete_async(const ::Murmur::AMD_Server_deletePtr &cb, const ::Ice::Current &current) {
@@ -118,8 +142,16 @@ void ::Murmur::ServerI::delete_async(const ::Murmur::AMD_Server_deletePtr &cb, c
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_delete
+	if (snapshot_Server_delete(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_delete
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_delete, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_delete, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::id_async(const ::Murmur::AMD_Server_idPtr &cb, const ::Ice::Current &current) {
@@ -148,8 +180,16 @@ void ::Murmur::ServerI::id_async(const ::Murmur::AMD_Server_idPtr &cb, const ::I
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_id
+	if (snapshot_Server_id(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_id
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_id, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_id, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::addCallback_async(const ::Murmur::AMD_Server_addCallbackPtr &cb,  const ::Murmur::ServerCallbackPrx& p1, const ::Ice::Current &current) {
@@ -178,8 +218,16 @@ void ::Murmur::ServerI::addCallback_async(const ::Murmur::AMD_Server_addCallback
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_addCallback
+	if (snapshot_Server_addCallback(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_addCallback
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_addCallback, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_addCallback, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::removeCallback_async(const ::Murmur::AMD_Server_removeCallbackPtr &cb,  const ::Murmur::ServerCallbackPrx& p1, const ::Ice::Current &current) {
@@ -208,8 +256,16 @@ void ::Murmur::ServerI::removeCallback_async(const ::Murmur::AMD_Server_removeCa
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_removeCallback
+	if (snapshot_Server_removeCallback(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_removeCallback
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_removeCallback, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_removeCallback, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setAuthenticator_async(const ::Murmur::AMD_Server_setAuthenticatorPtr &cb,  const ::Murmur::ServerAuthenticatorPrx& p1, const ::Ice::Current &current) {
@@ -238,8 +294,16 @@ void ::Murmur::ServerI::setAuthenticator_async(const ::Murmur::AMD_Server_setAut
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setAuthenticator
+	if (snapshot_Server_setAuthenticator(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_setAuthenticator
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setAuthenticator, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setAuthenticator, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getConf_async(const ::Murmur::AMD_Server_getConfPtr &cb,  const ::std::string& p1, const ::Ice::Current &current) {
@@ -268,8 +332,16 @@ void ::Murmur::ServerI::getConf_async(const ::Murmur::AMD_Server_getConfPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getConf
+	if (snapshot_Server_getConf(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getConf
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getConf, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getConf, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getAllConf_async(const ::Murmur::AMD_Server_getAllConfPtr &cb, const ::Ice::Current &current) {
@@ -298,8 +370,16 @@ void ::Murmur::ServerI::getAllConf_async(const ::Murmur::AMD_Server_getAllConfPt
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getAllConf
+	if (snapshot_Server_getAllConf(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getAllConf
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getAllConf, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getAllConf, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setConf_async(const ::Murmur::AMD_Server_setConfPtr &cb,  const ::std::string& p1,  const ::std::string& p2, const ::Ice::Current &current) {
@@ -328,8 +408,16 @@ void ::Murmur::ServerI::setConf_async(const ::Murmur::AMD_Server_setConfPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setConf
+	if (snapshot_Server_setConf(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_setConf
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setConf, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setConf, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setSuperuserPassword_async(const ::Murmur::AMD_Server_setSuperuserPasswordPtr &cb,  const ::std::string& p1, const ::Ice::Current &current) {
@@ -358,8 +446,16 @@ void ::Murmur::ServerI::setSuperuserPassword_async(const ::Murmur::AMD_Server_se
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setSuperuserPassword
+	if (snapshot_Server_setSuperuserPassword(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_setSuperuserPassword
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setSuperuserPassword, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setSuperuserPassword, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getLog_async(const ::Murmur::AMD_Server_getLogPtr &cb,  ::Ice::Int p1,  ::Ice::Int p2, const ::Ice::Current &current) {
@@ -388,8 +484,16 @@ void ::Murmur::ServerI::getLog_async(const ::Murmur::AMD_Server_getLogPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getLog
+	if (snapshot_Server_getLog(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_getLog
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getLog, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getLog, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getLogLen_async(const ::Murmur::AMD_Server_getLogLenPtr &cb, const ::Ice::Current &current) {
@@ -418,8 +522,16 @@ void ::Murmur::ServerI::getLogLen_async(const ::Murmur::AMD_Server_getLogLenPtr
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getLogLen
+	if (snapshot_Server_getLogLen(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getLogLen
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getLogLen, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getLogLen, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getUsers_async(const ::Murmur::AMD_Server_getUsersPtr &cb, const ::Ice::Current &current) {
@@ -448,8 +560,16 @@ void ::Murmur::ServerI::getUsers_async(const ::Murmur::AMD_Server_getUsersPtr &c
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getUsers
+	if (snapshot_Server_getUsers(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getUsers
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getUsers, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getUsers, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getChannels_async(const ::Murmur::AMD_Server_getChannelsPtr &cb, const ::Ice::Current &current) {
@@ -478,8 +598,16 @@ void ::Murmur::ServerI::getChannels_async(const ::Murmur::AMD_Server_getChannels
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getChannels
+	if (snapshot_Server_getChannels(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getChannels
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getChannels, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getChannels, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getCertificateList_async(const ::Murmur::AMD_Server_getCertificateListPtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -508,8 +636,16 @@ void ::Murmur::ServerI::getCertificateList_async(const ::Murmur::AMD_Server_getC
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getCertificateList
+	if (snapshot_Server_getCertificateList(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getCertificateList
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getCertificateList, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getCertificateList, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getTree_async(const ::Murmur::AMD_Server_getTreePtr &cb, const ::Ice::Current &current) {
@@ -538,8 +674,16 @@ void ::Murmur::ServerI::getTree_async(const ::Murmur::AMD_Server_getTreePtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getTree
+	if (snapshot_Server_getTree(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getTree
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getTree, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getTree, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getBans_async(const ::Murmur::AMD_Server_getBansPtr &cb, const ::Ice::Current &current) {
@@ -568,8 +712,16 @@ void ::Murmur::ServerI::getBans_async(const ::Murmur::AMD_Server_getBansPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getBans
+	if (snapshot_Server_getBans(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getBans
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getBans, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getBans, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setBans_async(const ::Murmur::AMD_Server_setBansPtr &cb,  const ::Murmur::BanList& p1, const ::Ice::Current &current) {
@@ -598,8 +750,16 @@ void ::Murmur::ServerI::setBans_async(const ::Murmur::AMD_Server_setBansPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setBans
+	if (snapshot_Server_setBans(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_setBans
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setBans, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setBans, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::kickUser_async(const ::Murmur::AMD_Server_kickUserPtr &cb,  ::Ice::Int p1,  const ::std::string& p2, const ::Ice::Current &current) {
@@ -628,8 +788,16 @@ void ::Murmur::ServerI::kickUser_async(const ::Murmur::AMD_Server_kickUserPtr &c
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_kickUser
+	if (snapshot_Server_kickUser(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_kickUser
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_kickUser, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_kickUser, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getState_async(const ::Murmur::AMD_Server_getStatePtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -658,8 +826,16 @@ void ::Murmur::ServerI::getState_async(const ::Murmur::AMD_Server_getStatePtr &c
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getState
+	if (snapshot_Server_getState(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getState
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getState, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getState, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setState_async(const ::Murmur::AMD_Server_setStatePtr &cb,  const ::Murmur::User& p1, const ::Ice::Current &current) {
@@ -688,8 +864,16 @@ void ::Murmur::ServerI::setState_async(const ::Murmur::AMD_Server_setStatePtr &c
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setState
+	if (snapshot_Server_setState(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_setState
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setState, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setState, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::sendMessage_async(const ::Murmur::AMD_Server_sendMessagePtr &cb,  ::Ice::Int p1,  const ::std::string& p2, const ::Ice::Current &current) {
@@ -718,8 +902,16 @@ void ::Murmur::ServerI::sendMessage_async(const ::Murmur::AMD_Server_sendMessage
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_sendMessage
+	if (snapshot_Server_sendMessage(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_sendMessage
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_sendMessage, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_sendMessage, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::hasPermission_async(const ::Murmur::AMD_Server_hasPermissionPtr &cb,  ::Ice::Int p1,  ::Ice::Int p2,  ::Ice::Int p3, const ::Ice::Current &current) {
@@ -748,8 +940,16 @@ void ::Murmur::ServerI::hasPermission_async(const ::Murmur::AMD_Server_hasPermis
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_hasPermission
+	if (snapshot_Server_hasPermission(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3))
+		return;
+#endif
+#ifndef MAIN_Server_hasPermission
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_hasPermission, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_hasPermission, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::effectivePermissions_async(const ::Murmur::AMD_Server_effectivePermissionsPtr &cb,  ::Ice::Int p1,  ::Ice::Int p2, const ::Ice::Current &current) {
@@ -778,8 +978,16 @@ void ::Murmur::ServerI::effectivePermissions_async(const ::Murmur::AMD_Server_ef
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_effectivePermissions
+	if (snapshot_Server_effectivePermissions(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_effectivePermissions
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_effectivePermissions, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_effectivePermissions, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::addContextCallback_async(const ::Murmur::AMD_Server_addContextCallbackPtr &cb,  ::Ice::Int p1,  const ::std::string& p2,  const ::std::string& p3,  const ::Murmur::ServerContextCallbackPrx& p4,  ::Ice::Int p5, const ::Ice::Current &current) {
@@ -808,8 +1016,16 @@ void ::Murmur::ServerI::addContextCallback_async(const ::Murmur::AMD_Server_addC
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_addContextCallback
+	if (snapshot_Server_addContextCallback(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3, p4, p5))
+		return;
+#endif
+#ifndef MAIN_Server_addContextCallback
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_addContextCallback, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3, p4, p5));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_addContextCallback, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3, p4, p5));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::removeContextCallback_async(const ::Murmur::AMD_Server_removeContextCallbackPtr &cb,  const ::Murmur::ServerContextCallbackPrx& p1, const ::Ice::Current &current) {
@@ -838,8 +1054,16 @@ void ::Murmur::ServerI::removeContextCallback_async(const ::Murmur::AMD_Server_r
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_removeContextCallback
+	if (snapshot_Server_removeContextCallback(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_removeContextCallback
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_removeContextCallback, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_removeContextCallback, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getChannelState_async(const ::Murmur::AMD_Server_getChannelStatePtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -868,8 +1092,16 @@ void ::Murmur::ServerI::getChannelState_async(const ::Murmur::AMD_Server_getChan
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getChannelState
+	if (snapshot_Server_getChannelState(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getChannelState
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getChannelState, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getChannelState, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setChannelState_async(const ::Murmur::AMD_Server_setChannelStatePtr &cb,  const ::Murmur::Channel& p1, const ::Ice::Current &current) {
@@ -898,8 +1130,16 @@ void ::Murmur::ServerI::setChannelState_async(const ::Murmur::AMD_Server_setChan
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setChannelState
+	if (snapshot_Server_setChannelState(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_setChannelState
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setChannelState, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setChannelState, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::removeChannel_async(const ::Murmur::AMD_Server_removeChannelPtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -928,8 +1168,16 @@ void ::Murmur::ServerI::removeChannel_async(const ::Murmur::AMD_Server_removeCha
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_removeChannel
+	if (snapshot_Server_removeChannel(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_removeChannel
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_removeChannel, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_removeChannel, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::addChannel_async(const ::Murmur::AMD_Server_addChannelPtr &cb,  const ::std::string& p1,  ::Ice::Int p2, const ::Ice::Current &current) {
@@ -958,8 +1206,54 @@ void ::Murmur::ServerI::addChannel_async(const ::Murmur::AMD_Server_addChannelPt
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_addChannel
+	if (snapshot_Server_addChannel(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_addChannel
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_addChannel, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_addChannel, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
+}
+
+void ::Murmur::ServerI::applyChannelBatch_async(const ::Murmur::AMD_Server_applyChannelBatchPtr &cb,  const ::Murmur::ChannelBatch& p1, const ::Ice::Current &current) {
+	// qWarning() << "applyChannelBatch" << meta->mp.qsIceSecretRead.isNull() << meta->mp.qsIceSecretRead.isEmpty();
+#ifndef ACCESS_Server_applyChannelBatch_ALL
+#ifdef ACCESS_Server_applyChannelBatch_READ
+	if (! meta->mp.qsIceSecretRead.isNull()) {
+		bool ok = ! meta->mp.qsIceSecretRead.isEmpty();
+#else
+	if (! meta->mp.qsIceSecretRead.isNull() || ! meta->mp.qsIceSecretWrite.isNull()) {
+		bool ok = ! meta->mp.qsIceSecretWrite.isEmpty();
+#endif
+		::Ice::Context::const_iterator i = current.ctx.find("secret");
+		ok = ok && (i != current.ctx.end());
+		if (ok) {
+			const QString &secret = u8((*i).second);
+#ifdef ACCESS_Server_applyChannelBatch_READ
+			ok = ((secret == meta->mp.qsIceSecretRead) || (secret == meta->mp.qsIceSecretWrite));
+#else
+			ok = (secret == meta->mp.qsIceSecretWrite);
+#endif
+		}
+		if (! ok) {
+			cb->ice_exception(InvalidSecretException());
+			return;
+		}
+	}
+#endif
+#ifdef SNAPSHOT_Server_applyChannelBatch
+	if (snapshot_Server_applyChannelBatch(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_applyChannelBatch
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_applyChannelBatch, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
+	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_applyChannelBatch, cb, QString::fromStdString(current.id.name).toInt(), p1));
+	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::sendMessageChannel_async(const ::Murmur::AMD_Server_sendMessageChannelPtr &cb,  ::Ice::Int p1,  bool p2,  const ::std::string& p3, const ::Ice::Current &current) {
@@ -988,8 +1282,16 @@ void ::Murmur::ServerI::sendMessageChannel_async(const ::Murmur::AMD_Server_send
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_sendMessageChannel
+	if (snapshot_Server_sendMessageChannel(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3))
+		return;
+#endif
+#ifndef MAIN_Server_sendMessageChannel
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_sendMessageChannel, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_sendMessageChannel, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getACL_async(const ::Murmur::AMD_Server_getACLPtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -1018,8 +1320,16 @@ void ::Murmur::ServerI::getACL_async(const ::Murmur::AMD_Server_getACLPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getACL
+	if (snapshot_Server_getACL(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getACL
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getACL, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getACL, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setACL_async(const ::Murmur::AMD_Server_setACLPtr &cb,  ::Ice::Int p1,  const ::Murmur::ACLList& p2,  const ::Murmur::GroupList& p3,  bool p4, const ::Ice::Current &current) {
@@ -1048,8 +1358,16 @@ void ::Murmur::ServerI::setACL_async(const ::Murmur::AMD_Server_setACLPtr &cb,
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setACL
+	if (snapshot_Server_setACL(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3, p4))
+		return;
+#endif
+#ifndef MAIN_Server_setACL
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setACL, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3, p4));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setACL, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3, p4));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::addUserToGroup_async(const ::Murmur::AMD_Server_addUserToGroupPtr &cb,  ::Ice::Int p1,  ::Ice::Int p2,  const ::std::string& p3, const ::Ice::Current &current) {
@@ -1078,8 +1396,16 @@ void ::Murmur::ServerI::addUserToGroup_async(const ::Murmur::AMD_Server_addUserT
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_addUserToGroup
+	if (snapshot_Server_addUserToGroup(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3))
+		return;
+#endif
+#ifndef MAIN_Server_addUserToGroup
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_addUserToGroup, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_addUserToGroup, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::removeUserFromGroup_async(const ::Murmur::AMD_Server_removeUserFromGroupPtr &cb,  ::Ice::Int p1,  ::Ice::Int p2,  const ::std::string& p3, const ::Ice::Current &current) {
@@ -1108,8 +1434,16 @@ void ::Murmur::ServerI::removeUserFromGroup_async(const ::Murmur::AMD_Server_rem
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_removeUserFromGroup
+	if (snapshot_Server_removeUserFromGroup(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3))
+		return;
+#endif
+#ifndef MAIN_Server_removeUserFromGroup
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_removeUserFromGroup, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_removeUserFromGroup, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::redirectWhisperGroup_async(const ::Murmur::AMD_Server_redirectWhisperGroupPtr &cb,  ::Ice::Int p1,  const ::std::string& p2,  const ::std::string& p3, const ::Ice::Current &current) {
@@ -1138,8 +1472,16 @@ void ::Murmur::ServerI::redirectWhisperGroup_async(const ::Murmur::AMD_Server_re
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_redirectWhisperGroup
+	if (snapshot_Server_redirectWhisperGroup(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3))
+		return;
+#endif
+#ifndef MAIN_Server_redirectWhisperGroup
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_redirectWhisperGroup, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_redirectWhisperGroup, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getUserNames_async(const ::Murmur::AMD_Server_getUserNamesPtr &cb,  const ::Murmur::IdList& p1, const ::Ice::Current &current) {
@@ -1168,8 +1510,16 @@ void ::Murmur::ServerI::getUserNames_async(const ::Murmur::AMD_Server_getUserNam
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getUserNames
+	if (snapshot_Server_getUserNames(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getUserNames
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getUserNames, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getUserNames, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getUserIds_async(const ::Murmur::AMD_Server_getUserIdsPtr &cb,  const ::Murmur::NameList& p1, const ::Ice::Current &current) {
@@ -1198,8 +1548,16 @@ void ::Murmur::ServerI::getUserIds_async(const ::Murmur::AMD_Server_getUserIdsPt
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getUserIds
+	if (snapshot_Server_getUserIds(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getUserIds
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getUserIds, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getUserIds, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::registerUser_async(const ::Murmur::AMD_Server_registerUserPtr &cb,  const ::Murmur::UserInfoMap& p1, const ::Ice::Current &current) {
@@ -1228,8 +1586,16 @@ void ::Murmur::ServerI::registerUser_async(const ::Murmur::AMD_Server_registerUs
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_registerUser
+	if (snapshot_Server_registerUser(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_registerUser
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_registerUser, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_registerUser, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::unregisterUser_async(const ::Murmur::AMD_Server_unregisterUserPtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -1258,8 +1624,16 @@ void ::Murmur::ServerI::unregisterUser_async(const ::Murmur::AMD_Server_unregist
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_unregisterUser
+	if (snapshot_Server_unregisterUser(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_unregisterUser
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_unregisterUser, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_unregisterUser, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::updateRegistration_async(const ::Murmur::AMD_Server_updateRegistrationPtr &cb,  ::Ice::Int p1,  const ::Murmur::UserInfoMap& p2, const ::Ice::Current &current) {
@@ -1288,8 +1662,16 @@ void ::Murmur::ServerI::updateRegistration_async(const ::Murmur::AMD_Server_upda
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_updateRegistration
+	if (snapshot_Server_updateRegistration(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_updateRegistration
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_updateRegistration, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_updateRegistration, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getRegistration_async(const ::Murmur::AMD_Server_getRegistrationPtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -1318,8 +1700,16 @@ void ::Murmur::ServerI::getRegistration_async(const ::Murmur::AMD_Server_getRegi
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getRegistration
+	if (snapshot_Server_getRegistration(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getRegistration
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getRegistration, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getRegistration, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getRegisteredUsers_async(const ::Murmur::AMD_Server_getRegisteredUsersPtr &cb,  const ::std::string& p1, const ::Ice::Current &current) {
@@ -1348,8 +1738,16 @@ void ::Murmur::ServerI::getRegisteredUsers_async(const ::Murmur::AMD_Server_getR
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getRegisteredUsers
+	if (snapshot_Server_getRegisteredUsers(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getRegisteredUsers
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getRegisteredUsers, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getRegisteredUsers, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::verifyPassword_async(const ::Murmur::AMD_Server_verifyPasswordPtr &cb,  const ::std::string& p1,  const ::std::string& p2, const ::Ice::Current &current) {
@@ -1378,8 +1776,16 @@ void ::Murmur::ServerI::verifyPassword_async(const ::Murmur::AMD_Server_verifyPa
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_verifyPassword
+	if (snapshot_Server_verifyPassword(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_verifyPassword
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_verifyPassword, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_verifyPassword, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getTexture_async(const ::Murmur::AMD_Server_getTexturePtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -1408,8 +1814,16 @@ void ::Murmur::ServerI::getTexture_async(const ::Murmur::AMD_Server_getTexturePt
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getTexture
+	if (snapshot_Server_getTexture(cb, QString::fromStdString(current.id.name).toInt(), p1))
+		return;
+#endif
+#ifndef MAIN_Server_getTexture
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getTexture, cb, QString::fromStdString(current.id.name).toInt(), p1));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getTexture, cb, QString::fromStdString(current.id.name).toInt(), p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::setTexture_async(const ::Murmur::AMD_Server_setTexturePtr &cb,  ::Ice::Int p1,  const ::Murmur::Texture& p2, const ::Ice::Current &current) {
@@ -1438,8 +1852,16 @@ void ::Murmur::ServerI::setTexture_async(const ::Murmur::AMD_Server_setTexturePt
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_setTexture
+	if (snapshot_Server_setTexture(cb, QString::fromStdString(current.id.name).toInt(), p1, p2))
+		return;
+#endif
+#ifndef MAIN_Server_setTexture
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_setTexture, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_setTexture, cb, QString::fromStdString(current.id.name).toInt(), p1, p2));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::getUptime_async(const ::Murmur::AMD_Server_getUptimePtr &cb, const ::Ice::Current &current) {
@@ -1468,8 +1890,16 @@ void ::Murmur::ServerI::getUptime_async(const ::Murmur::AMD_Server_getUptimePtr
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_getUptime
+	if (snapshot_Server_getUptime(cb, QString::fromStdString(current.id.name).toInt()))
+		return;
+#endif
+#ifndef MAIN_Server_getUptime
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_getUptime, cb, QString::fromStdString(current.id.name).toInt()));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_getUptime, cb, QString::fromStdString(current.id.name).toInt()));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::ServerI::updateCertificate_async(const ::Murmur::AMD_Server_updateCertificatePtr &cb,  const ::std::string& p1,  const ::std::string& p2,  const ::std::string& p3, const ::Ice::Current &current) {
@@ -1498,8 +1928,16 @@ void ::Murmur::ServerI::updateCertificate_async(const ::Murmur::AMD_Server_updat
 		}
 	}
 #endif
+#ifdef SNAPSHOT_Server_updateCertificate
+	if (snapshot_Server_updateCertificate(cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3))
+		return;
+#endif
+#ifndef MAIN_Server_updateCertificate
+	postServer(QString::fromStdString(current.id.name).toInt(), boost::bind(&impl_Server_updateCertificate, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
+#else
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Server_updateCertificate, cb, QString::fromStdString(current.id.name).toInt(), p1, p2, p3));
 	QCoreApplication::instance()->postEvent(mi, ie);
+#endif
 }
 
 void ::Murmur::MetaI::getServer_async(const ::Murmur::AMD_Meta_getServerPtr &cb,  ::Ice::Int p1, const ::Ice::Current &current) {
@@ -1527,6 +1965,10 @@ void ::Murmur::MetaI::getServer_async(const ::Murmur::AMD_Meta_getServerPtr &cb,
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getServer
+	if (snapshot_Meta_getServer(cb, current.adapter, p1))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getServer, cb, current.adapter, p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1557,6 +1999,10 @@ void ::Murmur::MetaI::newServer_async(const ::Murmur::AMD_Meta_newServerPtr &cb,
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_newServer
+	if (snapshot_Meta_newServer(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_newServer, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1587,6 +2033,10 @@ void ::Murmur::MetaI::getBootedServers_async(const ::Murmur::AMD_Meta_getBootedS
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getBootedServers
+	if (snapshot_Meta_getBootedServers(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getBootedServers, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1617,6 +2067,10 @@ void ::Murmur::MetaI::getAllServers_async(const ::Murmur::AMD_Meta_getAllServers
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getAllServers
+	if (snapshot_Meta_getAllServers(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getAllServers, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1647,6 +2101,10 @@ void ::Murmur::MetaI::getDefaultConf_async(const ::Murmur::AMD_Meta_getDefaultCo
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getDefaultConf
+	if (snapshot_Meta_getDefaultConf(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getDefaultConf, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1677,6 +2135,10 @@ void ::Murmur::MetaI::getVersion_async(const ::Murmur::AMD_Meta_getVersionPtr &c
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getVersion
+	if (snapshot_Meta_getVersion(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getVersion, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1707,6 +2169,10 @@ void ::Murmur::MetaI::addCallback_async(const ::Murmur::AMD_Meta_addCallbackPtr
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_addCallback
+	if (snapshot_Meta_addCallback(cb, current.adapter, p1))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_addCallback, cb, current.adapter, p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1737,6 +2203,10 @@ void ::Murmur::MetaI::removeCallback_async(const ::Murmur::AMD_Meta_removeCallba
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_removeCallback
+	if (snapshot_Meta_removeCallback(cb, current.adapter, p1))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_removeCallback, cb, current.adapter, p1));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1767,6 +2237,10 @@ void ::Murmur::MetaI::getUptime_async(const ::Murmur::AMD_Meta_getUptimePtr &cb,
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getUptime
+	if (snapshot_Meta_getUptime(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getUptime, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
@@ -1797,11 +2271,15 @@ void ::Murmur::MetaI::getSliceChecksums_async(const ::Murmur::AMD_Meta_getSliceC
 			return;
 		}
 	}
+#endif
+#ifdef SNAPSHOT_Meta_getSliceChecksums
+	if (snapshot_Meta_getSliceChecksums(cb, current.adapter))
+		return;
 #endif
 	ExecEvent *ie = new ExecEvent(boost::bind(&impl_Meta_getSliceChecksums, cb, current.adapter));
 	QCoreApplication::instance()->postEvent(mi, ie);
 }
 
 void ::Murmur::MetaI::getSlice_async(const ::Murmur::AMD_Meta_getSlicePtr& cb, const Ice::Current&) {
-	cb->ice_response(std::string("// Copyright 2005-2016 The Mumble Developers. All rights reserved.\n// Use of this source code is governed by a BSD-style license\n// that can be found in the LICENSE file at the root of the\n// Mumble source tree or at <https://www.mumble.info/LICENSE>.\n#include <Ice/SliceChecksumDict.ice>\nmodule Murmur\n{\n[\"python:seq:tuple\"] sequence<byte> NetAddress;\nstruct User {\nint session;\nint userid;\nbool mute;\nbool deaf;\nbool suppress;\nbool prioritySpeaker;\nbool selfMute;\nbool selfDeaf;\nbool recording;\nint channel;\nstring name;\nint onlinesecs;\nint bytespersec;\nint version;\nstring release;\nstring os;\nstring osversion;\nstring identity;\nstring context;\nstring comment;\nNetAddress address;\nbool tcponly;\nint idlesecs;\nfloat udpPing;\nfloat tcpPing;\n};\nsequence<int> IntList;\nstruct TextMessage {\nIntList sessions;\nIntList channels;\nIntList trees;\nstring text;\n};\nstruct Channel {\nint id;\nstring name;\nint parent;\nIntList links;\nstring description;\nbool temporary;\nint position;\n};\nstruct Group {\nstring name;\nbool inherited;\nbool inherit;\nbool inheritable;\nIntList add;\nIntList remove;\nIntList members;\n};\nconst int PermissionWrite = 0x01;\nconst int PermissionTraverse = 0x02;\nconst int PermissionEnter = 0x04;\nconst int PermissionSpeak = 0x08;\nconst int PermissionWhisper = 0x100;\nconst int PermissionMuteDeafen = 0x10;\nconst int PermissionMove = 0x20;\nconst int PermissionMakeChannel = 0x40;\nconst int PermissionMakeTempChannel = 0x400;\nconst int PermissionLinkChannel = 0x80;\nconst int PermissionTextMessage = 0x200;\nconst int PermissionKick = 0x10000;\nconst int PermissionBan = 0x20000;\nconst int PermissionRegister = 0x40000;\nconst int PermissionRegisterSelf = 0x80000;\nstruct ACL {\nbool applyHere;\nbool applySubs;\nbool inherited;\nint userid;\nstring group;\nint allow;\nint deny;\n};\nstruct Ban {\nNetAddress address;\nint bits;\nstring name;\nstring hash;\nstring reason;\nint start;\nint duration;\n};\nstruct LogEntry {\nint timestamp;\nstring txt;\n};\nclass Tree;\nsequence<Tree> TreeList;\nenum ChannelInfo { ChannelDescription, ChannelPosition };\nenum UserInfo { UserName, UserEmail, UserComment, UserHash, UserPassword, UserLastActive };\ndictionary<int, User> UserMap;\ndictionary<int, Channel> ChannelMap;\nsequence<Channel> ChannelList;\nsequence<User> UserList;\nsequence<Group> GroupList;\nsequence<ACL> ACLList;\nsequence<LogEntry> LogList;\nsequence<Ban> BanList;\nsequence<int> IdList;\nsequence<string> NameList;\ndictionary<int, string> NameMap;\ndictionary<string, int> IdMap;\nsequence<byte> Texture;\ndictionary<string, string> ConfigMap;\nsequence<string> GroupNameList;\nsequence<byte> CertificateDer;\nsequence<CertificateDer> CertificateList;\ndictionary<UserInfo, string> UserInfoMap;\nclass Tree {\nChannel c;\nTreeList children;\nUserList users;\n};\nexception MurmurException {};\nexception InvalidSessionException extends MurmurException {};\nexception InvalidChannelException extends MurmurException {};\nexception InvalidServerException extends MurmurException {};\nexception ServerBootedException extends MurmurException {};\nexception ServerFailureException extends MurmurException {};\nexception InvalidUserException extends MurmurException {};\nexception InvalidTextureException extends MurmurException {};\nexception InvalidCallbackException extends MurmurException {};\nexception InvalidSecretException extends MurmurException {};\nexception NestingLimitException extends MurmurException {};\nexception WriteOnlyException extends MurmurException {};\nexception InvalidInputDataException extends MurmurException {};\ninterface ServerCallback {\nidempotent void userConnected(User state);\nidempotent void userDisconnected(User state);\nidempotent void userStateChanged(User state);\nidempotent void userTextMessage(User state, TextMessage message);\nidempotent void channelCreated(Channel state);\nidempotent void channelRemoved(Channel state);\nidempotent void channelStateChanged(Channel state);\n};\nconst int ContextServer = 0x01;\nconst int ContextChannel = 0x02;\nconst int ContextUser = 0x04;\ninterface ServerContextCallback {\nidempotent void contextAction(string action, User usr, int session, int channelid);\n};\ninterface ServerAuthenticator {\nidempotent int authenticate(string name, string pw, CertificateList certificates, string certhash, bool certstrong, out string newname, out GroupNameList groups);\nidempotent bool getInfo(int id, out UserInfoMap info);\nidempotent int nameToId(string name);\nidempotent string idToName(int id);\nidempotent Texture idToTexture(int id);\n};\ninterface ServerUpdatingAuthenticator extends ServerAuthenticator {\nint registerUser(UserInfoMap info);\nint unregisterUser(int id);\nidempotent NameMap getRegisteredUsers(string filter);\nidempotent int setInfo(int id, UserInfoMap info);\nidempotent int setTexture(int id, Texture tex);\n};\n[\"amd\"] interface Server {\nidempotent bool isRunning() throws InvalidSecretException;\nvoid start() throws ServerBootedException, ServerFailureException, InvalidSecretException;\nvoid stop() throws ServerBootedException, InvalidSecretException;\nvoid delete() throws ServerBootedException, InvalidSecretException;\nidempotent int id() throws InvalidSecretException;\nvoid addCallback(ServerCallback *cb) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nvoid removeCallback(ServerCallback *cb) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nvoid setAuthenticator(ServerAuthenticator *auth) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nidempotent string getConf(string key) throws InvalidSecretException, WriteOnlyException;\nidempotent ConfigMap getAllConf() throws InvalidSecretException;\nidempotent void setConf(string key, string value) throws InvalidSecretException;\nidempotent void setSuperuserPassword(string pw) throws InvalidSecretException;\nidempotent LogList getLog(int first, int last) throws InvalidSecretException;\nidempotent int getLogLen() throws InvalidSecretException;\nidempotent UserMap getUsers() throws ServerBootedException, InvalidSecretException;\nidempotent ChannelMap getChannels() throws ServerBootedException, InvalidSecretException;\nidempotent CertificateList getCertificateList(int session) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent Tree getTree() throws ServerBootedException, InvalidSecretException;\nidempotent BanList getBans() throws ServerBootedException, InvalidSecretException;\nidempotent void setBans(BanList bans) throws ServerBootedException, InvalidSecretException;\nvoid kickUser(int session, string reason) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent User getState(int session) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent void setState(User state) throws ServerBootedException, InvalidSessionException, InvalidChannelException, InvalidSecretException;\nvoid sendMessage(int session, string text) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nbool hasPermission(int session, int channelid, int perm) throws ServerBootedException, InvalidSessionException, InvalidChannelException, InvalidSecretException;\nidempotent int effectivePermissions(int session, int channelid) throws ServerBootedException, InvalidSessionException, InvalidChannelException, InvalidSecretException;\nvoid addContextCallback(int session, string action, string text, ServerContextCallback *cb, int ctx) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nvoid removeContextCallback(ServerContextCallback *cb) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nidempotent Channel getChannelState(int channelid) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void setChannelState(Channel state) throws ServerBootedException, InvalidChannelException, InvalidSecretException, NestingLimitException;\nvoid removeChannel(int channelid) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nint addChannel(string name, int parent) throws ServerBootedException, InvalidChannelException, InvalidSecretException, NestingLimitException;\nvoid sendMessageChannel(int channelid, bool tree, string text) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void getACL(int channelid, out ACLList acls, out GroupList groups, out bool inherit) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void setACL(int channelid, ACLList acls, GroupList groups, bool inherit) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void addUserToGroup(int channelid, int session, string group) throws ServerBootedException, InvalidChannelException, InvalidSessionException, InvalidSecretException;\nidempotent void removeUserFromGroup(int channelid, int session, string group) throws ServerBootedException, InvalidChannelException, InvalidSessionException, InvalidSecretException;\nidempotent void redirectWhisperGroup(int session, string source, string target) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent NameMap getUserNames(IdList ids) throws ServerBootedException, InvalidSecretException;\nidempotent IdMap getUserIds(NameList names) throws ServerBootedException, InvalidSecretException;\nint registerUser(UserInfoMap info) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nvoid unregisterUser(int userid) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent void updateRegistration(int userid, UserInfoMap info) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent UserInfoMap getRegistration(int userid) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent NameMap getRegisteredUsers(string filter) throws ServerBootedException, InvalidSecretException;\nidempotent int verifyPassword(string name, string pw) throws ServerBootedException, InvalidSecretException;\nidempotent Texture getTexture(int userid) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent void setTexture(int userid, Texture tex) throws ServerBootedException, InvalidUserException, InvalidTextureException, InvalidSecretException;\nidempotent int getUptime() throws ServerBootedException, InvalidSecretException;\n idempotent void updateCertificate(string certificate, string privateKey, string passphrase) throws ServerBootedException, InvalidSecretException, InvalidInputDataException;\n};\ninterface MetaCallback {\nvoid started(Server *srv);\nvoid stopped(Server *srv);\n};\nsequence<Server *> ServerList;\n[\"amd\"] interface Meta {\nidempotent Server *getServer(int id) throws InvalidSecretException;\nServer *newServer() throws InvalidSecretException;\nidempotent ServerList getBootedServers() throws InvalidSecretException;\nidempotent ServerList getAllServers() throws InvalidSecretException;\nidempotent ConfigMap getDefaultConf() throws InvalidSecretException;\nidempotent void getVersion(out int major, out int minor, out int patch, out string text);\nvoid addCallback(MetaCallback *cb) throws InvalidCallbackException, InvalidSecretException;\nvoid removeCallback(MetaCallback *cb) throws InvalidCallbackException, InvalidSecretException;\nidempotent int getUptime();\nidempotent string getSlice();\nidempotent Ice::SliceChecksumDict getSliceChecksums();\n};\n};\n"));
+	cb->ice_response(std::string("// Copyright 2005-2016 The Mumble Developers. All rights reserved.\n// Use of this source code is governed by a BSD-style license\n// that can be found in the LICENSE file at the root of the\n// Mumble source tree or at <https://www.mumble.info/LICENSE>.\n#include <Ice/SliceChecksumDict.ice>\nmodule Murmur\n{\n[\"python:seq:tuple\"] sequence<byte> NetAddress;\nstruct User {\nint session;\nint userid;\nbool mute;\nbool deaf;\nbool suppress;\nbool prioritySpeaker;\nbool selfMute;\nbool selfDeaf;\nbool recording;\nint channel;\nstring name;\nint onlinesecs;\nint bytespersec;\nint version;\nstring release;\nstring os;\nstring osversion;\nstring identity;\nstring context;\nstring comment;\nNetAddress address;\nbool tcponly;\nint idlesecs;\nfloat udpPing;\nfloat tcpPing;\n};\nsequence<int> IntList;\nstruct TextMessage {\nIntList sessions;\nIntList channels;\nIntList trees;\nstring text;\n};\nstruct Channel {\nint id;\nstring name;\nint parent;\nIntList links;\nstring description;\nbool temporary;\nint position;\n};\nstruct Group {\nstring name;\nbool inherited;\nbool inherit;\nbool inheritable;\nIntList add;\nIntList remove;\nIntList members;\n};\nconst int PermissionWrite = 0x01;\nconst int PermissionTraverse = 0x02;\nconst int PermissionEnter = 0x04;\nconst int PermissionSpeak = 0x08;\nconst int PermissionWhisper = 0x100;\nconst int PermissionMuteDeafen = 0x10;\nconst int PermissionMove = 0x20;\nconst int PermissionMakeChannel = 0x40;\nconst int PermissionMakeTempChannel = 0x400;\nconst int PermissionLinkChannel = 0x80;\nconst int PermissionTextMessage = 0x200;\nconst int PermissionKick = 0x10000;\nconst int PermissionBan = 0x20000;\nconst int PermissionRegister = 0x40000;\nconst int PermissionRegisterSelf = 0x80000;\nstruct ACL {\nbool applyHere;\nbool applySubs;\nbool inherited;\nint userid;\nstring group;\nint allow;\nint deny;\n};\nstruct Ban {\nNetAddress address;\nint bits;\nstring name;\nstring hash;\nstring reason;\nint start;\nint duration;\n};\nstruct LogEntry {\nint timestamp;\nstring txt;\n};\nclass Tree;\nsequence<Tree> TreeList;\nenum ChannelInfo { ChannelDescription, ChannelPosition };\nenum UserInfo { UserName, UserEmail, UserComment, UserHash, UserPassword, UserLastActive };\ndictionary<int, User> UserMap;\ndictionary<int, Channel> ChannelMap;\nsequence<Channel> ChannelList;\nsequence<User> UserList;\nsequence<Group> GroupList;\nsequence<ACL> ACLList;\nsequence<LogEntry> LogList;\nsequence<Ban> BanList;\nsequence<int> IdList;\nsequence<string> NameList;\ndictionary<int, string> NameMap;\ndictionary<string, int> IdMap;\nsequence<byte> Texture;\ndictionary<string, string> ConfigMap;\nsequence<string> GroupNameList;\nsequence<byte> CertificateDer;\nsequence<CertificateDer> CertificateList;\ndictionary<UserInfo, string> UserInfoMap;\nenum ChannelBatchType { ChannelBatchAdd, ChannelBatchRemove, ChannelBatchUpdate, ChannelBatchLink, ChannelBatchUnlink, ChannelBatchSetACL };\nstruct ChannelBatchOperation {\nChannelBatchType type;\nint channel;\nint other;\nstring name;\nstring description;\nbool setPosition;\nint position;\nACLList acls;\nGroupList groups;\nbool inherit;\n};\nsequence<ChannelBatchOperation> ChannelBatch;\nclass Tree {\nChannel c;\nTreeList children;\nUserList users;\n};\nexception MurmurException {};\nexception InvalidSessionException extends MurmurException {};\nexception InvalidChannelException extends MurmurException {};\nexception InvalidServerException extends MurmurException {};\nexception ServerBootedException extends MurmurException {};\nexception ServerFailureException extends MurmurException {};\nexception InvalidUserException extends MurmurException {};\nexception InvalidTextureException extends MurmurException {};\nexception InvalidCallbackException extends MurmurException {};\nexception InvalidSecretException extends MurmurException {};\nexception NestingLimitException extends MurmurException {};\nexception WriteOnlyException extends MurmurException {};\nexception InvalidInputDataException extends MurmurException {};\ninterface ServerCallback {\nidempotent void userConnected(User state);\nidempotent void userDisconnected(User state);\nidempotent void userStateChanged(User state);\nidempotent void userTextMessage(User state, TextMessage message);\nidempotent void channelCreated(Channel state);\nidempotent void channelRemoved(Channel state);\nidempotent void channelStateChanged(Channel state);\n};\nconst int ContextServer = 0x01;\nconst int ContextChannel = 0x02;\nconst int ContextUser = 0x04;\ninterface ServerContextCallback {\nidempotent void contextAction(string action, User usr, int session, int channelid);\n};\ninterface ServerAuthenticator {\nidempotent int authenticate(string name, string pw, CertificateList certificates, string certhash, bool certstrong, out string newname, out GroupNameList groups);\nidempotent bool getInfo(int id, out UserInfoMap info);\nidempotent int nameToId(string name);\nidempotent string idToName(int id);\nidempotent Texture idToTexture(int id);\n};\ninterface ServerUpdatingAuthenticator extends ServerAuthenticator {\nint registerUser(UserInfoMap info);\nint unregisterUser(int id);\nidempotent NameMap getRegisteredUsers(string filter);\nidempotent int setInfo(int id, UserInfoMap info);\nidempotent int setTexture(int id, Texture tex);\n};\n[\"amd\"] interface Server {\nidempotent bool isRunning() throws InvalidSecretException;\nvoid start() throws ServerBootedException, ServerFailureException, InvalidSecretException;\nvoid stop() throws ServerBootedException, InvalidSecretException;\nvoid delete() throws ServerBootedException, InvalidSecretException;\nidempotent int id() throws InvalidSecretException;\nvoid addCallback(ServerCallback *cb) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nvoid removeCallback(ServerCallback *cb) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nvoid setAuthenticator(ServerAuthenticator *auth) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nidempotent string getConf(string key) throws InvalidSecretException, WriteOnlyException;\nidempotent ConfigMap getAllConf() throws InvalidSecretException;\nidempotent void setConf(string key, string value) throws InvalidSecretException;\nidempotent void setSuperuserPassword(string pw) throws InvalidSecretException;\nidempotent LogList getLog(int first, int last) throws InvalidSecretException;\nidempotent int getLogLen() throws InvalidSecretException;\nidempotent UserMap getUsers() throws ServerBootedException, InvalidSecretException;\nidempotent ChannelMap getChannels() throws ServerBootedException, InvalidSecretException;\nidempotent CertificateList getCertificateList(int session) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent Tree getTree() throws ServerBootedException, InvalidSecretException;\nidempotent BanList getBans() throws ServerBootedException, InvalidSecretException;\nidempotent void setBans(BanList bans) throws ServerBootedException, InvalidSecretException;\nvoid kickUser(int session, string reason) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent User getState(int session) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent void setState(User state) throws ServerBootedException, InvalidSessionException, InvalidChannelException, InvalidSecretException;\nvoid sendMessage(int session, string text) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nbool hasPermission(int session, int channelid, int perm) throws ServerBootedException, InvalidSessionException, InvalidChannelException, InvalidSecretException;\nidempotent int effectivePermissions(int session, int channelid) throws ServerBootedException, InvalidSessionException, InvalidChannelException, InvalidSecretException;\nvoid addContextCallback(int session, string action, string text, ServerContextCallback *cb, int ctx) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nvoid removeContextCallback(ServerContextCallback *cb) throws ServerBootedException, InvalidCallbackException, InvalidSecretException;\nidempotent Channel getChannelState(int channelid) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void setChannelState(Channel state) throws ServerBootedException, InvalidChannelException, InvalidSecretException, NestingLimitException;\nvoid removeChannel(int channelid) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nint addChannel(string name, int parent) throws ServerBootedException, InvalidChannelException, InvalidSecretException, NestingLimitException;\nIntList applyChannelBatch(ChannelBatch batch) throws ServerBootedException, InvalidChannelException, InvalidSecretException, NestingLimitException;\nvoid sendMessageChannel(int channelid, bool tree, string text) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void getACL(int channelid, out ACLList acls, out GroupList groups, out bool inherit) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void setACL(int channelid, ACLList acls, GroupList groups, bool inherit) throws ServerBootedException, InvalidChannelException, InvalidSecretException;\nidempotent void addUserToGroup(int channelid, int session, string group) throws ServerBootedException, InvalidChannelException, InvalidSessionException, InvalidSecretException;\nidempotent void removeUserFromGroup(int channelid, int session, string group) throws ServerBootedException, InvalidChannelException, InvalidSessionException, InvalidSecretException;\nidempotent void redirectWhisperGroup(int session, string source, string target) throws ServerBootedException, InvalidSessionException, InvalidSecretException;\nidempotent NameMap getUserNames(IdList ids) throws ServerBootedException, InvalidSecretException;\nidempotent IdMap getUserIds(NameList names) throws ServerBootedException, InvalidSecretException;\nint registerUser(UserInfoMap info) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nvoid unregisterUser(int userid) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent void updateRegistration(int userid, UserInfoMap info) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent UserInfoMap getRegistration(int userid) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent NameMap getRegisteredUsers(string filter) throws ServerBootedException, InvalidSecretException;\nidempotent int verifyPassword(string name, string pw) throws ServerBootedException, InvalidSecretException;\nidempotent Texture getTexture(int userid) throws ServerBootedException, InvalidUserException, InvalidSecretException;\nidempotent void setTexture(int userid, Texture tex) throws ServerBootedException, InvalidUserException, InvalidTextureException, InvalidSecretException;\nidempotent int getUptime() throws ServerBootedException, InvalidSecretException;\n idempotent void updateCertificate(string certificate, string privateKey, string passphrase) throws ServerBootedException, InvalidSecretException, InvalidInputDataException;\n};\ninterface MetaCallback {\nvoid started(Server *srv);\nvoid stopped(Server *srv);\n};\nsequence<Server *> ServerList;\n[\"amd\"] interface Meta {\nidempotent Server *getServer(int id) throws InvalidSecretException;\nServer *newServer() throws InvalidSecretException;\nidempotent ServerList getBootedServers() throws InvalidSecretException;\nidempotent ServerList getAllServers() throws InvalidSecretException;\nidempotent ConfigMap getDefaultConf() throws InvalidSecretException;\nidempotent void getVersion(out int major, out int minor, out int patch, out string text);\nvoid addCallback(MetaCallback *cb) throws InvalidCallbackException, InvalidSecretException;\nvoid removeCallback(MetaCallback *cb) throws InvalidCallbackException, InvalidSecretException;\nidempotent int getUptime();\nidempotent string getSlice();\nidempotent Ice::SliceChecksumDict getSliceChecksums();\n};\n};\n"));
 }
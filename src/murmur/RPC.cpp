@@ -6,6 +6,7 @@
 #include "murmur_pch.h"
 
 #include "Channel.h"
+#include "ControlThread.h"
 #include "Group.h"
 #include "Meta.h"
 #include "Server.h"
@@ -61,7 +62,8 @@ void Server::setUserState(User *pUser, Channel *cChannel, bool mute, bool deaf,
 	}
 
 	pUser->bPrioritySpeaker = prioritySpeaker;
-	pUser->qsName = name;
+	if (name != pUser->qsName)
+		setUserName(static_cast<ServerUser *>(pUser), name);
 	hashAssign(pUser->qsComment, pUser->qbaCommentHash, comment);
 
 	if (cChannel != pUser->cChannel) {
@@ -78,6 +80,7 @@ void Server::setUserState(User *pUser, Channel *cChannel, bool mute, bool deaf,
 		}
 		sendAll(mpus, 0x010202);
 
+		ListenerCall lc(this);
 		emit userStateChanged(pUser);
 	}
 }
@@ -187,7 +190,7 @@ bool Server::setChannelStateGRPC(const MumbleProto::ChannelState &cs, QString &e
 
 	if (cs.has_description()) {
 		QString qsDescription = u8(cs.description());
-		if (qsDescription != channel->qsDesc) {
+		if (qsDescription != channelDescription(channel)) {
 			hashAssign(channel->qsDesc, channel->qbaDescHash, qsDescription);
 			mpcs.set_description(cs.description());
 
@@ -206,6 +209,7 @@ bool Server::setChannelStateGRPC(const MumbleProto::ChannelState &cs, QString &e
 			mpcs.set_description_hash(blob(channel->qbaDescHash));
 		}
 		sendAll(mpcs, 0x010202);
+		ListenerCall lc(this);
 		emit channelStateChanged(channel);
 	}
 
@@ -279,7 +283,7 @@ bool Server::setChannelState(Channel *cChannel, Channel *cParent, const QString
 		mpcs.set_position(position);
 	}
 
-	if (! desc.isNull() && desc != cChannel->qsDesc) {
+	if (! desc.isNull() && desc != channelDescription(cChannel)) {
 		updated = true;
 		changed = true;
 		hashAssign(cChannel->qsDesc, cChannel->qbaDescHash, desc);
@@ -295,6 +299,7 @@ bool Server::setChannelState(Channel *cChannel, Channel *cParent, const QString
 			mpcs.set_description_hash(blob(cChannel->qbaDescHash));
 		}
 		sendAll(mpcs, 0x010202);
+		ListenerCall lc(this);
 		emit channelStateChanged(cChannel);
 	}
 
@@ -463,17 +468,19 @@ void Server::clearTempGroups(User *user, Channel *cChannel, bool recurse) {
 	clearACLCache(user);
 }
 
+// Authenticators and listeners are called on the thread of the
+// server, which can be a control thread. See ControlThread.
 void Server::connectAuthenticator(QObject *obj) {
-	connect(this, SIGNAL(registerUserSig(int &, const QMap<int, QString> &)), obj, SLOT(registerUserSlot(int &, const QMap<int, QString> &)));
-	connect(this, SIGNAL(unregisterUserSig(int &, int)), obj, SLOT(unregisterUserSlot(int &, int)));
-	connect(this, SIGNAL(getRegisteredUsersSig(const QString &, QMap<int, QString> &)), obj, SLOT(getRegisteredUsersSlot(const QString &, QMap<int, QString> &)));
-	connect(this, SIGNAL(getRegistrationSig(int &, int, QMap<int, QString> &)), obj, SLOT(getRegistrationSlot(int &, int, QMap<int, QString> &)));
-	connect(this, SIGNAL(authenticateSig(int &, QString &, int, const QList<QSslCertificate> &, const QString &, bool, const QString &)), obj, SLOT(authenticateSlot(int &, QString &, int, const QList<QSslCertificate> &, const QString &, bool, const QString &)));
-	connect(this, SIGNAL(setInfoSig(int &, int, const QMap<int, QString> &)), obj, SLOT(setInfoSlot(int &, int, const QMap<int, QString> &)));
-	connect(this, SIGNAL(setTextureSig(int &, int, const QByteArray &)), obj, SLOT(setTextureSlot(int &, int, const QByteArray &)));
-	connect(this, SIGNAL(idToNameSig(QString &, int)), obj, SLOT(idToNameSlot(QString &, int)));
-	connect(this, SIGNAL(nameToIdSig(int &, const QString &)), obj, SLOT(nameToIdSlot(int &, const QString &)));
-	connect(this, SIGNAL(idToTextureSig(QByteArray &, int)), obj, SLOT(idToTextureSlot(QByteArray &, int)));
+	connect(this, SIGNAL(registerUserSig(int &, const QMap<int, QString> &)), obj, SLOT(registerUserSlot(int &, const QMap<int, QString> &)), Qt::DirectConnection);
+	connect(this, SIGNAL(unregisterUserSig(int &, int)), obj, SLOT(unregisterUserSlot(int &, int)), Qt::DirectConnection);
+	connect(this, SIGNAL(getRegisteredUsersSig(const QString &, QMap<int, QString> &)), obj, SLOT(getRegisteredUsersSlot(const QString &, QMap<int, QString> &)), Qt::DirectConnection);
+	connect(this, SIGNAL(getRegistrationSig(int &, int, QMap<int, QString> &)), obj, SLOT(getRegistrationSlot(int &, int, QMap<int, QString> &)), Qt::DirectConnection);
+	connect(this, SIGNAL(authenticateSig(int &, QString &, int, const QList<QSslCertificate> &, const QString &, bool, const QString &)), obj, SLOT(authenticateSlot(int &, QString &, int, const QList<QSslCertificate> &, const QString &, bool, const QString &)), Qt::DirectConnection);
+	connect(this, SIGNAL(setInfoSig(int &, int, const QMap<int, QString> &)), obj, SLOT(setInfoSlot(int &, int, const QMap<int, QString> &)), Qt::DirectConnection);
+	connect(this, SIGNAL(setTextureSig(int &, int, const QByteArray &)), obj, SLOT(setTextureSlot(int &, int, const QByteArray &)), Qt::DirectConnection);
+	connect(this, SIGNAL(idToNameSig(QString &, int)), obj, SLOT(idToNameSlot(QString &, int)), Qt::DirectConnection);
+	connect(this, SIGNAL(nameToIdSig(int &, const QString &)), obj, SLOT(nameToIdSlot(int &, const QString &)), Qt::DirectConnection);
+	connect(this, SIGNAL(idToTextureSig(QByteArray &, int)), obj, SLOT(idToTextureSlot(QByteArray &, int)), Qt::DirectConnection);
 }
 
 void Server::disconnectAuthenticator(QObject *obj) {
@@ -490,13 +497,13 @@ void Server::disconnectAuthenticator(QObject *obj) {
 }
 
 void Server::connectListener(QObject *obj) {
-	connect(this, SIGNAL(userStateChanged(const User *)), obj, SLOT(userStateChanged(const User *)));
-	connect(this, SIGNAL(userTextMessage(const User *, const TextMessage &)), obj, SLOT(userTextMessage(const User *, const TextMessage &)));
-	connect(this, SIGNAL(userConnected(const User *)), obj, SLOT(userConnected(const User *)));
-	connect(this, SIGNAL(userDisconnected(const User *)), obj, SLOT(userDisconnected(const User *)));
-	connect(this, SIGNAL(channelStateChanged(const Channel *)), obj, SLOT(channelStateChanged(const Channel *)));
-	connect(this, SIGNAL(channelCreated(const Channel *)), obj, SLOT(channelCreated(const Channel *)));
-	connect(this, SIGNAL(channelRemoved(const Channel *)), obj, SLOT(channelRemoved(const Channel *)));
+	connect(this, SIGNAL(userStateChanged(const User *)), obj, SLOT(userStateChanged(const User *)), Qt::DirectConnection);
+	connect(this, SIGNAL(userTextMessage(const User *, const TextMessage &)), obj, SLOT(userTextMessage(const User *, const TextMessage &)), Qt::DirectConnection);
+	connect(this, SIGNAL(userConnected(const User *)), obj, SLOT(userConnected(const User *)), Qt::DirectConnection);
+	connect(this, SIGNAL(userDisconnected(const User *)), obj, SLOT(userDisconnected(const User *)), Qt::DirectConnection);
+	connect(this, SIGNAL(channelStateChanged(const Channel *)), obj, SLOT(channelStateChanged(const Channel *)), Qt::DirectConnection);
+	connect(this, SIGNAL(channelCreated(const Channel *)), obj, SLOT(channelCreated(const Channel *)), Qt::DirectConnection);
+	connect(this, SIGNAL(channelRemoved(const Channel *)), obj, SLOT(channelRemoved(const Channel *)), Qt::DirectConnection);
 }
 
 void Server::disconnectListener(QObject *obj) {
@@ -9,6 +9,7 @@
 
 #include "ACL.h"
 #include "Connection.h"
+#include "ControlThread.h"
 #include "Group.h"
 #include "User.h"
 #include "Channel.h"
@@ -117,6 +118,18 @@ Server::Server(int snum, QObject *p) : QThread(p) {
 	iCodecAlpha = iCodecBeta = 0;
 	bPreferAlpha = false;
 	bOpus = true;
+	iCodecUsers = iOpusUsers = 0;
+
+	ssSnapshot = ServerSnapshot(snum);
+	ssSnapshot.uiEpoch = static_cast<quint64>(QDateTime::currentMSecsSinceEpoch());
+	bSnapshotPending = false;
+	bSnapshotStats = false;
+	uiTextMessageId = 0;
+	iTextBlobBytes = 0;
+	bUserCountsScheduled = false;
+	bProtoCacheBusy = false;
+	// Reserved, so that emptying the buffer keeps its memory.
+	qbaProtoCache.reserve(1024);
 
 	qnamNetwork = NULL;
 
@@ -241,6 +254,13 @@ Server::Server(int snum, QObject *p) : QThread(p) {
 
 	connect(qtTimeout, SIGNAL(timeout()), this, SLOT(checkTimeout()));
 
+	connect(this, SIGNAL(userConnected(const User *)), this, SLOT(markSnapshotUser(const User *)));
+	connect(this, SIGNAL(userDisconnected(const User *)), this, SLOT(markSnapshotUser(const User *)));
+	connect(this, SIGNAL(userStateChanged(const User *)), this, SLOT(markSnapshotUser(const User *)));
+	connect(this, SIGNAL(channelCreated(const Channel *)), this, SLOT(markSnapshotChannel(const Channel *)));
+	connect(this, SIGNAL(channelRemoved(const Channel *)), this, SLOT(markSnapshotChannel(const Channel *)));
+	connect(this, SIGNAL(channelStateChanged(const Channel *)), this, SLOT(markSnapshotChannel(const Channel *)));
+
 	getBans();
 	readChannels();
 	readLinks();
@@ -259,6 +279,9 @@ Server::Server(int snum, QObject *p) : QThread(p) {
 #endif
 		initRegister();
 
+		foreach(const Channel *c, qhChannels)
+			markSnapshotChannel(c->iId);
+		publishSnapshot();
 	}
 }
 
@@ -284,7 +307,7 @@ void Server::startThread() {
 #endif
 	}
 	if (! qtTimeout->isActive())
-		qtTimeout->start(15500);
+		qtTimeout->start(1000);
 }
 
 void Server::stopThread() {
@@ -307,7 +330,21 @@ void Server::stopThread() {
 	qtTimeout->stop();
 }
 
+void Server::moveToControlThread(QThread *thread) {
+	// Only objects without a parent can change threads. The
+	// server is deleted explicitly by Meta, so it doesn't need one.
+	setParent(NULL);
+	qtTick.moveToThread(thread);
+#ifdef USE_BONJOUR
+	if (bsRegistration)
+		bsRegistration->moveToThread(thread);
+#endif
+	moveToThread(thread);
+}
+
 Server::~Server() {
+	ServerSnapshot::withdraw(iServerNum);
+
 #ifdef USE_BONJOUR
 	removeBonjour();
 #endif
@@ -380,6 +417,7 @@ void Server::readParams() {
 	iMaxUsersPerChannel = Meta::mp.iMaxUsersPerChannel;
 	iMaxTextMessageLength = Meta::mp.iMaxTextMessageLength;
 	iMaxImageMessageLength = Meta::mp.iMaxImageMessageLength;
+	iTextMessageBlobLength = Meta::mp.iTextMessageBlobLength;
 	bAllowHTML = Meta::mp.bAllowHTML;
 	iDefaultChan = Meta::mp.iDefaultChan;
 	bRememberChan = Meta::mp.bRememberChan;
@@ -437,6 +475,7 @@ void Server::readParams() {
 	iMaxUsersPerChannel = getConf("usersperchannel", iMaxUsersPerChannel).toInt();
 	iMaxTextMessageLength = getConf("textmessagelength", iMaxTextMessageLength).toInt();
 	iMaxImageMessageLength = getConf("imagemessagelength", iMaxImageMessageLength).toInt();
+	iTextMessageBlobLength = getConf("textmessagebloblength", iTextMessageBlobLength).toInt();
 	bAllowHTML = getConf("allowhtml", bAllowHTML).toBool();
 	iDefaultChan = getConf("defaultchannel", iDefaultChan).toInt();
 	bRememberChan = getConf("rememberchannel", bRememberChan).toBool();
@@ -477,8 +516,16 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 	int i = v.toInt();
 	if ((key == "password") || (key == "serverpassword"))
 		qsPassword = !v.isNull() ? v : Meta::mp.qsPassword;
-	else if (key == "timeout")
-		iTimeout = i ? i : Meta::mp.iTimeout;
+	else if (key == "timeout") {
+		int timeout = i ? i : Meta::mp.iTimeout;
+		if (timeout != iTimeout) {
+			iTimeout = timeout;
+			// Re-arm everyone so a shorter timeout takes effect
+			// without waiting for the old deadlines.
+			foreach(ServerUser *u, qhUsers)
+				twTimeouts.schedule(u->uiSession, timeoutClock() + static_cast<quint64>(qMax(0LL, iTimeout * 1000LL - u->activityTime())));
+		}
+	}
 	else if (key == "bandwidth") {
 		int length = i ? i : Meta::mp.iMaxBandwidth;
 		if (length != iMaxBandwidth) {
@@ -519,6 +566,8 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 			mpsc.set_image_message_length(length);
 			sendAll(mpsc);
 		}
+	} else if (key == "textmessagebloblength") {
+		iTextMessageBlobLength = i ? i : Meta::mp.iTextMessageBlobLength;
 	} else if (key == "allowhtml") {
 		bool allow = !v.isNull() ? QVariant(v).toBool() : Meta::mp.bAllowHTML;
 		if (allow != bAllowHTML) {
@@ -822,7 +871,7 @@ void Server::run() {
 					foreach(ServerUser *usr, qhHostUsers.value(ha)) {
 						if (checkDecrypt(usr, encrypt, buffer, len)) { // checkDecrypt takes the User's qrwlCrypt lock.
 							// Every time we relock, reverify users' existance.
-							// The main thread might delete the user while the lock isn't held.
+							// The control thread might delete the user while the lock isn't held.
 							unsigned int uiSession = usr->uiSession;
 							rl.unlock();
 							qrwlVoiceThread.lockForWrite();
@@ -935,7 +984,7 @@ void Server::sendMessage(ServerUser *u, const char *data, int len, QByteArray &c
 		msg.msg_controllen = CMSG_SPACE((u->saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo) : sizeof(struct in_pktinfo));
 
 		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-		HostAddress tcpha(u->saiTcpLocalAddress);
+		const HostAddress &tcpha = u->haTcpLocalAddress;
 		if (u->saiUdpAddress.ss_family == AF_INET6) {
 			cmsg->cmsg_level = IPPROTO_IPV6;
 			cmsg->cmsg_type = IPV6_PKTINFO;
@@ -1219,7 +1268,7 @@ void Server::newClient() {
 		ServerUser *u = new ServerUser(this, sock);
 		u->uiSession = qqIds.dequeue();
 		u->haAddress = ha;
-		HostAddress(sock->localAddress()).toSockaddr(& u->saiTcpLocalAddress);
+		u->haTcpLocalAddress = HostAddress(sock->localAddress());
 
 		{
 			QWriteLocker wl(&qrwlVoiceThread);
@@ -1227,6 +1276,8 @@ void Server::newClient() {
 			qhHostUsers[ha].insert(u);
 		}
 
+		rescheduleTimeout(u);
+
 		connect(u, SIGNAL(connectionClosed(QAbstractSocket::SocketError, const QString &)), this, SLOT(connectionClosed(QAbstractSocket::SocketError, const QString &)));
 		connect(u, SIGNAL(message(unsigned int, const QByteArray &)), this, SLOT(message(unsigned int, const QByteArray &)));
 		connect(u, SIGNAL(handleSslErrors(const QList<QSslError> &)), this, SLOT(sslError(const QList<QSslError> &)));
@@ -1392,11 +1443,17 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 		mpur.set_session(u->uiSession);
 		sendExcept(u, mpur);
 
+		ListenerCall lc(this);
 		emit userDisconnected(u);
 	}
 
 	Channel *old = u->cChannel;
 
+	twTimeouts.cancel(u->uiSession);
+	removeCodecUser(u);
+	if (u->sState == ServerUser::Authenticated)
+		unindexUser(u);
+
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 
@@ -1411,9 +1468,14 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 			old->removeUser(u);
 	}
 
+	markUserCount(old);
+
 	if (old && old->bTemporary && old->qlUsers.isEmpty())
 		QCoreApplication::instance()->postEvent(this, new ExecEvent(boost::bind(&Server::removeChannel, this, old->iId)));
 
+	for (QHash<QByteArray, TextBlob>::iterator i = qhTextBlobs.begin(); i != qhTextBlobs.end(); ++i)
+		i.value().qsSessions.remove(u->uiSession);
+
 	if (static_cast<int>(u->uiSession) < iMaxUsers * 2)
 		qqIds.enqueue(u->uiSession); // Reinsert session id into pool
 
@@ -1435,6 +1497,7 @@ void Server::message(unsigned int uiType, const QByteArray &qbaMsg, ServerUser *
 
 	if (u->sState == ServerUser::Authenticated) {
 		u->resetActivityTime();
+		rescheduleTimeout(u);
 	}
 
 	if (uiType == MessageHandler::UDPTunnel) {
@@ -1468,7 +1531,8 @@ void Server::message(unsigned int uiType, const QByteArray &qbaMsg, ServerUser *
 
 #ifdef QT_NO_DEBUG
 #define MUMBLE_MH_MSG(x) case MessageHandler:: x : { \
-		MumbleProto:: x msg; \
+		MessageCache<MumbleProto:: x>::Lease lease(mc##x, qbaMsg.size()); \
+		MumbleProto:: x &msg = lease.message(); \
 		if (msg.ParseFromArray(qbaMsg.constData(), qbaMsg.size())) { \
 			msg.DiscardUnknownFields(); \
 			msg##x(u, msg); \
@@ -1477,7 +1541,8 @@ void Server::message(unsigned int uiType, const QByteArray &qbaMsg, ServerUser *
 	}
 #else
 #define MUMBLE_MH_MSG(x) case MessageHandler:: x : { \
-		MumbleProto:: x msg; \
+		MessageCache<MumbleProto:: x>::Lease lease(mc##x, qbaMsg.size()); \
+		MumbleProto:: x &msg = lease.message(); \
 		if (msg.ParseFromArray(qbaMsg.constData(), qbaMsg.size())) { \
 			if (uiType != MessageHandler::Ping) { \
 				printf("== %s:\n", #x); \
@@ -1495,21 +1560,154 @@ void Server::message(unsigned int uiType, const QByteArray &qbaMsg, ServerUser *
 	}
 }
 
+quint64 Server::timeoutClock() const {
+	return tUptime.elapsed() / 1000ULL;
+}
+
+void Server::rescheduleTimeout(ServerUser *u) {
+	twTimeouts.schedule(u->uiSession, timeoutClock() + static_cast<quint64>(iTimeout) * 1000ULL);
+}
+
 void Server::checkTimeout() {
 	QList<ServerUser *> qlClose;
 
-	qrwlVoiceThread.lockForRead();
-	foreach(ServerUser *u, qhUsers) {
+	// qhUsers is owned by the control thread, which this runs on,
+	// so no lock is needed to read it here.
+	foreach(unsigned int session, twTimeouts.advance(timeoutClock())) {
+		ServerUser *u = qhUsers.value(session);
+		if (! u)
+			continue;
+
 		if (u->activityTime() > (iTimeout * 1000)) {
 			log(u, "Timeout");
 			qlClose.append(u);
+		} else {
+			// The timeout was raised since the deadline was armed.
+			twTimeouts.schedule(session, timeoutClock() + static_cast<quint64>(iTimeout * 1000 - u->activityTime()));
 		}
 	}
-	qrwlVoiceThread.unlock();
+
 	foreach(ServerUser *u, qlClose)
 		u->disconnectSocket(true);
 }
 
+void Server::scheduleSnapshot() {
+	if (! bSnapshotPending) {
+		bSnapshotPending = true;
+		QMetaObject::invokeMethod(this, "publishSnapshot", Qt::QueuedConnection);
+	}
+}
+
+void Server::markSnapshotUser(const User *u) {
+	qsSnapshotUsers.insert(u->uiSession);
+	scheduleSnapshot();
+}
+
+void Server::markSnapshotChannel(const Channel *c) {
+	markSnapshotChannel(c->iId);
+}
+
+void Server::markSnapshotChannel(int id) {
+	qsSnapshotChannels.insert(id);
+	scheduleSnapshot();
+}
+
+void Server::markSnapshotACL(const Channel *c) {
+	qsSnapshotACLs.insert(c->iId);
+	scheduleSnapshot();
+}
+
+void Server::publishSnapshot() {
+	if (! bSnapshotPending)
+		return;
+	bSnapshotPending = false;
+
+	SnapshotDelta delta;
+
+	foreach(unsigned int session, qsSnapshotUsers) {
+		ServerUser *u = qhUsers.value(session);
+		if (u && (u->sState == ServerUser::Authenticated)) {
+			UserSnapshot us(u);
+			ssSnapshot.qhUsers.insert(session, us);
+			delta.qlUsers << us;
+		} else if (ssSnapshot.qhUsers.remove(session)) {
+			delta.qlRemovedUsers << session;
+		}
+	}
+	qsSnapshotUsers.clear();
+
+	foreach(int id, qsSnapshotChannels) {
+		Channel *c = qhChannels.value(id);
+		if (c) {
+			ChannelSnapshot cs(c);
+			ssSnapshot.qhChannels.insert(id, cs);
+			delta.qlChannels << cs;
+		} else if (ssSnapshot.qhChannels.remove(id)) {
+			delta.qlRemovedChannels << id;
+		}
+	}
+	qsSnapshotChannels.clear();
+
+	foreach(int id, qsSnapshotACLs)
+		if (qhChannels.contains(id))
+			delta.qlACLChannels << id;
+	qsSnapshotACLs.clear();
+
+	if (bSnapshotStats) {
+		bSnapshotStats = false;
+		ssSnapshot.uiStatsTime = ServerSnapshot::now();
+		for (QHash<unsigned int, UserSnapshot>::iterator i = ssSnapshot.qhUsers.begin(); i != ssSnapshot.qhUsers.end(); ++i) {
+			const ServerUser *u = qhUsers.value(i.key());
+			if (u) {
+				UserSnapshot &us = i.value();
+				us.iOnlineSecs = u->bwr.onlineSeconds();
+				us.iIdleSecs = u->bwr.idleSeconds();
+				us.iBandwidth = u->bwr.bandwidth();
+				us.fUDPPing = u->dUDPPingAvg;
+				us.fTCPPing = u->dTCPPingAvg;
+				us.bTcpOnly = (u->aiUdpFlag == 0);
+			}
+		}
+	}
+
+	if (! delta.isEmpty())
+		ssSnapshot.addDelta(delta);
+	ServerSnapshot::publish(ssSnapshot, this);
+
+	if (! delta.isEmpty()) {
+		ListenerCall lc(this);
+		emit stateChanged(ssSnapshot);
+	}
+}
+
+void Server::refreshSnapshotStats() {
+	// Online and idle time, bandwidth and ping change without any
+	// event, so ServerSnapshot::get() asks for them when they are
+	// read. This is not a change of state, and doesn't create a
+	// new version.
+	bSnapshotStats = true;
+	bSnapshotPending = true;
+	publishSnapshot();
+}
+
+void Server::logMemoryUsage() const {
+	size_t total = 0;
+	size_t bandwidth = 0;
+	int users = 0;
+
+	foreach(ServerUser *u, qhUsers) {
+		total += u->memoryUsage();
+		bandwidth += u->bwr.memoryUsage();
+		++users;
+	}
+
+	log(QString::fromLatin1("Memory: %1 connections, %2 bytes (%3 bytes per connection, %4 bytes of voice bandwidth history)")
+	        .arg(users)
+	        .arg(static_cast<qulonglong>(total))
+	        .arg(static_cast<qulonglong>(users ? total / users : 0))
+	        .arg(static_cast<qulonglong>(bandwidth)));
+}
+
 void Server::tcpTransmitData(QByteArray a, unsigned int id) {
 	Connection *c = qhUsers.value(id);
 	if (c) {
@@ -1536,9 +1734,46 @@ void Server::doSync(unsigned int id) {
 	}
 }
 
+/// Hands out the buffer of a server that protobuf messages are
+/// serialized into, emptied but with its memory kept, or a buffer
+/// of its own if the server's is in use further up the stack.
+/// That happens when sending fails and the connection is closed
+/// from within the send.
+class ProtoCacheLease {
+	private:
+		Q_DISABLE_COPY(ProtoCacheLease)
+		QByteArray &qbaCache;
+		bool &bBusy;
+		bool bLeased;
+		QByteArray qbaOwn;
+	public:
+		/// Buffers that grew larger than this for a large message
+		/// are released after use.
+		static const int iMaxCapacity = 65536;
+
+		ProtoCacheLease(QByteArray &cache, bool &busy) : qbaCache(cache), bBusy(busy), bLeased(! busy) {
+			if (bLeased) {
+				bBusy = true;
+				qbaCache.resize(0);
+			}
+		}
+		~ProtoCacheLease() {
+			if (! bLeased)
+				return;
+			if (qbaCache.capacity() > iMaxCapacity) {
+				qbaCache = QByteArray();
+				qbaCache.reserve(1024);
+			}
+			bBusy = false;
+		}
+		QByteArray &cache() {
+			return bLeased ? qbaCache : qbaOwn;
+		}
+};
+
 void Server::sendProtoMessage(ServerUser *u, const ::google::protobuf::Message &msg, unsigned int msgType) {
-	QByteArray cache;
-	u->sendMessage(msg, msgType, cache);
+	ProtoCacheLease lease(qbaProtoCache, bProtoCacheBusy);
+	u->sendMessage(msg, msgType, lease.cache());
 }
 
 void Server::sendProtoAll(const ::google::protobuf::Message &msg, unsigned int msgType, unsigned int version) {
@@ -1546,11 +1781,13 @@ void Server::sendProtoAll(const ::google::protobuf::Message &msg, unsigned int m
 }
 
 void Server::sendProtoExcept(ServerUser *u, const ::google::protobuf::Message &msg, unsigned int msgType, unsigned int version) {
-	QByteArray cache;
+	ProtoCacheLease lease(qbaProtoCache, bProtoCacheBusy);
+	QByteArray &cache = lease.cache();
 	foreach(ServerUser *usr, qhUsers)
 		if ((usr != u) && (usr->sState == ServerUser::Authenticated))
 			if ((version == 0) || (usr->uiVersion >= version) || ((version & 0x80000000) && (usr->uiVersion < (~version))))
-				usr->sendMessage(msg, msgType, cache);
+				if (! usr->bScopedUserState || scopeUserMessage(usr, msg, msgType))
+					usr->sendMessage(msg, msgType, cache);
 }
 
 void Server::removeChannel(int id) {
@@ -1566,6 +1803,9 @@ void Server::removeChannel(Channel *chan, Channel *dest) {
 	if (dest == NULL)
 		dest = chan->cParent;
 
+	foreach(const Channel *l, chan->qsPermLinks)
+		markSnapshotChannel(l->iId);
+
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 		chan->unlink(NULL);
@@ -1590,6 +1830,7 @@ void Server::removeChannel(Channel *chan, Channel *dest) {
 		mpus.set_channel_id(target->iId);
 		userEnterChannel(p, target, mpus);
 		sendAll(mpus);
+		ListenerCall lc(this);
 		emit userStateChanged(p);
 	}
 
@@ -1597,8 +1838,15 @@ void Server::removeChannel(Channel *chan, Channel *dest) {
 	mpcr.set_channel_id(chan->iId);
 	sendAll(mpcr);
 
+	// Listeners of channelRemoved get the full description, which
+	// can't be read from the database once the channel is gone.
+	chan->qsDesc = channelDescription(chan);
+
 	removeChannelDB(chan);
-	emit channelRemoved(chan);
+	{
+		ListenerCall lc(this);
+		emit channelRemoved(chan);
+	}
 
 	if (chan->cParent) {
 		QWriteLocker wl(&qrwlVoiceThread);
@@ -1630,32 +1878,83 @@ bool Server::unregisterUser(int id) {
 				bool remrem = g->qsRemove.remove(id);
 				write = write || addrem || remrem;
 			}
-			if (write)
+			if (write) {
 				updateChannel(c);
+				markSnapshotACL(c);
+			}
 		}
 	}
 
-	foreach(ServerUser *u, qhUsers) {
-		if (u->iId == id) {
-			clearACLCache(u);
-			MumbleProto::UserState mpus;
-			mpus.set_session(u->uiSession);
-			mpus.set_user_id(-1);
-			sendAll(mpus);
-
-			u->iId = -1;
-			break;
-		}
+	ServerUser *u = userById(id);
+	if (u) {
+		clearACLCache(u);
+		MumbleProto::UserState mpus;
+		mpus.set_session(u->uiSession);
+		mpus.set_user_id(-1);
+		sendAll(mpus);
+
+		setUserId(u, -1);
 	}
 	return true;
 }
 
+void Server::indexUser(ServerUser *u) {
+	qmhUsersByName.insert(u->qsName.toLower(), u);
+	if (u->iId >= 0)
+		qmhUsersById.insert(u->iId, u);
+}
+
+void Server::unindexUser(ServerUser *u) {
+	qmhUsersByName.remove(u->qsName.toLower(), u);
+	if (u->iId >= 0)
+		qmhUsersById.remove(u->iId, u);
+}
+
+void Server::setUserName(ServerUser *u, const QString &name) {
+	if (u->sState != ServerUser::Authenticated) {
+		u->qsName = name;
+		return;
+	}
+
+	unindexUser(u);
+	u->qsName = name;
+	indexUser(u);
+	markSnapshotUser(u);
+}
+
+void Server::setUserId(ServerUser *u, int id) {
+	if (u->sState != ServerUser::Authenticated) {
+		u->iId = id;
+		return;
+	}
+
+	unindexUser(u);
+	u->iId = id;
+	indexUser(u);
+	markSnapshotUser(u);
+}
+
+ServerUser *Server::userByName(const QString &name) const {
+	return qmhUsersByName.value(name.toLower());
+}
+
+ServerUser *Server::userById(int id) const {
+	if (id < 0)
+		return NULL;
+	return qmhUsersById.value(id);
+}
+
 void Server::userEnterChannel(User *p, Channel *c, MumbleProto::UserState &mpus) {
 	if (p->cChannel == c)
 		return;
 
+	markSnapshotUser(p);
+
 	Channel *old = p->cChannel;
 
+	markUserCount(old);
+	markUserCount(c);
+
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 		c->addUser(p);
@@ -1680,6 +1979,10 @@ void Server::userEnterChannel(User *p, Channel *c, MumbleProto::UserState &mpus)
 	sendClientPermission(static_cast<ServerUser *>(p), c);
 	if (c->cParent)
 		sendClientPermission(static_cast<ServerUser *>(p), c->cParent);
+
+	ServerUser *u = static_cast<ServerUser *>(p);
+	if (u->bScopedUserState && (u->sState == ServerUser::Authenticated))
+		updateInterest(u);
 }
 
 bool Server::hasPermission(ServerUser *p, Channel *c, QFlags<ChanACL::Perm> perm) {
@@ -1820,26 +2123,43 @@ bool Server::validateChannelName(const QString &name) {
 	return (qrChannelName.exactMatch(name) && (name.length() <= 512));
 }
 
-void Server::recheckCodecVersions(ServerUser *connectingUser) {
-	QMap<int, int> qmCodecUsercount;
-	QMap<int, int>::const_iterator i;
-	int users = 0;
-	int opus = 0;
+void Server::addCodecUser(ServerUser *u) {
+	if (u->qlCodecs.isEmpty() && ! u->bOpus)
+		return;
 
-	// Count how many users use which codec
-	foreach(ServerUser *u, qhUsers) {
-		if (u->qlCodecs.isEmpty() && ! u->bOpus)
-			continue;
+	++iCodecUsers;
+	if (u->bOpus)
+		++iOpusUsers;
 
-		++users;
-		if (u->bOpus)
-			++opus;
+	foreach(int version, u->qlCodecs)
+		++qmCodecUsercount[version];
+}
+
+void Server::removeCodecUser(ServerUser *u) {
+	if (u->qlCodecs.isEmpty() && ! u->bOpus)
+		return;
 
-		foreach(int version, u->qlCodecs)
-			++qmCodecUsercount[version];
+	--iCodecUsers;
+	if (u->bOpus)
+		--iOpusUsers;
+
+	foreach(int version, u->qlCodecs) {
+		QMap<int, int>::iterator it = qmCodecUsercount.find(version);
+		if (it != qmCodecUsercount.end() && (--it.value() <= 0))
+			qmCodecUsercount.erase(it);
 	}
 
-	if (! users)
+	// A user's codecs are only ever declared once, in msgAuthenticate,
+	// so the tallies must never go negative.
+	Q_ASSERT(iCodecUsers >= 0 && iOpusUsers >= 0);
+}
+
+void Server::recheckCodecVersions(ServerUser *connectingUser) {
+	QMap<int, int>::const_iterator i;
+	const int users = iCodecUsers;
+	const int opus = iOpusUsers;
+
+	if (! users || qmCodecUsercount.isEmpty())
 		return;
 
 	// Enable Opus if the number of users with Opus is higher than the threshold
@@ -1906,7 +2226,7 @@ void Server::recheckCodecVersions(ServerUser *connectingUser) {
 
 void Server::hashAssign(QString &dest, QByteArray &hash, const QString &src) {
 	dest = src;
-	if (src.length() >= 128)
+	if (src.length() >= BLOB_HASH_THRESHOLD)
 		hash = sha1(src);
 	else
 		hash = QByteArray();
@@ -1914,7 +2234,7 @@ void Server::hashAssign(QString &dest, QByteArray &hash, const QString &src) {
 
 void Server::hashAssign(QByteArray &dest, QByteArray &hash, const QByteArray &src) {
 	dest = src;
-	if (src.length() >= 128)
+	if (src.length() >= BLOB_HASH_THRESHOLD)
 		hash = sha1(src);
 	else
 		hash = QByteArray();
@@ -1925,7 +2245,7 @@ bool Server::isTextAllowed(QString &text, bool &changed) {
 
 	if (! bAllowHTML) {
 		QString out;
-		if (HTMLFilter::filter(text, out)) {
+		if (HTMLFilter::filter(text, out) && (out != text)) {
 			changed = true;
 			text = out;
 		}
@@ -1949,33 +2269,11 @@ bool Server::isTextAllowed(QString &text, bool &changed) {
 		if (! text.contains(QLatin1Char('<')))
 			return false;
 
-		// Strip value from <img>s src attributes to check text-length only -
+		// Only count the text outside of the src attributes of <img>s -
 		// we already ensured the img-length requirement is met
-		QString qsOut;
-		QXmlStreamReader qxsr(QString::fromLatin1("<document>%1</document>").arg(text));
-		QXmlStreamWriter qxsw(&qsOut);
-		while (! qxsr.atEnd()) {
-			switch (qxsr.readNext()) {
-				case QXmlStreamReader::Invalid:
-					return false;
-				case QXmlStreamReader::StartElement: {
-						if (qxsr.name() == QLatin1String("img")) {
-							qxsw.writeStartElement(qxsr.namespaceUri().toString(), qxsr.name().toString());
-							foreach(const QXmlStreamAttribute &a, qxsr.attributes())
-								if (a.name() != QLatin1String("src"))
-									qxsw.writeAttribute(a);
-						} else {
-							qxsw.writeCurrentToken(qxsr);
-						}
-					}
-					break;
-				default:
-					qxsw.writeCurrentToken(qxsr);
-					break;
-			}
-		}
-
-		length = qsOut.length();
+		int imageLength;
+		if (! HTMLFilter::measure(text, length, imageLength))
+			return false;
 
 		return (length <= iMaxTextMessageLength);
 	}
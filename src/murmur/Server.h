@@ -32,10 +32,14 @@
 
 #include "ACL.h"
 #include "Message.h"
+#include "MessageCache.h"
 #include "Mumble.pb.h"
 #include "Net.h"
 #include "User.h"
 #include "Timer.h"
+#include "TimerWheel.h"
+#include "ServerSnapshot.h"
+#include "ChannelBatch.h"
 
 class BonjourServer;
 class Channel;
@@ -89,7 +93,7 @@ class ExecEvent : public QEvent {
 		boost::function<void ()> func;
 	public:
 		ExecEvent(boost::function<void ()>);
-		void execute();
+		virtual void execute();
 };
 
 class Server : public QThread {
@@ -120,6 +124,7 @@ class Server : public QThread {
 		bool bRememberChan;
 		int iMaxTextMessageLength;
 		int iMaxImageMessageLength;
+		int iTextMessageBlobLength;
 		int iOpusThreshold;
 		bool bAllowHTML;
 		QString qsPassword;
@@ -159,6 +164,16 @@ class Server : public QThread {
 		int iCodecBeta;
 		bool bPreferAlpha;
 		bool bOpus;
+
+		/// Codec support tallies of all users that declared their
+		/// codecs, maintained by addCodecUser() and removeCodecUser()
+		/// so recheckCodecVersions() doesn't have to walk qhUsers.
+		/// Only accessed from the server's control thread.
+		QMap<int, int> qmCodecUsercount;
+		int iCodecUsers;
+		int iOpusUsers;
+		void addCodecUser(ServerUser *u);
+		void removeCodecUser(ServerUser *u);
 		void recheckCodecVersions(ServerUser *connectingUser = 0);
 
 #ifdef USE_BONJOUR
@@ -169,6 +184,10 @@ class Server : public QThread {
 		QTimer qtTick;
 		void initRegister();
 
+		/// Moves the server and everything it owns to thread,
+		/// whose event loop then runs the server's control plane.
+		void moveToControlThread(QThread *thread);
+
 	private:
 		int iChannelNestingLimit;
 
@@ -184,6 +203,15 @@ class Server : public QThread {
 		const QString getDigest() const;
 
 	public slots:
+		void markSnapshotUser(const User *u);
+		void markSnapshotChannel(const Channel *c);
+		/// Record that the ACLs or groups of c changed.
+		void markSnapshotACL(const Channel *c);
+		/// Publish the pending changes to the snapshot now.
+		void publishSnapshot();
+		/// Publish the snapshot with up to date statistics now.
+		void refreshSnapshotStats();
+
 		void newClient();
 		void connectionClosed(QAbstractSocket::SocketError, const QString &);
 		void sslError(const QList<QSslError> &);
@@ -202,6 +230,17 @@ class Server : public QThread {
 		QList<SslServer *> qlServer;
 		QTimer *qtTimeout;
 
+		/// Connection deadlines, keyed by session ID. A session's
+		/// deadline is armed when it connects (authentication timeout)
+		/// and re-armed on every control message once it has
+		/// authenticated (activity timeout). checkTimeout() only
+		/// visits sessions whose deadline has passed.
+		///
+		/// Only accessed from the server's control thread.
+		TimerWheel twTimeouts;
+		quint64 timeoutClock() const;
+		void rescheduleTimeout(ServerUser *u);
+
 #ifdef Q_OS_UNIX
 		int aiNotify[2];
 		QList<int> qlUdpSocket;
@@ -213,14 +252,19 @@ class Server : public QThread {
 		QList<QSocketNotifier *> qlUdpNotifier;
 
 		/// This lock provides synchronization between the
-		/// main thread (where control channel messages and
-		/// RPC happens), and the Server's voice thread.
+		/// Server's control thread (where control channel
+		/// messages and RPC calls for the server are handled),
+		/// and the Server's voice thread. The control thread is
+		/// the ControlThread that the server is pinned to, or
+		/// the main thread if there are none.
 		///
 		/// These are the only two threads in Murmur that
-		/// access a Server's data.
+		/// access a Server's data. Other threads hand their work
+		/// to the control thread (see ControlThread), or read
+		/// the published ServerSnapshot.
 		///
 		/// The easiest way to understand the locking strategy
-		/// and synchronization between the main thread and the
+		/// and synchronization between the control thread and the
 		/// Server's voice thread is by using the concept of
 		/// ownership.
 		///
@@ -228,32 +272,32 @@ class Server : public QThread {
 		/// thread that is allowed to write to that object. To
 		/// make changes to it.
 		///
-		/// Most data in the Server class is owned by the main
-		/// thread. That means that the main thread is the only
+		/// Most data in the Server class is owned by the control
+		/// thread. That means that the control thread is the only
 		/// thread that writes/updates those structures.
 		///
 		/// When processing incoming voice data (and re-
 		/// broadcasting) that voice data), the Server's voice
 		/// thread needs to access various parts of Server's data,
 		/// such as qhUsers, qhChannels, User->cChannel, etc.
-		/// However, these are owned by the main thread.
+		/// However, these are owned by the control thread.
 		///
 		/// To ensure correct synchronization between the two
 		/// threads, the contract for using qrwlVoiceThread is
 		/// as follows:
 		///
 		///  - When the Server's voice thread needs to read data
-		///    owned by the main thread, it must hold a read lock
+		///    owned by the control thread, it must hold a read lock
 		///    on qrwlVoiceThread.
 		///
 		///  - The Server's voice thread does not write to any data
-		///    that is owned by the main thread.
+		///    that is owned by the control thread.
 		///
-		///  - When the main thread needs to write to data owned by
+		///  - When the control thread needs to write to data owned by
 		///    itself that is accessed by the voice thread, it must
 		///    hold a write lock on qrwlVoiceThread.
 		///
-		///  - When the main thread needs to read data that is owned
+		///  - When the control thread needs to read data that is owned
 		///    by itself, it DOES NOT hold a lock on qrwlVoiceThread.
 		///    That is because ownership of data guarantees that no
 		///    other thread can write to that data.
@@ -263,6 +307,82 @@ class Server : public QThread {
 		QHash<HostAddress, QSet<ServerUser *> > qhHostUsers;
 		QHash<unsigned int, Channel *> qhChannels;
 
+		/// Indexes over the authenticated users in qhUsers, keyed by
+		/// lower-cased name and by registered user ID.
+		///
+		/// They are owned by the control thread and are never read
+		/// by the voice thread, so they are updated without holding
+		/// qrwlVoiceThread. Change an authenticated user's name or
+		/// ID through setUserName() and setUserId() to keep them
+		/// consistent.
+		QMultiHash<QString, ServerUser *> qmhUsersByName;
+		QMultiHash<int, ServerUser *> qmhUsersById;
+		void indexUser(ServerUser *u);
+		void unindexUser(ServerUser *u);
+		void setUserName(ServerUser *u, const QString &name);
+		void setUserId(ServerUser *u, int id);
+		/// Returns an authenticated user whose name matches name,
+		/// ignoring case, or NULL.
+		ServerUser *userByName(const QString &name) const;
+		/// Returns an authenticated user registered as id, or NULL.
+		ServerUser *userById(int id) const;
+
+		/// The state published for read-only RPC methods; see
+		/// ServerSnapshot.
+		///
+		/// Changes are recorded by marking the user or channel
+		/// that changed, and are copied into ssSnapshot and
+		/// published together at the end of the event loop turn,
+		/// or when publishSnapshot() is called. Users and channels
+		/// that no longer exist are removed from the snapshot.
+		/// Each publish that changes the state records a
+		/// SnapshotDelta and emits stateChanged().
+		///
+		/// Only accessed from the server's control thread.
+		ServerSnapshot ssSnapshot;
+		QSet<unsigned int> qsSnapshotUsers;
+		QSet<int> qsSnapshotChannels;
+		QSet<int> qsSnapshotACLs;
+		bool bSnapshotPending;
+		bool bSnapshotStats;
+		void scheduleSnapshot();
+		void markSnapshotChannel(int id);
+
+		/// Text messages that wait for a text message filter, or
+		/// for earlier messages that are being filtered, by message
+		/// ID. Only accessed from the server's control thread.
+		struct PendingTextMessage {
+			unsigned int uiSession;
+			MumbleProto::TextMessage msg;
+			bool bFiltered;
+			int iResult;
+		};
+		QMap<quint64, PendingTextMessage> qmPendingTextMessages;
+		quint64 uiTextMessageId;
+		void processTextMessage(ServerUser *uSource, MumbleProto::TextMessage &msg);
+
+		/// A large text message, stored once and sent by hash to
+		/// clients that fetch it with RequestBlob if they don't
+		/// have it cached.
+		struct TextBlob {
+			std::string ssMessage;
+			/// Sessions the message was sent to by hash. Only they
+			/// may fetch it.
+			QSet<unsigned int> qsSessions;
+		};
+		/// Total size of the messages kept in qhTextBlobs.
+		static const int iMaxTextBlobBytes = 32 * 1024 * 1024;
+		/// Text blobs by SHA1 hash of their message. Only accessed
+		/// from the server's control thread.
+		QHash<QByteArray, TextBlob> qhTextBlobs;
+		/// Hashes of qhTextBlobs, least recently sent first.
+		QList<QByteArray> qlTextBlobs;
+		int iTextBlobBytes;
+
+		QSet<int> qsUserCountChannels;
+		bool bUserCountsScheduled;
+		void broadcastTextMessage(const QSet<ServerUser *> &users, MumbleProto::TextMessage &msg);
+
 		QMutex qmCache;
 		ChanACL::ACLCache acCache;
 
@@ -290,6 +410,17 @@ class Server : public QThread {
 		void sendProtoExcept(ServerUser *, const ::google::protobuf::Message &msg, unsigned int msgType, unsigned int minversion);
 		void sendProtoMessage(ServerUser *, const ::google::protobuf::Message &msg, unsigned int msgType);
 
+		/// Buffer that sendProtoMessage() and sendProtoExcept()
+		/// serialize into, reused between messages unless a send
+		/// further up the stack is still using it.
+		QByteArray qbaProtoCache;
+		bool bProtoCacheBusy;
+
+		/// Messages that message() parses into, one per type.
+#define MUMBLE_MH_MSG(x) MessageCache<MumbleProto:: x> mc##x;
+		MUMBLE_MH_ALL
+#undef MUMBLE_MH_MSG
+
 		// sendAll sends a protobuf message to all users on the server whose version is either bigger than v or
 		// lower than ~v. If v == 0 the message is sent to everyone.
 #define MUMBLE_MH_MSG(x) \
@@ -311,6 +442,10 @@ class Server : public QThread {
 		void log(const QString &) const;
 		void log(ServerUser *u, const QString &) const;
 
+		/// Log the number of connections and an estimate of the
+		/// memory they use. See ServerUser::memoryUsage().
+		void logMemoryUsage() const;
+
 		void removeChannel(int id);
 		void removeChannel(Channel *c, Channel *dest = NULL);
 		void userEnterChannel(User *u, Channel *c, MumbleProto::UserState &mpus);
@@ -321,6 +456,39 @@ class Server : public QThread {
 
 		bool canNest(Channel *newParent, Channel *channel = NULL) const;
 
+		// Interest-scoped user state. Implementation in Interest.cpp
+
+		/// Fills mpus with the full state of u, as sent to recipient.
+		void fillUserState(ServerUser *u, ServerUser *recipient, MumbleProto::UserState &mpus);
+		/// Returns true if r, which uses scoped user state, is
+		/// interested in the users in c.
+		bool isInterested(const ServerUser *r, const Channel *c) const;
+		/// Decides whether msg, which is being sent to all users,
+		/// goes to r, which uses scoped user state. It may send r
+		/// something else instead, such as the full state of a user
+		/// who came into its interest set.
+		bool scopeUserMessage(ServerUser *r, const ::google::protobuf::Message &msg, unsigned int msgType);
+		/// Sends r the users that came into its interest set, and
+		/// the user counts of the channels outside of it.
+		void updateInterest(ServerUser *r);
+		void sendUserCounts(ServerUser *r);
+		/// Records that the number of users in c changed, for the
+		/// user counts sent once per event loop turn.
+		void markUserCount(const Channel *c);
+		void flushUserCounts();
+
+		// Channel batches. Implementation in ChannelBatch.cpp
+
+		/// Applies all operations of batch, or none of them. Changes
+		/// to the database are made in one transaction, the tree is
+		/// changed under one write lock of qrwlVoiceThread, and users
+		/// are sent the resulting channel states once, at the end.
+		///
+		/// On success, added receives the IDs of the channels created
+		/// by the Add operations, in order. Otherwise, err describes
+		/// the first invalid operation.
+		ChannelBatch::Error applyChannelBatch(const ChannelBatch &batch, QList<int> &added, QString &err);
+
 		// RPC functions. Implementation in RPC.cpp
 		void connectAuthenticator(QObject *p);
 		void disconnectAuthenticator(QObject *p);
@@ -347,8 +515,14 @@ class Server : public QThread {
 		void channelStateChanged(const Channel *);
 		void channelCreated(const Channel *);
 		void channelRemoved(const Channel *);
+		/// Emitted after a snapshot with a new version has been
+		/// published. The change is the last delta of the snapshot.
+		void stateChanged(const ServerSnapshot &);
 
-		void textMessageFilterSig(int &, const User *, MumbleProto::TextMessage &);
+		/// Offers a text message to a text message filter. A filter
+		/// that takes the message sets pending, and calls
+		/// textMessageFiltered() with the message ID later.
+		void textMessageFilterSig(bool &pending, quint64 id, const User *, const MumbleProto::TextMessage &);
 
 		void contextAction(const User *, const QString &, unsigned int, int);
 	public:
@@ -379,6 +553,12 @@ class Server : public QThread {
 
 		void sendTextMessage(Channel *cChannel, ServerUser *pUser, bool tree, const QString &text);
 
+		/// Hands the verdict of a text message filter for message id
+		/// back to the server; see textMessageFilterSig(). result is
+		/// 0 to accept, 1 to reject and 2 to drop the message. If text
+		/// isn't null, it replaces the text of an accepted message.
+		void textMessageFiltered(quint64 id, int result, const QString &text = QString());
+
 		/// Returns true if a channel is full. If a user is provided, false will always
 		/// be returned if the user has write permission in the channel.
 		bool isChannelFull(Channel *c, ServerUser *u = 0);
@@ -388,10 +568,13 @@ class Server : public QThread {
 		int authenticate(QString &name, const QString &pw, int sessionId = 0, const QStringList &emails = QStringList(), const QString &certhash = QString(), bool bStrongCert = false, const QList<QSslCertificate> & = QList<QSslCertificate>());
 		Channel *addChannel(Channel *c, const QString &name, bool temporary = false, int position = 0, unsigned int maxUsers = 0);
 		void removeChannelDB(const Channel *c);
-		void readChannels(Channel *p = NULL);
+		void readChannels();
 		void readLinks();
 		void updateChannel(const Channel *c);
-		void readChannelPrivs(Channel *c);
+		/// Returns the description of a channel. Long descriptions
+		/// are not kept in memory after startup, only their hash,
+		/// so this may read the description from the database.
+		QString channelDescription(const Channel *c) const;
 		void setLastChannel(const User *u);
 		int readLastChannel(int id);
 		void dumpChannel(const Channel *c);
@@ -408,6 +591,10 @@ class Server : public QThread {
 		bool isUserId(int id);
 		void addLink(Channel *c, Channel *l);
 		void removeLink(Channel *c, Channel *l);
+		/// Store a link that has already been made or removed in
+		/// memory.
+		void addLinkDB(const Channel *c, const Channel *l);
+		void removeLinkDB(const Channel *c, const Channel *l);
 		void getBans();
 		void saveBans();
 		QVariant getConf(const QString &key, QVariant def);
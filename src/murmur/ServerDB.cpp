@@ -9,7 +9,9 @@
 
 #include "ACL.h"
 #include "Channel.h"
+#include "ChannelLoader.h"
 #include "Connection.h"
+#include "ControlThread.h"
 #include "DBus.h"
 #include "Group.h"
 #include "Meta.h"
@@ -26,25 +28,62 @@
 #define SOFTEXEC() ServerDB::exec(query, QString(), false)
 
 
-class TransactionHolder {
-	public:
-		QSqlQuery *qsqQuery;
-		TransactionHolder() {
-			ServerDB::db->transaction();
-			qsqQuery = new QSqlQuery();
-		}
+int TransactionHolder::iDepth = 0;
+QMutex TransactionHolder::qmTransaction(QMutex::Recursive);
 
-		~TransactionHolder() {
-			qsqQuery->clear();
-			delete qsqQuery;
-			ServerDB::db->commit();
-		}
-		TransactionHolder(const TransactionHolder & other) {
-			ServerDB::db->transaction();
-			qsqQuery = other.qsqQuery ? new QSqlQuery(*other.qsqQuery) : 0;
-		}
+TransactionHolder::TransactionHolder() {
+	qmTransaction.lock();
+	if (iDepth++ == 0)
+		ServerDB::connection()->transaction();
+	qsqQuery = new QSqlQuery(*ServerDB::connection());
+}
+
+TransactionHolder::~TransactionHolder() {
+	qsqQuery->clear();
+	delete qsqQuery;
+	if (--iDepth == 0)
+		ServerDB::connection()->commit();
+	qmTransaction.unlock();
+}
+
+TransactionHolder::TransactionHolder(const TransactionHolder &other) {
+	qmTransaction.lock();
+	if (iDepth++ == 0)
+		ServerDB::connection()->transaction();
+	qsqQuery = other.qsqQuery ? new QSqlQuery(*other.qsqQuery) : 0;
+}
+
+/// The database connection of a thread other than the main thread.
+///
+/// Qt only allows a connection to be used by the thread that
+/// opened it, so each control thread opens a clone of the main
+/// connection the first time it accesses the database, and closes
+/// it when the thread finishes.
+class ThreadConnection {
+	private:
+		Q_DISABLE_COPY(ThreadConnection)
+	public:
+		QString qsName;
+		QSqlDatabase *db;
+		ThreadConnection();
+		~ThreadConnection();
 };
 
+ThreadConnection::ThreadConnection() {
+	qsName = QString::fromLatin1("murmur_thread_%1").arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+	db = new QSqlDatabase(QSqlDatabase::cloneDatabase(*ServerDB::db, qsName));
+	if (! db->open())
+		qFatal("ServerDB: Failed to open thread connection: %s", qPrintable(db->lastError().text()));
+}
+
+ThreadConnection::~ThreadConnection() {
+	db->close();
+	delete db;
+	QSqlDatabase::removeDatabase(qsName);
+}
+
+static QThreadStorage<ThreadConnection *> qtsConnections;
+
 QSqlDatabase *ServerDB::db = NULL;
 Timer ServerDB::tLogClean;
 QString ServerDB::qsUpgradeSuffix;
@@ -482,7 +521,16 @@ ServerDB::~ServerDB() {
 	db = NULL;
 }
 
+QSqlDatabase *ServerDB::connection() {
+	if (QThread::currentThread() == QCoreApplication::instance()->thread())
+		return db;
+	if (! qtsConnections.hasLocalData())
+		qtsConnections.setLocalData(new ThreadConnection());
+	return qtsConnections.localData()->db;
+}
+
 bool ServerDB::prepare(QSqlQuery &query, const QString &str, bool fatal, bool warn) {
+	QSqlDatabase *db = connection();
 	if (! db->isValid()) {
 		qWarning("SQL [%s] rejected: Database is gone", qPrintable(str));
 		return false;
@@ -504,7 +552,7 @@ bool ServerDB::prepare(QSqlQuery &query, const QString &str, bool fatal, bool wa
 		if (! db->open()) {
 			qFatal("Lost connection to SQL Database: Reconnect: %s", qPrintable(db->lastError().text()));
 		}
-		query = QSqlQuery();
+		query = QSqlQuery(*db);
 		if (query.prepare(q)) {
 			qWarning("SQL Connection lost, reconnection OK");
 			return true;
@@ -528,7 +576,7 @@ bool ServerDB::exec(QSqlQuery &query, const QString &str, bool fatal, bool warn)
 	} else {
 
 		if (fatal) {
-			*db = QSqlDatabase();
+			*connection() = QSqlDatabase();
 			qFatal("SQL Error [%s]: %s", qPrintable(query.lastQuery()), qPrintable(query.lastError().text()));
 		} else if (warn) {
 			qDebug("SQL Error [%s]: %s", qPrintable(query.lastQuery()), qPrintable(query.lastError().text()));
@@ -545,7 +593,7 @@ bool ServerDB::execBatch(QSqlQuery &query, const QString &str, bool fatal) {
 	} else {
 
 		if (fatal) {
-			*db = QSqlDatabase();
+			*connection() = QSqlDatabase();
 			qFatal("SQL Error [%s]: %s", qPrintable(query.lastQuery()), qPrintable(query.lastError().text()));
 		} else
 			qDebug("SQL Error [%s]: %s", qPrintable(query.lastQuery()), qPrintable(query.lastError().text()));
@@ -670,7 +718,10 @@ int Server::registerUser(const QMap<int, QString> &info) {
 	qhUserIDCache.remove(name);
 
 	int res = -2;
-	emit registerUserSig(res, info);
+	{
+		ListenerCall lc(this);
+		emit registerUserSig(res, info);
+	}
 	if (res != -2) {
 		qhUserIDCache.remove(name);
 	}
@@ -717,7 +768,10 @@ bool Server::unregisterUserDB(int id) {
 	qhUserNameCache.remove(id);
 
 	int res = -2;
-	emit unregisterUserSig(res, id);
+	{
+		ListenerCall lc(this);
+		emit unregisterUserSig(res, id);
+	}
 	if (res == 0) {
 		return false;
 	}
@@ -741,7 +795,10 @@ bool Server::unregisterUserDB(int id) {
 QList<UserInfo> Server::getRegisteredUsersEx() {
 
 	QMap<int, QString> rpcUsers;
-	emit getRegisteredUsersSig(QString(), rpcUsers);
+	{
+		ListenerCall lc(this);
+		emit getRegisteredUsersSig(QString(), rpcUsers);
+	}
 
 	QList<UserInfo> users;
 	QMap<int, QString>::iterator it = rpcUsers.begin();
@@ -774,7 +831,10 @@ QList<UserInfo> Server::getRegisteredUsersEx() {
 QMap<int, QString > Server::getRegisteredUsers(const QString &filter) {
 	QMap<int, QString > m;
 
-	emit getRegisteredUsersSig(filter, m);
+	{
+		ListenerCall lc(this);
+		emit getRegisteredUsersSig(filter, m);
+	}
 
 	TransactionHolder th;
 
@@ -800,7 +860,10 @@ QMap<int, QString > Server::getRegisteredUsers(const QString &filter) {
 bool Server::isUserId(int id) {
 	QMap<int, QString> info;
 	int res = -2;
-	emit getRegistrationSig(res, id, info);
+	{
+		ListenerCall lc(this);
+		emit getRegistrationSig(res, id, info);
+	}
 	if (res >= 0)
 		return (res > 0);
 
@@ -820,7 +883,10 @@ bool Server::isUserId(int id) {
 QMap<int, QString> Server::getRegistration(int id) {
 	QMap<int, QString> info;
 	int res = -2;
-	emit getRegistrationSig(res, id, info);
+	{
+		ListenerCall lc(this);
+		emit getRegistrationSig(res, id, info);
+	}
 	if (res >= 0)
 		return info;
 
@@ -853,7 +919,10 @@ QMap<int, QString> Server::getRegistration(int id) {
 int Server::authenticate(QString &name, const QString &password, int sessionId, const QStringList &emails, const QString &certhash, bool bStrongCert, const QList<QSslCertificate> &certs) {
 	int res = bForceExternalAuth ? -3 : -2;
 
-	emit authenticateSig(res, name, sessionId, certs, certhash, bStrongCert, password);
+	{
+		ListenerCall lc(this);
+		emit authenticateSig(res, name, sessionId, certs, certhash, bStrongCert, password);
+	}
 
 	if (res != -2) {
 		// External authentication handled it. Ignore certificate completely.
@@ -1026,7 +1095,10 @@ bool Server::setInfo(int id, const QMap<int, QString> &setinfo) {
 		qhUserIDCache.remove(info.value(ServerDB::User_Name));
 	}
 
-	emit setInfoSig(res, id, info);
+	{
+		ListenerCall lc(this);
+		emit setInfoSig(res, id, info);
+	}
 	if (res >= 0)
 		return (res > 0);
 
@@ -1112,7 +1184,10 @@ bool Server::setTexture(int id, const QByteArray &texture) {
 	}
 
 	int res = -2;
-	emit setTextureSig(res, id, tex);
+	{
+		ListenerCall lc(this);
+		emit setTextureSig(res, id, tex);
+	}
 	if (res >= 0)
 		return (res > 0);
 
@@ -1180,7 +1255,10 @@ QString Server::getUserName(int id) {
 	if (qhUserNameCache.contains(id))
 		return qhUserNameCache.value(id);
 	QString name;
-	emit idToNameSig(name, id);
+	{
+		ListenerCall lc(this);
+		emit idToNameSig(name, id);
+	}
 	if (! name.isEmpty()) {
 		qhUserIDCache.insert(name, id);
 		qhUserNameCache.insert(id, name);
@@ -1205,7 +1283,10 @@ int Server::getUserID(const QString &name) {
 	if (qhUserIDCache.contains(name))
 		return qhUserIDCache.value(name);
 	int id = -2;
-	emit nameToIdSig(id, name);
+	{
+		ListenerCall lc(this);
+		emit nameToIdSig(id, name);
+	}
 	if (id != -2) {
 		qhUserIDCache.insert(name, id);
 		qhUserNameCache.insert(id, name);
@@ -1233,7 +1314,10 @@ int Server::getUserID(const QString &name) {
 
 QByteArray Server::getUserTexture(int id) {
 	QByteArray qba;
-	emit idToTextureSig(qba, id);
+	{
+		ListenerCall lc(this);
+		emit idToTextureSig(qba, id);
+	}
 	if (! qba.isNull()) {
 		return qba;
 	}
@@ -1260,6 +1344,13 @@ void Server::addLink(Channel *c, Channel *l) {
 		c->link(l);
 	}
 
+	addLinkDB(c, l);
+}
+
+void Server::addLinkDB(const Channel *c, const Channel *l) {
+	markSnapshotChannel(c->iId);
+	markSnapshotChannel(l->iId);
+
 	if (c->bTemporary || l->bTemporary)
 		return;
 	TransactionHolder th;
@@ -1283,6 +1374,13 @@ void Server::removeLink(Channel *c, Channel *l) {
 		c->unlink(l);
 	}
 
+	removeLinkDB(c, l);
+}
+
+void Server::removeLinkDB(const Channel *c, const Channel *l) {
+	markSnapshotChannel(c->iId);
+	markSnapshotChannel(l->iId);
+
 	if (c->bTemporary || l->bTemporary)
 		return;
 	TransactionHolder th;
@@ -1352,6 +1450,7 @@ Channel *Server::addChannel(Channel *p, const QString &name, bool temporary, int
 	c->iPosition = position;
 	c->uiMaxUsers = maxUsers;
 	qhChannels.insert(id, c);
+	markSnapshotChannel(id);
 	return c;
 }
 
@@ -1366,9 +1465,12 @@ void Server::removeChannelDB(const Channel *c) {
 		SQLEXEC();
 	}
 	qhChannels.remove(c->iId);
+	markSnapshotChannel(c->iId);
 }
 
 void Server::updateChannel(const Channel *c) {
+	markSnapshotChannel(c->iId);
+
 	if (c->bTemporary)
 		return;
 	TransactionHolder th;
@@ -1384,13 +1486,17 @@ void Server::updateChannel(const Channel *c) {
 	query.addBindValue(c->iId);
 	SQLEXEC();
 
-	// Update channel description information
 	SQLPREP("REPLACE INTO `%1channel_info` (`server_id`, `channel_id`, `key`, `value`) VALUES (?,?,?,?)");
-	query.addBindValue(iServerNum);
-	query.addBindValue(c->iId);
-	query.addBindValue(ServerDB::Channel_Description);
-	query.addBindValue(c->qsDesc);
-	SQLEXEC();
+
+	// Update channel description information, unless only its hash
+	// is held in memory, in which case the stored text is current.
+	if (! c->qsDesc.isEmpty() || c->qbaDescHash.isEmpty()) {
+		query.addBindValue(iServerNum);
+		query.addBindValue(c->iId);
+		query.addBindValue(ServerDB::Channel_Description);
+		query.addBindValue(c->qsDesc);
+		SQLEXEC();
+	}
 
 	// Update channel position information
 	query.addBindValue(iServerNum);
@@ -1464,108 +1570,76 @@ void Server::updateChannel(const Channel *c) {
 	}
 }
 
-/** Reads the channel privileges (group and acl) as well as the channel information key/value pairs from the database.
- * @param c Channel to fetch information for
+/** Reads the channel tree, the channel information key/value pairs and the channel privileges
+ * (group and acl) from the database.
+ *
+ * Everything is loaded with one query per table, rather than a handful of queries per channel,
+ * so boot time stays reasonable for servers with very large channel trees. See ChannelLoader.
  */
-void Server::readChannelPrivs(Channel *c) {
-	TransactionHolder th;
+void Server::readChannels() {
+	ChannelLoader cl;
 
-	int cid = c->iId;
+	{
+		TransactionHolder th;
+		QSqlQuery &query = *th.qsqQuery;
 
-	QSqlQuery &query = *th.qsqQuery;
+		ServerDB::prepare(query, QLatin1String(ChannelLoader::cChannelsQuery));
+		query.addBindValue(iServerNum);
+		SQLEXEC();
+		cl.readChannels(query);
+		cl.link(this);
 
-	SQLPREP("SELECT `key`, `value` FROM `%1channel_info` WHERE `server_id` = ? AND `channel_id` = ?");
-	query.addBindValue(iServerNum);
-	query.addBindValue(cid);
-	SQLEXEC();
-	while (query.next()) {
-		int key = query.value(0).toInt();
-		const QString &value = query.value(1).toString();
-		if (key == ServerDB::Channel_Description) {
-			hashAssign(c->qsDesc, c->qbaDescHash, value);
-		} else if (key == ServerDB::Channel_Position) {
-			c->iPosition = QVariant(value).toInt(); // If the conversion fails it'll return the default value 0
-		} else if (key == ServerDB::Channel_Max_Users) {
-			c->uiMaxUsers = QVariant(value).toUInt(); // If the conversion fails it'll return the default value 0
-		}
-	}
+		ServerDB::prepare(query, QLatin1String(ChannelLoader::cChannelInfoQuery));
+		query.addBindValue(iServerNum);
+		SQLEXEC();
+		cl.readChannelInfo(query);
 
-	SQLPREP("SELECT `group_id`, `name`, `inherit`, `inheritable` FROM `%1groups` WHERE `server_id` = ? AND `channel_id` = ?");
-	query.addBindValue(iServerNum);
-	query.addBindValue(cid);
-	SQLEXEC();
-	while (query.next()) {
-		int gid = query.value(0).toInt();
-		QString name = query.value(1).toString();
-		Group *g = new Group(c, name);
-		g->bInherit = query.value(2).toBool();
-		g->bInheritable = query.value(3).toBool();
-
-		QSqlQuery mem;
-		mem.prepare(QString::fromLatin1("SELECT user_id, addit FROM %1group_members WHERE group_id = ?").arg(Meta::mp.qsDBPrefix));
-		mem.addBindValue(gid);
-		mem.exec();
-		while (mem.next()) {
-			int uid = mem.value(0).toInt();
-			if (mem.value(1).toBool())
-				g->qsAdd << uid;
-			else
-				g->qsRemove << uid;
-		}
-	}
+		ServerDB::prepare(query, QLatin1String(ChannelLoader::cGroupsQuery));
+		query.addBindValue(iServerNum);
+		SQLEXEC();
+		cl.readGroups(query);
 
-	SQLPREP("SELECT `user_id`, `group_name`, `apply_here`, `apply_sub`, `grantpriv`, `revokepriv` FROM `%1acl` WHERE `server_id` = ? AND `channel_id` = ? ORDER BY `priority`");
-	query.addBindValue(iServerNum);
-	query.addBindValue(cid);
-	SQLEXEC();
-	while (query.next()) {
-		ChanACL *acl = new ChanACL(c);
-		acl->iUserId = query.value(0).isNull() ? -1 : query.value(0).toInt();
-		acl->qsGroup = query.value(1).toString();
-		acl->bApplyHere = query.value(2).toBool();
-		acl->bApplySubs = query.value(3).toBool();
-		acl->pAllow = static_cast<ChanACL::Permissions>(query.value(4).toInt());
-		acl->pDeny = static_cast<ChanACL::Permissions>(query.value(5).toInt());
+		ServerDB::prepare(query, QLatin1String(ChannelLoader::cGroupMembersQuery));
+		query.addBindValue(iServerNum);
+		SQLEXEC();
+		cl.readGroupMembers(query);
+
+		ServerDB::prepare(query, QLatin1String(ChannelLoader::cACLQuery));
+		query.addBindValue(iServerNum);
+		SQLEXEC();
+		cl.readACL(query);
 	}
-}
 
-void Server::readChannels(Channel *p) {
-	QList<Channel *> kids;
-	Channel *c;
-	QSqlQuery query;
-	int parentid = -1;
+	qhChannels.unite(cl.qhChannels);
 
-	if (p) {
-		parentid = p->iId;
-		readChannelPrivs(qhChannels.value(parentid));
+	foreach(Channel *c, cl.qlOrphans) {
+		log(QString::fromLatin1("Ignoring orphaned channel %1").arg(c->iId));
+		delete c;
 	}
+}
 
-	{
-		TransactionHolder th;
-		if (parentid == -1) {
-			SQLPREP("SELECT `channel_id`, `name`, `inheritacl` FROM `%1channels` WHERE `server_id` = ? AND `parent_id` IS NULL ORDER BY `name`");
-			query.addBindValue(iServerNum);
-		} else {
-			SQLPREP("SELECT `channel_id`, `name`, `inheritacl` FROM `%1channels` WHERE `server_id` = ? AND `parent_id`=? ORDER BY `name`");
-			query.addBindValue(iServerNum);
-			query.addBindValue(parentid);
-		}
-		SQLEXEC();
+QString Server::channelDescription(const Channel *c) const {
+	if (! c->qsDesc.isEmpty() || c->qbaDescHash.isEmpty())
+		return c->qsDesc;
 
-		while (query.next()) {
-			c = new Channel(query.value(0).toInt(), query.value(1).toString(), p);
-			if (! p)
-				c->setParent(this);
-			qhChannels.insert(c->iId, c);
-			c->bInheritACL = query.value(2).toBool();
-			kids << c;
-		}
-	}
+	QString desc;
+	if (ServerSnapshot::cachedDescription(c->qbaDescHash, desc))
+		return desc;
 
-	query.clear();
+	TransactionHolder th;
+	QSqlQuery &query = *th.qsqQuery;
 
-	foreach(c, kids)
-		readChannels(c);
+	SQLPREP("SELECT `value` FROM `%1channel_info` WHERE `server_id` = ? AND `channel_id` = ? AND `key` = ?");
+	query.addBindValue(iServerNum);
+	query.addBindValue(c->iId);
+	query.addBindValue(ServerDB::Channel_Description);
+	SQLEXEC();
+	if (query.next()) {
+		desc = query.value(0).toString();
+		// Lets snapshot readers on other threads find it.
+		ServerSnapshot::cacheDescription(c->qbaDescHash, desc);
+	}
+	return desc;
 }
 
 void Server::readLinks() {
@@ -1640,7 +1714,7 @@ void Server::dumpChannel(const Channel *c) {
 	}
 
 	qWarning("Channel %s (ACLInherit %d)", qPrintable(c->qsName), c->bInheritACL);
-	qWarning("Description: %s", qPrintable(c->qsDesc));
+	qWarning("Description: %s", qPrintable(channelDescription(c)));
 	foreach(g, c->qhGroups) {
 		qWarning("Group %s (Inh %d  Able %d)", qPrintable(g->qsName), g->bInherit, g->bInheritable);
 		foreach(pid, g->qsAdd)
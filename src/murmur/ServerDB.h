@@ -6,6 +6,7 @@
 #ifndef MUMBLE_MURMUR_DATABASE_H_
 #define MUMBLE_MURMUR_DATABASE_H_
 
+#include <QtCore/QMutex>
 #include <QtCore/QVariant>
 
 #include "Timer.h"
@@ -24,6 +25,7 @@ class ServerDB {
 		~ServerDB();
 		typedef QPair<unsigned int, QString> LogRecord;
 		static Timer tLogClean;
+		/// The connection of the main thread.
 		static QSqlDatabase *db;
 		static QString qsUpgradeSuffix;
 		static void setSUPW(int iServNum, const QString &pw);
@@ -40,6 +42,10 @@ class ServerDB {
 		static QString getLegacySHA1Hash(const QString &password);
 		static int getLogLen(int server_id);
 		static void wipeLogs();
+		/// Returns the connection of the calling thread. Control
+		/// threads get a connection of their own; see
+		/// MetaParams::iServerThreads.
+		static QSqlDatabase *connection();
 		static bool prepare(QSqlQuery &, const QString &, bool fatal = true, bool warn = true);
 		static bool exec(QSqlQuery &, const QString &str = QString(), bool fatal= true, bool warn = true);
 		static bool execBatch(QSqlQuery &, const QString &str = QString(), bool fatal= true);
@@ -51,4 +57,27 @@ class ServerDB {
 		static void writeSUPW(int srvnum, const QString &pwHash, const QString &saltHash, const QVariant &kdfIterations);
 };
 
+/// Groups the database changes made while it exists into one
+/// transaction.
+///
+/// Holders nest: only the outermost holder begins and commits the
+/// transaction, so a function that makes several changes can hold
+/// one around the functions that make each of them.
+///
+/// Only one thread at a time can hold transactions; holders on
+/// other threads wait until the outermost holder is gone.
+class TransactionHolder {
+	public:
+		QSqlQuery *qsqQuery;
+		TransactionHolder();
+		~TransactionHolder();
+		TransactionHolder(const TransactionHolder &other);
+	private:
+		/// Number of holders that exist. Only accessed with
+		/// qmTransaction locked.
+		static int iDepth;
+		/// Locked by every holder that exists.
+		static QMutex qmTransaction;
+};
+
 #endif
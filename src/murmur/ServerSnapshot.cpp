@@ -0,0 +1,224 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "murmur_pch.h"
+
+#include "ServerSnapshot.h"
+
+#include "Channel.h"
+#include "ServerUser.h"
+#include "Timer.h"
+
+QMutex ServerSnapshot::qmPublished;
+QHash<int, ServerSnapshot::Published> ServerSnapshot::qhPublished;
+QMutex ServerSnapshot::qmDescriptions;
+QCache<QByteArray, QString> ServerSnapshot::qcDescriptions(ServerSnapshot::iDescriptionCacheSize);
+static Timer tStatsClock;
+
+UserSnapshot::UserSnapshot() {
+	uiSession = 0;
+	iId = -1;
+	iChannel = 0;
+	bMute = bDeaf = bSuppress = bRecording = bPrioritySpeaker = bSelfMute = bSelfDeaf = false;
+	iOnlineSecs = iIdleSecs = iBandwidth = 0;
+	fUDPPing = fTCPPing = 0.0f;
+	bTcpOnly = false;
+	uiVersion = 0;
+}
+
+UserSnapshot::UserSnapshot(const ServerUser *u) {
+	uiSession = u->uiSession;
+	iId = u->iId;
+	qsName = u->qsName;
+	iChannel = u->cChannel ? u->cChannel->iId : 0;
+	bMute = u->bMute;
+	bDeaf = u->bDeaf;
+	bSuppress = u->bSuppress;
+	bRecording = u->bRecording;
+	bPrioritySpeaker = u->bPrioritySpeaker;
+	bSelfMute = u->bSelfMute;
+	bSelfDeaf = u->bSelfDeaf;
+	qsComment = u->qsComment;
+
+	iOnlineSecs = u->bwr.onlineSeconds();
+	iIdleSecs = u->bwr.idleSeconds();
+	iBandwidth = u->bwr.bandwidth();
+	fUDPPing = u->dUDPPingAvg;
+	fTCPPing = u->dTCPPingAvg;
+	bTcpOnly = (u->aiUdpFlag == 0);
+
+	uiVersion = u->uiVersion;
+	qsRelease = u->qsRelease;
+	qsOS = u->qsOS;
+	qsOSVersion = u->qsOSVersion;
+	qsIdentity = u->qsIdentity;
+	ssContext = u->ssContext;
+	haAddress = u->haAddress;
+}
+
+bool UserSnapshot::lessThan(const UserSnapshot *first, const UserSnapshot *second) {
+	return (QString::localeAwareCompare(first->qsName, second->qsName) < 0);
+}
+
+ChannelSnapshot::ChannelSnapshot() {
+	iId = 0;
+	iParent = -1;
+	bLazyDescription = false;
+	iPosition = 0;
+	bTemporary = false;
+}
+
+ChannelSnapshot::ChannelSnapshot(const Channel *c) {
+	iId = c->iId;
+	iParent = c->cParent ? c->cParent->iId : -1;
+	qsName = c->qsName;
+	qsDesc = c->qsDesc;
+	qbaDescHash = c->qbaDescHash;
+	bLazyDescription = c->qsDesc.isEmpty() && ! c->qbaDescHash.isEmpty();
+	iPosition = c->iPosition;
+	bTemporary = c->bTemporary;
+	foreach(const Channel *l, c->qsPermLinks)
+		qlLinks << l->iId;
+}
+
+bool ChannelSnapshot::description(QString &desc) const {
+	if (! bLazyDescription) {
+		desc = qsDesc;
+		return true;
+	}
+	return ServerSnapshot::cachedDescription(qbaDescHash, desc);
+}
+
+bool ChannelSnapshot::lessThan(const ChannelSnapshot *first, const ChannelSnapshot *second) {
+	if ((first->iPosition != second->iPosition) && (first->iParent == second->iParent))
+		return first->iPosition < second->iPosition;
+	else
+		return QString::localeAwareCompare(first->qsName, second->qsName) < 0;
+}
+
+bool SnapshotDelta::isEmpty() const {
+	return qlUsers.isEmpty() && qlRemovedUsers.isEmpty() && qlChannels.isEmpty() && qlRemovedChannels.isEmpty() && qlACLChannels.isEmpty();
+}
+
+ServerSnapshot::ServerSnapshot(int server) {
+	iServerNum = server;
+	uiEpoch = 0;
+	uiVersion = 0;
+	uiStatsTime = 0;
+}
+
+QHash<int, QList<const UserSnapshot *> > ServerSnapshot::usersByChannel() const {
+	QHash<int, QList<const UserSnapshot *> > qh;
+	for (QHash<unsigned int, UserSnapshot>::const_iterator i = qhUsers.constBegin(); i != qhUsers.constEnd(); ++i)
+		qh[i.value().iChannel] << &i.value();
+
+	for (QHash<int, QList<const UserSnapshot *> >::iterator i = qh.begin(); i != qh.end(); ++i)
+		qSort(i.value().begin(), i.value().end(), UserSnapshot::lessThan);
+	return qh;
+}
+
+QHash<int, QList<const ChannelSnapshot *> > ServerSnapshot::channelsByParent() const {
+	QHash<int, QList<const ChannelSnapshot *> > qh;
+	for (QHash<int, ChannelSnapshot>::const_iterator i = qhChannels.constBegin(); i != qhChannels.constEnd(); ++i)
+		qh[i.value().iParent] << &i.value();
+
+	for (QHash<int, QList<const ChannelSnapshot *> >::iterator i = qh.begin(); i != qh.end(); ++i)
+		qSort(i.value().begin(), i.value().end(), ChannelSnapshot::lessThan);
+	return qh;
+}
+
+void ServerSnapshot::addDelta(SnapshotDelta delta) {
+	delta.uiVersion = ++uiVersion;
+	if (qlDeltas.count() >= iMaxDeltas)
+		qlDeltas.removeFirst();
+	qlDeltas.append(delta);
+}
+
+bool ServerSnapshot::deltasSince(quint64 epoch, quint64 version, QList<SnapshotDelta> &deltas) const {
+	deltas.clear();
+	if ((epoch != uiEpoch) || (version > uiVersion))
+		return false;
+	if (version == uiVersion)
+		return true;
+	if (qlDeltas.isEmpty() || (qlDeltas.first().uiVersion > version + 1))
+		return false;
+
+	// Versions are consecutive, so the first delta to send can be
+	// found by its distance from the end.
+	int first = qlDeltas.count() - static_cast<int>(uiVersion - version);
+	deltas = qlDeltas.mid(first);
+	return true;
+}
+
+quint64 ServerSnapshot::now() {
+	return tStatsClock.elapsed();
+}
+
+void ServerSnapshot::publish(const ServerSnapshot &snapshot, QObject *owner) {
+	QMutexLocker l(&qmPublished);
+	Published &p = qhPublished[snapshot.iServerNum];
+	if (snapshot.uiStatsTime != p.ssSnapshot.uiStatsTime)
+		p.bStatsRequested = false;
+	p.ssSnapshot = snapshot;
+	p.qoOwner = owner;
+}
+
+void ServerSnapshot::withdraw(int server) {
+	ServerSnapshot old;
+	{
+		QMutexLocker l(&qmPublished);
+		// Release the last reference outside of the lock.
+		QHash<int, Published>::iterator i = qhPublished.find(server);
+		if (i == qhPublished.end())
+			return;
+		old = i.value().ssSnapshot;
+		qhPublished.erase(i);
+	}
+}
+
+bool ServerSnapshot::get(int server, ServerSnapshot &snapshot, bool stats) {
+	QMutexLocker l(&qmPublished);
+	QHash<int, Published>::iterator i = qhPublished.find(server);
+	if (i == qhPublished.end())
+		return false;
+
+	if (stats && (now() - i.value().ssSnapshot.uiStatsTime > uiMaxStatsAge)) {
+		// Statistics change without any event, so they are only
+		// refreshed when someone wants them. The owner is alive
+		// for as long as its snapshot is published.
+		QObject *owner = i.value().qoOwner;
+		if (owner->thread() == QThread::currentThread()) {
+			l.unlock();
+			QMetaObject::invokeMethod(owner, "refreshSnapshotStats", Qt::DirectConnection);
+			l.relock();
+			i = qhPublished.find(server);
+			if (i == qhPublished.end())
+				return false;
+		} else if (! i.value().bStatsRequested) {
+			// Readers on other threads never wait for the owner;
+			// they get the stale statistics, and the next reader
+			// gets the refreshed ones.
+			i.value().bStatsRequested = true;
+			QMetaObject::invokeMethod(owner, "refreshSnapshotStats", Qt::QueuedConnection);
+		}
+	}
+
+	snapshot = i.value().ssSnapshot;
+	return true;
+}
+
+void ServerSnapshot::cacheDescription(const QByteArray &hash, const QString &desc) {
+	QMutexLocker l(&qmDescriptions);
+	qcDescriptions.insert(hash, new QString(desc), desc.length());
+}
+
+bool ServerSnapshot::cachedDescription(const QByteArray &hash, QString &desc) {
+	QMutexLocker l(&qmDescriptions);
+	const QString *cached = qcDescriptions.object(hash);
+	if (! cached)
+		return false;
+	desc = *cached;
+	return true;
+}
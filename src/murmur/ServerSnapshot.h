@@ -0,0 +1,201 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_SERVERSNAPSHOT_H_
+#define MUMBLE_MURMUR_SERVERSNAPSHOT_H_
+
+#include <string>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QCache>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "Net.h"
+
+class Channel;
+class QObject;
+class ServerUser;
+
+/// State of an authenticated user, as published in a ServerSnapshot.
+struct UserSnapshot {
+	unsigned int uiSession;
+	int iId;
+	QString qsName;
+	int iChannel;
+	bool bMute, bDeaf, bSuppress, bRecording, bPrioritySpeaker, bSelfMute, bSelfDeaf;
+	QString qsComment;
+
+	int iOnlineSecs;
+	int iIdleSecs;
+	int iBandwidth;
+	float fUDPPing, fTCPPing;
+	bool bTcpOnly;
+
+	unsigned int uiVersion;
+	QString qsRelease;
+	QString qsOS;
+	QString qsOSVersion;
+	QString qsIdentity;
+	std::string ssContext;
+	HostAddress haAddress;
+
+	UserSnapshot();
+	explicit UserSnapshot(const ServerUser *u);
+
+	/// Sorts like User::lessThan.
+	static bool lessThan(const UserSnapshot *first, const UserSnapshot *second);
+};
+
+/// State of a channel, as published in a ServerSnapshot.
+struct ChannelSnapshot {
+	int iId;
+	/// ID of the parent channel, or -1 for the root channel.
+	int iParent;
+	QString qsName;
+	/// The description, unless bLazyDescription is set.
+	QString qsDesc;
+	QByteArray qbaDescHash;
+	/// The description is too long to be kept in memory. It is
+	/// in the description cache if it was read recently; see
+	/// description() and Server::channelDescription().
+	bool bLazyDescription;
+	int iPosition;
+	bool bTemporary;
+	QList<int> qlLinks;
+
+	ChannelSnapshot();
+	explicit ChannelSnapshot(const Channel *c);
+
+	/// Fetches the description into desc. Returns false if it is
+	/// lazy and not in the description cache, in which case only
+	/// the server's thread can read it.
+	bool description(QString &desc) const;
+
+	/// Sorts siblings like Channel::lessThan.
+	static bool lessThan(const ChannelSnapshot *first, const ChannelSnapshot *second);
+};
+
+/// The changes between two consecutive versions of a
+/// ServerSnapshot.
+struct SnapshotDelta {
+	/// The version of the snapshot after this change.
+	quint64 uiVersion;
+	/// Users that connected or changed state.
+	QList<UserSnapshot> qlUsers;
+	/// Sessions of users that disconnected.
+	QList<unsigned int> qlRemovedUsers;
+	/// Channels that were created or changed.
+	QList<ChannelSnapshot> qlChannels;
+	QList<int> qlRemovedChannels;
+	/// Channels whose ACLs or groups changed. ACLs aren't part
+	/// of the snapshot, so only the channel is recorded.
+	QList<int> qlACLChannels;
+
+	SnapshotDelta() : uiVersion(0) {}
+	bool isEmpty() const;
+};
+
+/// ServerSnapshot is a copy of the users, channels and links of
+/// a running virtual server that can be read from any thread.
+///
+/// Each Server keeps its snapshot up to date from its control
+/// thread and publishes it with publish(). Read-only RPC methods
+/// fetch the latest published snapshot with get() and build their
+/// reply from it on their own thread, without touching live objects
+/// or waiting for the control thread.
+///
+/// Snapshots are implicitly shared; fetching one is O(1), and the
+/// control thread only pays for a copy when it modifies a snapshot
+/// that a reader still holds.
+class ServerSnapshot {
+	public:
+		/// Number of deltas kept in qlDeltas.
+		static const int iMaxDeltas = 1024;
+		/// How old statistics may be when they are read, in
+		/// microseconds.
+		static const quint64 uiMaxStatsAge = 1000000ULL;
+		/// Size of the description cache, in characters.
+		static const int iDescriptionCacheSize = 8 * 1024 * 1024;
+
+		int iServerNum;
+		/// Identifies this run of the server. Versions are only
+		/// comparable between snapshots with the same epoch.
+		quint64 uiEpoch;
+		/// Incremented every time the state of the server changes.
+		/// Statistics (online time, ping and bandwidth) are kept
+		/// up to date without a new version.
+		quint64 uiVersion;
+		/// When the statistics of all users were last refreshed,
+		/// on the clock of now().
+		quint64 uiStatsTime;
+		QHash<unsigned int, UserSnapshot> qhUsers;
+		QHash<int, ChannelSnapshot> qhChannels;
+		/// The most recent changes, oldest first. The last delta
+		/// has the version of the snapshot.
+		QList<SnapshotDelta> qlDeltas;
+
+		ServerSnapshot(int server = -1);
+
+		/// Returns the users in each channel, sorted by name.
+		QHash<int, QList<const UserSnapshot *> > usersByChannel() const;
+		/// Returns the subchannels of each channel, sorted like
+		/// the channel tree in the client.
+		QHash<int, QList<const ChannelSnapshot *> > channelsByParent() const;
+
+		/// Appends delta as the next version of the snapshot,
+		/// forgetting the oldest delta if there are too many.
+		void addDelta(SnapshotDelta delta);
+		/// Fetches the deltas after version into deltas. Returns
+		/// false if they are no longer available, in which case
+		/// the reader has to start over from the full snapshot.
+		bool deltasSince(quint64 epoch, quint64 version, QList<SnapshotDelta> &deltas) const;
+
+		/// Microseconds on the clock of uiStatsTime.
+		static quint64 now();
+
+		/// Makes snapshot the latest snapshot of its server.
+		/// owner is the server, which has a refreshSnapshotStats()
+		/// slot and is not deleted before withdraw() is called.
+		static void publish(const ServerSnapshot &snapshot, QObject *owner);
+		/// Forgets the snapshot of a server that is stopping.
+		static void withdraw(int server);
+		/// Fetches the latest snapshot of server into snapshot.
+		/// Returns false if the server isn't running.
+		///
+		/// With stats, statistics older than uiMaxStatsAge are
+		/// refreshed first on the server's own thread. Other
+		/// threads never wait: they get the stale statistics, and
+		/// the server is asked to refresh them for later readers.
+		static bool get(int server, ServerSnapshot &snapshot, bool stats = false);
+
+		/// Remembers the description with the given hash for
+		/// ChannelSnapshot::description(). Descriptions are shared
+		/// by all servers, and the least recently used are
+		/// forgotten first.
+		static void cacheDescription(const QByteArray &hash, const QString &desc);
+		/// Fetches the description with the given hash into desc.
+		/// Returns false if it isn't cached.
+		static bool cachedDescription(const QByteArray &hash, QString &desc);
+
+	private:
+		struct Published {
+			ServerSnapshot ssSnapshot;
+			QObject *qoOwner;
+			/// A refresh of the statistics has been queued
+			/// and not published yet.
+			bool bStatsRequested;
+			Published() : qoOwner(NULL), bStatsRequested(false) {}
+		};
+		static QMutex qmPublished;
+		static QHash<int, Published> qhPublished;
+
+		static QMutex qmDescriptions;
+		static QCache<QByteArray, QString> qcDescriptions;
+};
+
+#endif
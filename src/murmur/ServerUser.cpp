@@ -14,7 +14,6 @@ ServerUser::ServerUser(Server *p, QSslSocket *socket) : Connection(p, socket), U
 	sUdpSocket = INVALID_SOCKET;
 
 	memset(&saiUdpAddress, 0, sizeof(saiUdpAddress));
-	memset(&saiTcpLocalAddress, 0, sizeof(saiTcpLocalAddress));
 
 	dUDPPingAvg = dUDPPingVar = 0.0f;
 	dTCPPingAvg = dTCPPingVar = 0.0f;
@@ -26,22 +25,108 @@ ServerUser::ServerUser(Server *p, QSslSocket *socket) : Connection(p, socket), U
 	iLastPermissionCheck = -1;
 	
 	bOpus = false;
+	bScopedUserState = false;
+	bTextMessageBlobs = false;
 }
 
 
 ServerUser::operator QString() const {
 	return QString::fromLatin1("%1:%2(%3)").arg(qsName).arg(uiSession).arg(iId);
 }
+
+static size_t stringMemoryUsage(const QString &str) {
+	return static_cast<size_t>(str.capacity()) * sizeof(QChar);
+}
+
+static size_t stringListMemoryUsage(const QStringList &list) {
+	size_t total = static_cast<size_t>(list.count()) * sizeof(void *);
+	foreach(const QString &str, list)
+		total += stringMemoryUsage(str);
+	return total;
+}
+
+size_t ServerUser::memoryUsage() const {
+	// Rough per-node cost of QMap and QHash entries.
+	const size_t node = 3 * sizeof(void *);
+
+	size_t total = sizeof(ServerUser);
+
+	total += bwr.memoryUsage();
+
+	total += stringMemoryUsage(qsName);
+	total += stringMemoryUsage(qsComment);
+	total += stringMemoryUsage(qsHash);
+	total += stringMemoryUsage(qsIdentity);
+	total += static_cast<size_t>(qbaCommentHash.capacity() + qbaTexture.capacity() + qbaTextureHash.capacity());
+	total += ssContext.capacity();
+
+	total += stringListMemoryUsage(qslEmail);
+	total += stringListMemoryUsage(qslAccessTokens);
+	total += static_cast<size_t>(qlCodecs.count()) * sizeof(void *);
+	total += static_cast<size_t>(qsInterest.count() + qsKnownSessions.count()) * (node + sizeof(int));
+
+	total += static_cast<size_t>(qmTargets.count()) * (node + sizeof(WhisperTarget));
+	total += static_cast<size_t>(qmTargetCache.count()) * (node + sizeof(TargetCache));
+	total += static_cast<size_t>(qmWhisperRedirect.count()) * (node + 2 * sizeof(QString));
+	total += static_cast<size_t>(qmPermissionSent.count()) * (node + sizeof(int) + sizeof(unsigned int));
+
+	total += static_cast<size_t>(qtsSocket->bytesAvailable() + qtsSocket->bytesToWrite());
+
+	return total;
+}
+
+QString ServerUser::intern(const QString &str) {
+	// Bounded, so clients making up release strings can't grow
+	// the pool without limit.
+	static const int maxEntries = 4096;
+	static QMutex qmPool;
+	static QSet<QString> qsPool;
+
+	if (str.isEmpty())
+		return str;
+
+	QMutexLocker lock(&qmPool);
+
+	QSet<QString>::const_iterator i = qsPool.constFind(str);
+	if (i != qsPool.constEnd())
+		return *i;
+
+	if (qsPool.count() < maxEntries)
+		qsPool.insert(str);
+
+	return str;
+}
+
 BandwidthRecord::BandwidthRecord() {
 	iRecNum = 0;
 	iSum = 0;
-	for (int i=0;i<N_BANDWIDTH_SLOTS;i++)
-		a_iBW[i] = 0;
+	pSlots = NULL;
+}
+
+BandwidthRecord::~BandwidthRecord() {
+	delete pSlots;
+}
+
+size_t BandwidthRecord::memoryUsage() const {
+	QMutexLocker ml(&qmMutex);
+
+	return pSlots ? sizeof(Slots) : 0;
 }
 
 bool BandwidthRecord::addFrame(int size, int maxpersec) {
 	QMutexLocker ml(&qmMutex);
 
+	if (! pSlots) {
+		pSlots = new Slots();
+		for (int i=0;i<N_BANDWIDTH_SLOTS;i++) {
+			pSlots->a_iBW[i] = 0;
+			pSlots->a_qtWhen[i] = tFirst;
+		}
+	}
+
+	unsigned short *a_iBW = pSlots->a_iBW;
+	Timer *a_qtWhen = pSlots->a_qtWhen;
+
 	quint64 elapsed = a_qtWhen[iRecNum].elapsed();
 
 	if (elapsed == 0)
@@ -74,7 +159,7 @@ int BandwidthRecord::onlineSeconds() const {
 int BandwidthRecord::idleSeconds() const {
 	QMutexLocker ml(&qmMutex);
 
-	quint64 iIdle = a_qtWhen[(iRecNum + N_BANDWIDTH_SLOTS - 1) % N_BANDWIDTH_SLOTS].elapsed();
+	quint64 iIdle = pSlots ? pSlots->a_qtWhen[(iRecNum + N_BANDWIDTH_SLOTS - 1) % N_BANDWIDTH_SLOTS].elapsed() : tFirst.elapsed();
 	if (tIdleControl.elapsed() < iIdle)
 		iIdle = tIdleControl.elapsed();
 
@@ -90,6 +175,12 @@ void BandwidthRecord::resetIdleSeconds() {
 int BandwidthRecord::bandwidth() const {
 	QMutexLocker ml(&qmMutex);
 
+	if (! pSlots)
+		return 0;
+
+	const unsigned short *a_iBW = pSlots->a_iBW;
+	const Timer *a_qtWhen = pSlots->a_qtWhen;
+
 	int sum = 0;
 	int records = 0;
 	quint64 elapsed = 0ULL;
@@ -26,20 +26,34 @@
 #define N_BANDWIDTH_SLOTS 360
 
 struct BandwidthRecord {
-	int iRecNum;
-	int iSum;
-	Timer tFirst;
-	Timer tIdleControl;
-	unsigned short a_iBW[N_BANDWIDTH_SLOTS];
-	Timer a_qtWhen[N_BANDWIDTH_SLOTS];
-	mutable QMutex qmMutex;
-
-	BandwidthRecord();
-	bool addFrame(int size, int maxpersec);
-	int onlineSeconds() const;
-	int idleSeconds() const;
-	void resetIdleSeconds();
-	int bandwidth() const;
+	private:
+		Q_DISABLE_COPY(BandwidthRecord)
+	public:
+		/// The per-frame history. It accounts for most of a
+		/// BandwidthRecord's size, so it is only allocated once the
+		/// user sends its first voice frame. Until then, every slot
+		/// is considered to have been written at tFirst.
+		struct Slots {
+			unsigned short a_iBW[N_BANDWIDTH_SLOTS];
+			Timer a_qtWhen[N_BANDWIDTH_SLOTS];
+		};
+
+		int iRecNum;
+		int iSum;
+		Timer tFirst;
+		Timer tIdleControl;
+		Slots *pSlots;
+		mutable QMutex qmMutex;
+
+		BandwidthRecord();
+		~BandwidthRecord();
+		bool addFrame(int size, int maxpersec);
+		int onlineSeconds() const;
+		int idleSeconds() const;
+		void resetIdleSeconds();
+		int bandwidth() const;
+		/// Heap memory owned by this record, in bytes.
+		size_t memoryUsage() const;
 };
 
 struct WhisperTarget {
@@ -96,6 +110,19 @@ class ServerUser : public Connection, public User {
 		QList<int> qlCodecs;
 		bool bOpus;
 
+		/// The client only receives UserState for the users in its
+		/// interest set. See Server::isInterested().
+		bool bScopedUserState;
+		/// Channels whose subtrees the client is interested in.
+		QSet<int> qsInterest;
+		/// Sessions whose state the client has and is kept up to
+		/// date with.
+		QSet<unsigned int> qsKnownSessions;
+
+		/// The client receives large text messages by hash. See
+		/// Server::broadcastTextMessage().
+		bool bTextMessageBlobs;
+
 		QStringList qslAccessTokens;
 
 		QMap<int, WhisperTarget> qmTargets;
@@ -112,8 +139,20 @@ class ServerUser : public Connection, public User {
 #endif
 		BandwidthRecord bwr;
 		struct sockaddr_storage saiUdpAddress;
-		struct sockaddr_storage saiTcpLocalAddress;
+		/// The address the client connected to, which UDP replies are
+		/// sent from.
+		HostAddress haTcpLocalAddress;
 		ServerUser(Server *parent, QSslSocket *socket);
+
+		/// Estimate of the memory used by this connection, in bytes.
+		/// It covers the object itself, the heap data it owns and the
+		/// socket's pending buffers, but not the TLS library's state.
+		size_t memoryUsage() const;
+
+		/// Returns a shared copy of str from a process-wide pool, so
+		/// the client release and OS strings that most users have in
+		/// common are only stored once.
+		static QString intern(const QString &str);
 };
 
 #endif
@@ -0,0 +1,169 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "murmur_pch.h"
+
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(unsigned int tickLength) {
+	uiTick = 0;
+	uiTickLength = tickLength ? tickLength : 1;
+	for (int l = 0; l < WHEEL_LEVELS; ++l)
+		for (int i = 0; i < WHEEL_SIZE; ++i)
+			a_pSlots[l][i] = NULL;
+}
+
+TimerWheel::~TimerWheel() {
+	clear();
+}
+
+void TimerWheel::link(Entry *e) {
+	// Pick the lowest level whose range covers the distance to the
+	// deadline. Deadlines beyond the range of the top level are parked
+	// in its farthest slot and re-filed when that slot cascades.
+	quint64 deadline = e->uiDeadline;
+	if (deadline < uiTick)
+		deadline = uiTick;
+
+	quint64 delta = deadline - uiTick;
+
+	int level = 0;
+	while ((level < WHEEL_LEVELS - 1) && (delta >= (1ULL << (WHEEL_BITS * (level + 1)))))
+		++level;
+
+	if (delta >= (1ULL << (WHEEL_BITS * WHEEL_LEVELS)))
+		deadline = uiTick + (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+	int idx = static_cast<int>((deadline >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+	Entry *&head = a_pSlots[level][idx];
+	e->ppSlot = &head;
+	e->prev = NULL;
+	e->next = head;
+	if (head)
+		head->prev = e;
+	head = e;
+}
+
+void TimerWheel::unlink(Entry *e) {
+	if (e->prev)
+		e->prev->next = e->next;
+	else if (e->ppSlot)
+		*e->ppSlot = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	e->ppSlot = NULL;
+	e->prev = e->next = NULL;
+}
+
+void TimerWheel::cascade(int level) {
+	int idx = static_cast<int>((uiTick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+	Entry *e = a_pSlots[level][idx];
+	a_pSlots[level][idx] = NULL;
+
+	while (e) {
+		Entry *next = e->next;
+		e->ppSlot = NULL;
+		link(e);
+		e = next;
+	}
+}
+
+void TimerWheel::schedule(unsigned int key, quint64 deadline) {
+	// Round up to the next tick, and never file into the tick
+	// that has already been processed.
+	quint64 tick = (deadline + uiTickLength - 1) / uiTickLength;
+	if (tick <= uiTick)
+		tick = uiTick + 1;
+
+	Entry *e = qhEntries.value(key);
+	if (e) {
+		if (e->uiDeadline == tick)
+			return;
+		unlink(e);
+	} else {
+		e = new Entry();
+		e->uiKey = key;
+		e->ppSlot = NULL;
+		qhEntries.insert(key, e);
+	}
+
+	e->uiDeadline = tick;
+	link(e);
+}
+
+bool TimerWheel::cancel(unsigned int key) {
+	Entry *e = qhEntries.take(key);
+	if (! e)
+		return false;
+
+	unlink(e);
+	delete e;
+	return true;
+}
+
+bool TimerWheel::contains(unsigned int key) const {
+	return qhEntries.contains(key);
+}
+
+int TimerWheel::count() const {
+	return qhEntries.count();
+}
+
+void TimerWheel::clear() {
+	foreach(Entry *e, qhEntries)
+		delete e;
+	qhEntries.clear();
+
+	for (int l = 0; l < WHEEL_LEVELS; ++l)
+		for (int i = 0; i < WHEEL_SIZE; ++i)
+			a_pSlots[l][i] = NULL;
+}
+
+QList<unsigned int> TimerWheel::advance(quint64 now) {
+	QList<unsigned int> expired;
+
+	quint64 target = now / uiTickLength;
+
+	// If nothing is armed there is no need to walk the ticks.
+	if (qhEntries.isEmpty() && (target > uiTick))
+		uiTick = target;
+
+	while (uiTick < target) {
+		++uiTick;
+
+		// Whenever a level wraps, re-file the next slot of each
+		// level above it into the finer-grained levels below,
+		// starting from the coarsest.
+		int wrapped = 0;
+		while ((wrapped < WHEEL_LEVELS - 1) && ((uiTick & ((1ULL << (WHEEL_BITS * (wrapped + 1))) - 1)) == 0))
+			++wrapped;
+		for (int l = wrapped; l > 0; --l)
+			cascade(l);
+
+		int idx = static_cast<int>(uiTick & WHEEL_MASK);
+		Entry *e = a_pSlots[0][idx];
+		a_pSlots[0][idx] = NULL;
+
+		while (e) {
+			Entry *next = e->next;
+			e->ppSlot = NULL;
+			if (e->uiDeadline <= uiTick) {
+				expired << e->uiKey;
+				qhEntries.remove(e->uiKey);
+				delete e;
+			} else {
+				link(e);
+			}
+			e = next;
+		}
+
+		if (qhEntries.isEmpty() && (target > uiTick))
+			uiTick = target;
+	}
+
+	return expired;
+}
@@ -0,0 +1,81 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_TIMERWHEEL_H_
+#define MUMBLE_MURMUR_TIMERWHEEL_H_
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+
+/// TimerWheel is a hierarchical timing wheel that tracks one
+/// deadline per key (a session ID in Murmur).
+///
+/// Scheduling, rescheduling and cancelling a key is O(1).
+/// Advancing the wheel costs time proportional to the number
+/// of elapsed ticks and the number of keys that expire, not
+/// the number of keys being tracked.
+///
+/// All times are in milliseconds, relative to an arbitrary
+/// monotonic epoch chosen by the caller. Deadlines are
+/// rounded up to the next tick.
+///
+/// TimerWheel is not thread safe. In Murmur, it is only
+/// accessed from the control thread of its server.
+class TimerWheel {
+	private:
+		Q_DISABLE_COPY(TimerWheel)
+
+		static const int WHEEL_BITS = 6;
+		static const int WHEEL_SIZE = 1 << WHEEL_BITS;
+		static const int WHEEL_MASK = WHEEL_SIZE - 1;
+		static const int WHEEL_LEVELS = 4;
+
+		struct Entry {
+			unsigned int uiKey;
+			quint64 uiDeadline;
+			Entry **ppSlot;
+			Entry *prev;
+			Entry *next;
+		};
+
+		Entry *a_pSlots[WHEEL_LEVELS][WHEEL_SIZE];
+		QHash<unsigned int, Entry *> qhEntries;
+		quint64 uiTick;
+		unsigned int uiTickLength;
+
+		void link(Entry *e);
+		void unlink(Entry *e);
+		void cascade(int level);
+	public:
+		/// Construct a wheel with the given tick length. The
+		/// wheel starts at time 0.
+		TimerWheel(unsigned int tickLength = 1000);
+		~TimerWheel();
+
+		/// Arm (or re-arm) the deadline for key. A deadline that
+		/// has already passed will expire on the next advance().
+		void schedule(unsigned int key, quint64 deadline);
+
+		/// Remove the deadline for key, if any.
+		/// Returns true if a deadline was removed.
+		bool cancel(unsigned int key);
+
+		/// Returns true if key currently has a deadline.
+		bool contains(unsigned int key) const;
+
+		/// Returns the number of armed deadlines.
+		int count() const;
+
+		/// Removes all deadlines.
+		void clear();
+
+		/// Move the wheel forward to time now, and return the keys
+		/// whose deadlines expired in deadline order (modulo tick
+		/// granularity). Expired keys are no longer tracked.
+		QList<unsigned int> advance(quint64 now);
+};
+
+#endif
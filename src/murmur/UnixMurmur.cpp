@@ -7,7 +7,9 @@
 
 #include "UnixMurmur.h"
 
+#include "ControlThread.h"
 #include "Meta.h"
+#include "Server.h"
 
 QMutex *LimitTest::qm;
 QWaitCondition *LimitTest::qw;
@@ -85,9 +87,11 @@ extern QFile *qfLog;
 
 int UnixMurmur::iHupFd[2];
 int UnixMurmur::iTermFd[2];
+int UnixMurmur::iUsr1Fd[2];
 
 UnixMurmur::UnixMurmur() {
 	bRoot = true;
+	uiBootResident = 0;
 	logToSyslog = false;
 
 	if (geteuid() != 0 && getuid() != 0) {
@@ -99,13 +103,18 @@ UnixMurmur::UnixMurmur() {
 	if (::socketpair(AF_UNIX, SOCK_STREAM, 0, iTermFd))
 		qFatal("Couldn't create TERM socketpair");
 
+	if (::socketpair(AF_UNIX, SOCK_STREAM, 0, iUsr1Fd))
+		qFatal("Couldn't create USR1 socketpair");
+
 	qsnHup = new QSocketNotifier(iHupFd[1], QSocketNotifier::Read, this);
 	qsnTerm = new QSocketNotifier(iTermFd[1], QSocketNotifier::Read, this);
+	qsnUsr1 = new QSocketNotifier(iUsr1Fd[1], QSocketNotifier::Read, this);
 
 	connect(qsnHup, SIGNAL(activated(int)), this, SLOT(handleSigHup()));
 	connect(qsnTerm, SIGNAL(activated(int)), this, SLOT(handleSigTerm()));
+	connect(qsnUsr1, SIGNAL(activated(int)), this, SLOT(handleSigUsr1()));
 
-	struct sigaction hup, term;
+	struct sigaction hup, term, usr1;
 
 	hup.sa_handler = hupSignalHandler;
 	sigemptyset(&hup.sa_mask);
@@ -121,20 +130,31 @@ UnixMurmur::UnixMurmur() {
 	if (sigaction(SIGTERM, &term, NULL))
 		qFatal("Failed to install SIGTERM handler");
 
+	usr1.sa_handler = usr1SignalHandler;
+	sigemptyset(&usr1.sa_mask);
+	usr1.sa_flags = SA_RESTART;
+
+	if (sigaction(SIGUSR1, &usr1, NULL))
+		qFatal("Failed to install SIGUSR1 handler");
+
 	umask(S_IRWXO);
 }
 
 UnixMurmur::~UnixMurmur() {
 	delete qsnHup;
 	delete qsnTerm;
+	delete qsnUsr1;
 
 	qsnHup = NULL;
 	qsnTerm = NULL;
+	qsnUsr1 = NULL;
 
 	close(iHupFd[0]);
 	close(iHupFd[1]);
 	close(iTermFd[0]);
 	close(iTermFd[1]);
+	close(iUsr1Fd[0]);
+	close(iUsr1Fd[1]);
 }
 
 void UnixMurmur::hupSignalHandler(int) {
@@ -149,6 +169,12 @@ void UnixMurmur::termSignalHandler(int) {
 	Q_UNUSED(len);
 }
 
+void UnixMurmur::usr1SignalHandler(int) {
+	char a = 1;
+	ssize_t len = ::write(iUsr1Fd[0], &a, sizeof(a));
+	Q_UNUSED(len);
+}
+
 
 // Keep these two synchronized with matching actions in DBus.cpp
 
@@ -199,6 +225,64 @@ void UnixMurmur::handleSigTerm() {
 	qsnTerm->setEnabled(true);
 }
 
+static void logServerMemoryUsage(int srvnum, int *users) {
+	Server *s = meta->server(srvnum);
+	if (! s)
+		return;
+	s->logMemoryUsage();
+	*users += s->qhUsers.count();
+}
+
+void UnixMurmur::handleSigUsr1() {
+	qsnUsr1->setEnabled(false);
+	char tmp;
+	ssize_t len = ::read(iUsr1Fd[1], &tmp, sizeof(tmp));
+	Q_UNUSED(len);
+
+	qWarning("Caught SIGUSR1, logging memory usage");
+
+	// Each server is inspected on its own thread, one at a time.
+	int users = 0;
+	foreach(int srvnum, meta->qhServers.keys())
+		ControlThread::call(srvnum, boost::bind(&logServerMemoryUsage, srvnum, &users));
+
+	// The estimates above leave out Qt's socket state and the TLS
+	// library; the resident set size is what the kernel actually
+	// charges, so the growth since boot divided by the number of
+	// connections is the measured cost of one.
+	const quint64 resident = residentBytes();
+	const quint64 growth = (resident > uiBootResident) ? (resident - uiBootResident) : 0;
+	qWarning("Memory: resident %llu bytes, %llu bytes at boot, %llu bytes per connection over %d connections",
+	         static_cast<unsigned long long>(resident), static_cast<unsigned long long>(uiBootResident),
+	         static_cast<unsigned long long>(users ? growth / static_cast<quint64>(users) : 0), users);
+
+	qsnUsr1->setEnabled(true);
+}
+
+quint64 UnixMurmur::residentBytes() {
+#ifdef Q_OS_LINUX
+	// The second field of statm is the resident set size in pages.
+	QFile f(QLatin1String("/proc/self/statm"));
+	if (f.open(QIODevice::ReadOnly)) {
+		const QList<QByteArray> fields = f.readAll().split(' ');
+		if (fields.count() > 1)
+			return fields.at(1).toULongLong() * static_cast<quint64>(sysconf(_SC_PAGESIZE));
+	}
+#endif
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+#ifdef Q_OS_DARWIN
+	return static_cast<quint64>(ru.ru_maxrss);
+#else
+	return static_cast<quint64>(ru.ru_maxrss) * 1024ULL;
+#endif
+}
+
+void UnixMurmur::recordBootResident() {
+	uiBootResident = residentBytes();
+}
+
 void UnixMurmur::setuid() {
 	if (Meta::mp.uiUid != 0) {
 #ifdef Q_OS_DARWIN
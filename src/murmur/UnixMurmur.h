@@ -32,14 +32,19 @@ class UnixMurmur : public QObject {
 		Q_DISABLE_COPY(UnixMurmur)
 	protected:
 		bool bRoot;
-		static int iHupFd[2], iTermFd[2];
-		QSocketNotifier *qsnHup, *qsnTerm;
+		static int iHupFd[2], iTermFd[2], iUsr1Fd[2];
+		QSocketNotifier *qsnHup, *qsnTerm, *qsnUsr1;
+		/// Resident set size once the servers were booted, before
+		/// any client connected.
+		quint64 uiBootResident;
 
 		static void hupSignalHandler(int);
 		static void termSignalHandler(int);
+		static void usr1SignalHandler(int);
 	public slots:
 		void handleSigHup();
 		void handleSigTerm();
+		void handleSigUsr1();
 	public:
 		bool logToSyslog;
 
@@ -48,6 +53,12 @@ class UnixMurmur : public QObject {
 		void finalcap();
 		const QString trySystemIniFiles(const QString& fname);
 
+		/// Resident set size of the process in bytes, as the kernel
+		/// reports it. Where it can't tell the current size, this is
+		/// the peak.
+		static quint64 residentBytes();
+		void recordBootResident();
+
 		UnixMurmur();
 		~UnixMurmur();
 };
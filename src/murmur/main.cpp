@@ -39,7 +39,12 @@ static LogEmitter le;
 
 static QStringList qlErrors;
 
+// Servers log from their voice and control threads.
+static QMutex qmLog(QMutex::Recursive);
+
 static void murmurMessageOutputQString(QtMsgType type, const QString &msg) {
+	QMutexLocker l(&qmLog);
+
 #ifdef Q_OS_UNIX
 	if (unixMurmur->logToSyslog) {
 		int level;
@@ -526,6 +531,10 @@ int main(int argc, char **argv) {
 
 	meta->bootAll();
 
+#ifdef Q_OS_UNIX
+	unixhandler.recordBootResident();
+#endif
+
 	res=a.exec();
 
 	qWarning("Killing running servers");
@@ -15,8 +15,8 @@ TARGET = murmur
 DBFILE  = murmur.db
 LANGUAGE	= C++
 FORMS =
-HEADERS *= Server.h ServerUser.h Meta.h PBKDF2.h
-SOURCES *= main.cpp Server.cpp ServerUser.cpp ServerDB.cpp Register.cpp Cert.cpp Messages.cpp Meta.cpp RPC.cpp PBKDF2.cpp
+HEADERS *= Server.h ServerUser.h Meta.h PBKDF2.h TimerWheel.h ServerSnapshot.h ChannelBatch.h ChannelLoader.h ControlThread.h
+SOURCES *= main.cpp Server.cpp ServerUser.cpp ServerDB.cpp Register.cpp Cert.cpp Messages.cpp Meta.cpp RPC.cpp PBKDF2.cpp TimerWheel.cpp ServerSnapshot.cpp ChannelBatch.cpp ChannelLoader.cpp Interest.cpp ControlThread.cpp
 
 DIST = DBus.h ServerDB.h ../../icons/murmur.ico Murmur.ice MurmurI.h MurmurIceWrapper.cpp murmur.plist
 PRECOMPILED_HEADER = murmur_pch.h
@@ -32,8 +32,11 @@ public:
 
 	void handle(bool ok) {
 		$service$_$method$::create(this->rpc, this->service);
+		if (ok && RPCSnapshotHandler< $service$_$method$ >::handle(this)) {
+			return;
+		}
 		auto ie = new RPCExecEvent(::boost::bind(&$service$_$method$::impl, this, ok), this);
-		QCoreApplication::instance()->postEvent(rpc, ie);
+		this->rpc->post(ie, ok ? &this->request : NULL);
 	}
 
 	static void create(MurmurRPCImpl *rpc, ::$ns$::$service$::AsyncService *service) {
@@ -63,7 +66,7 @@ public:
 	void handle(bool ok) {
 		$service$_$method$::create(this->rpc, this->service);
 		auto ie = new RPCExecEvent(::boost::bind(&$service$_$method$::impl, this, ok), this);
-		QCoreApplication::instance()->postEvent(rpc, ie);
+		this->rpc->post(ie, ok ? &this->request : NULL);
 	}
 
 	static void create(MurmurRPCImpl *rpc, ::$ns$::$service$::AsyncService *service) {
@@ -123,14 +126,17 @@ public:
 
 	void impl(bool ok);
 
+	// write() and read() complete on the completion queue thread rather
+	// than through the main thread, so that they work on any thread.
 	bool write() {
-		bool processed = false;
+		::std::atomic<bool> processed(false);
 		bool success;
-		auto cb = [&success, &processed] ($service$_$method$ *, bool ok) {
+		auto cb = [&success, &processed] (bool ok) {
 			success = ok;
 			processed = true;
 		};
-		stream.Write(response, callback(cb));
+		auto done = new ::boost::function<void(bool)>(cb);
+		stream.Write(response, done);
 		while (!processed) {
 			QCoreApplication::processEvents(QEventLoop::ExcludeSocketNotifiers, 100);
 		}
@@ -138,13 +144,14 @@ public:
 	}
 
 	bool read() {
-		bool processed = false;
+		::std::atomic<bool> processed(false);
 		bool success;
-		auto cb = [&success, &processed] ($service$_$method$ *, bool ok) {
+		auto cb = [&success, &processed] (bool ok) {
 			success = ok;
 			processed = true;
 		};
-		stream.Read(&request, callback(cb));
+		auto done = new ::boost::function<void(bool)>(cb);
+		stream.Read(&request, done);
 		while (!processed) {
 			QCoreApplication::processEvents(QEventLoop::ExcludeSocketNotifiers, 100);
 		}
@@ -0,0 +1,266 @@
+/**
+ * Benchmark of loading a channel tree and its privileges from the
+ * database, one channel at a time as Server::readChannels used to, and
+ * with the queries and ChannelLoader that Server::readChannels uses now.
+ *
+ * Uses an in-memory SQLite database with Murmur's schema for the
+ * channels, channel_info, groups, group_members and acl tables. Sizes
+ * can be given on the command line; the default is 10k and 100k
+ * channels.
+ */
+
+#include <QtCore>
+#include <QtSql>
+
+#include "ACL.h"
+#include "Channel.h"
+#include "ChannelLoader.h"
+#include "Group.h"
+#include "Message.h"
+#include "Timer.h"
+
+#define FANOUT 10
+
+static const int iServerNum = 1;
+
+static void exec(QSqlQuery &query) {
+	if (! query.exec())
+		qFatal("SQL error: %s (%s)", qPrintable(query.lastError().text()), qPrintable(query.lastQuery()));
+}
+
+static void createSchema() {
+	QSqlQuery query;
+	const char *statements[] = {
+		"CREATE TABLE `channels` (`server_id` INTEGER NOT NULL, `channel_id` INTEGER NOT NULL, `parent_id` INTEGER, `name` TEXT, `inheritacl` INTEGER)",
+		"CREATE UNIQUE INDEX `channel_id` ON `channels`(`server_id`, `channel_id`)",
+		"CREATE TABLE `channel_info` (`server_id` INTEGER NOT NULL, `channel_id` INTEGER NOT NULL, `key` INTEGER, `value` TEXT)",
+		"CREATE UNIQUE INDEX `channel_info_id` ON `channel_info`(`server_id`, `channel_id`, `key`)",
+		"CREATE TABLE `groups` (`group_id` INTEGER PRIMARY KEY AUTOINCREMENT, `server_id` INTEGER NOT NULL, `name` TEXT, `channel_id` INTEGER NOT NULL, `inherit` INTEGER, `inheritable` INTEGER)",
+		"CREATE UNIQUE INDEX `groups_name_channels` ON `groups`(`server_id`, `channel_id`, `name`)",
+		"CREATE TABLE `group_members` (`group_id` INTEGER NOT NULL, `server_id` INTEGER NOT NULL, `user_id` INTEGER NOT NULL, `addit` INTEGER)",
+		"CREATE TABLE `acl` (`server_id` INTEGER NOT NULL, `channel_id` INTEGER NOT NULL, `priority` INTEGER, `user_id` INTEGER, `group_name` TEXT, `apply_here` INTEGER, `apply_sub` INTEGER, `grantpriv` INTEGER, `revokepriv` INTEGER)",
+		"CREATE UNIQUE INDEX `acl_channel_pri` ON `acl`(`server_id`, `channel_id`, `priority`)",
+	};
+	for (unsigned int i = 0; i < sizeof(statements) / sizeof(statements[0]); ++i) {
+		query.prepare(QLatin1String(statements[i]));
+		exec(query);
+	}
+}
+
+// Every channel gets a description (every tenth a long one), a
+// position, a group with two members and an ACL entry.
+static void populate(int count) {
+	QSqlDatabase::database().transaction();
+
+	QSqlQuery channel, info, group, member, acl;
+	channel.prepare(QLatin1String("INSERT INTO `channels` (`server_id`, `channel_id`, `parent_id`, `name`, `inheritacl`) VALUES (?,?,?,?,1)"));
+	info.prepare(QLatin1String("INSERT INTO `channel_info` (`server_id`, `channel_id`, `key`, `value`) VALUES (?,?,?,?)"));
+	group.prepare(QLatin1String("INSERT INTO `groups` (`group_id`, `server_id`, `name`, `channel_id`, `inherit`, `inheritable`) VALUES (?,?,'admin',?,1,1)"));
+	member.prepare(QLatin1String("INSERT INTO `group_members` (`group_id`, `server_id`, `user_id`, `addit`) VALUES (?,?,?,?)"));
+	acl.prepare(QLatin1String("INSERT INTO `acl` (`server_id`, `channel_id`, `priority`, `user_id`, `group_name`, `apply_here`, `apply_sub`, `grantpriv`, `revokepriv`) VALUES (?,?,1,NULL,'admin',1,1,1,0)"));
+
+	const QString longDesc = QString(200, QLatin1Char('x'));
+
+	for (int id = 0; id < count; ++id) {
+		channel.addBindValue(iServerNum);
+		channel.addBindValue(id);
+		channel.addBindValue(id ? QVariant((id - 1) / FANOUT) : QVariant(QVariant::Int));
+		channel.addBindValue(id ? QString::fromLatin1("Channel %1").arg(id) : QString::fromLatin1("Root"));
+		exec(channel);
+
+		info.addBindValue(iServerNum);
+		info.addBindValue(id);
+		info.addBindValue(0);
+		info.addBindValue((id % 10) ? QString::fromLatin1("Description of %1").arg(id) : longDesc);
+		exec(info);
+
+		info.addBindValue(iServerNum);
+		info.addBindValue(id);
+		info.addBindValue(2);
+		info.addBindValue(QString::number(id % 7));
+		exec(info);
+
+		group.addBindValue(id + 1);
+		group.addBindValue(iServerNum);
+		group.addBindValue(id);
+		exec(group);
+
+		for (int m = 0; m < 2; ++m) {
+			member.addBindValue(id + 1);
+			member.addBindValue(iServerNum);
+			member.addBindValue(id + m);
+			member.addBindValue(m == 0);
+			exec(member);
+		}
+
+		acl.addBindValue(iServerNum);
+		acl.addBindValue(id);
+		exec(acl);
+	}
+
+	QSqlDatabase::database().commit();
+}
+
+static void readInfo(Channel *c, int key, const QString &value) {
+	if (key == 0) {
+		if (value.length() >= BLOB_HASH_THRESHOLD) {
+			c->qsDesc = QString();
+			c->qbaDescHash = sha1(value);
+		} else {
+			c->qsDesc = value;
+		}
+	} else if (key == 2) {
+		c->iPosition = QVariant(value).toInt();
+	}
+}
+
+static void readACL(Channel *c, const QSqlQuery &query, int first) {
+	ChanACL *acl = new ChanACL(c);
+	acl->iUserId = query.value(first).isNull() ? -1 : query.value(first).toInt();
+	acl->qsGroup = query.value(first + 1).toString();
+	acl->bApplyHere = query.value(first + 2).toBool();
+	acl->bApplySubs = query.value(first + 3).toBool();
+	acl->pAllow = static_cast<ChanACL::Permissions>(query.value(first + 4).toInt());
+	acl->pDeny = static_cast<ChanACL::Permissions>(query.value(first + 5).toInt());
+}
+
+// The old way: the privileges of each channel, then its children.
+static void readChannelPrivsPerChannel(Channel *c) {
+	QSqlQuery query;
+
+	query.prepare(QLatin1String("SELECT `key`, `value` FROM `channel_info` WHERE `server_id` = ? AND `channel_id` = ?"));
+	query.addBindValue(iServerNum);
+	query.addBindValue(c->iId);
+	exec(query);
+	while (query.next())
+		readInfo(c, query.value(0).toInt(), query.value(1).toString());
+
+	query.prepare(QLatin1String("SELECT `group_id`, `name`, `inherit`, `inheritable` FROM `groups` WHERE `server_id` = ? AND `channel_id` = ?"));
+	query.addBindValue(iServerNum);
+	query.addBindValue(c->iId);
+	exec(query);
+	while (query.next()) {
+		Group *g = new Group(c, query.value(1).toString());
+		g->bInherit = query.value(2).toBool();
+		g->bInheritable = query.value(3).toBool();
+
+		QSqlQuery mem;
+		mem.prepare(QLatin1String("SELECT user_id, addit FROM group_members WHERE group_id = ?"));
+		mem.addBindValue(query.value(0).toInt());
+		exec(mem);
+		while (mem.next()) {
+			if (mem.value(1).toBool())
+				g->qsAdd << mem.value(0).toInt();
+			else
+				g->qsRemove << mem.value(0).toInt();
+		}
+	}
+
+	query.prepare(QLatin1String("SELECT `user_id`, `group_name`, `apply_here`, `apply_sub`, `grantpriv`, `revokepriv` FROM `acl` WHERE `server_id` = ? AND `channel_id` = ? ORDER BY `priority`"));
+	query.addBindValue(iServerNum);
+	query.addBindValue(c->iId);
+	exec(query);
+	while (query.next())
+		readACL(c, query, 0);
+}
+
+static void readChannelsPerChannel(Channel *p, QHash<int, Channel *> &channels, QObject *owner) {
+	QList<Channel *> kids;
+	{
+		QSqlQuery query;
+		if (! p) {
+			query.prepare(QLatin1String("SELECT `channel_id`, `name`, `inheritacl` FROM `channels` WHERE `server_id` = ? AND `parent_id` IS NULL ORDER BY `name`"));
+			query.addBindValue(iServerNum);
+		} else {
+			readChannelPrivsPerChannel(p);
+			query.prepare(QLatin1String("SELECT `channel_id`, `name`, `inheritacl` FROM `channels` WHERE `server_id` = ? AND `parent_id`=? ORDER BY `name`"));
+			query.addBindValue(iServerNum);
+			query.addBindValue(p->iId);
+		}
+		exec(query);
+		while (query.next()) {
+			Channel *c = new Channel(query.value(0).toInt(), query.value(1).toString(), p);
+			if (! p)
+				c->setParent(owner);
+			c->bInheritACL = query.value(2).toBool();
+			channels.insert(c->iId, c);
+			kids << c;
+		}
+	}
+	foreach(Channel *c, kids)
+		readChannelsPerChannel(c, channels, owner);
+}
+
+// Runs one of ChannelLoader's queries, as ServerDB does for the server.
+static void run(QSqlQuery &query, const char *sql) {
+	query.prepare(QString::fromLatin1(sql).arg(QString()));
+	query.addBindValue(iServerNum);
+	exec(query);
+}
+
+// The new way, as in Server::readChannels(): one query per table.
+static void readChannelsBulk(QHash<int, Channel *> &channels, QObject *owner) {
+	ChannelLoader cl;
+	QSqlQuery query;
+
+	run(query, ChannelLoader::cChannelsQuery);
+	cl.readChannels(query);
+	cl.link(owner);
+
+	run(query, ChannelLoader::cChannelInfoQuery);
+	cl.readChannelInfo(query);
+
+	run(query, ChannelLoader::cGroupsQuery);
+	cl.readGroups(query);
+
+	run(query, ChannelLoader::cGroupMembersQuery);
+	cl.readGroupMembers(query);
+
+	run(query, ChannelLoader::cACLQuery);
+	cl.readACL(query);
+
+	channels = cl.qhChannels;
+	qDeleteAll(cl.qlOrphans);
+}
+
+int main(int argc, char **argv) {
+	QCoreApplication a(argc, argv);
+
+	QList<int> sizes;
+	for (int i = 1; i < argc; ++i)
+		sizes << atoi(argv[i]);
+	if (sizes.isEmpty())
+		sizes << 10000 << 100000;
+
+	foreach(int size, sizes) {
+		{
+			QSqlDatabase db = QSqlDatabase::addDatabase(QLatin1String("QSQLITE"));
+			db.setDatabaseName(QLatin1String(":memory:"));
+			if (! db.open())
+				qFatal("Failed to open database: %s", qPrintable(db.lastError().text()));
+
+			createSchema();
+			populate(size);
+
+			Timer t;
+			quint64 usperchannel, usbulk;
+			QHash<int, Channel *> perchannel, bulk;
+			QObject owner;
+
+			t.restart();
+			readChannelsPerChannel(NULL, perchannel, &owner);
+			usperchannel = t.restart();
+
+			readChannelsBulk(bulk, &owner);
+			usbulk = t.restart();
+
+			qWarning("%d channels: %lldus one channel at a time (%d), %lldus in bulk (%d)",
+			         size, usperchannel, perchannel.count(), usbulk, bulk.count());
+
+			db.close();
+		}
+		QSqlDatabase::removeDatabase(QLatin1String(QSqlDatabase::defaultConnection));
+	}
+
+	return 0;
+}
@@ -0,0 +1,11 @@
+TEMPLATE = app
+CONFIG  += qt thread warn_on release
+CONFIG -= app_bundle
+QT += network sql xml
+LANGUAGE = C++
+TARGET = ChannelLoad
+SOURCES = ChannelLoad.cpp ChannelLoader.cpp Channel.cpp ACL.cpp Group.cpp User.cpp Timer.cpp
+HEADERS = ChannelLoader.h Channel.h ACL.h Group.h User.h Timer.h
+VPATH += .. ../murmur
+INCLUDEPATH += .. ../murmur ../mumble
+include(../mumble.pri)
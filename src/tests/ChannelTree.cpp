@@ -0,0 +1,69 @@
+/**
+ * Benchmark of channel tree construction and traversal at
+ * 10k, 100k and 1M channels.
+ */
+
+#include <QtCore>
+
+#include "Channel.h"
+#include "Timer.h"
+
+#define FANOUT 10
+
+static Channel *buildTree(int count, QList<Channel *> &all) {
+	Channel *root = new Channel(0, QLatin1String("Root"));
+	all << root;
+
+	int id = 1;
+	for (int i = 0; id < count; ++i) {
+		Channel *p = all.at(i);
+		for (int j = 0; (j < FANOUT) && (id < count); ++j, ++id)
+			all << new Channel(id, QString::fromLatin1("Channel %1").arg(id), p);
+	}
+	return root;
+}
+
+int main(int argc, char **argv) {
+	Q_UNUSED(argc);
+	Q_UNUSED(argv);
+
+	static const int sizes[] = { 10000, 100000, 1000000 };
+
+	for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+		Timer t;
+		quint64 usbuild, uschildren, uspath, usbfs, usdelete;
+		QList<Channel *> all;
+
+		t.restart();
+		Channel *root = buildTree(sizes[s], all);
+		usbuild = t.restart();
+
+		int children = root->allChildren().count();
+		uschildren = t.restart();
+
+		int pathlen = 0;
+		foreach(const Channel *c, all)
+			pathlen += c->getPath().length();
+		uspath = t.restart();
+
+		// Same walk as the channel tree sync in msgAuthenticate.
+		int visited = 0;
+		QQueue<Channel *> q;
+		q << root;
+		while (! q.isEmpty()) {
+			Channel *c = q.dequeue();
+			++visited;
+			foreach(Channel *chld, c->qlChannels)
+				q.enqueue(chld);
+		}
+		usbfs = t.restart();
+
+		delete root;
+		usdelete = t.restart();
+
+		qWarning("%d channels: %lldus build, %lldus allChildren (%d), %lldus getPath (%d), %lldus BFS (%d), %lldus delete",
+		         sizes[s], usbuild, uschildren, children, uspath, pathlen, usbfs, visited, usdelete);
+	}
+
+	return 0;
+}
@@ -0,0 +1,10 @@
+TEMPLATE = app
+CONFIG  += qt thread warn_on release
+CONFIG -= app_bundle
+LANGUAGE = C++
+TARGET = ChannelTree
+SOURCES = ChannelTree.cpp Channel.cpp ACL.cpp Group.cpp User.cpp Timer.cpp
+HEADERS = Channel.h ACL.h Group.h User.h Timer.h
+VPATH += ..
+INCLUDEPATH += .. ../murmur ../mumble
+include(../mumble.pri)
@@ -0,0 +1,271 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+/**
+ * Replays packet arrival traces through the playout buffer and reports
+ * mouth-to-ear latency against glitch rate for a range of target
+ * percentiles.
+ *
+ * Usage: PlayoutSim [trace...]
+ *
+ * A trace has one packet per line: its sequence number and arrival
+ * time in milliseconds, separated by whitespace. Each packet holds two
+ * 10 ms frames, so sequence numbers go up by 2. Lines starting with #
+ * are skipped. Without arguments, a few synthetic traces are used.
+ */
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "PlayoutBuffer.h"
+#include "TimeStretch.h"
+
+static const unsigned int iSampleRate = 48000;
+static const unsigned int iFrameSize = iSampleRate / 100;
+static const unsigned int iFramesPerPacket = 2;
+static const quint64 uiFrameLength = 10000;
+
+struct Arrival {
+	unsigned int iSeq;
+	quint64 uiArrival;
+
+	bool operator <(const Arrival &other) const {
+		return uiArrival < other.uiArrival;
+	}
+};
+
+struct Trace {
+	const char *name;
+	std::vector<Arrival> arrivals;
+};
+
+struct Result {
+	double dMeanLatency;
+	double dHighLatency;
+	double dGlitchRate;
+	double dStretchRate;
+};
+
+static quint32 uiRandom = 1;
+
+static double random01() {
+	uiRandom = uiRandom * 1103515245U + 12345U;
+	return static_cast<double>((uiRandom >> 8) & 0xffffff) / 16777216.0;
+}
+
+// One second of a vowel-like signal at 140 Hz whose loudness follows
+// syllables, so that there are pauses to stretch in.
+static std::vector<float> voice() {
+	std::vector<float> v(iSampleRate);
+	for (unsigned int i = 0; i < iSampleRate; ++i) {
+		const double t = static_cast<double>(i) / iSampleRate;
+		const double envelope = std::max(0.0, sin(2.0 * M_PI * 3.0 * t));
+		double s = 0.0;
+		for (int h = 1; h <= 8; ++h)
+			s += sin(2.0 * M_PI * 140.0 * h * t) / h;
+		v[i] = static_cast<float>(0.2 * envelope * s);
+	}
+	return v;
+}
+
+static const std::vector<float> vVoice = voice();
+
+// jitter(i) is the queueing delay of packet i in microseconds. Packets
+// can't overtake each other, as they share a queue.
+template<typename F>
+static Trace synthesize(const char *name, double loss, F jitter) {
+	Trace t;
+	t.name = name;
+
+	quint64 last = 0;
+	for (unsigned int i = 0; i < 3000; ++i) {
+		const unsigned int seq = i * iFramesPerPacket;
+		quint64 arrival = seq * uiFrameLength + 20000 + static_cast<quint64>(jitter(i));
+		arrival = std::max(arrival, last);
+		last = arrival;
+		if (random01() >= loss) {
+			Arrival a = { seq, arrival };
+			t.arrivals.push_back(a);
+		}
+	}
+	return t;
+}
+
+struct Steady {
+	double operator()(unsigned int) const {
+		return random01() * 4000.0;
+	}
+};
+
+// Short spikes, as on a busy wireless link.
+struct Spikes {
+	double operator()(unsigned int) const {
+		double j = -log(1.0 - random01()) * 3000.0;
+		if (random01() < 0.005)
+			j += 40000.0 + random01() * 80000.0;
+		return j;
+	}
+};
+
+// A queue that slowly fills and drains.
+struct Congested {
+	mutable double dQueue;
+	Congested() : dQueue(0.0) {}
+	double operator()(unsigned int) const {
+		dQueue = std::min(std::max(dQueue + (random01() - 0.5) * 6000.0, 0.0), 80000.0);
+		return dQueue + random01() * 5000.0;
+	}
+};
+
+static bool load(const char *path, Trace &t) {
+	FILE *f = fopen(path, "r");
+	if (! f)
+		return false;
+
+	t.name = path;
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		unsigned int seq;
+		double ms;
+		if ((line[0] == '#') || (sscanf(line, "%u %lf", &seq, &ms) != 2))
+			continue;
+		Arrival a = { seq, static_cast<quint64>(ms * 1000.0) };
+		t.arrivals.push_back(a);
+	}
+	fclose(f);
+
+	std::stable_sort(t.arrivals.begin(), t.arrivals.end());
+	return ! t.arrivals.empty();
+}
+
+// Plays the trace the way AudioOutputSpeech::needSamples() does, with
+// the mixer asking for 10 ms every 10 ms.
+static Result simulate(const Trace &t, float pct) {
+	JitterHistogram jh;
+	PlayoutBuffer pb(iFrameSize, iSampleRate, &jh, pct, static_cast<int>(uiFrameLength));
+
+	std::vector<float> buffer(iFrameSize + iFrameSize / 2);
+	std::vector<double> latencies;
+
+	size_t next = 0;
+	unsigned int pending = 0;
+	unsigned int missCount = 0;
+	unsigned int framesLeft = 0;
+	unsigned int frameSeq = 0;
+	unsigned int played = 0;
+	unsigned int concealed = 0;
+	unsigned int stretches = 0;
+
+	const quint64 end = t.arrivals.back().uiArrival + 200000;
+	for (quint64 now = t.arrivals.front().uiArrival; now < end; now += uiFrameLength) {
+		for (; (next < t.arrivals.size()) && (t.arrivals[next].uiArrival <= now); ++next) {
+			VoicePacket vp;
+			vp.iSeq = t.arrivals[next].iSeq;
+			vp.uiArrival = t.arrivals[next].uiArrival;
+			vp.iSamples = iFramesPerPacket * iFrameSize;
+			vp.iSize = 1;
+			vp.cData[0] = 0;
+			pb.put(vp);
+		}
+
+		pending -= std::min(pending, iFrameSize);
+		while (pending < iFrameSize) {
+			if (! pb.ready(now) && (++missCount < 20)) {
+				pending += iFrameSize;
+				continue;
+			}
+			const bool starting = ! pb.started();
+
+			if (! framesLeft) {
+				const VoicePacket *vp = pb.get(now);
+				if (! vp) {
+					// Running out at the end of the trace isn't a glitch.
+					if (pb.started() && (next < t.arrivals.size()))
+						++concealed;
+					pending += iFrameSize;
+					continue;
+				}
+				framesLeft = vp->iSamples / iFrameSize;
+				frameSeq = vp->iSeq;
+			}
+
+			for (unsigned int i = 0; i < iFrameSize; ++i)
+				buffer[i] = vVoice[(frameSeq * iFrameSize + i) % iSampleRate];
+
+			float pow = 0.0f;
+			for (unsigned int i = 0; i < iFrameSize; ++i)
+				pow += buffer[i] * buffer[i];
+			const bool quiet = (pow < 1e-4f * iFrameSize);
+
+			unsigned int n = iFrameSize;
+			const PlayoutBuffer::Adjustment adj = starting ? PlayoutBuffer::Keep : pb.adjustment(quiet);
+			if (adj != PlayoutBuffer::Keep) {
+				const unsigned int minLag = iSampleRate / 400;
+				const unsigned int maxLag = (iSampleRate * 3) / 200;
+				n = (adj == PlayoutBuffer::Shorten) ? TimeStretch::shorten(&buffer[0], n, minLag, maxLag) : TimeStretch::lengthen(&buffer[0], n, minLag, maxLag);
+				if (n != iFrameSize) {
+					pb.stretched(static_cast<int>(n) - static_cast<int>(iFrameSize));
+					++stretches;
+				}
+			}
+
+			// The frame starts playing once what is already queued
+			// has played.
+			const quint64 playTime = now + (static_cast<quint64>(pending) * 1000000ULL) / iSampleRate;
+			latencies.push_back(static_cast<double>(playTime - frameSeq * uiFrameLength) / 1000.0);
+
+			++played;
+			++frameSeq;
+			--framesLeft;
+			pending += n;
+		}
+	}
+
+	Result r;
+	std::sort(latencies.begin(), latencies.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < latencies.size(); ++i)
+		sum += latencies[i];
+	r.dMeanLatency = latencies.empty() ? 0.0 : sum / static_cast<double>(latencies.size());
+	r.dHighLatency = latencies.empty() ? 0.0 : latencies[(latencies.size() * 95) / 100];
+	r.dGlitchRate = 100.0 * concealed / std::max(played + concealed, 1U);
+	r.dStretchRate = 100.0 * stretches / std::max(played, 1U);
+	return r;
+}
+
+int main(int argc, char **argv) {
+	std::vector<Trace> traces;
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; ++i) {
+			Trace t;
+			if (! load(argv[i], t)) {
+				fprintf(stderr, "Failed to read trace %s\n", argv[i]);
+				return 1;
+			}
+			traces.push_back(t);
+		}
+	} else {
+		traces.push_back(synthesize("steady", 0.0, Steady()));
+		traces.push_back(synthesize("spikes", 0.01, Spikes()));
+		traces.push_back(synthesize("congested", 0.005, Congested()));
+	}
+
+	const float percentiles[] = { 50.0f, 80.0f, 90.0f, 95.0f, 99.0f };
+
+	printf("%-16s %6s %12s %12s %10s %10s\n", "trace", "pct", "mean ms", "95% ms", "glitch %", "stretch %");
+	for (size_t t = 0; t < traces.size(); ++t) {
+		for (size_t p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); ++p) {
+			const Result r = simulate(traces[t], percentiles[p]);
+			printf("%-16s %6.0f %12.1f %12.1f %10.2f %10.2f\n", traces[t].name, percentiles[p], r.dMeanLatency, r.dHighLatency, r.dGlitchRate, r.dStretchRate);
+		}
+	}
+
+	return 0;
+}
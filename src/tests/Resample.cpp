@@ -1,122 +1,220 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
 /**
- * Speex resampling test / information.
+ * Compares Resampler with the speex resampler it replaces, for the
+ * conversions the client does most.
+ *
+ * Usage: Resample [quality...]
+ *
+ * For each conversion and quality (3, the one the client uses, by
+ * default), it reports:
+ *  - the time it takes to resample a 10 ms mono frame,
+ *  - the worst SNR of a set of tones spread over the passband, where
+ *    everything but the tone (aliases, images, noise) counts as noise,
+ *  - the passband ripple, the difference between the largest and the
+ *    smallest gain of those tones.
+ * The passband is taken to end at 80% of the lower Nyquist frequency.
  */
 
 #define _USE_MATH_DEFINES
 #include <cmath>
-#include <QtCore>
-#include <ipp.h>
-#include <windows.h>
-#include "Timer.h"
-
-#define ITER 1000
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
 
 #include <speex/speex_resampler.h>
 
-int main(int argc, char **argv) {
-	ippStaticInit();
-	ippSetNumThreads(1);
-
-#ifdef Q_OS_WIN
-	if (!SetPriorityClass(GetCurrentProcess(),HIGH_PRIORITY_CLASS))
-		qWarning("Application: Failed to set priority!");
-#endif
-
-	QCoreApplication a(argc, argv);
-
-	SpeexResamplerState *srs;
-
-	int iMicFreq = 44100;
-	int iSampleRate = 48000;
-	int iFrameSize = iSampleRate / 100;
-	int err = 0;
-
-	srs = speex_resampler_init(1, iMicFreq, iSampleRate, 3, &err);
-
-	int iMicLength = (iFrameSize * iMicFreq) / iSampleRate;
-
-	qWarning() << iMicFreq << iSampleRate << iFrameSize << iMicLength;
+#include "AudioMix.h"
+#include "Resampler.h"
+#include "Timer.h"
 
-	float *pfInput = new float[iMicLength];
-	float *pfOutput = new float[iFrameSize];
+static const unsigned int iIterations = 2000;
+static const unsigned int iTones = 12;
+static const double dAmplitude = 0.5;
+
+struct Conversion {
+	unsigned int iIn;
+	unsigned int iOut;
+};
+
+static const Conversion cConversions[] = {
+	{ 44100, 48000 },
+	{ 48000, 44100 },
+	{ 16000, 48000 },
+	{ 48000, 96000 },
+};
+
+// Both resamplers behind one interface, so that they are measured the
+// same way.
+class Engine {
+	public:
+		virtual ~Engine() {}
+		virtual const char *name() const = 0;
+		virtual void process(const float *in, unsigned int &inlen, float *out, unsigned int &outlen) = 0;
+};
+
+class SpeexEngine : public Engine {
+	protected:
+		SpeexResamplerState *srs;
+	public:
+		SpeexEngine(unsigned int in, unsigned int out, int quality) {
+			int err;
+			srs = speex_resampler_init(1, in, out, quality, &err);
+		}
+		~SpeexEngine() {
+			speex_resampler_destroy(srs);
+		}
+		const char *name() const {
+			return "speex";
+		}
+		void process(const float *in, unsigned int &inlen, float *out, unsigned int &outlen) {
+			spx_uint32_t il = inlen;
+			spx_uint32_t ol = outlen;
+			speex_resampler_process_float(srs, 0, in, &il, out, &ol);
+			inlen = il;
+			outlen = ol;
+		}
+};
+
+class ResamplerEngine : public Engine {
+	protected:
+		Resampler r;
+	public:
+		ResamplerEngine(unsigned int in, unsigned int out, int quality) : r(1, in, out, quality) {}
+		const char *name() const {
+			return AudioMix::implementation();
+		}
+		void process(const float *in, unsigned int &inlen, float *out, unsigned int &outlen) {
+			r.process(in, inlen, out, outlen);
+		}
+};
+
+static Engine *create(bool speex, const Conversion &c, int quality) {
+	if (speex)
+		return new SpeexEngine(c.iIn, c.iOut, quality);
+	return new ResamplerEngine(c.iIn, c.iOut, quality);
+}
 
-	for (int i=0;i<iMicLength;++i) {
-		pfInput[i] = sinf((M_PI * i * 20) / iMicLength);
+// Microseconds per 10 ms frame.
+static double throughput(Engine *e, const Conversion &c) {
+	const unsigned int inFrame = c.iIn / 100;
+	const unsigned int outFrame = c.iOut / 100;
+	std::vector<float> in(inFrame);
+	std::vector<float> out(outFrame + 1);
+	for (unsigned int i = 0; i < inFrame; ++i)
+		in[i] = static_cast<float>(dAmplitude * sin(2.0 * M_PI * 440.0 * i / c.iIn));
+
+	// Warm up the caches and branch predictors first.
+	for (unsigned int i = 0; i < iIterations / 10; ++i) {
+		unsigned int inlen = inFrame;
+		unsigned int outlen = outFrame + 1;
+		e->process(&in[0], inlen, &out[0], outlen);
 	}
 
-	for (int i=0;i<iFrameSize;++i)
-		pfOutput[i] = 0;
-
-	qWarning() << "speex resampler latency: " << speex_resampler_get_input_latency(srs);
-
-
 	Timer t;
-
-	for (int i=0;i<ITER;++i) {
-		spx_uint32_t inlen = iMicLength;
-		spx_uint32_t outlen = iFrameSize;
-		speex_resampler_process_float(srs, 0, pfInput, &inlen, pfOutput, &outlen);
+	for (unsigned int i = 0; i < iIterations; ++i) {
+		unsigned int inlen = inFrame;
+		unsigned int outlen = outFrame + 1;
+		e->process(&in[0], inlen, &out[0], outlen);
 	}
+	return static_cast<double>(t.elapsed()) / iIterations;
+}
 
-	quint64 e = t.elapsed();
-
-	qWarning() << "speex us per iteration: " << (e / ITER);
-
-	float min = 0.0;
-	float max = 0.0;
-
-	for (int i=0;i<iFrameSize;++i) {
-		min = qMin(min, pfOutput[i]);
-		max = qMax(max, pfOutput[i]);
+// Resamples one second of a tone at freq Hz in 10 ms frames, and fits a
+// tone of the same frequency to the output by least squares. Returns
+// the gain of the fitted tone, and the ratio of its power to that of
+// what is left.
+static void tone(Engine *e, const Conversion &c, double freq, double &gain, double &snr) {
+	const unsigned int inFrame = c.iIn / 100;
+	std::vector<float> in(c.iIn);
+	std::vector<float> out(c.iOut + c.iOut / 100);
+	for (unsigned int i = 0; i < c.iIn; ++i)
+		in[i] = static_cast<float>(dAmplitude * sin(2.0 * M_PI * freq * i / c.iIn));
+
+	unsigned int consumed = 0;
+	unsigned int produced = 0;
+	while (consumed < c.iIn) {
+		unsigned int inlen = std::min(inFrame, c.iIn - consumed);
+		unsigned int outlen = static_cast<unsigned int>(out.size()) - produced;
+		e->process(&in[consumed], inlen, &out[produced], outlen);
+		consumed += inlen;
+		produced += outlen;
 	}
 
-	qWarning() << "Speex bounds" << min << max;
-
-	delete [] pfOutput;
-
-	int history=24;
-	int lastread = history;
-	double time = history;
-	int olen = 0;
-
-	float *inBuf = ippsMalloc_32f(iMicLength+history*2+2);
-	ippsZero_32f(inBuf, iMicLength+history*2+2);
-
-	pfOutput = ippsMalloc_32f(iFrameSize+2);
-
-	for (int i=0;i<iFrameSize;++i)
-		pfOutput[i] = 0;
-
-
-	IppsResamplingPolyphaseFixed_32f *pSpec = NULL;
-	ippsResamplePolyphaseFixedInitAlloc_32f(&pSpec, iMicFreq, iSampleRate, 2*history, 0.90f, 8.0f, ippAlgHintFast);
-
-	t.restart();
-
-	for (int i=0;i<ITER;++i) {
-		ippsCopy_32f(pfInput, inBuf + history, iMicLength);
-
-		ippsResamplePolyphaseFixed_32f(pSpec, inBuf, iMicLength, pfOutput, .99f, &time, &olen);
-
-		time -= iMicLength;
-
-		ippsMove_32f(inBuf + history, inBuf, history);
+	// Skip the start, where the filter is still filling.
+	const unsigned int first = c.iOut / 20;
+	double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+	for (unsigned int k = first; k < produced; ++k) {
+		const double t = 2.0 * M_PI * freq * k / c.iOut;
+		const double s = sin(t);
+		const double co = cos(t);
+		ss += s * s;
+		cc += co * co;
+		sc += s * co;
+		ys += out[k] * s;
+		yc += out[k] * co;
+	}
+	const double det = ss * cc - sc * sc;
+	const double a = (ys * cc - yc * sc) / det;
+	const double b = (yc * ss - ys * sc) / det;
+
+	double signal = 0.0;
+	double noise = 0.0;
+	for (unsigned int k = first; k < produced; ++k) {
+		const double t = 2.0 * M_PI * freq * k / c.iOut;
+		const double fit = a * sin(t) + b * cos(t);
+		signal += fit * fit;
+		noise += (out[k] - fit) * (out[k] - fit);
 	}
 
-	e = t.elapsed();
-	qWarning() << "ipp us per iteration: " << (e / ITER);
-
-	min = 0.0;
-	max = 0.0;
+	gain = 20.0 * log10(sqrt(a * a + b * b) / dAmplitude);
+	snr = 10.0 * log10(signal / std::max(noise, 1e-30));
+}
 
-	for (int i=0;i<iFrameSize;++i) {
-		min = qMin(min, pfOutput[i]);
-		max = qMax(max, pfOutput[i]);
+static void measure(bool speex, const Conversion &c, int quality) {
+	Engine *e = create(speex, c, quality);
+	const char *name = e->name();
+	const double usec = throughput(e, c);
+	delete e;
+
+	const double top = 0.8 * std::min(c.iIn, c.iOut) / 2.0;
+	double minSnr = 1e9;
+	double minGain = 1e9;
+	double maxGain = -1e9;
+	for (unsigned int i = 0; i < iTones; ++i) {
+		// Spread logarithmically from 100 Hz to the top of the passband.
+		const double freq = 100.0 * pow(top / 100.0, static_cast<double>(i) / (iTones - 1));
+		double gain, snr;
+		e = create(speex, c, quality);
+		tone(e, c, freq, gain, snr);
+		delete e;
+		minSnr = std::min(minSnr, snr);
+		minGain = std::min(minGain, gain);
+		maxGain = std::max(maxGain, gain);
 	}
 
-	qWarning() << "IPP bounds" << min << max;
+	printf("%6u -> %-6u %4d %-8s %10.2f %10.1f %10.1f %12.4f\n", c.iIn, c.iOut, quality, name, usec, 10000.0 / usec, minSnr, maxGain - minGain);
+}
 
-	delete [] pfInput;
+int main(int argc, char **argv) {
+	std::vector<int> qualities;
+	for (int i = 1; i < argc; ++i)
+		qualities.push_back(atoi(argv[i]));
+	if (qualities.empty())
+		qualities.push_back(3);
+
+	printf("Resampler kernels: %s\n\n", AudioMix::implementation());
+	printf("%-16s %4s %-8s %10s %10s %10s %12s\n", "conversion", "q", "engine", "us/frame", "realtime", "min SNR dB", "ripple dB");
+	for (size_t q = 0; q < qualities.size(); ++q) {
+		for (size_t c = 0; c < sizeof(cConversions) / sizeof(cConversions[0]); ++c) {
+			measure(true, cConversions[c], qualities[q]);
+			measure(false, cConversions[c], qualities[q]);
+		}
+	}
 
 	return 0;
 }
@@ -1,24 +1,19 @@
 include(../../compiler.pri)
+
 TEMPLATE = app
-CONFIG += qt thread warn_on release qtestlib no_keywords console
+CONFIG += qt thread warn_on release console
 CONFIG -= app_bundle
+QT += network sql svg xml
+isEqual(QT_MAJOR_VERSION, 5) {
+  QT *= widgets
+}
 LANGUAGE = C++
 TARGET = Resample
-SOURCES = Resample.cpp Timer.cpp
-HEADERS = Timer.h
-VPATH += ..
-INCLUDEPATH	*= .. ../../3rdparty/speex-src/include ../../3rdparty/speex-src/libspeex ../../3rdparty/speex-build
-LIBS 		*= -lspeex
-
-win32 {
-  CONFIG(intelcpp) {
-    LIBS	*= -l"\Program Files (x86)\Intel/Compiler\11.0\075\cpp\ipp\ia32\lib\ippsemerged"
-    LIBS	*= -l"\Program Files (x86)\Intel/Compiler\11.0\075\cpp\ipp\ia32\lib\ippsmerged"
-    LIBS	*= -l"\Program Files (x86)\Intel/Compiler\11.0\075\cpp\ipp\ia32\lib\ippsremerged"
-    LIBS	*= -l"\Program Files (x86)\Intel/Compiler\11.0\075\cpp\ipp\ia32\lib\ippsrmerged"
-    LIBS	*= -l"\Program Files (x86)\Intel/Compiler\11.0\075\cpp\ipp\ia32\lib\ippcorel"
-  }
-}
+HEADERS = Timer.h AudioMix.h Resampler.h
+SOURCES = Resample.cpp Timer.cpp AudioMix.cpp Resampler.cpp
+VPATH += .. ../mumble
+INCLUDEPATH *= .. ../mumble ../../3rdparty/celt-0.7.0-src/libcelt ../../3rdparty/speex-src/include ../../3rdparty/speex-src/libspeex ../../3rdparty/speex-build ../../3rdparty/speexdsp-src/include
+LIBS *= -lspeex
 
 CONFIG(debug, debug|release) {
   QMAKE_LIBDIR += ../../debug
@@ -0,0 +1,286 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "AudioMix.h"
+
+// Length of a 10ms callback at 48kHz.
+static const unsigned int iFrame = 480;
+
+class TestAudioMix : public QObject {
+		Q_OBJECT
+	private:
+		QVector<float> qvSource;
+		static float sample(unsigned int i);
+	private slots:
+		void initTestCase();
+		void add();
+		void addRamp();
+		void interleave();
+		void clip();
+		void toShort();
+		void toShortPower();
+		void power();
+		void dot();
+		void benchmarkPlain_data();
+		void benchmarkPlain();
+		void benchmarkKernels_data();
+		void benchmarkKernels();
+		void benchmarkCapturePlain();
+		void benchmarkCaptureKernels();
+};
+
+// A deterministic signal that goes past full scale.
+float TestAudioMix::sample(unsigned int i) {
+	return static_cast<float>((i * 7919) % 2001) / 800.0f - 1.25f;
+}
+
+void TestAudioMix::initTestCase() {
+	qWarning("Using %s kernels", AudioMix::implementation());
+
+	qvSource.resize(iFrame * 8);
+	for (int i = 0; i < qvSource.size(); ++i)
+		qvSource[i] = sample(i);
+}
+
+// All lengths up to a few vectors, to cover the partial vectors at
+// the end.
+
+void TestAudioMix::add() {
+	for (unsigned int n = 0; n < 67; ++n) {
+		QVector<float> dst(n), expected(n);
+		for (unsigned int i = 0; i < n; ++i)
+			dst[i] = expected[i] = sample(i + 13);
+
+		AudioMix::add(dst.data(), qvSource.constData(), n, 0.3f);
+		for (unsigned int i = 0; i < n; ++i)
+			expected[i] += qvSource[i] * 0.3f;
+
+		for (unsigned int i = 0; i < n; ++i)
+			QVERIFY(qAbs(dst[i] - expected[i]) < 1e-6f);
+	}
+}
+
+void TestAudioMix::addRamp() {
+	for (unsigned int n = 0; n < 67; ++n) {
+		QVector<float> dst(n), expected(n);
+		for (unsigned int i = 0; i < n; ++i)
+			dst[i] = expected[i] = sample(i + 13);
+
+		AudioMix::addRamp(dst.data(), qvSource.constData(), n, 0.8f, -0.01f);
+		for (unsigned int i = 0; i < n; ++i)
+			expected[i] += qvSource[i] * (0.8f - 0.01f * static_cast<float>(i));
+
+		for (unsigned int i = 0; i < n; ++i)
+			QVERIFY(qAbs(dst[i] - expected[i]) < 1e-6f);
+	}
+}
+
+void TestAudioMix::interleave() {
+	for (unsigned int nchan = 1; nchan <= 8; ++nchan) {
+		for (unsigned int n = 0; n < 37; ++n) {
+			QVector<float> dst(n * nchan);
+			AudioMix::interleave(dst.data(), qvSource.constData(), nchan, n);
+			for (unsigned int i = 0; i < n; ++i)
+				for (unsigned int s = 0; s < nchan; ++s)
+					QCOMPARE(dst[i * nchan + s], qvSource[s * n + i]);
+		}
+	}
+}
+
+void TestAudioMix::clip() {
+	for (unsigned int n = 0; n < 67; ++n) {
+		QVector<float> buf = qvSource.mid(0, n);
+		AudioMix::clip(buf.data(), n);
+		for (unsigned int i = 0; i < n; ++i)
+			QCOMPARE(buf[i], qBound(-1.0f, qvSource[i], 1.0f));
+	}
+}
+
+void TestAudioMix::toShort() {
+	for (unsigned int n = 0; n < 67; ++n) {
+		QVector<short> dst(n);
+		AudioMix::toShort(dst.data(), qvSource.constData(), n);
+		for (unsigned int i = 0; i < n; ++i)
+			QCOMPARE(dst[i], static_cast<short>(qBound(-32768.f, (qvSource[i] * 32768.f), 32767.f)));
+	}
+
+	short s;
+	const float full[3] = { 1.0f, -1.0f, 0.0f };
+	const short expected[3] = { 32767, -32768, 0 };
+	for (int i = 0; i < 3; ++i) {
+		AudioMix::toShort(&s, &full[i], 1);
+		QCOMPARE(s, expected[i]);
+	}
+}
+
+// The sums are added up in a different order, so they may differ in
+// the last bits.
+static bool closeTo(float a, float b) {
+	return qAbs(a - b) <= 1e-5f * qMax(qAbs(b), 1.0f);
+}
+
+void TestAudioMix::toShortPower() {
+	for (unsigned int n = 0; n < 67; ++n) {
+		QVector<short> dst(n);
+		float peak = -1.0f;
+		const float sum = AudioMix::toShortPower(dst.data(), qvSource.constData(), n, peak);
+
+		float expectedSum = 0.0f, expectedPeak = 0.0f;
+		for (unsigned int i = 0; i < n; ++i) {
+			const float v = qBound(-32768.f, (qvSource[i] * 32768.f), 32767.f);
+			QCOMPARE(dst[i], static_cast<short>(v));
+			expectedSum += v * v;
+			expectedPeak = qMax(expectedPeak, qAbs(v));
+		}
+		QVERIFY(closeTo(sum, expectedSum));
+		QCOMPARE(peak, expectedPeak);
+	}
+}
+
+void TestAudioMix::power() {
+	QVector<short> src(67);
+	for (int i = 0; i < src.size(); ++i)
+		src[i] = static_cast<short>(qBound(-32768.f, (qvSource[i] * 32768.f), 32767.f));
+
+	for (unsigned int n = 0; n < 67; ++n) {
+		float peak = -1.0f;
+		const float sum = AudioMix::power(src.constData(), n, peak);
+
+		float expectedSum = 0.0f, expectedPeak = 0.0f;
+		for (unsigned int i = 0; i < n; ++i) {
+			const float v = static_cast<float>(src[i]);
+			expectedSum += v * v;
+			expectedPeak = qMax(expectedPeak, qAbs(v));
+		}
+		QVERIFY(closeTo(sum, expectedSum));
+		QCOMPARE(peak, expectedPeak);
+	}
+
+	// Full scale doesn't overflow.
+	const short full[8] = { -32768, -32768, -32768, -32768, -32768, -32768, -32768, -32768 };
+	float peak;
+	QCOMPARE(AudioMix::power(full, 8, peak), 8.0f * 32768.0f * 32768.0f);
+	QCOMPARE(peak, 32768.0f);
+}
+
+void TestAudioMix::dot() {
+	for (unsigned int n = 0; n < 67; ++n) {
+		float expected = 0.0f;
+		for (unsigned int i = 0; i < n; ++i)
+			expected += qvSource[i] * qvSource[i + 101];
+		QVERIFY(closeTo(AudioMix::dot(qvSource.constData(), qvSource.constData() + 101, n), expected));
+	}
+}
+
+static void benchmarkData() {
+	QTest::addColumn<int>("speakers");
+	QTest::addColumn<int>("channels");
+
+	QTest::newRow("1 speaker, stereo") << 1 << 2;
+	QTest::newRow("20 speakers, stereo") << 20 << 2;
+	QTest::newRow("20 speakers, 7.1") << 20 << 8;
+}
+
+void TestAudioMix::benchmarkPlain_data() {
+	benchmarkData();
+}
+
+// What AudioOutput::mix() used to do: mix every speaker into the
+// interleaved buffer one channel at a time, then clip.
+void TestAudioMix::benchmarkPlain() {
+	QFETCH(int, speakers);
+	QFETCH(int, channels);
+
+	const unsigned int nchan = channels;
+	QVector<float> output(iFrame * nchan);
+	QVector<short> out(iFrame * nchan);
+
+	QBENCHMARK {
+		memset(output.data(), 0, sizeof(float) * iFrame * nchan);
+		for (int u = 0; u < speakers; ++u) {
+			const float *pfBuffer = qvSource.constData() + (u % 8) * iFrame;
+			for (unsigned int s = 0; s < nchan; ++s) {
+				const float old = 0.5f;
+				const float inc = 0.1f / static_cast<float>(iFrame);
+				float *o = output.data() + s;
+				for (unsigned int i = 0; i < iFrame; ++i)
+					o[i * nchan] += pfBuffer[i] * (old + inc * static_cast<float>(i));
+			}
+		}
+		for (unsigned int i = 0; i < iFrame * nchan; ++i)
+			out[i] = static_cast<short>(qBound(-32768.f, (output[i] * 32768.f), 32767.f));
+	}
+}
+
+void TestAudioMix::benchmarkKernels_data() {
+	benchmarkData();
+}
+
+// What AudioOutput::mix() does now.
+void TestAudioMix::benchmarkKernels() {
+	QFETCH(int, speakers);
+	QFETCH(int, channels);
+
+	const unsigned int nchan = channels;
+	QVector<float> planar(iFrame * nchan);
+	QVector<float> output(iFrame * nchan);
+	QVector<short> out(iFrame * nchan);
+
+	QBENCHMARK {
+		memset(planar.data(), 0, sizeof(float) * iFrame * nchan);
+		for (int u = 0; u < speakers; ++u) {
+			const float *pfBuffer = qvSource.constData() + (u % 8) * iFrame;
+			for (unsigned int s = 0; s < nchan; ++s)
+				AudioMix::addRamp(planar.data() + s * iFrame, pfBuffer, iFrame, 0.5f, 0.1f / static_cast<float>(iFrame));
+		}
+		AudioMix::interleave(output.data(), planar.constData(), nchan, iFrame);
+		AudioMix::toShort(out.data(), output.constData(), iFrame * nchan);
+	}
+}
+
+// What AudioInput used to do with a 10ms microphone frame: convert it,
+// then measure it, and measure it again after preprocessing.
+void TestAudioMix::benchmarkCapturePlain() {
+	QVector<short> mic(iFrame);
+	float level = 0.0f;
+
+	QBENCHMARK {
+		for (unsigned int i = 0; i < iFrame; ++i)
+			mic[i] = static_cast<short>(qBound(-32768.f, (qvSource[i] * 32768.f), 32767.f));
+
+		float sum = 1.0f;
+		short max = 1;
+		for (unsigned int i = 0; i < iFrame; ++i) {
+			sum += static_cast<float>(mic[i] * mic[i]);
+			max = std::max(static_cast<short>(abs(mic[i])), max);
+		}
+		level += sum + max;
+
+		sum = 1.0f;
+		for (unsigned int i = 0; i < iFrame; ++i)
+			sum += static_cast<float>(mic[i] * mic[i]);
+		level += sum;
+	}
+	QVERIFY(level > 0.0f);
+}
+
+// What AudioInput does now.
+void TestAudioMix::benchmarkCaptureKernels() {
+	QVector<short> mic(iFrame);
+	float level = 0.0f;
+
+	QBENCHMARK {
+		float peak;
+		level += AudioMix::toShortPower(mic.data(), qvSource.constData(), iFrame, peak) + peak;
+		level += AudioMix::power(mic.constData(), iFrame, peak);
+	}
+	QVERIFY(level > 0.0f);
+}
+
+QTEST_MAIN(TestAudioMix)
+#include "TestAudioMix.moc"
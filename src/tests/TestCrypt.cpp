@@ -12,6 +12,7 @@ class TestCrypt : public QObject {
 		void ivrecovery();
 		void reverserecovery();
 		void tamper();
+		void inplace();
 };
 
 void TestCrypt::reverserecovery() {
@@ -202,5 +203,34 @@ void TestCrypt::tamper() {
 	QVERIFY(cs.decrypt(encrypted, decrypted, len+4));
 }
 
+// Decrypting into the buffer the packet came in gives the same result.
+void TestCrypt::inplace() {
+	const unsigned char rawkey[AES_BLOCK_SIZE] = {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f};
+	const unsigned char nonce[AES_BLOCK_SIZE] = {0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x00};
+	CryptState enc, dec;
+	enc.setKey(rawkey, nonce, nonce);
+	dec.setKey(rawkey, nonce, nonce);
+
+	for (int len=1;len<128;len++) {
+		unsigned char src[len];
+		for (int i=0;i<len;i++)
+			src[i] = (i + 1);
+
+		unsigned char buffer[len+4];
+		enc.encrypt(src, buffer, len);
+		QVERIFY(dec.decrypt(buffer, buffer, len+4));
+		for (int i=0;i<len;i++)
+			QCOMPARE(buffer[i], src[i]);
+	}
+
+	// Tampered packets are still caught.
+	const unsigned char msg[] = "It was a funky funky town!";
+	int len = sizeof(msg);
+	unsigned char buffer[len+4];
+	enc.encrypt(msg, buffer, len);
+	buffer[len] ^= 1;
+	QVERIFY(! dec.decrypt(buffer, buffer, len+4));
+}
+
 QTEST_MAIN(TestCrypt)
 #include "TestCrypt.moc"
@@ -0,0 +1,129 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "HTMLFilter.h"
+
+class TestHTMLFilter : public QObject {
+		Q_OBJECT
+	private:
+		static QString imageMessage(int size);
+		static int xmlLength(const QString &text);
+	private slots:
+		void measure_data();
+		void measure();
+		void benchmarkXML_data();
+		void benchmarkXML();
+		void benchmarkMeasure_data();
+		void benchmarkMeasure();
+};
+
+/// Returns a text message with an inline image of about size bytes,
+/// like the ones the client sends.
+QString TestHTMLFilter::imageMessage(int size) {
+	QByteArray qba(size * 3 / 4, '\0');
+	for (int i = 0; i < qba.size(); ++i)
+		qba[i] = static_cast<char>(qrand());
+	return QString::fromLatin1("<p>Look at this: <img src=\"data:image/jpeg;base64,%1\" /></p>").arg(QString::fromLatin1(qba.toBase64()));
+}
+
+/// The length Server::isTextAllowed() used to measure, by writing the
+/// message again without the src attributes of its images.
+int TestHTMLFilter::xmlLength(const QString &text) {
+	QString qsOut;
+	QXmlStreamReader qxsr(QString::fromLatin1("<document>%1</document>").arg(text));
+	QXmlStreamWriter qxsw(&qsOut);
+	while (! qxsr.atEnd()) {
+		switch (qxsr.readNext()) {
+			case QXmlStreamReader::Invalid:
+				return -1;
+			case QXmlStreamReader::StartElement: {
+					if (qxsr.name() == QLatin1String("img")) {
+						qxsw.writeStartElement(qxsr.namespaceUri().toString(), qxsr.name().toString());
+						foreach(const QXmlStreamAttribute &a, qxsr.attributes())
+							if (a.name() != QLatin1String("src"))
+								qxsw.writeAttribute(a);
+					} else {
+						qxsw.writeCurrentToken(qxsr);
+					}
+				}
+				break;
+			default:
+				qxsw.writeCurrentToken(qxsr);
+				break;
+		}
+	}
+	return qsOut.length();
+}
+
+void TestHTMLFilter::measure_data() {
+	QTest::addColumn<QString>("text");
+	QTest::addColumn<bool>("valid");
+	QTest::addColumn<int>("textLength");
+	QTest::addColumn<int>("imageLength");
+
+	QTest::newRow("plain") << QString::fromLatin1("hello") << true << 5 << 0;
+	QTest::newRow("element") << QString::fromLatin1("<b>x</b>") << true << 8 << 0;
+	QTest::newRow("mismatch") << QString::fromLatin1("<b>x</i>") << false << 0 << 0;
+	QTest::newRow("unclosed") << QString::fromLatin1("<a href=\"x\">") << false << 0 << 0;
+	QTest::newRow("image") << QString::fromLatin1("<img src=\"data:abc\" />") << true << 7 << 8;
+	QTest::newRow("attributes") << QString::fromLatin1("<p><img alt='a' src=\"data:abcdef\"/>hi</p>") << true << 23 << 11;
+	QTest::newRow("not an image") << QString::fromLatin1("<a src=\"xyz\"/>") << true << 14 << 0;
+	QTest::newRow("entities") << QString::fromLatin1("a &amp; b &#x41; &#65;") << true << 22 << 0;
+	QTest::newRow("undeclared entity") << QString::fromLatin1("a &nbsp; b") << false << 0 << 0;
+	QTest::newRow("bare ampersand") << QString::fromLatin1("a & b") << false << 0 << 0;
+	QTest::newRow("comment") << QString::fromLatin1("<!-- <b> --><br/>") << true << 17 << 0;
+	QTest::newRow("cdata") << QString::fromLatin1("<![CDATA[<b>]]>") << true << 15 << 0;
+	QTest::newRow("lt in attribute") << QString::fromLatin1("<img src=\"a<\"/>") << false << 0 << 0;
+	QTest::newRow("attribute spacing") << QString::fromLatin1("<a b='1'c='2'/>") << false << 0 << 0;
+}
+
+void TestHTMLFilter::measure() {
+	QFETCH(QString, text);
+	QFETCH(bool, valid);
+	QFETCH(int, textLength);
+	QFETCH(int, imageLength);
+
+	int tl, il;
+	QCOMPARE(HTMLFilter::measure(text, tl, il), valid);
+	if (valid) {
+		QCOMPARE(tl, textLength);
+		QCOMPARE(il, imageLength);
+	}
+}
+
+void TestHTMLFilter::benchmarkXML_data() {
+	QTest::addColumn<QString>("text");
+	QTest::newRow("16KiB") << imageMessage(16 * 1024);
+	QTest::newRow("1MiB") << imageMessage(1024 * 1024);
+}
+
+void TestHTMLFilter::benchmarkXML() {
+	QFETCH(QString, text);
+	int length = 0;
+	QBENCHMARK {
+		length = xmlLength(text);
+	}
+	QVERIFY(length > 0);
+}
+
+void TestHTMLFilter::benchmarkMeasure_data() {
+	benchmarkXML_data();
+}
+
+void TestHTMLFilter::benchmarkMeasure() {
+	QFETCH(QString, text);
+	int length = 0, imageLength = 0;
+	QBENCHMARK {
+		QVERIFY(HTMLFilter::measure(text, length, imageLength));
+	}
+	QVERIFY(length < 64);
+	QVERIFY(imageLength > text.length() - 64);
+}
+
+QTEST_MAIN(TestHTMLFilter)
+#include "TestHTMLFilter.moc"
@@ -0,0 +1,10 @@
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib
+CONFIG -= app_bundle
+QT += network sql xml
+LANGUAGE = C++
+TARGET = TestHTMLFilter
+SOURCES = TestHTMLFilter.cpp HTMLFilter.cpp
+HEADERS = HTMLFilter.h
+VPATH += ..
+INCLUDEPATH += .. ../murmur
@@ -0,0 +1,88 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "LatencyProbe.h"
+
+// Frames of 10 ms.
+static const unsigned int iFrame = LatencyProbe::iRate / 100;
+
+class TestLatencyProbe : public QObject {
+		Q_OBJECT
+	private:
+		static void run(LatencyProbe &lp, unsigned int frames, bool send);
+	private slots:
+		void burst();
+		void stages();
+		void order();
+};
+
+// Plays frames frames of the test signal back right away, as the audio
+// path would with a zero latency, in packets of two frames. Without
+// send, the packets are never reported as sent.
+void TestLatencyProbe::run(LatencyProbe &lp, unsigned int frames, bool send) {
+	QVector<float> packet(2 * iFrame);
+	for (unsigned int seq = 0; seq < frames; ++seq) {
+		float *frame = packet.data() + (seq % 2) * iFrame;
+		lp.capture(frame, iFrame);
+		lp.framed(iFrame);
+		lp.preprocessed(seq);
+		if (seq % 2 == 0)
+			continue;
+
+		const unsigned int first = seq - 1;
+		if (send)
+			lp.sent(first, 2);
+		lp.received(first, 2);
+		lp.dequeued(first, 2);
+		lp.decoded(first, 1);
+		lp.decoded(seq, 1);
+		lp.played(packet.constData(), 2 * iFrame, 1);
+	}
+}
+
+// Silence, but for a burst after the first second.
+void TestLatencyProbe::burst() {
+	LatencyProbe lp(3);
+	QVector<float> captured(2 * LatencyProbe::iRate);
+	lp.capture(captured.data(), captured.size());
+
+	unsigned int loud = 0;
+	for (int i = 0; i < captured.size(); ++i) {
+		QVERIFY(qAbs(captured[i]) <= LatencyProbe::fAmplitude);
+		if (captured[i] != 0.0f) {
+			QVERIFY(static_cast<unsigned int>(i) >= LatencyProbe::iRate);
+			QVERIFY(static_cast<unsigned int>(i) < LatencyProbe::iRate + LatencyProbe::iBurst);
+			++loud;
+		}
+	}
+	QVERIFY(loud > LatencyProbe::iBurst / 2);
+}
+
+void TestLatencyProbe::stages() {
+	LatencyProbe lp(3);
+	QVERIFY(! lp.finished());
+
+	run(lp, 300, true);
+	QVERIFY(lp.finished());
+
+	const QString report = lp.report();
+	QVERIFY(report.startsWith(QLatin1String("Mouth-to-ear latency of 3 bursts (0 lost)")));
+	foreach(const QString &stage, QStringList() << QLatin1String("framing") << QLatin1String("network") << QLatin1String("mixing") << QLatin1String("total"))
+		QVERIFY2(report.contains(stage), qPrintable(stage));
+}
+
+// A stage that is skipped holds up the ones after it.
+void TestLatencyProbe::order() {
+	LatencyProbe lp(3);
+	run(lp, 300, false);
+	QVERIFY(! lp.finished());
+	QVERIFY(lp.report().startsWith(QLatin1String("Mouth-to-ear latency of 0 bursts (0 lost)")));
+}
+
+QTEST_MAIN(TestLatencyProbe)
+#include "TestLatencyProbe.moc"
@@ -0,0 +1,15 @@
+include(../../compiler.pri)
+
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib release
+CONFIG -= app_bundle
+QT += network sql svg xml
+isEqual(QT_MAJOR_VERSION, 5) {
+  QT *= widgets
+}
+LANGUAGE = C++
+TARGET = TestLatencyProbe
+HEADERS = LatencyProbe.h Timer.h
+SOURCES = TestLatencyProbe.cpp LatencyProbe.cpp Timer.cpp
+VPATH += .. ../mumble
+INCLUDEPATH += .. ../mumble ../../3rdparty/celt-0.7.0-src/libcelt ../../3rdparty/speex-src/include ../../3rdparty/speexdsp-src/include
@@ -0,0 +1,192 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include <cstdlib>
+#include <new>
+
+#include "Message.h"
+#include "MessageCache.h"
+#include "Mumble.pb.h"
+
+// Counts heap allocations, so the tests can tell how many a parse
+// or a serialization makes.
+static QAtomicInt qaiAllocations;
+
+void *operator new(size_t size) {
+	qaiAllocations.ref();
+	void *p = malloc(size ? size : 1);
+	if (! p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw() {
+	free(p);
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete[](void *p) throw() {
+	operator delete(p);
+}
+
+static int allocations() {
+#if QT_VERSION >= 0x050000
+	return qaiAllocations.load();
+#else
+	return qaiAllocations;
+#endif
+}
+
+class TestMessageCache : public QObject {
+		Q_OBJECT
+	private:
+		QByteArray qbaUserState;
+		QByteArray qbaTextMessage;
+		static QByteArray serialize(const ::google::protobuf::Message &msg);
+	private slots:
+		void initTestCase();
+		void reuse();
+		void nested();
+		void large();
+		void benchmarkFresh();
+		void benchmarkCached();
+		void benchmarkSerializeFresh();
+		void benchmarkSerializeReused();
+};
+
+QByteArray TestMessageCache::serialize(const ::google::protobuf::Message &msg) {
+	QByteArray qba(msg.ByteSize(), '\0');
+	msg.SerializeToArray(qba.data(), qba.size());
+	return qba;
+}
+
+void TestMessageCache::initTestCase() {
+	MumbleProto::UserState mpus;
+	mpus.set_session(42);
+	mpus.set_actor(7);
+	mpus.set_name("A user with a reasonably long name");
+	mpus.set_channel_id(12);
+	mpus.set_self_mute(true);
+	mpus.set_plugin_context(std::string(64, 'c'));
+	mpus.set_plugin_identity("identity");
+	mpus.set_comment("A short comment");
+	qbaUserState = serialize(mpus);
+
+	MumbleProto::TextMessage mptm;
+	mptm.set_actor(7);
+	for (unsigned int i = 0; i < 16; ++i)
+		mptm.add_session(i);
+	mptm.add_channel_id(3);
+	mptm.set_message(std::string(512, 'x'));
+	qbaTextMessage = serialize(mptm);
+}
+
+void TestMessageCache::reuse() {
+	MessageCache<MumbleProto::UserState> mc;
+	{
+		MessageCache<MumbleProto::UserState>::Lease lease(mc, qbaUserState.size());
+		QVERIFY(lease.message().ParseFromArray(qbaUserState.constData(), qbaUserState.size()));
+	}
+
+	int before = allocations();
+	{
+		MessageCache<MumbleProto::UserState>::Lease lease(mc, qbaUserState.size());
+		QVERIFY(lease.message().ParseFromArray(qbaUserState.constData(), qbaUserState.size()));
+		QCOMPARE(lease.message().session(), 42U);
+		QCOMPARE(lease.message().channel_id(), 12U);
+	}
+	QCOMPARE(allocations() - before, 0);
+}
+
+void TestMessageCache::nested() {
+	MessageCache<MumbleProto::TextMessage> mc;
+	MessageCache<MumbleProto::TextMessage>::Lease outer(mc, qbaTextMessage.size());
+	QVERIFY(outer.message().ParseFromArray(qbaTextMessage.constData(), qbaTextMessage.size()));
+	{
+		MessageCache<MumbleProto::TextMessage>::Lease inner(mc, 0);
+		QVERIFY(&inner.message() != &outer.message());
+		QCOMPARE(inner.message().session_size(), 0);
+	}
+	QCOMPARE(outer.message().session_size(), 16);
+}
+
+void TestMessageCache::large() {
+	MessageCache<MumbleProto::TextMessage> mc;
+	MumbleProto::TextMessage *cached;
+	{
+		MessageCache<MumbleProto::TextMessage>::Lease lease(mc, MessageCache<MumbleProto::TextMessage>::iMaxSize + 1);
+		cached = &lease.message();
+		cached->set_message(std::string(MessageCache<MumbleProto::TextMessage>::iMaxSize + 1, 'x'));
+	}
+	// The large message was dropped after use.
+	QVERIFY(! cached->has_message());
+}
+
+void TestMessageCache::benchmarkFresh() {
+	int before = allocations();
+	int iterations = 0;
+	QBENCHMARK {
+		MumbleProto::UserState mpus;
+		mpus.ParseFromArray(qbaUserState.constData(), qbaUserState.size());
+		MumbleProto::TextMessage mptm;
+		mptm.ParseFromArray(qbaTextMessage.constData(), qbaTextMessage.size());
+		++iterations;
+	}
+	qWarning("%.1f allocations per iteration", static_cast<double>(allocations() - before) / iterations);
+}
+
+void TestMessageCache::benchmarkCached() {
+	MessageCache<MumbleProto::UserState> mcus;
+	MessageCache<MumbleProto::TextMessage> mctm;
+	int before = allocations();
+	int iterations = 0;
+	QBENCHMARK {
+		MessageCache<MumbleProto::UserState>::Lease us(mcus, qbaUserState.size());
+		us.message().ParseFromArray(qbaUserState.constData(), qbaUserState.size());
+		MessageCache<MumbleProto::TextMessage>::Lease tm(mctm, qbaTextMessage.size());
+		tm.message().ParseFromArray(qbaTextMessage.constData(), qbaTextMessage.size());
+		++iterations;
+	}
+	qWarning("%.1f allocations per iteration", static_cast<double>(allocations() - before) / iterations);
+}
+
+void TestMessageCache::benchmarkSerializeFresh() {
+	MumbleProto::TextMessage mptm;
+	mptm.ParseFromArray(qbaTextMessage.constData(), qbaTextMessage.size());
+	int before = allocations();
+	int iterations = 0;
+	QBENCHMARK {
+		QByteArray cache;
+		cache.resize(mptm.ByteSize() + 6);
+		mptm.SerializeToArray(cache.data() + 6, cache.size() - 6);
+		++iterations;
+	}
+	qWarning("%.1f allocations per iteration", static_cast<double>(allocations() - before) / iterations);
+}
+
+void TestMessageCache::benchmarkSerializeReused() {
+	MumbleProto::TextMessage mptm;
+	mptm.ParseFromArray(qbaTextMessage.constData(), qbaTextMessage.size());
+	QByteArray cache;
+	cache.reserve(1024);
+	int before = allocations();
+	int iterations = 0;
+	QBENCHMARK {
+		cache.resize(0);
+		cache.resize(mptm.ByteSize() + 6);
+		mptm.SerializeToArray(cache.data() + 6, cache.size() - 6);
+		++iterations;
+	}
+	qWarning("%.1f allocations per iteration", static_cast<double>(allocations() - before) / iterations);
+}
+
+QTEST_MAIN(TestMessageCache)
+#include "TestMessageCache.moc"
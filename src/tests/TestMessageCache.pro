@@ -0,0 +1,18 @@
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib release
+CONFIG -= app_bundle
+LANGUAGE = C++
+TARGET = TestMessageCache
+HEADERS = MessageCache.h Message.h
+PROTOS = Mumble.proto
+SOURCES = TestMessageCache.cpp Mumble.pb.cc
+VPATH += ..
+INCLUDEPATH += .. ../murmur ../mumble
+LIBS += -lprotobuf
+
+protoc.output = ${QMAKE_FILE_BASE}.pb.cc ${QMAKE_FILE_BASE}.pb.h
+protoc.commands = protoc -I${QMAKE_FILE_PATH} ${QMAKE_FILE_NAME} --cpp_out=.
+protoc.input = PROTOS
+protoc.CONFIG *= no_link target_predeps
+
+QMAKE_EXTRA_COMPILERS *= protoc
@@ -0,0 +1,177 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "PlayoutBuffer.h"
+#include "TimeStretch.h"
+
+// 10ms frames at 48kHz, two per packet.
+static const unsigned int iFrameSize = 480;
+static const unsigned int iSampleRate = 48000;
+static const quint64 uiFrameLength = 10000;
+
+class TestPlayoutBuffer : public QObject {
+		Q_OBJECT
+	private:
+		static bool put(PlayoutBuffer &pb, unsigned int seq, quint64 arrival);
+	private slots:
+		void reorder();
+		void late();
+		void lostAndUnderrun();
+		void start();
+		void target();
+		void stretchPeriodic();
+		void stretchNoise();
+};
+
+bool TestPlayoutBuffer::put(PlayoutBuffer &pb, unsigned int seq, quint64 arrival) {
+	VoicePacket vp;
+	vp.iSeq = seq;
+	vp.uiArrival = arrival;
+	vp.iSamples = 2 * iFrameSize;
+	vp.iSize = 1;
+	vp.cData[0] = static_cast<char>(seq);
+	return pb.put(vp);
+}
+
+void TestPlayoutBuffer::reorder() {
+	JitterHistogram jh;
+	PlayoutBuffer pb(iFrameSize, iSampleRate, &jh, 95.0f, 0);
+
+	QVERIFY(put(pb, 4, 60000));
+	QVERIFY(put(pb, 0, 61000));
+	QVERIFY(put(pb, 2, 62000));
+	QVERIFY(! put(pb, 2, 63000));
+
+	for (unsigned int seq = 0; seq <= 4; seq += 2) {
+		const VoicePacket *vp = pb.get(100000);
+		QVERIFY(vp);
+		QCOMPARE(vp->iSeq, seq);
+		QCOMPARE(vp->cData[0], static_cast<char>(seq));
+	}
+	QVERIFY(! pb.get(100000));
+}
+
+void TestPlayoutBuffer::late() {
+	JitterHistogram jh;
+	PlayoutBuffer pb(iFrameSize, iSampleRate, &jh, 95.0f, 0);
+
+	QVERIFY(put(pb, 2, 40000));
+	QVERIFY(pb.get(50000));
+	QVERIFY(! put(pb, 0, 60000));
+	QVERIFY(! put(pb, 2, 60000));
+	QCOMPARE(pb.iLate, 2U);
+	QVERIFY(put(pb, 4, 60000));
+}
+
+void TestPlayoutBuffer::lostAndUnderrun() {
+	JitterHistogram jh;
+	PlayoutBuffer pb(iFrameSize, iSampleRate, &jh, 95.0f, 0);
+
+	QVERIFY(put(pb, 0, 20000));
+	QVERIFY(put(pb, 4, 60000));
+
+	QVERIFY(pb.get(70000));
+	// Packet 2 is missing while 4 is there, so both its frames are lost.
+	QVERIFY(! pb.get(80000));
+	QVERIFY(! pb.get(90000));
+	QCOMPARE(pb.iLost, 2U);
+	const VoicePacket *vp = pb.get(100000);
+	QVERIFY(vp);
+	QCOMPARE(vp->iSeq, 4U);
+
+	// Nothing is waiting, so packet 6 may still come.
+	QVERIFY(! pb.get(120000));
+	QCOMPARE(pb.iUnderruns, 1U);
+	QCOMPARE(pb.iLost, 2U);
+	QVERIFY(put(pb, 6, 125000));
+	vp = pb.get(130000);
+	QVERIFY(vp);
+	QCOMPARE(vp->iSeq, 6U);
+}
+
+void TestPlayoutBuffer::start() {
+	JitterHistogram jh;
+	PlayoutBuffer pb(iFrameSize, iSampleRate, &jh, 95.0f, 30000);
+
+	QVERIFY(! pb.ready(0));
+	QVERIFY(put(pb, 0, 20000));
+	QVERIFY(! pb.ready(40000));
+	QVERIFY(pb.ready(50000));
+	QVERIFY(! pb.started());
+
+	// A burst of packets that spans the target starts playout at once.
+	PlayoutBuffer burst(iFrameSize, iSampleRate, &jh, 95.0f, 30000);
+	QVERIFY(put(burst, 0, 20000));
+	QVERIFY(! burst.ready(20000));
+	QVERIFY(put(burst, 2, 20000));
+	QVERIFY(burst.ready(20000));
+}
+
+void TestPlayoutBuffer::target() {
+	JitterHistogram jh;
+	PlayoutBuffer pb(iFrameSize, iSampleRate, &jh, 95.0f, 10000);
+
+	// Without jitter, the minimum applies.
+	for (unsigned int i = 0; i < 50; ++i)
+		put(pb, 2 * i, 2 * i * uiFrameLength + 20000);
+	QCOMPARE(pb.targetDelay(), 10000);
+
+	// Every fifth packet is 40ms late, which the 95th percentile covers.
+	for (unsigned int i = 50; i < 300; ++i)
+		put(pb, 2 * i, 2 * i * uiFrameLength + 20000 + ((i % 5) ? 0 : 40000));
+	QVERIFY(pb.targetDelay() >= 40000);
+	QVERIFY(pb.targetDelay() <= 40000 + JitterHistogram::iBinWidth);
+
+	// The histogram outlives the buffer.
+	PlayoutBuffer next(iFrameSize, iSampleRate, &jh, 95.0f, 10000);
+	QCOMPARE(next.targetDelay(), pb.targetDelay());
+	PlayoutBuffer median(iFrameSize, iSampleRate, &jh, 50.0f, 10000);
+	QCOMPARE(median.targetDelay(), 10000);
+}
+
+// A signal with a period of 100 samples can be cut or extended by two
+// periods without a trace.
+void TestPlayoutBuffer::stretchPeriodic() {
+	QVector<float> signal(2 * iFrameSize);
+	for (int i = 0; i < signal.size(); ++i)
+		signal[i] = 0.5f * sinf(static_cast<float>(2.0 * M_PI * i / 100.0)) + 0.2f * sinf(static_cast<float>(6.0 * M_PI * i / 100.0));
+
+	QVector<float> buf = signal.mid(0, iFrameSize);
+	QCOMPARE(TimeStretch::shorten(buf.data(), iFrameSize, 120, 240), iFrameSize - 200);
+	for (unsigned int i = 0; i < iFrameSize - 200; ++i)
+		QVERIFY(qAbs(buf[i] - signal[i]) < 1e-4f);
+
+	buf = signal.mid(0, iFrameSize);
+	buf.resize(iFrameSize + 240);
+	QCOMPARE(TimeStretch::lengthen(buf.data(), iFrameSize, 120, 240), iFrameSize + 200);
+	for (unsigned int i = 0; i < iFrameSize + 200; ++i)
+		QVERIFY(qAbs(buf[i] - signal[i]) < 1e-4f);
+}
+
+// Noise has no period, so stretching it would be audible. Silence can
+// be stretched anywhere.
+void TestPlayoutBuffer::stretchNoise() {
+	QVector<float> noise(iFrameSize + 240);
+	quint32 r = 1;
+	for (unsigned int i = 0; i < iFrameSize; ++i) {
+		r = r * 1103515245U + 12345U;
+		noise[i] = static_cast<float>((r >> 8) & 0xffff) / 32768.0f - 1.0f;
+	}
+	const QVector<float> copy = noise;
+
+	QCOMPARE(TimeStretch::shorten(noise.data(), iFrameSize, 120, 240), iFrameSize);
+	QCOMPARE(TimeStretch::lengthen(noise.data(), iFrameSize, 120, 240), iFrameSize);
+	QCOMPARE(noise, copy);
+
+	QVector<float> silence(iFrameSize + 240);
+	QVERIFY(TimeStretch::shorten(silence.data(), iFrameSize, 120, 240) < iFrameSize);
+	QVERIFY(TimeStretch::lengthen(silence.data(), iFrameSize, 120, 240) > iFrameSize);
+}
+
+QTEST_MAIN(TestPlayoutBuffer)
+#include "TestPlayoutBuffer.moc"
@@ -0,0 +1,178 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "PositionBuffer.h"
+
+// A sample with every coordinate set to v.
+static PositionSample sample(float v, bool valid = true) {
+	PositionSample ps;
+	ps.uiTime = 0;
+	ps.bValid = valid;
+	for (int i = 0; i < 3; ++i)
+		ps.fPosition[i] = ps.fFront[i] = ps.fTop[i] = ps.fCameraPosition[i] = ps.fCameraFront[i] = ps.fCameraTop[i] = v;
+	return ps;
+}
+
+// Whether every coordinate of ps is the same, and returns it in v.
+static bool uniform(const PositionSample &ps, float &v) {
+	v = ps.fPosition[0];
+	for (int i = 0; i < 3; ++i)
+		if ((ps.fPosition[i] != v) || (ps.fFront[i] != v) || (ps.fTop[i] != v) || (ps.fCameraPosition[i] != v) || (ps.fCameraFront[i] != v) || (ps.fCameraTop[i] != v))
+			return false;
+	return true;
+}
+
+class TestPositionBuffer : public QObject {
+		Q_OBJECT
+	private slots:
+		void empty();
+		void latest();
+		void interpolate();
+		void invalid();
+		void stalled();
+		void threads();
+};
+
+void TestPositionBuffer::empty() {
+	PositionBuffer pb;
+	PositionBuffer::Reader r;
+	PositionSample older, newer;
+	QVERIFY(! pb.read(r, older, newer));
+	QVERIFY(! pb.latest(r, newer));
+	QVERIFY(! pb.interpolated(r, newer));
+}
+
+void TestPositionBuffer::latest() {
+	PositionBuffer pb;
+	PositionBuffer::Reader r;
+	PositionSample older, newer;
+
+	pb.publish(sample(1.0f));
+	QVERIFY(pb.read(r, older, newer));
+	QCOMPARE(older.fPosition[0], 1.0f);
+	QCOMPARE(newer.fPosition[0], 1.0f);
+
+	for (int i = 2; i < 10; ++i) {
+		pb.publish(sample(static_cast<float>(i)));
+		QVERIFY(pb.read(r, older, newer));
+		QCOMPARE(older.fPosition[0], static_cast<float>(i - 1));
+		QCOMPARE(newer.fPosition[0], static_cast<float>(i));
+		QVERIFY(older.uiTime <= newer.uiTime);
+
+		QVERIFY(pb.latest(r, newer));
+		QCOMPARE(newer.fCameraTop[2], static_cast<float>(i));
+	}
+}
+
+// Right after a sample is published the result is near the older one,
+// and an interval later it is the newer one.
+void TestPositionBuffer::interpolate() {
+	PositionBuffer pb;
+	PositionBuffer::Reader r;
+	PositionSample ps;
+	float v;
+
+	pb.publish(sample(0.0f));
+	QTest::qSleep(50);
+	pb.publish(sample(10.0f));
+
+	QVERIFY(pb.interpolated(r, ps));
+	QVERIFY(uniform(ps, v));
+	QVERIFY(v >= 0.0f);
+	QVERIFY(v < 5.0f);
+
+	QTest::qSleep(100);
+	QVERIFY(pb.interpolated(r, ps));
+	QVERIFY(uniform(ps, v));
+	QCOMPARE(v, 10.0f);
+}
+
+// Invalid samples are never interpolated into.
+void TestPositionBuffer::invalid() {
+	PositionBuffer pb;
+	PositionBuffer::Reader r;
+	PositionSample ps;
+
+	pb.publish(sample(1.0f));
+	pb.publish(sample(2.0f, false));
+	QVERIFY(! pb.latest(r, ps));
+	QVERIFY(! pb.interpolated(r, ps));
+
+	pb.publish(sample(3.0f));
+	QVERIFY(pb.latest(r, ps));
+	QVERIFY(pb.interpolated(r, ps));
+	QCOMPARE(ps.fPosition[0], 3.0f);
+}
+
+// A buffer whose writer can be stopped halfway through publishing.
+class StalledBuffer : public PositionBuffer {
+	public:
+		void stall() {
+			qaiVersion[iPublished % 2].fetchAndAddOrdered(1);
+		}
+};
+
+// A reader doesn't wait for a stalled writer, but falls back to the
+// samples it read last, if it has any.
+void TestPositionBuffer::stalled() {
+	StalledBuffer pb;
+	PositionBuffer::Reader r, fresh;
+	PositionSample older, newer;
+
+	pb.publish(sample(1.0f));
+	pb.publish(sample(2.0f));
+	QVERIFY(pb.read(r, older, newer));
+
+	pb.stall();
+	QVERIFY(! pb.read(fresh, older, newer));
+	QVERIFY(pb.read(r, older, newer));
+	QCOMPARE(older.fPosition[0], 1.0f);
+	QCOMPARE(newer.fPosition[0], 2.0f);
+	QVERIFY(pb.latest(r, newer));
+	QCOMPARE(newer.fPosition[0], 2.0f);
+}
+
+class Sampler : public QThread {
+	public:
+		PositionBuffer *pbBuffer;
+		int iCount;
+		void run() Q_DECL_OVERRIDE {
+			for (int i = 1; i <= iCount; ++i)
+				pbBuffer->publish(sample(static_cast<float>(i)));
+		}
+};
+
+// Readers never see a sample that is half written, and the two latest
+// samples are always neighbours.
+void TestPositionBuffer::threads() {
+	PositionBuffer pb;
+	Sampler sampler;
+	sampler.pbBuffer = &pb;
+	sampler.iCount = 1000000;
+	sampler.start();
+
+	PositionBuffer::Reader r;
+	PositionSample older, newer;
+	float o, n, last = 0.0f;
+	while (! sampler.isFinished()) {
+		if (! pb.read(r, older, newer))
+			continue;
+		QVERIFY(uniform(older, o));
+		QVERIFY(uniform(newer, n));
+		QVERIFY((n == o + 1.0f) || ((n == 1.0f) && (o == 1.0f)));
+		QVERIFY(n >= last);
+		last = n;
+	}
+
+	sampler.wait();
+	QVERIFY(pb.read(r, older, newer));
+	QCOMPARE(newer.fPosition[0], static_cast<float>(sampler.iCount));
+}
+
+QTEST_MAIN(TestPositionBuffer)
+#include "TestPositionBuffer.moc"
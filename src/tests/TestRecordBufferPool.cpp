@@ -0,0 +1,119 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "RecordBufferPool.h"
+
+class TestRecordBufferPool : public QObject {
+		Q_OBJECT
+	private slots:
+		void exhaust();
+		void recycleOutOfOrder();
+		void threads();
+};
+
+void TestRecordBufferPool::exhaust() {
+	RecordBufferPool pool(4, 16);
+	QCOMPARE(pool.bufferSamples(), 16U);
+
+	QList<RecordBuffer *> taken;
+	for (int i = 0; i < 4; ++i) {
+		RecordBuffer *rb = pool.reserve();
+		QVERIFY(rb);
+		QCOMPARE(pool.reserve(), rb);
+		rb->iIndex = i;
+		pool.commit();
+	}
+	QVERIFY(! pool.reserve());
+	QCOMPARE(pool.queued(), 4);
+
+	for (int i = 0; i < 4; ++i) {
+		RecordBuffer *rb = pool.take();
+		QVERIFY(rb);
+		QCOMPARE(rb->iIndex, i);
+		taken << rb;
+	}
+	QVERIFY(! pool.take());
+	QVERIFY(! pool.reserve());
+
+	pool.recycle(taken.at(2));
+	QCOMPARE(pool.reserve(), taken.at(2));
+}
+
+// Buffers come back in whatever order the writers finish them, and
+// never overlap.
+void TestRecordBufferPool::recycleOutOfOrder() {
+	RecordBufferPool pool(8, 4);
+	QList<RecordBuffer *> taken;
+
+	for (int round = 0; round < 100; ++round) {
+		while (RecordBuffer *rb = pool.reserve()) {
+			for (int i = 0; i < 4; ++i)
+				rb->pfSamples[i] = static_cast<float>(round);
+			pool.commit();
+		}
+		while (RecordBuffer *rb = pool.take())
+			taken << rb;
+		QCOMPARE(taken.count(), 8);
+
+		foreach(RecordBuffer *rb, taken)
+			for (int i = 0; i < 4; ++i)
+				QCOMPARE(rb->pfSamples[i], static_cast<float>(round));
+
+		for (int i = 0; i < taken.count(); i += 2)
+			pool.recycle(taken.at(i));
+		for (int i = taken.count() - 1; i > 0; i -= 2)
+			pool.recycle(taken.at(i));
+		taken.clear();
+	}
+}
+
+class Producer : public QThread {
+	public:
+		RecordBufferPool *rbpPool;
+		int iCount;
+		void run() Q_DECL_OVERRIDE {
+			for (int n = 0; n < iCount; ++n) {
+				RecordBuffer *rb;
+				while (! (rb = rbpPool->reserve()))
+					QThread::yieldCurrentThread();
+				rb->iIndex = n;
+				rb->iSamples = rbpPool->bufferSamples();
+				for (unsigned int i = 0; i < rb->iSamples; ++i)
+					rb->pfSamples[i] = static_cast<float>(n % 65536);
+				rbpPool->commit();
+			}
+		}
+};
+
+// Everything the producer queues arrives in order and intact.
+void TestRecordBufferPool::threads() {
+	RecordBufferPool pool(16, 64);
+	Producer producer;
+	producer.rbpPool = &pool;
+	producer.iCount = 200000;
+	producer.start();
+
+	for (int n = 0; n < producer.iCount; ) {
+		RecordBuffer *rb = pool.take();
+		if (! rb) {
+			QThread::yieldCurrentThread();
+			continue;
+		}
+		QCOMPARE(rb->iIndex, n);
+		for (unsigned int i = 0; i < rb->iSamples; ++i)
+			QCOMPARE(rb->pfSamples[i], static_cast<float>(n % 65536));
+		pool.recycle(rb);
+		++n;
+	}
+
+	producer.wait();
+	QVERIFY(! pool.take());
+}
+
+QTEST_MAIN(TestRecordBufferPool)
+#include "TestRecordBufferPool.moc"
@@ -0,0 +1,9 @@
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib
+CONFIG -= app_bundle
+LANGUAGE = C++
+TARGET = TestRecordBufferPool
+SOURCES = TestRecordBufferPool.cpp
+HEADERS = RecordBufferPool.h
+VPATH += ../mumble
+INCLUDEPATH += .. ../mumble
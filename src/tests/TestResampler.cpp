@@ -0,0 +1,234 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "AudioMix.h"
+#include "Resampler.h"
+
+class TestResampler : public QObject {
+		Q_OBJECT
+	private:
+		static QVector<float> sine(unsigned int rate, double freq, unsigned int n);
+		static double snr(const QVector<float> &out, unsigned int rate, double freq, unsigned int skip);
+	private slots:
+		void initTestCase();
+		void frames_data();
+		void frames();
+		void dc_data();
+		void dc();
+		void tone_data();
+		void tone();
+		void chunks();
+		void channels();
+		void reset();
+};
+
+QVector<float> TestResampler::sine(unsigned int rate, double freq, unsigned int n) {
+	QVector<float> v(n);
+	for (unsigned int i = 0; i < n; ++i)
+		v[i] = static_cast<float>(0.5 * sin(2.0 * M_PI * freq * i / rate));
+	return v;
+}
+
+// Fits a tone at freq to out[skip...] and returns the ratio of its
+// power to that of the rest in dB.
+double TestResampler::snr(const QVector<float> &out, unsigned int rate, double freq, unsigned int skip) {
+	double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+	for (int k = skip; k < out.size(); ++k) {
+		const double t = 2.0 * M_PI * freq * k / rate;
+		ss += sin(t) * sin(t);
+		cc += cos(t) * cos(t);
+		sc += sin(t) * cos(t);
+		ys += out[k] * sin(t);
+		yc += out[k] * cos(t);
+	}
+	const double det = ss * cc - sc * sc;
+	const double a = (ys * cc - yc * sc) / det;
+	const double b = (yc * ss - ys * sc) / det;
+
+	double signal = 0.0, noise = 0.0;
+	for (int k = skip; k < out.size(); ++k) {
+		const double t = 2.0 * M_PI * freq * k / rate;
+		const double fit = a * sin(t) + b * cos(t);
+		signal += fit * fit;
+		noise += (out[k] - fit) * (out[k] - fit);
+	}
+	return 10.0 * log10(signal / noise);
+}
+
+void TestResampler::initTestCase() {
+	qWarning("Using %s kernels", AudioMix::implementation());
+}
+
+void TestResampler::frames_data() {
+	QTest::addColumn<unsigned int>("in");
+	QTest::addColumn<unsigned int>("out");
+
+	QTest::newRow("44100") << 44100U << 48000U;
+	QTest::newRow("16000") << 16000U << 48000U;
+	QTest::newRow("96000") << 96000U << 48000U;
+	QTest::newRow("48000 to 44100") << 48000U << 44100U;
+}
+
+// Like speex, a 10ms frame in gives a 10ms frame out, from the first
+// frame on.
+void TestResampler::frames() {
+	QFETCH(unsigned int, in);
+	QFETCH(unsigned int, out);
+
+	Resampler r(1, in, out, 3);
+	QVector<float> input(in / 100), output(out / 100);
+	for (int i = 0; i < 20; ++i) {
+		unsigned int inlen = input.size();
+		unsigned int outlen = output.size();
+		r.process(input.constData(), inlen, output.data(), outlen);
+		QCOMPARE(inlen, in / 100);
+		QCOMPARE(outlen, out / 100);
+	}
+}
+
+void TestResampler::dc_data() {
+	frames_data();
+	QTest::newRow("uneven") << 47999U << 48000U;
+}
+
+// Once the filter is full, a constant stays constant, in every phase.
+void TestResampler::dc() {
+	QFETCH(unsigned int, in);
+	QFETCH(unsigned int, out);
+
+	Resampler r(1, in, out, 3);
+	QVector<float> input(in / 10, 0.25f), output(out / 10 + 1);
+	unsigned int inlen = input.size();
+	unsigned int outlen = output.size();
+	r.process(input.constData(), inlen, output.data(), outlen);
+
+	const unsigned int skip = (r.taps() * out) / in + 2;
+	QVERIFY(outlen > skip);
+	for (unsigned int i = skip; i < outlen; ++i)
+		QVERIFY(qAbs(output[i] - 0.25f) < 1e-5f);
+}
+
+void TestResampler::tone_data() {
+	QTest::addColumn<unsigned int>("in");
+	QTest::addColumn<unsigned int>("out");
+	QTest::addColumn<int>("quality");
+	QTest::addColumn<double>("freq");
+	QTest::addColumn<double>("minSnr");
+
+	QTest::newRow("44100 q3") << 44100U << 48000U << 3 << 1000.0 << 85.0;
+	QTest::newRow("44100 q3 high") << 44100U << 48000U << 3 << 15000.0 << 85.0;
+	QTest::newRow("48000 to 44100 q3") << 48000U << 44100U << 3 << 1000.0 << 85.0;
+	QTest::newRow("16000 q3") << 16000U << 48000U << 3 << 1000.0 << 85.0;
+	QTest::newRow("48000 to 96000 q3") << 48000U << 96000U << 3 << 1000.0 << 85.0;
+	QTest::newRow("44100 q10") << 44100U << 48000U << 10 << 1000.0 << 120.0;
+	QTest::newRow("uneven") << 47999U << 48000U << 3 << 1000.0 << 85.0;
+	QTest::newRow("q0") << 44100U << 48000U << 0 << 1000.0 << 60.0;
+}
+
+void TestResampler::tone() {
+	QFETCH(unsigned int, in);
+	QFETCH(unsigned int, out);
+	QFETCH(int, quality);
+	QFETCH(double, freq);
+	QFETCH(double, minSnr);
+
+	Resampler r(1, in, out, quality);
+	const QVector<float> input = sine(in, freq, in / 2);
+	QVector<float> output(out / 2 + 1);
+	unsigned int inlen = input.size();
+	unsigned int outlen = output.size();
+	r.process(input.constData(), inlen, output.data(), outlen);
+	QCOMPARE(inlen, static_cast<unsigned int>(input.size()));
+	output.resize(outlen);
+
+	const double s = snr(output, out, freq, out / 20);
+	QVERIFY2(s >= minSnr, qPrintable(QString::number(s)));
+}
+
+// How the input and output are cut into calls makes no difference. Calls
+// whose output fills up don't take all input.
+void TestResampler::chunks() {
+	const QVector<float> input = sine(44100, 440.0, 4410);
+
+	Resampler whole(1, 44100, 48000, 3);
+	QVector<float> expected(4800);
+	unsigned int inlen = input.size();
+	unsigned int outlen = expected.size();
+	whole.process(input.constData(), inlen, expected.data(), outlen);
+	QCOMPARE(outlen, 4800U);
+
+	Resampler parts(1, 44100, 48000, 3);
+	QVector<float> output(4800);
+	unsigned int consumed = 0, produced = 0;
+	while (produced < 4800U) {
+		inlen = qMin(97U, input.size() - consumed);
+		outlen = qMin(61U, 4800U - produced);
+		parts.process(input.constData() + consumed, inlen, output.data() + produced, outlen);
+		consumed += inlen;
+		produced += outlen;
+	}
+	QCOMPARE(consumed, 4410U);
+	QCOMPARE(output, expected);
+
+	// With room for only one sample, only what fits in the history is
+	// taken.
+	Resampler small(1, 44100, 48000, 3);
+	inlen = input.size();
+	outlen = 1;
+	small.process(input.constData(), inlen, output.data(), outlen);
+	QCOMPARE(outlen, 1U);
+	QVERIFY(inlen < static_cast<unsigned int>(input.size()));
+}
+
+// Interleaved channels are resampled independently.
+void TestResampler::channels() {
+	const QVector<float> left = sine(44100, 440.0, 4410);
+	const QVector<float> right = sine(44100, 3000.0, 4410);
+	QVector<float> stereo(2 * 4410);
+	for (int i = 0; i < 4410; ++i) {
+		stereo[2 * i] = left[i];
+		stereo[2 * i + 1] = right[i];
+	}
+
+	Resampler rs(2, 44100, 48000, 3);
+	QVector<float> output(2 * 4800);
+	unsigned int inlen = 4410;
+	unsigned int outlen = 4800;
+	rs.process(stereo.constData(), inlen, output.data(), outlen);
+	QCOMPARE(outlen, 4800U);
+
+	const QVector<float> *channels[2] = { &left, &right };
+	for (int c = 0; c < 2; ++c) {
+		Resampler rm(1, 44100, 48000, 3);
+		QVector<float> mono(4800);
+		inlen = 4410;
+		outlen = 4800;
+		rm.process(channels[c]->constData(), inlen, mono.data(), outlen);
+		for (int i = 0; i < 4800; ++i)
+			QCOMPARE(output[2 * i + c], mono[i]);
+	}
+}
+
+void TestResampler::reset() {
+	const QVector<float> input = sine(16000, 440.0, 1600);
+	Resampler r(1, 16000, 48000, 3);
+
+	QVector<float> first(4800), second(4800);
+	unsigned int inlen = 1600, outlen = 4800;
+	r.process(input.constData(), inlen, first.data(), outlen);
+
+	r.reset();
+	inlen = 1600;
+	outlen = 4800;
+	r.process(input.constData(), inlen, second.data(), outlen);
+	QCOMPARE(second, first);
+	QCOMPARE(r.inputLatency(), r.taps() / 2);
+}
+
+QTEST_MAIN(TestResampler)
+#include "TestResampler.moc"
@@ -0,0 +1,95 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "SampleRing.h"
+
+class TestSampleRing : public QObject {
+		Q_OBJECT
+	private slots:
+		void wrap();
+		void full();
+		void threads();
+};
+
+// Odd sizes, so that reads and writes straddle the end of the ring.
+void TestSampleRing::wrap() {
+	SampleRing ring(100);
+	QCOMPARE(ring.available(), 0U);
+	QCOMPARE(ring.space(), 100U);
+
+	float in[37], out[37];
+	float next = 0.0f, expected = 0.0f;
+	for (int round = 0; round < 50; ++round) {
+		for (int i = 0; i < 37; ++i)
+			in[i] = next++;
+		ring.write(in, 37);
+		QCOMPARE(ring.available(), 37U);
+
+		QCOMPARE(ring.read(out, 30), 30U);
+		QCOMPARE(ring.read(out + 30, 30), 7U);
+		for (int i = 0; i < 37; ++i)
+			QCOMPARE(out[i], expected++);
+		QCOMPARE(ring.available(), 0U);
+	}
+}
+
+void TestSampleRing::full() {
+	SampleRing ring(64);
+	float buf[64] = { 0.0f };
+	ring.write(buf, 64);
+	QCOMPARE(ring.space(), 0U);
+	QCOMPARE(ring.available(), 64U);
+
+	QCOMPARE(ring.read(buf, 10), 10U);
+	QCOMPARE(ring.space(), 10U);
+}
+
+class Producer : public QThread {
+	public:
+		SampleRing *srRing;
+		unsigned int uiCount;
+		void run() Q_DECL_OVERRIDE {
+			float buf[480];
+			unsigned int written = 0;
+			while (written < uiCount) {
+				const unsigned int n = qMin(uiCount - written, 1 + written % 480);
+				while (srRing->space() < n)
+					QThread::yieldCurrentThread();
+				for (unsigned int i = 0; i < n; ++i)
+					buf[i] = static_cast<float>((written + i) % 65536);
+				srRing->write(buf, n);
+				written += n;
+			}
+		}
+};
+
+// Everything the producer writes arrives in order and intact.
+void TestSampleRing::threads() {
+	SampleRing ring(2048);
+	Producer producer;
+	producer.srRing = &ring;
+	producer.uiCount = 2000000;
+	producer.start();
+
+	float buf[256];
+	unsigned int read = 0;
+	while (read < producer.uiCount) {
+		const unsigned int n = ring.read(buf, 1 + read % 256);
+		for (unsigned int i = 0; i < n; ++i)
+			QCOMPARE(buf[i], static_cast<float>((read + i) % 65536));
+		read += n;
+		if (! n)
+			QThread::yieldCurrentThread();
+	}
+
+	producer.wait();
+	QCOMPARE(ring.available(), 0U);
+}
+
+QTEST_MAIN(TestSampleRing)
+#include "TestSampleRing.moc"
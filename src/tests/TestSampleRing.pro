@@ -0,0 +1,9 @@
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib
+CONFIG -= app_bundle
+LANGUAGE = C++
+TARGET = TestSampleRing
+SOURCES = TestSampleRing.cpp
+HEADERS = SampleRing.h
+VPATH += ../mumble
+INCLUDEPATH += .. ../mumble
@@ -0,0 +1,114 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "TimerWheel.h"
+
+class TestTimerWheel : public QObject {
+		Q_OBJECT
+	private slots:
+		void expire();
+		void reschedule();
+		void cancel();
+		void longDeadline();
+		void randomized();
+};
+
+void TestTimerWheel::expire() {
+	TimerWheel tw(1000);
+
+	tw.schedule(1, 3000);
+	tw.schedule(2, 5500);
+	QCOMPARE(tw.count(), 2);
+
+	QVERIFY(tw.advance(2999).isEmpty());
+
+	QList<unsigned int> ql = tw.advance(3000);
+	QCOMPARE(ql.count(), 1);
+	QCOMPARE(ql.at(0), 1U);
+
+	// 5500 rounds up to the 6000 tick.
+	QVERIFY(tw.advance(5999).isEmpty());
+	QCOMPARE(tw.advance(6000).count(), 1);
+	QCOMPARE(tw.count(), 0);
+}
+
+void TestTimerWheel::reschedule() {
+	TimerWheel tw(1000);
+
+	tw.schedule(7, 10000);
+	for (quint64 t = 1000; t < 60000; t += 1000) {
+		QVERIFY(tw.advance(t).isEmpty());
+		tw.schedule(7, t + 10000);
+	}
+	QVERIFY(tw.contains(7));
+	QCOMPARE(tw.advance(69000).count(), 1);
+	QVERIFY(! tw.contains(7));
+
+	// A deadline in the past fires on the next tick.
+	tw.schedule(8, 0);
+	QCOMPARE(tw.advance(70000).count(), 1);
+}
+
+void TestTimerWheel::cancel() {
+	TimerWheel tw(1000);
+
+	tw.schedule(1, 2000);
+	tw.schedule(2, 2000);
+	QVERIFY(tw.cancel(1));
+	QVERIFY(! tw.cancel(1));
+
+	QList<unsigned int> ql = tw.advance(2000);
+	QCOMPARE(ql.count(), 1);
+	QCOMPARE(ql.at(0), 2U);
+}
+
+void TestTimerWheel::longDeadline() {
+	TimerWheel tw(1);
+
+	// Beyond the range of the top level; must still fire on time.
+	const quint64 deadline = 1ULL << 26;
+	tw.schedule(1, deadline);
+	QVERIFY(tw.advance(deadline - 1).isEmpty());
+	QCOMPARE(tw.advance(deadline).count(), 1);
+}
+
+void TestTimerWheel::randomized() {
+	TimerWheel tw(10);
+	QMap<unsigned int, quint64> expected;
+	quint64 now = 0;
+
+	qsrand(1);
+	for (int i = 0; i < 200000; ++i) {
+		unsigned int key = static_cast<unsigned int>(qrand() % 500);
+		int op = qrand() % 10;
+		if (op < 6) {
+			quint64 deadline = now + static_cast<quint64>(qrand() % 100000);
+			tw.schedule(key, deadline);
+			quint64 tick = (deadline + 9) / 10;
+			if (tick <= now / 10)
+				tick = now / 10 + 1;
+			expected.insert(key, tick);
+		} else if (op < 7) {
+			tw.cancel(key);
+			expected.remove(key);
+		} else {
+			now += static_cast<quint64>(qrand() % 500);
+			foreach(unsigned int k, tw.advance(now)) {
+				QVERIFY(expected.contains(k));
+				QVERIFY(expected.value(k) <= now / 10);
+				expected.remove(k);
+			}
+			foreach(quint64 tick, expected)
+				QVERIFY(tick > now / 10);
+		}
+		QCOMPARE(tw.count(), expected.count());
+	}
+}
+
+QTEST_MAIN(TestTimerWheel)
+#include "TestTimerWheel.moc"
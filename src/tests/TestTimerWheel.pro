@@ -0,0 +1,10 @@
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib
+CONFIG -= app_bundle
+QT += network sql xml
+LANGUAGE = C++
+TARGET = TestTimerWheel
+SOURCES = TestTimerWheel.cpp TimerWheel.cpp
+HEADERS = TimerWheel.h
+VPATH += ../murmur
+INCLUDEPATH += .. ../murmur
@@ -0,0 +1,94 @@
+// Copyright 2005-2016 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <QtCore>
+#include <QtTest>
+
+#include "VoicePacketRing.h"
+
+class TestVoicePacketRing : public QObject {
+		Q_OBJECT
+	private slots:
+		void order();
+		void full();
+		void threads();
+};
+
+void TestVoicePacketRing::order() {
+	VoicePacketRing ring;
+	QVERIFY(! ring.front());
+
+	for (unsigned int round = 0; round < 3; ++round) {
+		for (unsigned int i = 0; i < 40; ++i) {
+			VoicePacket *vp = ring.reserve();
+			QVERIFY(vp);
+			vp->iSeq = round * 100 + i;
+			vp->iSize = 1;
+			ring.commit();
+		}
+		for (unsigned int i = 0; i < 40; ++i) {
+			const VoicePacket *vp = ring.front();
+			QVERIFY(vp);
+			QCOMPARE(vp->iSeq, round * 100 + i);
+			ring.pop();
+		}
+		QVERIFY(! ring.front());
+	}
+}
+
+void TestVoicePacketRing::full() {
+	VoicePacketRing ring;
+	for (int i = 0; i < VoicePacketRing::iSlots - 1; ++i) {
+		QVERIFY(ring.reserve());
+		ring.commit();
+	}
+	QVERIFY(! ring.reserve());
+
+	ring.pop();
+	QVERIFY(ring.reserve());
+}
+
+class Producer : public QThread {
+	public:
+		VoicePacketRing *vprRing;
+		unsigned int uiCount;
+		void run() Q_DECL_OVERRIDE {
+			for (unsigned int i = 0; i < uiCount; ++i) {
+				VoicePacket *vp;
+				while (! (vp = vprRing->reserve()))
+					QThread::yieldCurrentThread();
+				vp->iSeq = i;
+				vp->iSize = sizeof(unsigned int);
+				memcpy(vp->cData, &i, sizeof(i));
+				vprRing->commit();
+			}
+		}
+};
+
+// Everything the producer writes arrives in order and intact.
+void TestVoicePacketRing::threads() {
+	VoicePacketRing ring;
+	Producer producer;
+	producer.vprRing = &ring;
+	producer.uiCount = 200000;
+	producer.start();
+
+	for (unsigned int i = 0; i < producer.uiCount; ++i) {
+		const VoicePacket *vp;
+		while (! (vp = ring.front()))
+			QThread::yieldCurrentThread();
+		unsigned int data;
+		memcpy(&data, vp->cData, sizeof(data));
+		QCOMPARE(vp->iSeq, i);
+		QCOMPARE(data, i);
+		ring.pop();
+	}
+
+	producer.wait();
+	QVERIFY(! ring.front());
+}
+
+QTEST_MAIN(TestVoicePacketRing)
+#include "TestVoicePacketRing.moc"
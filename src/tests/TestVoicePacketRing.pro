@@ -0,0 +1,9 @@
+TEMPLATE = app
+CONFIG += qt warn_on qtestlib
+CONFIG -= app_bundle
+LANGUAGE = C++
+TARGET = TestVoicePacketRing
+SOURCES = TestVoicePacketRing.cpp
+HEADERS = VoicePacketRing.h
+VPATH += ../mumble
+INCLUDEPATH += .. ../mumble